@@ -11,6 +11,76 @@ constexpr int MAX_STRING_LENGTH = 256;
 constexpr int DEFAULT_TIMEOUT = 1000;  // ms
 constexpr int POLLING_INTERVAL = 1000; // ms
 constexpr int BANDWIDTH_WINDOW = 5000; // ms
+constexpr int RATE_BUCKET_WIDTH = 50;  // ms
+constexpr int RATE_WINDOW_BUCKETS = BANDWIDTH_WINDOW / RATE_BUCKET_WIDTH;
+
+constexpr int SAMPLING_TICK = 50;               // ms
+constexpr int SAMPLING_MIN_INTERVAL = 50;       // ms
+constexpr int SAMPLING_MAX_INTERVAL = 8000;     // ms
+constexpr int SAMPLING_VISIBLE_INTERVAL = 250;  // ms
+constexpr double SAMPLING_CPU_BUDGET = 0.02;    // 2% of one core
+
+constexpr int MAX_ARRIVAL_WORKERS = 8;
+constexpr int TRANSFER_POOL_SIZE = 32;
+constexpr int TRANSFER_BUFFER_SIZE = 16384; // bytes
+constexpr int MAX_ISO_PACKETS = 32;
+constexpr int HOTPLUG_DEBOUNCE_WINDOW = 250; // ms
+constexpr int HOTPLUG_FLOOD_WINDOW = 10;      // s over which a port's arrivals are counted
+constexpr int HOTPLUG_FLOOD_ARRIVALS = 20;    // arrivals per window before a port is blocked
+constexpr int HOTPLUG_FLOOD_DESCRIPTOR_CHANGES = 4;    // different devices per window
+constexpr int HOTPLUG_FLOOD_BLOCK = 300;      // s a flooding port stays blocked
+constexpr int HOTPLUG_FLOOD_LOG_RATE = 10;    // arrival events logged per second, all ports
+constexpr int IDENTITY_RETENTION = 600;      // s
+constexpr int MAX_RETAINED_IDENTITIES = 1024;
+constexpr int MAX_ARRIVAL_HISTORY = 100000;   // arrivals kept for policy dry runs
+constexpr int ARRIVAL_LOG_FLUSH_INTERVAL = 1000;   // ms between arrival log writes
+
+constexpr int FLASH_BLOCK_SIZE = 1024;      // bytes, DFU wTransferSize
+constexpr int FLASH_PIPELINE_DEPTH = 8;     // bulk blocks in flight per device
+constexpr int FLASH_MAX_RETRIES = 3;
+constexpr int FLASH_SESSIONS_PER_BUS = 16;
+constexpr int FLASH_RETRY_BACKOFF = 200;    // ms
+constexpr int DFU_MAX_POLLS = 10000;
+
+constexpr int ANOMALY_ERROR_INTERVAL = 10;     // s, error-rate aggregation
+constexpr int ANOMALY_HOTPLUG_INTERVAL = 60;   // s, hotplug-rate aggregation
+constexpr int ANOMALY_SEASON_BINS = 24;        // hour-of-day baselines
+
+constexpr int USBMON_RING_BATCH = 256;         // events fetched per ioctl
+constexpr int URB_TABLE_CAPACITY = 8192;       // in-flight URBs tracked
+constexpr int URB_ORPHAN_TIMEOUT = 60;         // s before an unmatched S is dropped
+constexpr int URB_DEPTH_SLOT = 100;            // ms per in-flight depth sample
+constexpr int URB_DEPTH_SLOTS = 64;
+
+constexpr int MSC_HEATMAP_BUCKETS = 256;
+constexpr int MSC_MAX_PENDING = 32;            // BOT tags tracked per device
+constexpr int MSC_THROTTLE_MIN_BYTES = 65536;  // commands large enough to rate
+constexpr double MSC_THROTTLE_RATIO = 0.5;     // of the best sustained rate
+
+constexpr int HID_IDLE_PERIODS = 8;            // longer gaps are idle, not drops
+
+constexpr int AUDIO_PROBE_PACKETS = 256;       // packets to infer format and rate from
+constexpr int AUDIO_IDLE_GAP = 500;            // ms between completions of a stopped stream
+constexpr int AUDIO_GAP_SLACK = 2000;          // us of completion jitter tolerated
+
+constexpr int CDC_RESPONSE_TIMEOUT = 5000;     // ms before a serial request is unanswered
+
+constexpr int PERIODICITY_BIN = 250;           // us per activity bin
+constexpr int PERIODICITY_WINDOW = 4096;       // bins per analysis window, a power of two
+constexpr double PERIODICITY_MIN_CORRELATION = 0.3;
+
+constexpr int CAPTURE_SNAPLEN = 256;           // payload bytes kept per transfer
+constexpr int CAPTURE_BLOCK_SIZE = 65536;      // raw bytes per compressed block
+constexpr int CAPTURE_MEMORY_BUDGET = 64 * 1024 * 1024;
+constexpr int CAPTURE_ZSTD_LEVEL = 3;
+constexpr int CAPTURE_DICT_SIZE = 16384;
+constexpr int CAPTURE_DICT_TRAIN_BLOCKS = 4;   // blocks of a class sampled for its dictionary
+
+constexpr int EXFIL_WINDOW = 10;               // s a bulk write is measured over
+constexpr int EXFIL_BURST_BYTES = 64 * 1024 * 1024;    // written within the window
+constexpr double EXFIL_ENTROPY_THRESHOLD = 7.5;        // bits per byte; compressed or encrypted
+constexpr int EXFIL_SAMPLE_BUDGET = 8 * 1024 * 1024;   // payload bytes hashed per second, all devices
+constexpr int EXFIL_SAMPLE_BYTES = 4096;       // hashed per sampled write
 
 namespace ErrorCodes {
     constexpr int SUCCESS = 0;
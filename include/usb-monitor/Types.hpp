@@ -28,12 +28,33 @@ struct PowerStats {
     uint16_t maxPower;      // mA
 };
 
+struct EndpointBandwidth {
+    uint8_t address;        // bEndpointAddress
+    uint8_t interfaceNumber;
+    uint8_t transferType;   // LIBUSB_TRANSFER_TYPE_*
+    uint64_t bytes;
+    uint64_t packets;
+    double rate;            // bytes/sec
+    double packetRate;      // packets/sec
+    double peakRate;        // bytes/sec, busiest bucket
+};
+
+struct InterfaceBandwidth {
+    uint8_t interfaceNumber;
+    uint8_t interfaceClass;
+    uint64_t bytes;
+    double rate;            // bytes/sec
+    double peakRate;        // bytes/sec, busiest bucket
+};
+
 struct BandwidthStats {
     uint64_t bytesRead;
     uint64_t bytesWritten;
     double readSpeed;       // bytes/sec
     double writeSpeed;      // bytes/sec
     uint8_t speedClass;     // USB_SPEED_*
+    std::vector<EndpointBandwidth> endpoints;
+    std::vector<InterfaceBandwidth> interfaces;
 };
 
 enum class DeviceClass {
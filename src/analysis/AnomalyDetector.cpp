@@ -0,0 +1,243 @@
+// src/analysis/AnomalyDetector.cpp
+#include "AnomalyDetector.hpp"
+#include "ProtocolAnalyzer.hpp"
+#include "../core/DeviceManager.hpp"
+#include "../core/BandwidthMonitor.hpp"
+#include "../core/UsbDevice.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <QTimer>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+namespace {
+// Longest silence replayed as empty intervals; beyond that the interval
+// grid just jumps forward
+constexpr int MAX_GAP_INTERVALS = 64;
+
+DetectorConfig defaultConfig(AnomalyMetric metric) {
+    DetectorConfig config;
+    switch (metric) {
+        case AnomalyMetric::Throughput:
+            config.minDeviation = 1024.0;
+            config.seasonBins = ANOMALY_SEASON_BINS;
+            break;
+        case AnomalyMetric::ErrorRate:
+            config.minDeviation = 0.05;
+            break;
+        case AnomalyMetric::HotplugFrequency:
+            config.minDeviation = 1.0;
+            config.warmup = 10;
+            break;
+    }
+    return config;
+}
+} // namespace
+
+class AnomalyDetector::Private {
+public:
+    // Turns discrete events into a per-interval rate sample
+    struct EventCounter {
+        StreamingDetector detector;
+        std::chrono::system_clock::time_point start;
+        uint32_t events{0};
+        
+        explicit EventCounter(const DetectorConfig& config) : detector(config) {}
+    };
+    
+    std::unordered_map<std::string, StreamingDetector> throughput;
+    std::unordered_map<std::string, EventCounter> errors;
+    std::unordered_map<std::string, EventCounter> hotplug;
+    DetectorConfig configs[3]{
+        defaultConfig(AnomalyMetric::Throughput),
+        defaultConfig(AnomalyMetric::ErrorRate),
+        defaultConfig(AnomalyMetric::HotplugFrequency)
+    };
+    mutable std::mutex mutex;
+    QTimer* flushTimer{nullptr};
+    
+    const DetectorConfig& configFor(AnomalyMetric metric) const {
+        return configs[static_cast<int>(metric)];
+    }
+    
+    static void report(std::vector<AnomalyEvent>& events, const std::string& source,
+                       AnomalyMetric metric, const DetectorResult& result,
+                       std::chrono::system_clock::time_point when) {
+        if (result.kind == AnomalyKind::None) return;
+        events.push_back({source, metric, result.kind, result.value,
+                          result.expected, result.score, when});
+    }
+    
+    // Feeds every interval that ended before 'when'
+    static void close(EventCounter& counter, const std::string& source, AnomalyMetric metric,
+                      std::chrono::seconds interval, double scale,
+                      std::chrono::system_clock::time_point when,
+                      std::vector<AnomalyEvent>& events) {
+        int replayed = 0;
+        while (when >= counter.start + interval) {
+            if (replayed++ == MAX_GAP_INTERVALS) {
+                auto behind = (when - counter.start) / interval;
+                counter.start += behind * interval;
+                break;
+            }
+            double rate = counter.events * scale;
+            counter.events = 0;
+            counter.start += interval;
+            report(events, source, metric, counter.detector.update(rate, counter.start), counter.start);
+        }
+    }
+    
+    void count(std::unordered_map<std::string, EventCounter>& counters, const std::string& source,
+               AnomalyMetric metric, std::chrono::seconds interval, double scale,
+               std::chrono::system_clock::time_point when, std::vector<AnomalyEvent>& events) {
+        auto it = counters.find(source);
+        if (it == counters.end()) {
+            it = counters.emplace(source, EventCounter(configFor(metric))).first;
+            it->second.start = when;
+        }
+        close(it->second, source, metric, interval, scale, when, events);
+        it->second.events++;
+    }
+};
+
+AnomalyDetector::AnomalyDetector(QObject* parent)
+    : QObject(parent)
+    , d(std::make_unique<Private>()) {
+    
+    d->flushTimer = new QTimer(this);
+    connect(d->flushTimer, &QTimer::timeout, this, [this]() { flush(); });
+    d->flushTimer->start(ANOMALY_ERROR_INTERVAL * 1000);
+}
+
+AnomalyDetector::~AnomalyDetector() = default;
+
+void AnomalyDetector::attach(DeviceManager* manager, ProtocolAnalyzer* analyzer) {
+    if (manager) {
+        connect(manager->bandwidthMonitor(), &BandwidthMonitor::statsUpdated,
+                this, [this](const UsbDevice* device, const BandwidthStats& stats) {
+            recordThroughput(device->stableId(), stats.readSpeed + stats.writeSpeed);
+        });
+        connect(manager, &DeviceManager::deviceAdded,
+                this, [this](std::shared_ptr<UsbDevice> device) {
+            recordHotplug(device->portPath());
+        });
+        connect(manager, &DeviceManager::deviceReenumerated,
+                this, [this](std::shared_ptr<UsbDevice> device) {
+            recordHotplug(device->portPath());
+        });
+        connect(manager, &DeviceManager::deviceRemoved,
+                this, [this](std::shared_ptr<UsbDevice> device) {
+            recordHotplug(device->portPath());
+            removeDevice(device->stableId());
+        });
+    }
+    
+    if (analyzer) {
+        connect(analyzer, &ProtocolAnalyzer::transferError,
+                this, [this](const UsbDevice* device, uint8_t, int) {
+            recordTransferError(device->stableId());
+        });
+    }
+}
+
+void AnomalyDetector::setConfig(AnomalyMetric metric, const DetectorConfig& config) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->configs[static_cast<int>(metric)] = config;
+    
+    // Detectors are rebuilt lazily with the new settings
+    switch (metric) {
+        case AnomalyMetric::Throughput: d->throughput.clear(); break;
+        case AnomalyMetric::ErrorRate: d->errors.clear(); break;
+        case AnomalyMetric::HotplugFrequency: d->hotplug.clear(); break;
+    }
+}
+
+DetectorConfig AnomalyDetector::config(AnomalyMetric metric) const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->configFor(metric);
+}
+
+void AnomalyDetector::recordThroughput(const std::string& deviceId, double bytesPerSecond,
+                                       std::chrono::system_clock::time_point when) {
+    std::vector<AnomalyEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        auto it = d->throughput.find(deviceId);
+        if (it == d->throughput.end()) {
+            it = d->throughput.emplace(deviceId,
+                StreamingDetector(d->configFor(AnomalyMetric::Throughput))).first;
+        }
+        Private::report(events, deviceId, AnomalyMetric::Throughput,
+                        it->second.update(bytesPerSecond, when), when);
+    }
+    
+    for (const auto& event : events) {
+        emit anomalyDetected(event);
+    }
+}
+
+void AnomalyDetector::recordTransferError(const std::string& deviceId,
+                                          std::chrono::system_clock::time_point when) {
+    std::vector<AnomalyEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->count(d->errors, deviceId, AnomalyMetric::ErrorRate,
+                 std::chrono::seconds(ANOMALY_ERROR_INTERVAL), 1.0 / ANOMALY_ERROR_INTERVAL,
+                 when, events);
+    }
+    
+    for (const auto& event : events) {
+        emit anomalyDetected(event);
+    }
+}
+
+void AnomalyDetector::recordHotplug(const std::string& portPath,
+                                    std::chrono::system_clock::time_point when) {
+    std::vector<AnomalyEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->count(d->hotplug, portPath, AnomalyMetric::HotplugFrequency,
+                 std::chrono::seconds(ANOMALY_HOTPLUG_INTERVAL), 60.0 / ANOMALY_HOTPLUG_INTERVAL,
+                 when, events);
+    }
+    
+    for (const auto& event : events) {
+        emit anomalyDetected(event);
+    }
+}
+
+void AnomalyDetector::flush(std::chrono::system_clock::time_point when) {
+    std::vector<AnomalyEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        for (auto& [source, counter] : d->errors) {
+            Private::close(counter, source, AnomalyMetric::ErrorRate,
+                           std::chrono::seconds(ANOMALY_ERROR_INTERVAL),
+                           1.0 / ANOMALY_ERROR_INTERVAL, when, events);
+        }
+        for (auto& [source, counter] : d->hotplug) {
+            Private::close(counter, source, AnomalyMetric::HotplugFrequency,
+                           std::chrono::seconds(ANOMALY_HOTPLUG_INTERVAL),
+                           60.0 / ANOMALY_HOTPLUG_INTERVAL, when, events);
+        }
+    }
+    
+    for (const auto& event : events) {
+        emit anomalyDetected(event);
+    }
+}
+
+void AnomalyDetector::removeDevice(const std::string& deviceId) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->throughput.erase(deviceId);
+    d->errors.erase(deviceId);
+}
+
+size_t AnomalyDetector::trackedSources() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->throughput.size() + d->errors.size() + d->hotplug.size();
+}
+
+} // namespace usb_monitor
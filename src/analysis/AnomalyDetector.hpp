@@ -0,0 +1,69 @@
+// src/analysis/AnomalyDetector.hpp
+#pragma once
+#include "StreamingDetector.hpp"
+#include <QObject>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace usb_monitor {
+
+class DeviceManager;
+class ProtocolAnalyzer;
+
+enum class AnomalyMetric {
+    Throughput,         // bytes/s
+    ErrorRate,          // failed transfers/s
+    HotplugFrequency    // arrivals + removals per minute, per port
+};
+
+struct AnomalyEvent {
+    std::string source;             // Device stable id, or port path for hotplug
+    AnomalyMetric metric;
+    AnomalyKind kind;
+    double value;
+    double expected;
+    double score;
+    std::chrono::system_clock::time_point timestamp;
+};
+
+// Per-device streaming detectors over throughput, transfer errors and
+// hotplug churn. Every sample costs O(1) and each source keeps a fixed
+// amount of state, so this can run on every stats update.
+class AnomalyDetector : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AnomalyDetector(QObject* parent = nullptr);
+    ~AnomalyDetector();
+
+    // Feeds bandwidth stats, hotplug events and (optionally) transfer
+    // errors from the given sources
+    void attach(DeviceManager* manager, ProtocolAnalyzer* analyzer = nullptr);
+    
+    void setConfig(AnomalyMetric metric, const DetectorConfig& config);
+    DetectorConfig config(AnomalyMetric metric) const;
+    
+    void recordThroughput(const std::string& deviceId, double bytesPerSecond,
+                          std::chrono::system_clock::time_point when = std::chrono::system_clock::now());
+    void recordTransferError(const std::string& deviceId,
+                             std::chrono::system_clock::time_point when = std::chrono::system_clock::now());
+    void recordHotplug(const std::string& portPath,
+                       std::chrono::system_clock::time_point when = std::chrono::system_clock::now());
+    
+    // Closes finished error/hotplug intervals, so quiet periods are
+    // learned (and sudden silence is noticed) without new events
+    void flush(std::chrono::system_clock::time_point when = std::chrono::system_clock::now());
+    
+    void removeDevice(const std::string& deviceId);
+    size_t trackedSources() const;
+
+signals:
+    void anomalyDetected(const AnomalyEvent& event);
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,312 @@
+// src/analysis/AudioStreamAnalyzer.cpp
+#include "AudioStreamAnalyzer.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr std::array<uint32_t, 14> STANDARD_RATES = {
+    8000, 11025, 16000, 22050, 24000, 32000, 44100,
+    48000, 88200, 96000, 176400, 192000, 352800, 384000
+};
+
+constexpr uint8_t SET_INTERFACE_REQUEST_TYPE = 0x01;   // Standard, to an interface
+constexpr uint8_t SET_INTERFACE = 0x0B;
+
+bool withinPercent(double rate, uint32_t nominal) {
+    return std::abs(rate - nominal) <= nominal * 0.01;
+}
+
+double ppm(double rate, uint32_t nominal) {
+    return nominal ? (rate - nominal) / nominal * 1e6 : 0.0;
+}
+
+} // namespace
+
+uint32_t AudioStreamAnalyzer::servicePeriod(uint8_t bInterval, int speed) {
+    // Isochronous intervals are 2^(bInterval-1) frames or microframes
+    int exponent = std::clamp<int>(bInterval, 1, 16) - 1;
+    return (speed >= LIBUSB_SPEED_HIGH ? 125u : 1000u) << exponent;
+}
+
+uint32_t AudioStreamAnalyzer::nearestStandardRate(double rate) {
+    for (uint32_t standard : STANDARD_RATES) {
+        if (withinPercent(rate, standard)) return standard;
+    }
+    return 0;
+}
+
+void AudioStreamAnalyzer::StreamState::select(int index) {
+    format = index;
+    probeBytes = probePackets = 0;
+    setRate(index >= 0 ? formats[index].sampleRate : 0);
+}
+
+void AudioStreamAnalyzer::StreamState::setRate(uint32_t rate) {
+    nominalRate = rate;
+    
+    // Asynchronous and adaptive endpoints may vary a packet by one frame
+    double expected = rate * (servicePeriod / 1e6);
+    lowSamples = uint32_t(std::max(std::floor(expected) - 1, 0.0));
+    highSamples = uint32_t(std::ceil(expected) + 1);
+}
+
+void AudioStreamAnalyzer::StreamState::probe() {
+    double perPacket = double(probeBytes) / probePackets;
+    double packetsPerSecond = 1e6 / servicePeriod;
+    uint64_t bytes = probeBytes;
+    probeBytes = probePackets = 0;
+    
+    if (format < 0) {
+        // The first alternate setting whose frame size gives a sane rate
+        for (size_t i = 0; i < formats.size(); i++) {
+            double rate = perPacket / formats[i].bytesPerFrame * packetsPerSecond;
+            uint32_t nominal = formats[i].sampleRate;
+            if (nominal ? withinPercent(rate, nominal) : nearestStandardRate(rate) != 0) {
+                select(int(i));
+                break;
+            }
+        }
+        if (format < 0) return;
+    }
+    
+    uint16_t frame = formats[format].bytesPerFrame;
+    if (nominalRate == 0) {
+        setRate(nearestStandardRate(perPacket / frame * packetsPerSecond));
+    }
+    if (nominalRate) samples += bytes / frame;
+}
+
+void AudioStreamAnalyzer::StreamState::countPacket(uint32_t length) {
+    packets++;
+    if (format < 0 || nominalRate == 0) {
+        probeBytes += length;
+        if (++probePackets >= uint64_t(AUDIO_PROBE_PACKETS)) probe();
+        return;
+    }
+    
+    uint16_t frame = formats[format].bytesPerFrame;
+    uint32_t count = length / frame;
+    if (length % frame) misaligned++;
+    samples += count;
+    minSamples = std::min(minSamples, count);
+    maxSamples = std::max(maxSamples, count);
+    
+    if (count == 0) {
+        emptyPackets++;
+        underruns++;
+    } else if (count < lowSamples) {
+        underruns++;
+    } else if (count > highSamples) {
+        overruns++;
+    }
+}
+
+void AudioStreamAnalyzer::StreamState::completion(const UrbEvent& event) {
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < event.isoPacketCount; i++) {
+        const auto& packet = event.isoPackets[i];
+        if (packet.status != 0) {
+            packets++;
+            packetErrors++;
+            continue;
+        }
+        bytes += packet.length;
+        countPacket(packet.length);
+    }
+    
+    // Each completion should follow the previous one by the time its own
+    // packets take on the bus
+    if (lastCompletion >= 0 && event.timestamp >= lastCompletion) {
+        uint64_t delta = event.timestamp - lastCompletion;
+        if (delta <= uint64_t(AUDIO_IDLE_GAP) * 1000) {
+            uint64_t covered = uint64_t(event.isoPacketCount) * servicePeriod;
+            if (delta > covered + AUDIO_GAP_SLACK) discontinuities++;
+            activeTime += delta;
+            activeBytes += bytes;
+        }
+    }
+    lastCompletion = event.timestamp;
+}
+
+void AudioStreamAnalyzer::StreamState::feedback(double rate) {
+    if (feedbackCount++ == 0) {
+        feedbackMin = feedbackMax = rate;
+    } else {
+        feedbackMin = std::min(feedbackMin, rate);
+        feedbackMax = std::max(feedbackMax, rate);
+    }
+    feedbackSum += rate;
+}
+
+void AudioStreamAnalyzer::addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                                      uint32_t servicePeriod, const AudioFormat& format) {
+    if (format.bytesPerFrame == 0) return;
+    
+    auto& state = streams[endpointKey(busNumber, deviceAddress, endpoint)];
+    state.servicePeriod = servicePeriod;
+    for (const auto& known : state.formats) {
+        if (known.interfaceNumber == format.interfaceNumber &&
+            known.altSetting == format.altSetting) {
+            return;
+        }
+    }
+    state.formats.push_back(format);
+}
+
+void AudioStreamAnalyzer::addFeedback(uint16_t busNumber, uint8_t deviceAddress,
+                                      uint8_t feedbackEndpoint, uint8_t dataEndpoint,
+                                      bool highSpeed) {
+    feedbackLinks[endpointKey(busNumber, deviceAddress, feedbackEndpoint)] =
+        FeedbackLink{endpointKey(busNumber, deviceAddress, dataEndpoint), highSpeed};
+}
+
+void AudioStreamAnalyzer::setInterface(const UrbEvent& event) {
+    uint8_t altSetting = event.setup[2];
+    uint8_t interfaceNumber = event.setup[4];
+    uint32_t prefix = endpointKey(event.busNumber, event.deviceAddress, 0) >> 8;
+    
+    for (auto& [key, state] : streams) {
+        if ((key >> 8) != prefix) continue;
+        
+        bool ours = false;
+        int index = -1;
+        for (size_t i = 0; i < state.formats.size(); i++) {
+            if (state.formats[i].interfaceNumber != interfaceNumber) continue;
+            ours = true;
+            if (state.formats[i].altSetting == altSetting) index = int(i);
+        }
+        if (!ours) continue;
+        
+        // Alternate setting 0, or one without this endpoint, stops it
+        state.select(index);
+        state.lastCompletion = -1;
+        state.activeBytes = state.activeTime = 0;
+    }
+}
+
+void AudioStreamAnalyzer::feedbackCompletion(const UrbEvent& event, const FeedbackLink& link) {
+    auto it = streams.find(link.dataKey);
+    if (it == streams.end() || !event.data) return;
+    
+    for (uint32_t i = 0; i < event.isoPacketCount; i++) {
+        const auto& packet = event.isoPackets[i];
+        if (packet.status != 0 || packet.length < 3 ||
+            packet.offset + packet.length > event.capturedLength) {
+            continue;
+        }
+        
+        // Samples per frame as 10.14 fixed point at full speed, per
+        // microframe as 16.16 at high speed
+        const uint8_t* value = event.data + packet.offset;
+        double rate;
+        if (packet.length == 3) {
+            uint32_t raw = value[0] | value[1] << 8 | value[2] << 16;
+            rate = raw / 16384.0 * 1000.0;
+        } else {
+            uint32_t raw = value[0] | value[1] << 8 | value[2] << 16 | uint32_t(value[3]) << 24;
+            rate = raw / 65536.0 * (link.highSpeed ? 8000.0 : 1000.0);
+        }
+        if (rate > 0) it->second.feedback(rate);
+    }
+}
+
+void AudioStreamAnalyzer::process(const UrbEvent& event) {
+    if (event.type == 'S' && event.hasSetup &&
+        event.setup[0] == SET_INTERFACE_REQUEST_TYPE && event.setup[1] == SET_INTERFACE) {
+        setInterface(event);
+        return;
+    }
+    if (event.type != 'C' || event.transferType != LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) return;
+    
+    uint32_t key = endpointKey(event.busNumber, event.deviceAddress, event.endpoint);
+    auto stream = streams.find(key);
+    if (stream != streams.end()) {
+        stream->second.completion(event);
+        return;
+    }
+    
+    auto link = feedbackLinks.find(key);
+    if (link != feedbackLinks.end()) {
+        feedbackCompletion(event, link->second);
+    }
+}
+
+AudioStreamStats AudioStreamAnalyzer::describe(uint32_t key, const StreamState& state) {
+    AudioStreamStats stats{};
+    stats.busNumber = uint16_t(key >> 16);
+    stats.deviceAddress = uint8_t(key >> 8);
+    stats.endpoint = uint8_t(key);
+    stats.nominalRate = state.nominalRate;
+    stats.packets = state.packets;
+    stats.samples = state.samples;
+    stats.minSamplesPerPacket = state.maxSamples ? state.minSamples : 0;
+    stats.maxSamplesPerPacket = state.maxSamples;
+    stats.emptyPackets = state.emptyPackets;
+    stats.underruns = state.underruns;
+    stats.overruns = state.overruns;
+    stats.packetErrors = state.packetErrors;
+    stats.misalignedPackets = state.misaligned;
+    stats.discontinuities = state.discontinuities;
+    
+    if (state.format >= 0) {
+        const auto& format = state.formats[state.format];
+        stats.altSetting = format.altSetting;
+        stats.bytesPerFrame = format.bytesPerFrame;
+        
+        uint64_t counted = state.packets - state.packetErrors - state.probePackets;
+        stats.samplesPerPacket = counted ? double(state.samples) / counted : 0.0;
+        if (state.activeTime) {
+            stats.measuredRate = double(state.activeBytes) / format.bytesPerFrame * 1e6 / state.activeTime;
+            stats.measuredDriftPpm = ppm(stats.measuredRate, state.nominalRate);
+        }
+    }
+    
+    if (state.feedbackCount) {
+        stats.hasFeedback = true;
+        stats.feedbackRate = state.feedbackSum / state.feedbackCount;
+        stats.feedbackDriftPpm = ppm(stats.feedbackRate, state.nominalRate);
+        stats.feedbackMinPpm = ppm(state.feedbackMin, state.nominalRate);
+        stats.feedbackMaxPpm = ppm(state.feedbackMax, state.nominalRate);
+    }
+    return stats;
+}
+
+std::vector<AudioStreamStats> AudioStreamAnalyzer::streamStats(uint16_t busNumber,
+                                                               uint8_t deviceAddress) const {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    
+    std::vector<AudioStreamStats> result;
+    for (const auto& [key, state] : streams) {
+        if ((key >> 8) == prefix) result.push_back(describe(key, state));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.endpoint < b.endpoint;
+    });
+    return result;
+}
+
+std::vector<AudioStreamStats> AudioStreamAnalyzer::allStats() const {
+    std::vector<AudioStreamStats> result;
+    result.reserve(streams.size());
+    for (const auto& [key, state] : streams) {
+        result.push_back(describe(key, state));
+    }
+    return result;
+}
+
+void AudioStreamAnalyzer::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    auto matches = [prefix](const auto& entry) {
+        return (entry.first >> 8) == prefix;
+    };
+    std::erase_if(streams, matches);
+    std::erase_if(feedbackLinks, matches);
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,131 @@
+// src/analysis/AudioStreamAnalyzer.hpp
+#pragma once
+#include "../capture/UrbEvent.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+// One alternate setting of an audio streaming interface
+struct AudioFormat {
+    uint8_t interfaceNumber;
+    uint8_t altSetting;
+    uint16_t bytesPerFrame;     // Subslot size times channels
+    uint32_t sampleRate;        // Hz when the descriptor fixes it, else 0
+};
+
+struct AudioStreamStats {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t endpoint;
+    uint8_t altSetting;         // 0 while the format is unknown
+    uint16_t bytesPerFrame;
+    uint32_t nominalRate;       // Hz, declared or the nearest standard rate
+    uint64_t packets;
+    uint64_t samples;
+    double samplesPerPacket;
+    uint32_t minSamplesPerPacket;
+    uint32_t maxSamplesPerPacket;
+    uint64_t emptyPackets;
+    uint64_t underruns;         // Empty or short packets
+    uint64_t overruns;          // Packets longer than the clock allows
+    uint64_t packetErrors;      // Failed on the bus
+    uint64_t misalignedPackets; // Not a whole number of frames
+    uint64_t discontinuities;   // Completions later than their packets account for
+    double measuredRate;        // Hz against the host clock
+    double measuredDriftPpm;
+    bool hasFeedback;
+    double feedbackRate;        // Hz, mean of the feedback endpoint's values
+    double feedbackDriftPpm;
+    double feedbackMinPpm;
+    double feedbackMaxPpm;
+};
+
+// Continuity and clock drift of USB audio isochronous streams. Sample
+// counts come from the iso packet lengths, so payloads are never read
+// except on feedback endpoints. Which alternate setting is in use is taken
+// from captured SET_INTERFACE requests, or inferred from the packet sizes
+// when the capture started after it.
+class AudioStreamAnalyzer {
+public:
+    // Service interval of an isochronous endpoint, us
+    static uint32_t servicePeriod(uint8_t bInterval, int speed);
+    
+    // The standard sample rate within 1% of rate, or 0
+    static uint32_t nearestStandardRate(double rate);
+    
+    // Called once per alternate setting carrying the endpoint
+    void addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                     uint32_t servicePeriod, const AudioFormat& format);
+    
+    // Explicit feedback endpoint for an asynchronous OUT stream
+    void addFeedback(uint16_t busNumber, uint8_t deviceAddress, uint8_t feedbackEndpoint,
+                     uint8_t dataEndpoint, bool highSpeed);
+    
+    void process(const UrbEvent& event);
+    
+    std::vector<AudioStreamStats> streamStats(uint16_t busNumber, uint8_t deviceAddress) const;
+    std::vector<AudioStreamStats> allStats() const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+
+private:
+    struct StreamState {
+        uint32_t servicePeriod{1000};
+        std::vector<AudioFormat> formats;
+        int format{-1};
+        uint32_t nominalRate{0};
+        uint32_t lowSamples{0};     // Per-packet bounds, once the rate is known
+        uint32_t highSamples{0};
+        
+        // Packets seen since the format or rate became unknown
+        uint64_t probeBytes{0};
+        uint64_t probePackets{0};
+        
+        uint64_t packets{0};
+        uint64_t samples{0};
+        uint32_t minSamples{UINT32_MAX};
+        uint32_t maxSamples{0};
+        uint64_t emptyPackets{0};
+        uint64_t underruns{0};
+        uint64_t overruns{0};
+        uint64_t packetErrors{0};
+        uint64_t misaligned{0};
+        uint64_t discontinuities{0};
+        
+        // Host-clock rate measurement for the current format
+        int64_t lastCompletion{-1};
+        uint64_t activeBytes{0};
+        uint64_t activeTime{0};     // us
+        
+        uint64_t feedbackCount{0};
+        double feedbackSum{0.0};
+        double feedbackMin{0.0};
+        double feedbackMax{0.0};
+        
+        void select(int index);
+        void setRate(uint32_t rate);
+        void completion(const UrbEvent& event);
+        void countPacket(uint32_t length);
+        void probe();
+        void feedback(double rate);
+    };
+    
+    struct FeedbackLink {
+        uint32_t dataKey;
+        bool highSpeed;
+    };
+    
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    void setInterface(const UrbEvent& event);
+    void feedbackCompletion(const UrbEvent& event, const FeedbackLink& link);
+    static AudioStreamStats describe(uint32_t key, const StreamState& state);
+
+    std::unordered_map<uint32_t, StreamState> streams;
+    std::unordered_map<uint32_t, FeedbackLink> feedbackLinks;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,244 @@
+// src/analysis/CdcAcmTracker.cpp
+#include "CdcAcmTracker.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <cstring>
+
+namespace usb_monitor {
+
+namespace {
+
+// CDC PSTN class requests and notifications
+constexpr uint8_t CLASS_INTERFACE_OUT = 0x21;
+constexpr uint8_t CLASS_INTERFACE_IN = 0xA1;
+constexpr uint8_t SET_LINE_CODING = 0x20;
+constexpr uint8_t GET_LINE_CODING = 0x21;
+constexpr uint8_t SET_CONTROL_LINE_STATE = 0x22;
+constexpr uint8_t SEND_BREAK = 0x23;
+constexpr uint8_t SERIAL_STATE = 0x20;
+
+constexpr uint32_t LINE_CODING_LENGTH = 7;
+constexpr uint32_t SERIAL_STATE_LENGTH = 10;
+
+// UART state bits of SERIAL_STATE
+constexpr uint16_t STATE_BREAK = 0x04;
+constexpr uint16_t STATE_FRAMING = 0x10;
+constexpr uint16_t STATE_PARITY = 0x20;
+constexpr uint16_t STATE_OVERRUN = 0x40;
+
+RateWindow<>::Clock::time_point toTimePoint(int64_t micros) {
+    return RateWindow<>::Clock::time_point(std::chrono::microseconds(micros));
+}
+
+bool containsLineEnd(const uint8_t* data, uint32_t length) {
+    return std::memchr(data, '\n', length) || std::memchr(data, '\r', length);
+}
+
+CdcLineCoding parseLineCoding(const uint8_t* data) {
+    CdcLineCoding coding;
+    coding.baudRate = data[0] | data[1] << 8 | data[2] << 16 | uint32_t(data[3]) << 24;
+    coding.stopBits = data[4];
+    coding.parity = data[5];
+    coding.dataBits = data[6];
+    coding.known = true;
+    return coding;
+}
+
+bool sameCoding(const CdcLineCoding& a, const CdcLineCoding& b) {
+    return a.baudRate == b.baudRate && a.stopBits == b.stopBits &&
+           a.parity == b.parity && a.dataBits == b.dataBits;
+}
+
+} // namespace
+
+double CdcLineCoding::characterRate() const {
+    if (!known || baudRate == 0) return 0.0;
+    
+    double stop = stopBits == 1 ? 1.5 : stopBits == 2 ? 2.0 : 1.0;
+    double bits = 1.0 + dataBits + (parity ? 1.0 : 0.0) + stop;
+    return baudRate / bits;
+}
+
+void CdcAcmTracker::DeviceState::control(const UrbEvent& event) {
+    if (event.type == 'C') {
+        // Only the answer to a GET_LINE_CODING is of interest
+        if (event.id != lineCodingRead || event.status != 0) return;
+        lineCodingRead = 0;
+        if (event.data && event.capturedLength >= LINE_CODING_LENGTH) {
+            lineCoding = parseLineCoding(event.data);
+        }
+        return;
+    }
+    if (!event.hasSetup) return;
+    
+    uint8_t requestType = event.setup[0];
+    uint8_t request = event.setup[1];
+    if (requestType == CLASS_INTERFACE_IN && request == GET_LINE_CODING) {
+        lineCodingRead = event.id;
+        return;
+    }
+    if (requestType != CLASS_INTERFACE_OUT) return;
+    
+    switch (request) {
+        case SET_LINE_CODING:
+            if (event.data && event.capturedLength >= LINE_CODING_LENGTH) {
+                auto coding = parseLineCoding(event.data);
+                if (lineCoding.known && !sameCoding(coding, lineCoding)) {
+                    lineCodingChanges++;
+                }
+                lineCoding = coding;
+            }
+            break;
+        case SET_CONTROL_LINE_STATE:
+            dtr = event.setup[2] & 0x01;
+            rts = event.setup[2] & 0x02;
+            break;
+        case SEND_BREAK:
+            // A duration of 0 ends a break rather than sending one
+            if (event.setup[2] || event.setup[3]) breaks++;
+            break;
+    }
+}
+
+void CdcAcmTracker::DeviceState::notification(const UrbEvent& event) {
+    if (!event.data || event.capturedLength < SERIAL_STATE_LENGTH) return;
+    if (event.data[0] != CLASS_INTERFACE_IN || event.data[1] != SERIAL_STATE) return;
+    
+    uint16_t state = event.data[8] | event.data[9] << 8;
+    if (state & STATE_BREAK) breaks++;
+    if (state & STATE_FRAMING) framingErrors++;
+    if (state & STATE_PARITY) parityErrors++;
+    if (state & STATE_OVERRUN) overruns++;
+}
+
+void CdcAcmTracker::DeviceState::dataOut(const UrbEvent& event) {
+    if (event.type == 'C') {
+        if (event.status == 0 && event.length) {
+            out.add(event.length, 1, toTimePoint(event.timestamp));
+        }
+        return;
+    }
+    
+    // A submission ending a line is a request; the clock starts when the
+    // host hands it over
+    if (!event.data || !containsLineEnd(event.data, event.capturedLength)) return;
+    if (requestTime >= 0 && !firstByteSeen) unanswered++;
+    requests++;
+    requestTime = event.timestamp;
+    firstByteSeen = false;
+}
+
+void CdcAcmTracker::DeviceState::dataIn(const UrbEvent& event) {
+    if (event.type != 'C' || event.status != 0 || event.length == 0) return;
+    in.add(event.length, 1, toTimePoint(event.timestamp));
+    
+    if (requestTime < 0) return;
+    
+    int64_t elapsed = event.timestamp - requestTime;
+    if (elapsed < 0) return;
+    if (elapsed > int64_t(CDC_RESPONSE_TIMEOUT) * 1000) {
+        if (!firstByteSeen) unanswered++;
+        requestTime = -1;
+        return;
+    }
+    
+    if (!firstByteSeen) {
+        response.add(uint64_t(elapsed));
+        firstByteSeen = true;
+    }
+    if (event.data && containsLineEnd(event.data, event.capturedLength)) {
+        lineResponse.add(uint64_t(elapsed));
+        requestTime = -1;
+    }
+}
+
+void CdcAcmTracker::addPort(uint16_t busNumber, uint8_t deviceAddress, uint8_t notifyEndpoint,
+                            uint8_t dataIn, uint8_t dataOut) {
+    auto& state = devices[deviceKey(busNumber, deviceAddress)];
+    if (notifyEndpoint) state.role(notifyEndpoint) = Role::Notify;
+    if (state.role(dataIn) == Role::DataIn && state.role(dataOut) == Role::DataOut) return;
+    
+    state.role(dataIn) = Role::DataIn;
+    state.role(dataOut) = Role::DataOut;
+    state.ports++;
+}
+
+void CdcAcmTracker::process(const UrbEvent& event) {
+    auto it = devices.find(deviceKey(event.busNumber, event.deviceAddress));
+    if (it == devices.end()) return;
+    
+    auto& state = it->second;
+    state.lastTimestamp = std::max(state.lastTimestamp, event.timestamp);
+    if (event.transferType == LIBUSB_TRANSFER_TYPE_CONTROL) {
+        state.control(event);
+        return;
+    }
+    
+    switch (state.role(event.endpoint)) {
+        case Role::Notify:
+            if (event.type == 'C' && event.status == 0) state.notification(event);
+            break;
+        case Role::DataIn:
+            state.dataIn(event);
+            break;
+        case Role::DataOut:
+            state.dataOut(event);
+            break;
+        case Role::None:
+            break;
+    }
+}
+
+bool CdcAcmTracker::isTracked(uint16_t busNumber, uint8_t deviceAddress) const {
+    return devices.count(deviceKey(busNumber, deviceAddress)) != 0;
+}
+
+CdcAcmDirection CdcAcmTracker::describe(const RateWindow<>& window, int64_t now,
+                                        const CdcLineCoding& coding) {
+    auto copy = window;
+    copy.advance(toTimePoint(now));
+    
+    double characterRate = coding.characterRate();
+    return CdcAcmDirection{
+        copy.totalBytes(),
+        copy.rate(),
+        copy.peakRate(),
+        characterRate > 0 ? copy.rate() / characterRate : 0.0
+    };
+}
+
+CdcAcmStats CdcAcmTracker::stats(uint16_t busNumber, uint8_t deviceAddress) const {
+    CdcAcmStats stats{};
+    stats.busNumber = busNumber;
+    stats.deviceAddress = deviceAddress;
+    
+    auto it = devices.find(deviceKey(busNumber, deviceAddress));
+    if (it == devices.end()) return stats;
+    
+    const auto& state = it->second;
+    stats.ports = state.ports;
+    stats.lineCoding = state.lineCoding;
+    stats.lineCodingChanges = state.lineCodingChanges;
+    stats.dtr = state.dtr;
+    stats.rts = state.rts;
+    stats.breaks = state.breaks;
+    stats.framingErrors = state.framingErrors;
+    stats.parityErrors = state.parityErrors;
+    stats.overruns = state.overruns;
+    stats.in = describe(state.in, state.lastTimestamp, state.lineCoding);
+    stats.out = describe(state.out, state.lastTimestamp, state.lineCoding);
+    stats.requests = state.requests;
+    stats.unanswered = state.unanswered;
+    stats.meanResponse = state.response.mean();
+    stats.p50Response = state.response.percentile(0.50);
+    stats.p99Response = state.response.percentile(0.99);
+    stats.p50LineResponse = state.lineResponse.percentile(0.50);
+    stats.p99LineResponse = state.lineResponse.percentile(0.99);
+    return stats;
+}
+
+void CdcAcmTracker::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    devices.erase(deviceKey(busNumber, deviceAddress));
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,116 @@
+// src/analysis/CdcAcmTracker.hpp
+#pragma once
+#include "UrbMatcher.hpp"
+#include "../capture/UrbEvent.hpp"
+#include "../core/RateWindow.hpp"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+namespace usb_monitor {
+
+struct CdcLineCoding {
+    uint32_t baudRate{0};
+    uint8_t stopBits{0};        // 0: 1, 1: 1.5, 2: 2
+    uint8_t parity{0};          // 0: none, 1: odd, 2: even, 3: mark, 4: space
+    uint8_t dataBits{0};
+    bool known{false};
+    
+    // Bytes/s the line carries at this coding, start and stop bits included
+    double characterRate() const;
+};
+
+struct CdcAcmDirection {
+    uint64_t bytes;
+    double rate;                // bytes/s over the recent window
+    double peakRate;
+    double utilization;         // rate over the line's character rate
+};
+
+struct CdcAcmStats {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t ports;
+    CdcLineCoding lineCoding;   // Last one set or read
+    uint64_t lineCodingChanges;
+    bool dtr;
+    bool rts;
+    uint64_t breaks;
+    uint64_t framingErrors;     // From SERIAL_STATE notifications
+    uint64_t parityErrors;
+    uint64_t overruns;
+    CdcAcmDirection in;         // Device to host
+    CdcAcmDirection out;
+    
+    // Round trips of line-oriented traffic: a line sent to the device and
+    // the first, and the complete, line coming back
+    uint64_t requests;
+    uint64_t unanswered;
+    double meanResponse;        // us to the first byte
+    uint64_t p50Response;
+    uint64_t p99Response;
+    uint64_t p50LineResponse;   // us to the end of the response line
+    uint64_t p99LineResponse;
+};
+
+// Decodes CDC-ACM class requests and notifications and meters the data
+// interface of each serial device from capture. State is fixed-size per
+// device whatever the traffic.
+class CdcAcmTracker {
+public:
+    // One call per ACM function; notifyEndpoint is 0 if there is none
+    void addPort(uint16_t busNumber, uint8_t deviceAddress, uint8_t notifyEndpoint,
+                 uint8_t dataIn, uint8_t dataOut);
+    void process(const UrbEvent& event);
+    
+    bool isTracked(uint16_t busNumber, uint8_t deviceAddress) const;
+    CdcAcmStats stats(uint16_t busNumber, uint8_t deviceAddress) const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+
+private:
+    enum class Role : uint8_t { None, Notify, DataIn, DataOut };
+    
+    struct DeviceState {
+        std::array<Role, 32> roles{};   // By endpoint number and direction
+        uint8_t ports{0};
+        
+        CdcLineCoding lineCoding;
+        uint64_t lineCodingChanges{0};
+        uint64_t lineCodingRead{0};     // URB id of a pending GET_LINE_CODING
+        bool dtr{false};
+        bool rts{false};
+        uint64_t breaks{0};
+        uint64_t framingErrors{0};
+        uint64_t parityErrors{0};
+        uint64_t overruns{0};
+        
+        RateWindow<> in;
+        RateWindow<> out;
+        int64_t lastTimestamp{0};
+        
+        // Outstanding line sent to the device
+        int64_t requestTime{-1};
+        bool firstByteSeen{false};
+        uint64_t requests{0};
+        uint64_t unanswered{0};
+        LatencyHistogram response;
+        LatencyHistogram lineResponse;
+        
+        Role& role(uint8_t endpoint) { return roles[(endpoint & 0x0F) | ((endpoint & 0x80) >> 3)]; }
+        void control(const UrbEvent& event);
+        void notification(const UrbEvent& event);
+        void dataOut(const UrbEvent& event);
+        void dataIn(const UrbEvent& event);
+    };
+    
+    static uint16_t deviceKey(uint16_t bus, uint8_t address) {
+        return static_cast<uint16_t>((bus << 8) | address);
+    }
+    
+    static CdcAcmDirection describe(const RateWindow<>& window, int64_t now,
+                                    const CdcLineCoding& coding);
+
+    std::unordered_map<uint16_t, DeviceState> devices;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,168 @@
+// src/analysis/ExfiltrationDetector.cpp
+#include "ExfiltrationDetector.hpp"
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr size_t MIN_SAMPLE = 256;          // Shorter payloads say little about entropy
+constexpr uint64_t MIN_SAMPLES = 8;         // Before the rolling entropy is trusted
+constexpr double ENTROPY_SMOOTHING = 0.1;
+
+// BOT command wrappers share the OUT pipe with the data
+bool isCommandWrapper(const UrbEvent& event) {
+    return event.length == 31 && event.capturedLength >= 4 && std::memcmp(event.data, "USBC", 4) == 0;
+}
+
+} // namespace
+
+double ExfiltrationDetector::entropy(const uint8_t* data, size_t length) {
+    if (length == 0) return 0.0;
+    
+    // Four interleaved histograms, so runs of one byte value do not
+    // serialize on a single counter and the loop pipelines
+    uint32_t counts[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for (; i < length; i++) {
+        counts[0][data[i]]++;
+    }
+    
+    double bits = 0.0;
+    int used = 0;
+    for (int value = 0; value < 256; value++) {
+        uint32_t count = counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+        if (!count) continue;
+        used++;
+        double p = double(count) / length;
+        bits -= p * std::log2(p);
+    }
+    
+    // Miller-Madow: a short sample of random bytes misses some values and
+    // reads low; 4 KiB of random data would otherwise score about 7.95
+    bits += (used - 1) / (2.0 * length * std::log(2.0));
+    return std::min(bits, 8.0);
+}
+
+void ExfiltrationDetector::addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint) {
+    endpoints.insert(endpointKey(busNumber, deviceAddress, endpoint));
+    devices[deviceKey(busNumber, deviceAddress)];
+}
+
+void ExfiltrationDetector::setDefaultPolicy(const ExfiltrationPolicy& policy) {
+    defaultPolicy = policy;
+}
+
+void ExfiltrationDetector::setPolicy(uint16_t busNumber, uint8_t deviceAddress,
+                                     const ExfiltrationPolicy& policy) {
+    devices[deviceKey(busNumber, deviceAddress)].policy = policy;
+}
+
+bool ExfiltrationDetector::takeSample(size_t bytes, bool urgent, int64_t timestamp) {
+    if (lastRefill >= 0 && timestamp > lastRefill) {
+        budget += double(timestamp - lastRefill) * EXFIL_SAMPLE_BUDGET / 1e6;
+        budget = std::min<double>(budget, EXFIL_SAMPLE_BUDGET);
+    }
+    lastRefill = std::max(lastRefill, timestamp);
+    
+    // Quiet devices keep half the budget free for ones nearing a burst
+    double reserve = urgent ? 0.0 : EXFIL_SAMPLE_BUDGET / 2.0;
+    if (budget - double(bytes) < reserve) return false;
+    budget -= double(bytes);
+    return true;
+}
+
+std::optional<ExfiltrationAlert> ExfiltrationDetector::process(const UrbEvent& event) {
+    // usbmon carries OUT data with the submission, so writes are counted
+    // there; a failed write is still an attempt
+    if (event.type != 'S' || event.isInput() || event.transferType != LIBUSB_TRANSFER_TYPE_BULK ||
+        event.length == 0) {
+        return std::nullopt;
+    }
+    if (!endpoints.count(endpointKey(event.busNumber, event.deviceAddress, event.endpoint))) {
+        return std::nullopt;
+    }
+    if (isCommandWrapper(event)) return std::nullopt;
+    
+    uint16_t key = deviceKey(event.busNumber, event.deviceAddress);
+    auto& state = devices[key];
+    const auto& policy = policyOf(state);
+    
+    auto now = Window::Clock::time_point(std::chrono::microseconds(event.timestamp));
+    state.window.add(event.length, 1, now);
+    state.lastWrite = event.timestamp;
+    state.writes++;
+    
+    uint64_t windowBytes = state.window.windowBytes();
+    bool nearBurst = windowBytes * 2 >= policy.burstBytes;
+    size_t sample = std::min<size_t>(event.capturedLength, EXFIL_SAMPLE_BYTES);
+    if (event.data && sample >= MIN_SAMPLE && takeSample(sample, nearBurst, event.timestamp)) {
+        double bits = entropy(event.data, sample);
+        state.entropy = state.sampledWrites == 0
+            ? bits
+            : state.entropy + ENTROPY_SMOOTHING * (bits - state.entropy);
+        state.sampledWrites++;
+        state.sampledBytes += sample;
+    }
+    
+    // Hysteresis: a burst ends once the window drains to half the limit
+    if (!state.inBurst && windowBytes >= policy.burstBytes) {
+        state.inBurst = true;
+        state.bursts++;
+    } else if (state.inBurst && windowBytes * 2 < policy.burstBytes) {
+        state.inBurst = false;
+        state.alerted = false;
+    }
+    
+    if (!state.inBurst || state.alerted || policy.highEntropyAllowed ||
+        state.sampledWrites < MIN_SAMPLES || state.entropy < policy.entropyThreshold) {
+        return std::nullopt;
+    }
+    
+    state.alerted = true;
+    state.alerts++;
+    return ExfiltrationAlert{event.busNumber, event.deviceAddress, event.timestamp,
+                             windowBytes, state.window.rate(), state.entropy};
+}
+
+ExfiltrationStats ExfiltrationDetector::stats(uint16_t busNumber, uint8_t deviceAddress) const {
+    ExfiltrationStats stats{};
+    auto it = devices.find(deviceKey(busNumber, deviceAddress));
+    if (it == devices.end()) return stats;
+    
+    const auto& state = it->second;
+    auto window = state.window;
+    window.advance(Window::Clock::time_point(std::chrono::microseconds(state.lastWrite)));
+    stats.bytesWritten = window.totalBytes();
+    stats.writes = state.writes;
+    stats.writeRate = window.rate();
+    stats.windowBytes = window.windowBytes();
+    stats.entropy = state.entropy;
+    stats.sampledWrites = state.sampledWrites;
+    stats.sampledBytes = state.sampledBytes;
+    stats.bursts = state.bursts;
+    stats.alerts = state.alerts;
+    return stats;
+}
+
+void ExfiltrationDetector::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    devices.erase(deviceKey(busNumber, deviceAddress));
+    for (auto it = endpoints.begin(); it != endpoints.end();) {
+        if ((*it >> 8) == ((uint32_t(busNumber) << 8) | deviceAddress)) {
+            it = endpoints.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace usb_monitor
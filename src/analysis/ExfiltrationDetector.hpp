@@ -0,0 +1,100 @@
+// src/analysis/ExfiltrationDetector.hpp
+#pragma once
+#include "../capture/UrbEvent.hpp"
+#include "../core/RateWindow.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace usb_monitor {
+
+// What a device may write before it is reported
+struct ExfiltrationPolicy {
+    uint64_t burstBytes{EXFIL_BURST_BYTES};     // Within EXFIL_WINDOW seconds
+    double entropyThreshold{EXFIL_ENTROPY_THRESHOLD};
+    bool highEntropyAllowed{false};             // Encrypted volumes, backup targets
+};
+
+struct ExfiltrationAlert {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    int64_t timestamp;          // us since the epoch
+    uint64_t windowBytes;       // Written within the window
+    double writeRate;           // bytes/s over the window
+    double entropy;             // Rolling, bits per byte
+};
+
+struct ExfiltrationStats {
+    uint64_t bytesWritten;
+    uint64_t writes;
+    double writeRate;           // bytes/s over the window
+    uint64_t windowBytes;
+    double entropy;             // Rolling over sampled writes, bits per byte
+    uint64_t sampledWrites;
+    uint64_t sampledBytes;
+    uint64_t bursts;            // Windows that went over burstBytes
+    uint64_t alerts;
+};
+
+// Watches the data written to mass storage bulk OUT endpoints for large
+// bursts of high-entropy data, the shape of copying out compressed or
+// encrypted archives. Write payloads are sampled for byte entropy under a
+// global byte budget, so the cost stays fixed at any bus speed; devices
+// nearing a burst get first call on the budget.
+class ExfiltrationDetector {
+public:
+    // Only registered endpoints are watched
+    void addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint);
+    void setDefaultPolicy(const ExfiltrationPolicy& policy);
+    void setPolicy(uint16_t busNumber, uint8_t deviceAddress, const ExfiltrationPolicy& policy);
+    
+    // Returns an alert once per burst of high-entropy writes
+    std::optional<ExfiltrationAlert> process(const UrbEvent& event);
+    
+    ExfiltrationStats stats(uint16_t busNumber, uint8_t deviceAddress) const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+    
+    // Shannon entropy of the bytes in bits per byte, bias-corrected for
+    // short samples
+    static double entropy(const uint8_t* data, size_t length);
+
+private:
+    using Window = RateWindow<EXFIL_WINDOW, 1000>;
+    
+    struct DeviceState {
+        std::optional<ExfiltrationPolicy> policy;
+        Window window;
+        int64_t lastWrite{0};
+        uint64_t writes{0};
+        double entropy{0.0};
+        uint64_t sampledWrites{0};
+        uint64_t sampledBytes{0};
+        uint64_t bursts{0};
+        uint64_t alerts{0};
+        bool inBurst{false};
+        bool alerted{false};
+    };
+    
+    static uint16_t deviceKey(uint16_t bus, uint8_t address) {
+        return static_cast<uint16_t>((bus << 8) | address);
+    }
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    const ExfiltrationPolicy& policyOf(const DeviceState& state) const {
+        return state.policy ? *state.policy : defaultPolicy;
+    }
+    bool takeSample(size_t bytes, bool urgent, int64_t timestamp);
+    
+    ExfiltrationPolicy defaultPolicy;
+    std::unordered_set<uint32_t> endpoints;
+    std::unordered_map<uint16_t, DeviceState> devices;
+    double budget{EXFIL_SAMPLE_BUDGET};    // Bytes that may be hashed now
+    int64_t lastRefill{-1};
+};
+
+} // namespace usb_monitor
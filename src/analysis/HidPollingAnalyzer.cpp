@@ -0,0 +1,127 @@
+// src/analysis/HidPollingAnalyzer.cpp
+#include "HidPollingAnalyzer.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+#include <cmath>
+
+namespace usb_monitor {
+
+uint32_t HidPollingAnalyzer::pollingPeriod(uint8_t bInterval, int speed) {
+    // High speed and up: 2^(bInterval-1) microframes of 125 us
+    if (speed >= LIBUSB_SPEED_HIGH) {
+        int exponent = std::clamp<int>(bInterval, 1, 16) - 1;
+        return 125u << exponent;
+    }
+    // Low and full speed: bInterval frames of 1 ms
+    return std::max<uint32_t>(bInterval, 1) * 1000;
+}
+
+uint32_t HidPollingAnalyzer::EndpointState::period() const {
+    if (declaredPeriod) return declaredPeriod;
+    
+    // Without a descriptor the fastest common interval stands in
+    return intervals.count() >= 16 ? static_cast<uint32_t>(intervals.percentile(0.10)) : 0;
+}
+
+void HidPollingAnalyzer::EndpointState::report(int64_t timestamp) {
+    reports++;
+    if (lastReport < 0 || timestamp < lastReport) {
+        lastReport = timestamp;
+        return;
+    }
+    
+    uint64_t interval = timestamp - lastReport;
+    lastReport = timestamp;
+    intervals.add(interval);
+    
+    uint32_t p = period();
+    if (p == 0 || interval > uint64_t(HID_IDLE_PERIODS) * p) return;
+    
+    // Which poll this report landed in; the ones before it had no report
+    uint64_t polls = std::max<uint64_t>(1, (interval + p / 2) / p);
+    dropped += polls - 1;
+    expectedPolls += polls;
+    activeReports++;
+    activeTime += interval;
+    
+    double deviation = double(interval) - double(polls * p);
+    jitter.add(static_cast<uint64_t>(std::abs(deviation)));
+    jitterCount++;
+    double delta = deviation - jitterMean;
+    jitterMean += delta / jitterCount;
+    jitterM2 += delta * (deviation - jitterMean);
+}
+
+void HidPollingAnalyzer::addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                                     uint32_t declaredPeriod) {
+    endpoints[endpointKey(busNumber, deviceAddress, endpoint)].declaredPeriod = declaredPeriod;
+}
+
+void HidPollingAnalyzer::process(const UrbEvent& event) {
+    // Only successful IN completions carry a report
+    if (event.type != 'C' || event.status != 0 || event.length == 0 ||
+        event.transferType != LIBUSB_TRANSFER_TYPE_INTERRUPT || !event.isInput()) {
+        return;
+    }
+    
+    auto it = endpoints.find(endpointKey(event.busNumber, event.deviceAddress, event.endpoint));
+    if (it != endpoints.end()) {
+        it->second.report(event.timestamp);
+    }
+}
+
+HidEndpointStats HidPollingAnalyzer::describe(uint32_t key, const EndpointState& state) {
+    HidEndpointStats stats;
+    stats.busNumber = uint16_t(key >> 16);
+    stats.deviceAddress = uint8_t(key >> 8);
+    stats.endpoint = uint8_t(key);
+    stats.declaredPeriod = state.declaredPeriod;
+    stats.effectivePeriod = state.period();
+    stats.reports = state.reports;
+    stats.declaredRate = state.declaredPeriod ? 1e6 / state.declaredPeriod : 0.0;
+    stats.measuredRate = state.activeTime ? state.activeReports * 1e6 / state.activeTime : 0.0;
+    stats.meanInterval = state.intervals.mean();
+    stats.p50Interval = state.intervals.percentile(0.50);
+    stats.p99Interval = state.intervals.percentile(0.99);
+    stats.jitterMean = state.jitterMean;
+    stats.jitterStdDev = state.jitterCount > 1 ? std::sqrt(state.jitterM2 / (state.jitterCount - 1)) : 0.0;
+    stats.jitterP99 = state.jitter.percentile(0.99);
+    stats.droppedReports = state.dropped;
+    stats.dropRatio = state.expectedPolls ? double(state.dropped) / state.expectedPolls : 0.0;
+    stats.intervalHistogram = state.intervals.buckets();
+    stats.jitterHistogram = state.jitter.buckets();
+    return stats;
+}
+
+std::vector<HidEndpointStats> HidPollingAnalyzer::endpointStats(uint16_t busNumber,
+                                                                uint8_t deviceAddress) const {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    
+    std::vector<HidEndpointStats> result;
+    for (const auto& [key, state] : endpoints) {
+        if ((key >> 8) == prefix) result.push_back(describe(key, state));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.endpoint < b.endpoint;
+    });
+    return result;
+}
+
+std::vector<HidEndpointStats> HidPollingAnalyzer::allStats() const {
+    std::vector<HidEndpointStats> result;
+    result.reserve(endpoints.size());
+    for (const auto& [key, state] : endpoints) {
+        result.push_back(describe(key, state));
+    }
+    return result;
+}
+
+void HidPollingAnalyzer::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    std::erase_if(endpoints, [prefix](const auto& entry) {
+        return (entry.first >> 8) == prefix;
+    });
+}
+
+} // namespace usb_monitor
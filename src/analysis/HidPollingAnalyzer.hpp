@@ -0,0 +1,80 @@
+// src/analysis/HidPollingAnalyzer.hpp
+#pragma once
+#include "UrbMatcher.hpp"
+#include "../capture/UrbEvent.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+struct HidEndpointStats {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t endpoint;
+    uint32_t declaredPeriod;    // us, from bInterval; 0 if unknown
+    uint32_t effectivePeriod;   // Declared, or estimated from the intervals
+    uint64_t reports;
+    double declaredRate;        // Hz
+    double measuredRate;        // Hz while reporting, idle gaps excluded
+    double meanInterval;        // us
+    uint64_t p50Interval;
+    uint64_t p99Interval;
+    double jitterMean;          // us, interval minus period
+    double jitterStdDev;
+    uint64_t jitterP99;         // |interval - period|, us
+    uint64_t droppedReports;    // Polls skipped inside a burst, estimated
+    double dropRatio;
+    std::array<uint32_t, LatencyHistogram::BUCKETS> intervalHistogram;
+    std::array<uint32_t, LatencyHistogram::BUCKETS> jitterHistogram;
+};
+
+// Report timing of HID interrupt IN endpoints from captured completion
+// timestamps. Gaps of more than HID_IDLE_PERIODS periods are treated as
+// the user being idle; shorter gaps that span several periods count as
+// dropped reports. Fixed memory per endpoint.
+class HidPollingAnalyzer {
+public:
+    // Only registered endpoints are analyzed
+    void addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                     uint32_t declaredPeriod);
+    void process(const UrbEvent& event);
+    
+    std::vector<HidEndpointStats> endpointStats(uint16_t busNumber, uint8_t deviceAddress) const;
+    std::vector<HidEndpointStats> allStats() const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+    
+    // Polling period in us for an interrupt endpoint's bInterval at a
+    // LIBUSB_SPEED_* device speed
+    static uint32_t pollingPeriod(uint8_t bInterval, int speed);
+
+private:
+    struct EndpointState {
+        uint32_t declaredPeriod{0};
+        int64_t lastReport{-1};
+        uint64_t reports{0};
+        uint64_t activeReports{0};
+        uint64_t activeTime{0};     // us, sum of non-idle intervals
+        uint64_t dropped{0};
+        uint64_t expectedPolls{0};  // Polls covered by non-idle intervals
+        LatencyHistogram intervals;
+        LatencyHistogram jitter;
+        // Welford running moments of the signed jitter
+        uint64_t jitterCount{0};
+        double jitterMean{0.0};
+        double jitterM2{0.0};
+        
+        uint32_t period() const;
+        void report(int64_t timestamp);
+    };
+    
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    static HidEndpointStats describe(uint32_t key, const EndpointState& state);
+
+    std::unordered_map<uint32_t, EndpointState> endpoints;
+};
+
+} // namespace usb_monitor
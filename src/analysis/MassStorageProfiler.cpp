@@ -0,0 +1,393 @@
+// src/analysis/MassStorageProfiler.cpp
+#include "MassStorageProfiler.hpp"
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr uint32_t CBW_SIGNATURE = 0x43425355;  // "USBC"
+constexpr uint32_t CSW_SIGNATURE = 0x53425355;  // "USBS"
+constexpr uint32_t CBW_LENGTH = 31;
+constexpr uint32_t CSW_LENGTH = 13;
+constexpr size_t CDB_OFFSET = 15;
+
+// Large commands needed before a best rate is trusted
+constexpr uint32_t THROTTLE_WARMUP = 8;
+constexpr double COMMAND_RATE_ALPHA = 0.25;
+
+uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint32_t be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint64_t be64(const uint8_t* p) {
+    return (uint64_t(be32(p)) << 32) | be32(p + 4);
+}
+
+uint16_t deviceKey(uint16_t busNumber, uint8_t deviceAddress) {
+    return static_cast<uint16_t>((busNumber << 8) | deviceAddress);
+}
+
+bool isBulk(const UrbEvent& event, bool input) {
+    return event.transferType == LIBUSB_TRANSFER_TYPE_BULK && event.isInput() == input;
+}
+
+} // namespace
+
+struct MassStorageProfiler::DeviceState {
+    struct Command {
+        uint32_t tag;
+        uint8_t opcode;
+        uint8_t serviceAction;  // For opcodes that carry one in CDB byte 1
+        bool isRead;
+        bool isWrite;
+        uint64_t lba;
+        uint32_t blocks;
+        uint32_t expected;      // dCBWDataTransferLength
+        int64_t start;
+    };
+    
+    struct OpcodeState {
+        uint64_t count{0};
+        uint64_t failed{0};
+        uint64_t bytes{0};
+        uint64_t busyTime{0};   // us
+        LatencyHistogram latency;
+    };
+    
+    struct Direction {
+        RateWindow<> window;
+        double commandRate{0.0};
+        double bestCommandRate{0.0};
+        uint32_t samples{0};
+        
+        void add(uint64_t bytes, int64_t latency, int64_t now) {
+            window.add(bytes, 1, RateWindow<>::Clock::time_point(std::chrono::microseconds(now)));
+            if (bytes < uint64_t(MSC_THROTTLE_MIN_BYTES) || latency <= 0) return;
+            
+            double rate = bytes * 1e6 / latency;
+            commandRate = samples++ ? commandRate + COMMAND_RATE_ALPHA * (rate - commandRate) : rate;
+            if (samples >= THROTTLE_WARMUP) {
+                bestCommandRate = std::max(bestCommandRate, commandRate);
+            }
+        }
+        
+        MassStorageDirection describe(int64_t now) const {
+            auto copy = window;
+            copy.advance(RateWindow<>::Clock::time_point(std::chrono::microseconds(now)));
+            return MassStorageDirection{
+                copy.totalBytes(),
+                copy.rate(),
+                commandRate,
+                bestCommandRate,
+                samples >= THROTTLE_WARMUP && commandRate < MSC_THROTTLE_RATIO * bestCommandRate
+            };
+        }
+    };
+    
+    std::vector<Command> pending;
+    std::map<uint8_t, OpcodeState> opcodes;
+    Direction read;
+    Direction write;
+    
+    uint32_t depth{0};
+    uint32_t peakDepth{0};
+    int64_t firstChange{-1};
+    int64_t lastChange{0};
+    int64_t lastTimestamp{0};
+    double depthIntegral{0.0};
+    
+    uint64_t capacity{0};
+    uint32_t blockSize{512};
+    uint64_t blocksPerBucket{1};
+    std::array<uint64_t, MSC_HEATMAP_BUCKETS> readHeat{};
+    std::array<uint64_t, MSC_HEATMAP_BUCKETS> writeHeat{};
+    
+    void setDepth(uint32_t newDepth, int64_t now) {
+        if (firstChange < 0) firstChange = lastChange = now;
+        if (now > lastChange) {
+            depthIntegral += double(depth) * double(now - lastChange);
+            lastChange = now;
+        }
+        depth = newDepth;
+        peakDepth = std::max(peakDepth, depth);
+    }
+    
+    // Widens the buckets (merging neighbours) until 'blocks' fit. Worked
+    // out by division: the product overflows for LBAs near 2^64.
+    void coverBlocks(uint64_t blocks) {
+        uint64_t needed = blocks / MSC_HEATMAP_BUCKETS + (blocks % MSC_HEATMAP_BUCKETS != 0);
+        while (blocksPerBucket < needed) {
+            for (auto* heat : {&readHeat, &writeHeat}) {
+                for (size_t i = 0; i < MSC_HEATMAP_BUCKETS / 2; i++) {
+                    (*heat)[i] = (*heat)[2 * i] + (*heat)[2 * i + 1];
+                }
+                std::fill(heat->begin() + MSC_HEATMAP_BUCKETS / 2, heat->end(), 0);
+            }
+            blocksPerBucket *= 2;
+        }
+    }
+    
+    void addHeat(std::array<uint64_t, MSC_HEATMAP_BUCKETS>& heat, uint64_t lba, uint32_t blocks) {
+        // A range that wraps is garbage; past a known capacity is clipped
+        if (blocks == 0 || lba > UINT64_MAX - blocks) return;
+        uint64_t end = lba + blocks;
+        if (capacity) {
+            if (lba >= capacity) return;
+            end = std::min(end, capacity);
+        }
+        coverBlocks(end);
+        
+        uint64_t last = (end - 1) / blocksPerBucket;
+        for (uint64_t bucket = lba / blocksPerBucket; bucket <= last; bucket++) {
+            uint64_t from = std::max(lba, bucket * blocksPerBucket);
+            uint64_t to = bucket == last ? end : (bucket + 1) * blocksPerBucket;
+            heat[bucket] += to - from;
+        }
+    }
+    
+    static void decodeCdb(const uint8_t* cdb, Command& command) {
+        command.opcode = cdb[0];
+        command.serviceAction = cdb[1] & 0x1F;
+        command.lba = 0;
+        command.blocks = 0;
+        switch (cdb[0]) {
+            case 0x08: case 0x0A:   // READ(6), WRITE(6)
+                command.lba = ((cdb[1] & 0x1F) << 16) | (cdb[2] << 8) | cdb[3];
+                command.blocks = cdb[4] ? cdb[4] : 256;
+                break;
+            case 0x28: case 0x2A:   // READ(10), WRITE(10)
+                command.lba = be32(cdb + 2);
+                command.blocks = (cdb[7] << 8) | cdb[8];
+                break;
+            case 0xA8: case 0xAA:   // READ(12), WRITE(12)
+                command.lba = be32(cdb + 2);
+                command.blocks = be32(cdb + 6);
+                break;
+            case 0x88: case 0x8A:   // READ(16), WRITE(16)
+                command.lba = be64(cdb + 2);
+                command.blocks = be32(cdb + 10);
+                break;
+        }
+        command.isRead = cdb[0] == 0x08 || cdb[0] == 0x28 || cdb[0] == 0xA8 || cdb[0] == 0x88;
+        command.isWrite = cdb[0] == 0x0A || cdb[0] == 0x2A || cdb[0] == 0xAA || cdb[0] == 0x8A;
+    }
+    
+    void commandWrapper(const UrbEvent& event) {
+        const uint8_t* cbw = event.data;
+        Command command{};
+        command.tag = le32(cbw + 4);
+        command.expected = le32(cbw + 8);
+        command.start = event.timestamp;
+        decodeCdb(cbw + CDB_OFFSET, command);
+        
+        if (pending.size() >= size_t(MSC_MAX_PENDING)) {
+            // The CSW for the oldest command was never seen (reset, lost capture)
+            pending.erase(pending.begin());
+            setDepth(depth - 1, event.timestamp);
+        }
+        pending.push_back(command);
+        setDepth(depth + 1, event.timestamp);
+    }
+    
+    void statusWrapper(const UrbEvent& event) {
+        const uint8_t* csw = event.data;
+        uint32_t tag = le32(csw + 4);
+        auto it = std::find_if(pending.begin(), pending.end(),
+                               [tag](const Command& command) { return command.tag == tag; });
+        if (it == pending.end()) return;
+        
+        Command command = *it;
+        pending.erase(it);
+        setDepth(depth - 1, event.timestamp);
+        
+        uint32_t residue = le32(csw + 8);
+        bool passed = csw[12] == 0;
+        uint64_t bytes = command.expected - std::min(residue, command.expected);
+        int64_t latency = std::max<int64_t>(event.timestamp - command.start, 0);
+        
+        auto& stats = opcodes[command.opcode];
+        stats.count++;
+        stats.bytes += bytes;
+        stats.busyTime += latency;
+        stats.latency.add(latency);
+        if (!passed) {
+            stats.failed++;
+            return;
+        }
+        
+        if (command.isRead) {
+            read.add(bytes, latency, event.timestamp);
+            addHeat(readHeat, command.lba, command.blocks);
+        } else if (command.isWrite) {
+            write.add(bytes, latency, event.timestamp);
+            addHeat(writeHeat, command.lba, command.blocks);
+        }
+    }
+    
+    // Data-in of READ CAPACITY sizes the heatmap to the medium
+    void dataIn(const UrbEvent& event) {
+        if (pending.empty()) return;
+        
+        const Command& command = pending.back();
+        if (command.opcode == 0x25 && event.capturedLength >= 8) {
+            capacity = uint64_t(be32(event.data)) + 1;
+            blockSize = be32(event.data + 4);
+        } else if (command.opcode == 0x9E && command.serviceAction == 0x10 &&
+                   event.capturedLength >= 12) {
+            // SERVICE ACTION IN(16) also carries GET LBA STATUS and others
+            uint64_t lastLba = be64(event.data);
+            capacity = lastLba == UINT64_MAX ? lastLba : lastLba + 1;
+            blockSize = be32(event.data + 8);
+        } else {
+            return;
+        }
+        coverBlocks(capacity);
+    }
+};
+
+MassStorageProfiler::MassStorageProfiler() = default;
+
+MassStorageProfiler::~MassStorageProfiler() = default;
+
+void MassStorageProfiler::process(const UrbEvent& event) {
+    if (event.transferType != LIBUSB_TRANSFER_TYPE_BULK || !event.data) return;
+    
+    uint16_t key = deviceKey(event.busNumber, event.deviceAddress);
+    
+    // A CBW arrives with its OUT submission; devices are only tracked once
+    // one has been seen
+    if (event.type == 'S' && isBulk(event, false)) {
+        if (event.length != CBW_LENGTH || event.capturedLength < CBW_LENGTH ||
+            le32(event.data) != CBW_SIGNATURE) {
+            return;
+        }
+        auto& state = devices[key];
+        if (!state) state = std::make_unique<DeviceState>();
+        state->lastTimestamp = std::max(state->lastTimestamp, event.timestamp);
+        state->commandWrapper(event);
+        return;
+    }
+    
+    if (event.type != 'C' || !isBulk(event, true) || event.status != 0) return;
+    
+    auto it = devices.find(key);
+    if (it == devices.end()) return;
+    
+    auto& state = *it->second;
+    state.lastTimestamp = std::max(state.lastTimestamp, event.timestamp);
+    if (event.length == CSW_LENGTH && event.capturedLength >= CSW_LENGTH &&
+        le32(event.data) == CSW_SIGNATURE) {
+        state.statusWrapper(event);
+    } else {
+        state.dataIn(event);
+    }
+}
+
+bool MassStorageProfiler::isMassStorage(uint16_t busNumber, uint8_t deviceAddress) const {
+    return devices.count(deviceKey(busNumber, deviceAddress)) > 0;
+}
+
+MassStorageProfile MassStorageProfiler::describe(uint16_t key, const DeviceState& state) const {
+    MassStorageProfile profile;
+    profile.busNumber = key >> 8;
+    profile.deviceAddress = key & 0xFF;
+    
+    for (const auto& [opcode, stats] : state.opcodes) {
+        profile.commands.push_back(ScsiCommandStats{
+            opcode,
+            opcodeName(opcode),
+            stats.count,
+            stats.failed,
+            stats.bytes,
+            stats.latency.mean(),
+            stats.latency.percentile(0.50),
+            stats.latency.percentile(0.99),
+            stats.latency.max(),
+            stats.busyTime ? stats.bytes * 1e6 / stats.busyTime : 0.0
+        });
+    }
+    
+    profile.read = state.read.describe(state.lastTimestamp);
+    profile.write = state.write.describe(state.lastTimestamp);
+    
+    profile.queueDepth = state.depth;
+    profile.peakQueueDepth = state.peakDepth;
+    double elapsed = state.firstChange >= 0 ? double(state.lastTimestamp - state.firstChange) : 0.0;
+    double integral = state.depthIntegral + double(state.depth) * double(state.lastTimestamp - state.lastChange);
+    profile.averageQueueDepth = elapsed > 0 ? integral / elapsed : state.depth;
+    
+    profile.capacityBlocks = state.capacity;
+    profile.blockSize = state.blockSize;
+    profile.blocksPerBucket = state.blocksPerBucket;
+    profile.readHeat.assign(state.readHeat.begin(), state.readHeat.end());
+    profile.writeHeat.assign(state.writeHeat.begin(), state.writeHeat.end());
+    return profile;
+}
+
+MassStorageProfile MassStorageProfiler::profile(uint16_t busNumber, uint8_t deviceAddress) const {
+    uint16_t key = deviceKey(busNumber, deviceAddress);
+    auto it = devices.find(key);
+    if (it == devices.end()) {
+        DeviceState empty;
+        return describe(key, empty);
+    }
+    return describe(key, *it->second);
+}
+
+std::vector<MassStorageProfile> MassStorageProfiler::allProfiles() const {
+    std::vector<MassStorageProfile> result;
+    result.reserve(devices.size());
+    for (const auto& [key, state] : devices) {
+        result.push_back(describe(key, *state));
+    }
+    return result;
+}
+
+void MassStorageProfiler::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    devices.erase(deviceKey(busNumber, deviceAddress));
+}
+
+std::string MassStorageProfiler::opcodeName(uint8_t opcode) {
+    switch (opcode) {
+        case 0x00: return "TEST UNIT READY";
+        case 0x03: return "REQUEST SENSE";
+        case 0x04: return "FORMAT UNIT";
+        case 0x08: return "READ(6)";
+        case 0x0A: return "WRITE(6)";
+        case 0x12: return "INQUIRY";
+        case 0x1A: return "MODE SENSE(6)";
+        case 0x1B: return "START STOP UNIT";
+        case 0x1E: return "PREVENT ALLOW MEDIUM REMOVAL";
+        case 0x23: return "READ FORMAT CAPACITIES";
+        case 0x25: return "READ CAPACITY(10)";
+        case 0x28: return "READ(10)";
+        case 0x2A: return "WRITE(10)";
+        case 0x2F: return "VERIFY(10)";
+        case 0x35: return "SYNCHRONIZE CACHE(10)";
+        case 0x42: return "UNMAP";
+        case 0x5A: return "MODE SENSE(10)";
+        case 0x88: return "READ(16)";
+        case 0x8A: return "WRITE(16)";
+        case 0x91: return "SYNCHRONIZE CACHE(16)";
+        case 0x9E: return "SERVICE ACTION IN(16)";
+        case 0xA0: return "REPORT LUNS";
+        case 0xA8: return "READ(12)";
+        case 0xAA: return "WRITE(12)";
+        default: {
+            char name[8];
+            std::snprintf(name, sizeof(name), "0x%02X", opcode);
+            return name;
+        }
+    }
+}
+
+} // namespace usb_monitor
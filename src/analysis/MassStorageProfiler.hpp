@@ -0,0 +1,78 @@
+// src/analysis/MassStorageProfiler.hpp
+#pragma once
+#include "UrbMatcher.hpp"
+#include "../capture/UrbEvent.hpp"
+#include "../core/RateWindow.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+struct ScsiCommandStats {
+    uint8_t opcode;
+    std::string name;
+    uint64_t count;
+    uint64_t failed;            // CSW status other than passed
+    uint64_t bytes;             // Data actually transferred
+    double meanLatency;         // us, CBW submit to CSW complete
+    uint64_t p50Latency;
+    uint64_t p99Latency;
+    uint64_t maxLatency;
+    double throughput;          // bytes/s while commands were outstanding
+};
+
+struct MassStorageDirection {
+    uint64_t bytes;
+    double rate;                // bytes/s over the recent window
+    double commandRate;         // bytes/s per large command, smoothed
+    double bestCommandRate;
+    bool throttled;             // commandRate fell well below the best
+};
+
+struct MassStorageProfile {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    std::vector<ScsiCommandStats> commands;
+    MassStorageDirection read;
+    MassStorageDirection write;
+    uint32_t queueDepth;
+    uint32_t peakQueueDepth;
+    double averageQueueDepth;   // Time-weighted
+    uint64_t capacityBlocks;    // From READ CAPACITY, 0 if not seen
+    uint32_t blockSize;
+    uint64_t blocksPerBucket;   // LBA span of one heatmap bucket
+    std::vector<uint64_t> readHeat;   // Blocks read per bucket
+    std::vector<uint64_t> writeHeat;
+};
+
+// Decodes Bulk-Only Transport from capture (CBW on bulk OUT, CSW on bulk
+// IN) and profiles each mass-storage device's SCSI commands. Everything is
+// aggregated incrementally, in fixed memory per device.
+class MassStorageProfiler {
+public:
+    MassStorageProfiler();
+    ~MassStorageProfiler();
+
+    void process(const UrbEvent& event);
+    
+    bool isMassStorage(uint16_t busNumber, uint8_t deviceAddress) const;
+    MassStorageProfile profile(uint16_t busNumber, uint8_t deviceAddress) const;
+    std::vector<MassStorageProfile> allProfiles() const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+    
+    static std::string opcodeName(uint8_t opcode);
+
+private:
+    struct DeviceState;
+    
+    MassStorageProfile describe(uint16_t key, const DeviceState& state) const;
+
+    std::unordered_map<uint16_t, std::unique_ptr<DeviceState>> devices;
+};
+
+} // namespace usb_monitor
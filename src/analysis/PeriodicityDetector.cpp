@@ -0,0 +1,210 @@
+// src/analysis/PeriodicityDetector.cpp
+#include "PeriodicityDetector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr size_t FFT_SIZE = PERIODICITY_WINDOW * 2;    // Zero padded, no wraparound
+constexpr uint32_t MIN_EVENTS = 8;
+
+// Of the correlation peaks at least this close to the highest, the
+// shortest lag is the fundamental
+constexpr double PEAK_FRACTION = 0.8;
+
+// Inter-arrival spread under which the gaps alone give the period
+constexpr double REGULAR_SPREAD = 1.25;
+
+} // namespace
+
+PeriodicityDetector::PeriodicityDetector()
+    : spectrum(FFT_SIZE)
+    , twiddles(FFT_SIZE / 2)
+    , correlation(PERIODICITY_WINDOW / 2 + 1) {
+    for (size_t i = 0; i < twiddles.size(); i++) {
+        twiddles[i] = std::polar(1.0, -2.0 * std::numbers::pi * i / FFT_SIZE);
+    }
+}
+
+void PeriodicityDetector::fft(std::vector<std::complex<double>>& data, bool inverse) const {
+    size_t n = data.size();
+    
+    // Bit-reversal permutation, then iterative radix-2 butterflies
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(data[i], data[j]);
+    }
+    for (size_t length = 2; length <= n; length <<= 1) {
+        size_t stride = n / length;
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t k = 0; k < length / 2; k++) {
+                auto w = twiddles[k * stride];
+                if (inverse) w = std::conj(w);
+                auto even = data[start + k];
+                auto odd = data[start + k + length / 2] * w;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+            }
+        }
+    }
+}
+
+void PeriodicityDetector::autocorrelate(const std::vector<uint16_t>& bins) {
+    double mean = 0.0;
+    for (uint16_t count : bins) mean += count;
+    mean /= bins.size();
+    
+    // Wiener-Khinchin: the inverse transform of the power spectrum
+    for (size_t i = 0; i < bins.size(); i++) spectrum[i] = bins[i] - mean;
+    std::fill(spectrum.begin() + bins.size(), spectrum.end(), 0.0);
+    fft(spectrum, false);
+    for (auto& value : spectrum) value = std::norm(value);
+    fft(spectrum, true);
+    
+    double zero = spectrum[0].real();
+    for (size_t lag = 0; lag < correlation.size(); lag++) {
+        correlation[lag] = zero > 0 ? spectrum[lag].real() / zero : 0.0;
+    }
+}
+
+void PeriodicityDetector::analyze(EndpointState& state, uint8_t endpoint) {
+    state.valid = false;
+    if (state.events < MIN_EVENTS || state.gaps.count() < MIN_EVENTS - 1) return;
+    
+    double windowTime = double(PERIODICITY_WINDOW) * PERIODICITY_BIN;
+    EndpointPeriod result{};
+    result.endpoint = endpoint;
+    result.eventRate = state.events * 1e6 / windowTime;
+    result.emptyFraction = double(state.empty) / state.events;
+    
+    double meanGap = double(state.gapSum) / state.gaps.count();
+    double p10 = double(state.gaps.percentile(0.10));
+    double p50 = double(state.gaps.percentile(0.50));
+    double p90 = double(state.gaps.percentile(0.90));
+    bool regular = p10 > 0 && p90 <= REGULAR_SPREAD * p10;
+    
+    // Faster than two bins only the gaps can tell
+    if (meanGap < 2.0 * PERIODICITY_BIN) {
+        if (!regular) return;
+        result.period = meanGap;
+        result.strength = p10 / p90;
+        result.eventsPerBurst = 1.0;
+        state.result = result;
+        state.valid = true;
+        return;
+    }
+    
+    autocorrelate(state.bins);
+    
+    double highest = 0.0;
+    for (size_t lag = 2; lag + 1 < correlation.size(); lag++) {
+        highest = std::max(highest, correlation[lag]);
+    }
+    if (highest < PERIODICITY_MIN_CORRELATION) return;
+    
+    size_t peak = 0;
+    for (size_t lag = 2; lag + 1 < correlation.size(); lag++) {
+        double r = correlation[lag];
+        if (r >= PEAK_FRACTION * highest && r >= correlation[lag - 1] && r >= correlation[lag + 1]) {
+            peak = lag;
+            break;
+        }
+    }
+    if (peak == 0) return;
+    
+    // Parabolic interpolation puts the peak between bins
+    double before = correlation[peak - 1];
+    double at = correlation[peak];
+    double after = correlation[peak + 1];
+    double curvature = before - 2.0 * at + after;
+    double offset = curvature < 0 ? 0.5 * (before - after) / curvature : 0.0;
+    double period = (peak + offset) * PERIODICITY_BIN;
+    
+    // Gaps that agree with the correlation give a finer period
+    if (regular && std::abs(meanGap - period) <= PERIODICITY_BIN) period = meanGap;
+    
+    result.period = period;
+    result.strength = at;
+    result.eventsPerBurst = state.events * period / windowTime;
+    result.bursty = p50 < period / 4 && result.eventsPerBurst >= 1.5;
+    state.result = result;
+    state.valid = true;
+}
+
+void PeriodicityDetector::addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint) {
+    endpoints.try_emplace(endpointKey(busNumber, deviceAddress, endpoint));
+}
+
+void PeriodicityDetector::process(const UrbEvent& event) {
+    if (event.type != 'C') return;
+    
+    // Any traffic moves the clock that ages out stopped endpoints
+    latest = std::max(latest, event.timestamp);
+    auto it = endpoints.find(endpointKey(event.busNumber, event.deviceAddress, event.endpoint));
+    if (it == endpoints.end()) return;
+    
+    auto& state = it->second;
+    if (state.bins.empty()) state.bins.resize(PERIODICITY_WINDOW);
+    
+    int64_t windowLength = int64_t(PERIODICITY_WINDOW) * PERIODICITY_BIN;
+    if (state.windowStart < 0 || event.timestamp < state.windowStart) {
+        state.windowStart = event.timestamp;
+    } else if (event.timestamp >= state.windowStart + windowLength) {
+        analyze(state, event.endpoint);
+        state.analyzedAt = state.windowStart + windowLength;
+        
+        // Windows follow on back to back unless the endpoint went quiet
+        int64_t next = state.windowStart + windowLength;
+        state.windowStart = event.timestamp < next + windowLength ? next : event.timestamp;
+        std::fill(state.bins.begin(), state.bins.end(), 0);
+        state.events = state.empty = 0;
+        state.gaps = LatencyHistogram();
+        state.gapSum = 0;
+    }
+    
+    size_t bin = size_t((event.timestamp - state.windowStart) / PERIODICITY_BIN);
+    if (state.bins[bin] < UINT16_MAX) state.bins[bin]++;
+    state.events++;
+    if (event.length == 0) state.empty++;
+    
+    if (state.lastEvent >= 0 && event.timestamp >= state.lastEvent &&
+        event.timestamp - state.lastEvent < windowLength) {
+        uint64_t gap = uint64_t(event.timestamp - state.lastEvent);
+        state.gaps.add(gap);
+        state.gapSum += gap;
+    }
+    state.lastEvent = event.timestamp;
+}
+
+std::vector<EndpointPeriod> PeriodicityDetector::periods(uint16_t busNumber,
+                                                         uint8_t deviceAddress) const {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    int64_t stale = int64_t(PERIODICITY_WINDOW) * PERIODICITY_BIN * 2;
+    
+    std::vector<EndpointPeriod> result;
+    for (const auto& [key, state] : endpoints) {
+        if ((key >> 8) != prefix || !state.valid) continue;
+        
+        // An endpoint that stopped has no current period
+        if (latest - state.analyzedAt > stale) continue;
+        result.push_back(state.result);
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.endpoint < b.endpoint;
+    });
+    return result;
+}
+
+void PeriodicityDetector::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    std::erase_if(endpoints, [prefix](const auto& entry) {
+        return (entry.first >> 8) == prefix;
+    });
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,73 @@
+// src/analysis/PeriodicityDetector.hpp
+#pragma once
+#include "UrbMatcher.hpp"
+#include "../capture/UrbEvent.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <complex>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+struct EndpointPeriod {
+    uint8_t endpoint;
+    double period;              // us between polls, or between bursts
+    double strength;            // 0..1, how clean the periodicity is
+    bool bursty;                // Several transfers per period
+    double eventsPerBurst;
+    double eventRate;           // Completions/s
+    double emptyFraction;       // Completions that moved no data
+};
+
+// Finds the period of each endpoint's traffic over fixed windows of
+// PERIODICITY_WINDOW bins. Completions are counted into bins and the
+// window's autocorrelation is taken through an FFT; the inter-arrival
+// histogram covers periods shorter than two bins. Fixed memory per
+// endpoint.
+class PeriodicityDetector {
+public:
+    PeriodicityDetector();
+    
+    // Only registered endpoints are analyzed; their window is allocated
+    // on first traffic
+    void addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint);
+    void process(const UrbEvent& event);
+    
+    // Endpoints of the device found periodic in their last full window
+    std::vector<EndpointPeriod> periods(uint16_t busNumber, uint8_t deviceAddress) const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+
+private:
+    struct EndpointState {
+        std::vector<uint16_t> bins;
+        int64_t windowStart{-1};
+        int64_t lastEvent{-1};
+        uint32_t events{0};
+        uint32_t empty{0};
+        LatencyHistogram gaps;          // Inter-arrival, this window
+        uint64_t gapSum{0};
+        
+        bool valid{false};
+        int64_t analyzedAt{0};
+        EndpointPeriod result{};
+    };
+    
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    void analyze(EndpointState& state, uint8_t endpoint);
+    void autocorrelate(const std::vector<uint16_t>& bins);
+    void fft(std::vector<std::complex<double>>& data, bool inverse) const;
+
+    std::unordered_map<uint32_t, EndpointState> endpoints;
+    int64_t latest{0};
+    
+    // Scratch shared by all endpoints
+    std::vector<std::complex<double>> spectrum;
+    std::vector<std::complex<double>> twiddles;
+    std::vector<double> correlation;
+};
+
+} // namespace usb_monitor
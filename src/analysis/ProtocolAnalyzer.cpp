@@ -1,19 +1,55 @@
 // src/analysis/ProtocolAnalyzer.cpp
 #include "ProtocolAnalyzer.hpp"
 #include "../core/UsbDevice.hpp"
+#include "../core/BandwidthMonitor.hpp"
+#include "../capture/UsbmonReader.hpp"
+#include "../capture/CaptureStore.hpp"
+#include "../capture/PayloadSearch.hpp"
+#include "../core/Logger.hpp"
 #include <QTimer>
+#include <algorithm>
+#include <cmath>
 #include <deque>
+#include <map>
 #include <mutex>
 #include <chrono>
+#include <optional>
+#include <unordered_map>
 
 namespace usb_monitor {
 
+namespace {
+
+// UVC interface subclasses and class-specific descriptor codes
+constexpr uint8_t UVC_SUBCLASS_VIDEOCONTROL = 0x01;
+constexpr uint8_t UVC_SUBCLASS_VIDEOSTREAMING = 0x02;
+constexpr uint8_t UVC_CS_INTERFACE = 0x24;
+constexpr uint8_t UVC_VC_HEADER = 0x01;
+
+// UAC streaming interfaces and their class-specific descriptors
+constexpr uint8_t UAC_SUBCLASS_AUDIOSTREAMING = 0x02;
+constexpr uint8_t UAC_VERSION_2 = 0x20;
+constexpr uint8_t UAC_CS_INTERFACE = 0x24;
+constexpr uint8_t UAC_AS_GENERAL = 0x01;
+constexpr uint8_t UAC_FORMAT_TYPE = 0x02;
+constexpr uint8_t UAC_FORMAT_TYPE_I = 0x01;
+constexpr uint8_t USB_ENDPOINT_USAGE_FEEDBACK = 0x10;
+
+// CDC-ACM communication interfaces and the union functional descriptor
+constexpr uint8_t CDC_SUBCLASS_ACM = 0x02;
+constexpr uint8_t CDC_CS_INTERFACE = 0x24;
+constexpr uint8_t CDC_UNION = 0x06;
+
+} // namespace
+
 struct TransferRecord {
     std::chrono::steady_clock::time_point timestamp;
     uint8_t endpointAddress;
-    std::vector<uint8_t> data;
+    size_t length;
     bool isInput;
     int status;
+    std::chrono::microseconds latency;
+    uint64_t payload;
 };
 
 class ProtocolAnalyzer::Private {
@@ -22,27 +58,68 @@ public:
     std::map<const UsbDevice*, QTimer*> monitoringTimers;
     size_t maxHistorySize{1000};
     std::mutex historyMutex;
-    ProtocolAnalyzer* q_ptr;
+    ProtocolAnalyzer* q_ptr{nullptr};
+    
+    // Capture state. Monitored devices are looked up by bus/address, which
+    // is all usbmon reports.
+    UrbMatcher matcher;
+    MassStorageProfiler massStorage;
+    HidPollingAnalyzer hidPolling;
+    VideoStreamAnalyzer video;
+    AudioStreamAnalyzer audio;
+    CdcAcmTracker serial;
+    PeriodicityDetector periodicity;
+    ExfiltrationDetector exfiltration;
+    
+    // Payload snippets of monitored endpoints, keyed for the store by
+    // interface class. OUT data is held by URB id until it completes.
+    CaptureStore payloads;
+    std::unordered_map<uint32_t, uint8_t> endpointClasses;
+    std::unordered_map<uint64_t, uint64_t> pendingPayloads;
+    std::unique_ptr<PayloadSearch> payloadSearch;   // Started on first search
+    std::once_flag payloadSearchOnce;
+    std::mutex captureMutex;
+    std::unordered_map<uint16_t, const UsbDevice*> devicesByAddress;
+    std::unordered_map<uint16_t, const UsbDevice*> watchedStorage;  // Exfiltration only
+    UsbmonReader* reader{nullptr};
+    BandwidthMonitor* bandwidth{nullptr};   // Fed the matched transfers
+    QTimer* expiryTimer{nullptr};
+    
+    static uint16_t addressKey(uint16_t busNumber, uint8_t deviceAddress) {
+        return static_cast<uint16_t>((busNumber << 8) | deviceAddress);
+    }
+    
+    static uint32_t endpointKey(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint) {
+        return (uint32_t(busNumber) << 16) | (uint32_t(deviceAddress) << 8) | endpoint;
+    }
     
     void recordTransfer(const UsbDevice* device,
                        uint8_t endpointAddress,
-                       const std::vector<uint8_t>& data,
+                       size_t length,
                        bool isInput,
-                       int status) {
+                       int status,
+                       std::chrono::microseconds latency = std::chrono::microseconds(0)) {
         std::lock_guard<std::mutex> lock(historyMutex);
-        
-        auto& history = transferHistory[device];
-        
+        recordLocked(transferHistory[device], endpointAddress, length, isInput, status, latency);
+    }
+    
+    void recordLocked(std::deque<TransferRecord>& history,
+                      uint8_t endpointAddress,
+                      size_t length,
+                      bool isInput,
+                      int status,
+                      std::chrono::microseconds latency,
+                      uint64_t payload = CaptureStore::NO_PAYLOAD) {
         // Add new record
-        TransferRecord record{
+        history.push_back(TransferRecord{
             std::chrono::steady_clock::now(),
             endpointAddress,
-            data,
+            length,
             isInput,
-            status
-        };
-        
-        history.push_back(std::move(record));
+            status,
+            latency,
+            payload
+        });
         
         // Trim history if needed
         while (history.size() > maxHistorySize) {
@@ -50,9 +127,335 @@ public:
         }
     }
     
+    // dwClockFrequency from the UVC VideoControl header, 0 if absent
+    static uint32_t videoClockFrequency(const libusb_config_descriptor* config) {
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            const libusb_interface* interface = &config->interface[i];
+            for (int j = 0; j < interface->num_altsetting; j++) {
+                const libusb_interface_descriptor* setting = &interface->altsetting[j];
+                if (setting->bInterfaceClass != LIBUSB_CLASS_VIDEO ||
+                    setting->bInterfaceSubClass != UVC_SUBCLASS_VIDEOCONTROL) {
+                    continue;
+                }
+                
+                // Class-specific descriptors, each prefixed by its length
+                const unsigned char* extra = setting->extra;
+                int remaining = setting->extra_length;
+                while (remaining >= 2 && extra[0] >= 2 && extra[0] <= remaining) {
+                    if (extra[0] >= 11 && extra[1] == UVC_CS_INTERFACE && extra[2] == UVC_VC_HEADER) {
+                        return uint32_t(extra[7]) | uint32_t(extra[8]) << 8 |
+                               uint32_t(extra[9]) << 16 | uint32_t(extra[10]) << 24;
+                    }
+                    remaining -= extra[0];
+                    extra += extra[0];
+                }
+            }
+        }
+        return 0;
+    }
+    
+    // Frame size and, for UAC1 with a single discrete rate, the sample rate
+    // of an audio streaming alternate setting
+    static AudioFormat audioFormat(const libusb_interface_descriptor* setting) {
+        AudioFormat format{setting->bInterfaceNumber, setting->bAlternateSetting, 0, 0};
+        bool uac2 = setting->bInterfaceProtocol == UAC_VERSION_2;
+        int channels = 0;
+        int subslot = 0;
+        
+        const unsigned char* extra = setting->extra;
+        int remaining = setting->extra_length;
+        while (remaining >= 3 && extra[0] >= 3 && extra[0] <= remaining) {
+            int length = extra[0];
+            if (extra[1] == UAC_CS_INTERFACE) {
+                if (uac2 && extra[2] == UAC_AS_GENERAL && length >= 11) {
+                    channels = extra[10];
+                } else if (uac2 && extra[2] == UAC_FORMAT_TYPE && length >= 6 &&
+                           extra[3] == UAC_FORMAT_TYPE_I) {
+                    subslot = extra[4];
+                } else if (!uac2 && extra[2] == UAC_FORMAT_TYPE && length >= 8 &&
+                           extra[3] == UAC_FORMAT_TYPE_I) {
+                    channels = extra[4];
+                    subslot = extra[5];
+                    if (extra[7] == 1 && length >= 11) {
+                        format.sampleRate = extra[8] | extra[9] << 8 | extra[10] << 16;
+                    }
+                }
+            }
+            remaining -= length;
+            extra += length;
+        }
+        format.bytesPerFrame = static_cast<uint16_t>(channels * subslot);
+        return format;
+    }
+    
+    void registerAudioEndpoint(const DeviceIdentifier& id, int speed,
+                               const libusb_interface_descriptor* setting,
+                               const libusb_endpoint_descriptor* endpoint) {
+        if ((endpoint->bmAttributes & LIBUSB_ISO_USAGE_TYPE_MASK) != USB_ENDPOINT_USAGE_FEEDBACK) {
+            audio.addEndpoint(id.busNumber, id.deviceAddress, endpoint->bEndpointAddress,
+                              AudioStreamAnalyzer::servicePeriod(endpoint->bInterval, speed),
+                              audioFormat(setting));
+            return;
+        }
+        
+        // Explicit feedback serves the data endpoint of the same setting
+        for (int k = 0; k < setting->bNumEndpoints; k++) {
+            const libusb_endpoint_descriptor* data = &setting->endpoint[k];
+            if (data != endpoint &&
+                (data->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) {
+                audio.addFeedback(id.busNumber, id.deviceAddress, endpoint->bEndpointAddress,
+                                  data->bEndpointAddress, speed >= LIBUSB_SPEED_HIGH);
+                return;
+            }
+        }
+    }
+    
+    // Pairs each ACM communication interface with its data interface
+    void registerSerialPorts(const DeviceIdentifier& id, const libusb_config_descriptor* config) {
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            if (config->interface[i].num_altsetting < 1) continue;
+            const libusb_interface_descriptor* comm = &config->interface[i].altsetting[0];
+            if (comm->bInterfaceClass != LIBUSB_CLASS_COMM ||
+                comm->bInterfaceSubClass != CDC_SUBCLASS_ACM) {
+                continue;
+            }
+            
+            uint8_t notify = 0;
+            for (int k = 0; k < comm->bNumEndpoints; k++) {
+                const libusb_endpoint_descriptor* endpoint = &comm->endpoint[k];
+                if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_INTERRUPT &&
+                    (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN)) {
+                    notify = endpoint->bEndpointAddress;
+                }
+            }
+            
+            // The union descriptor names the data interface; without one
+            // it conventionally follows
+            int dataInterface = comm->bInterfaceNumber + 1;
+            const unsigned char* extra = comm->extra;
+            int remaining = comm->extra_length;
+            while (remaining >= 3 && extra[0] >= 3 && extra[0] <= remaining) {
+                if (extra[1] == CDC_CS_INTERFACE && extra[2] == CDC_UNION && extra[0] >= 5) {
+                    dataInterface = extra[4];
+                }
+                remaining -= extra[0];
+                extra += extra[0];
+            }
+            
+            for (int j = 0; j < config->bNumInterfaces; j++) {
+                if (config->interface[j].num_altsetting < 1) continue;
+                const libusb_interface_descriptor* data = &config->interface[j].altsetting[0];
+                if (data->bInterfaceNumber != dataInterface ||
+                    data->bInterfaceClass != LIBUSB_CLASS_DATA) {
+                    continue;
+                }
+                
+                uint8_t in = 0;
+                uint8_t out = 0;
+                for (int k = 0; k < data->bNumEndpoints; k++) {
+                    const libusb_endpoint_descriptor* endpoint = &data->endpoint[k];
+                    if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK) continue;
+                    if (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN) {
+                        in = endpoint->bEndpointAddress;
+                    } else {
+                        out = endpoint->bEndpointAddress;
+                    }
+                }
+                if (in && out) {
+                    serial.addPort(id.busNumber, id.deviceAddress, notify, in, out);
+                }
+            }
+        }
+    }
+    
+    // Tells the class analyzers which captured endpoints belong to them
+    void registerEndpoints(const UsbDevice* device) {
+        auto config = device->configDescriptor();
+        if (!config) return;
+        
+        auto id = device->identifier();
+        int speed = libusb_get_device_speed(device->nativeDevice());
+        uint32_t videoClock = videoClockFrequency(config.get());
+        
+        std::lock_guard<std::mutex> lock(captureMutex);
+        registerSerialPorts(id, config.get());
+        endpointClasses[endpointKey(id.busNumber, id.deviceAddress, 0x00)] = LIBUSB_CLASS_PER_INTERFACE;
+        endpointClasses[endpointKey(id.busNumber, id.deviceAddress, 0x80)] = LIBUSB_CLASS_PER_INTERFACE;
+        periodicity.addEndpoint(id.busNumber, id.deviceAddress, 0x00);
+        periodicity.addEndpoint(id.busNumber, id.deviceAddress, 0x80);
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            const libusb_interface* interface = &config->interface[i];
+            for (int j = 0; j < interface->num_altsetting; j++) {
+                const libusb_interface_descriptor* setting = &interface->altsetting[j];
+                
+                for (int k = 0; k < setting->bNumEndpoints; k++) {
+                    const libusb_endpoint_descriptor* endpoint = &setting->endpoint[k];
+                    uint8_t type = endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+                    bool input = endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN;
+                    endpointClasses[endpointKey(id.busNumber, id.deviceAddress,
+                                                endpoint->bEndpointAddress)] = setting->bInterfaceClass;
+                    periodicity.addEndpoint(id.busNumber, id.deviceAddress, endpoint->bEndpointAddress);
+                    
+                    if (setting->bInterfaceClass == LIBUSB_CLASS_HID &&
+                        type == LIBUSB_TRANSFER_TYPE_INTERRUPT && input) {
+                        hidPolling.addEndpoint(id.busNumber, id.deviceAddress,
+                                               endpoint->bEndpointAddress,
+                                               HidPollingAnalyzer::pollingPeriod(endpoint->bInterval, speed));
+                    }
+                    if (setting->bInterfaceClass == LIBUSB_CLASS_VIDEO &&
+                        setting->bInterfaceSubClass == UVC_SUBCLASS_VIDEOSTREAMING && input &&
+                        (type == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS || type == LIBUSB_TRANSFER_TYPE_BULK)) {
+                        video.addEndpoint(id.busNumber, id.deviceAddress,
+                                          endpoint->bEndpointAddress, videoClock);
+                    }
+                    if (setting->bInterfaceClass == LIBUSB_CLASS_AUDIO &&
+                        setting->bInterfaceSubClass == UAC_SUBCLASS_AUDIOSTREAMING &&
+                        type == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) {
+                        registerAudioEndpoint(id, speed, setting, endpoint);
+                    }
+                }
+            }
+        }
+        registerStorageWrites(id, config.get());
+    }
+    
+    // Locked; returns whether the device has any mass storage bulk OUT
+    bool registerStorageWrites(const DeviceIdentifier& id, const libusb_config_descriptor* config) {
+        bool found = false;
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            const libusb_interface* interface = &config->interface[i];
+            for (int j = 0; j < interface->num_altsetting; j++) {
+                const libusb_interface_descriptor* setting = &interface->altsetting[j];
+                if (setting->bInterfaceClass != LIBUSB_CLASS_MASS_STORAGE) continue;
+                
+                for (int k = 0; k < setting->bNumEndpoints; k++) {
+                    const libusb_endpoint_descriptor* endpoint = &setting->endpoint[k];
+                    if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_BULK &&
+                        !(endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN)) {
+                        exfiltration.addEndpoint(id.busNumber, id.deviceAddress, endpoint->bEndpointAddress);
+                        found = true;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+    
+    // Capture thread, locked. OUT data comes with the submission and IN
+    // data with the completion; isochronous payloads are left to the
+    // stream analyzers.
+    uint64_t storePayload(const UrbEvent& event) {
+        if (event.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) return CaptureStore::NO_PAYLOAD;
+        
+        auto cls = endpointClasses.find(endpointKey(event.busNumber, event.deviceAddress, event.endpoint));
+        if (cls == endpointClasses.end()) return CaptureStore::NO_PAYLOAD;
+        
+        bool hasData = event.data && event.capturedLength;
+        CaptureTag tag{event.timestamp, addressKey(event.busNumber, event.deviceAddress), event.endpoint};
+        if (event.type == 'S') {
+            if (!event.isInput() && hasData) {
+                if (pendingPayloads.size() >= size_t(URB_TABLE_CAPACITY)) pendingPayloads.clear();
+                pendingPayloads[event.id] = payloads.append(cls->second, event.data, event.capturedLength, tag);
+            }
+            return CaptureStore::NO_PAYLOAD;
+        }
+        
+        auto pending = pendingPayloads.find(event.id);
+        if (pending != pendingPayloads.end()) {
+            uint64_t handle = pending->second;
+            pendingPayloads.erase(pending);
+            return handle;
+        }
+        return event.isInput() && hasData
+            ? payloads.append(cls->second, event.data, event.capturedLength, tag)
+            : CaptureStore::NO_PAYLOAD;
+    }
+    
+    // Capture thread; the alert is raised on the analyzer's thread
+    void reportExfiltration(const ExfiltrationAlert& alert) {
+        QMetaObject::invokeMethod(q_ptr, [this, alert]() {
+            const UsbDevice* device = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(historyMutex);
+                uint16_t key = addressKey(alert.busNumber, alert.deviceAddress);
+                auto it = devicesByAddress.find(key);
+                if (it != devicesByAddress.end()) {
+                    device = it->second;
+                } else if (auto watched = watchedStorage.find(key); watched != watchedStorage.end()) {
+                    device = watched->second;
+                } else {
+                    return;
+                }
+            }
+            emit q_ptr->exfiltrationSuspected(device, alert);
+        }, Qt::QueuedConnection);
+    }
+    
+    // Capture thread
+    void handleUrb(const UrbEvent& event) {
+        std::optional<MatchedTransfer> matched;
+        std::optional<ExfiltrationAlert> alert;
+        uint64_t payload;
+        {
+            std::lock_guard<std::mutex> lock(captureMutex);
+            payload = storePayload(event);
+            matched = matcher.process(event);
+            massStorage.process(event);
+            hidPolling.process(event);
+            video.process(event);
+            audio.process(event);
+            serial.process(event);
+            periodicity.process(event);
+            alert = exfiltration.process(event);
+        }
+        if (alert) {
+            reportExfiltration(*alert);
+        }
+        if (!matched) return;
+        
+        const UsbDevice* device = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(historyMutex);
+            auto it = devicesByAddress.find(addressKey(matched->busNumber, matched->deviceAddress));
+            if (it == devicesByAddress.end()) return;
+            
+            device = it->second;
+            recordLocked(transferHistory[device],
+                         matched->endpoint,
+                         matched->actual,
+                         matched->endpoint & LIBUSB_ENDPOINT_IN,
+                         matched->status,
+                         std::chrono::microseconds(matched->latency),
+                         payload);
+            // Still monitored while the lock is held, so safe to describe
+            if (bandwidth) {
+                bandwidth->recordTransfer(device, matched->endpoint, matched->actual);
+            }
+        }
+        
+        if (matched->status != 0) {
+            uint8_t endpoint = matched->endpoint;
+            int status = matched->status;
+            QMetaObject::invokeMethod(q_ptr, [this, device, endpoint, status]() {
+                // The device may have stopped being monitored meanwhile
+                {
+                    std::lock_guard<std::mutex> lock(historyMutex);
+                    if (transferHistory.find(device) == transferHistory.end()) return;
+                }
+                emit q_ptr->transferError(device, endpoint, status);
+            }, Qt::QueuedConnection);
+        }
+    }
+    
     void analyzeProtocol(const UsbDevice* device) {
         if (!device || !device->isOpen()) return;
         
+        // With capture running the history holds real transfers
+        if (reader && reader->isRunning()) {
+            analyzeTransferPatterns(device);
+            return;
+        }
+        
         // Monitor endpoints for activity
         libusb_device* dev = device->nativeDevice();
         libusb_config_descriptor* config;
@@ -66,10 +469,9 @@ public:
                         const libusb_endpoint_descriptor* endpoint = &setting->endpoint[k];
                         
                         // Simulate some transfer activity for demonstration
-                        std::vector<uint8_t> dummyData(endpoint->wMaxPacketSize);
                         recordTransfer(device,
                                      endpoint->bEndpointAddress,
-                                     dummyData,
+                                     endpoint->wMaxPacketSize,
                                      endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN,
                                      0);
                     }
@@ -83,6 +485,13 @@ public:
     }
     
     void analyzeTransferPatterns(const UsbDevice* device) {
+        std::vector<EndpointPeriod> periods;
+        if (reader && reader->isRunning()) {
+            auto id = device->identifier();
+            std::lock_guard<std::mutex> lock(captureMutex);
+            periods = periodicity.periods(id.busNumber, id.deviceAddress);
+        }
+        
         std::lock_guard<std::mutex> lock(historyMutex);
         
         auto it = transferHistory.find(device);
@@ -99,7 +508,7 @@ public:
         
         for (const auto& record : history) {
             endpointFrequency[record.endpointAddress]++;
-            averageTransferSize[record.endpointAddress] += record.data.size();
+            averageTransferSize[record.endpointAddress] += record.length;
             if (record.status != 0) {
                 errorCount[record.endpointAddress]++;
             }
@@ -139,6 +548,7 @@ public:
             }
         }
         pattern.hasRegularTransferSizes = regularSizes;
+        pattern.periodicEndpoints = std::move(periods);
         
         // Check error rates
         for (const auto& pair : errorCount) {
@@ -158,6 +568,7 @@ public:
 ProtocolAnalyzer::ProtocolAnalyzer(QObject* parent)
     : QObject(parent)
     , d(std::make_unique<Private>()) {
+    d->q_ptr = this;
 }
 
 ProtocolAnalyzer::~ProtocolAnalyzer() {
@@ -191,6 +602,12 @@ void ProtocolAnalyzer::startMonitoring(std::shared_ptr<UsbDevice> device) {
     {
         std::lock_guard<std::mutex> lock(d->historyMutex);
         d->transferHistory[device.get()] = std::deque<TransferRecord>();
+        auto id = device->identifier();
+        d->devicesByAddress[Private::addressKey(id.busNumber, id.deviceAddress)] = device.get();
+    }
+    d->registerEndpoints(device.get());
+    if (d->bandwidth && isCapturing()) {
+        d->bandwidth->setCaptureFeed(device.get(), true);
     }
     
     // Initial analysis
@@ -207,9 +624,105 @@ void ProtocolAnalyzer::stopMonitoring(std::shared_ptr<UsbDevice> device) {
         d->monitoringTimers.erase(it);
     }
     
+    if (d->bandwidth) {
+        d->bandwidth->setCaptureFeed(device.get(), false);
+    }
+    
+    // Writes of a device watched for exfiltration stay watched
+    auto id = device->identifier();
+    uint16_t key = Private::addressKey(id.busNumber, id.deviceAddress);
+    bool watched;
     {
         std::lock_guard<std::mutex> lock(d->historyMutex);
         d->transferHistory.erase(device.get());
+        d->devicesByAddress.erase(key);
+        watched = d->watchedStorage.count(key) > 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(d->captureMutex);
+        d->matcher.removeDevice(id.busNumber, id.deviceAddress);
+        d->massStorage.removeDevice(id.busNumber, id.deviceAddress);
+        d->hidPolling.removeDevice(id.busNumber, id.deviceAddress);
+        d->video.removeDevice(id.busNumber, id.deviceAddress);
+        d->audio.removeDevice(id.busNumber, id.deviceAddress);
+        d->serial.removeDevice(id.busNumber, id.deviceAddress);
+        d->periodicity.removeDevice(id.busNumber, id.deviceAddress);
+        if (!watched) {
+            d->exfiltration.removeDevice(id.busNumber, id.deviceAddress);
+        }
+        
+        uint32_t prefix = Private::endpointKey(id.busNumber, id.deviceAddress, 0) >> 8;
+        std::erase_if(d->endpointClasses, [prefix](const auto& entry) {
+            return (entry.first >> 8) == prefix;
+        });
+    }
+}
+
+bool ProtocolAnalyzer::watchExfiltration(std::shared_ptr<UsbDevice> device,
+                                         const ExfiltrationPolicy& policy) {
+    if (!device) return false;
+    auto config = device->configDescriptor();
+    if (!config) return false;
+    
+    auto id = device->identifier();
+    uint16_t key = Private::addressKey(id.busNumber, id.deviceAddress);
+    std::optional<uint16_t> previous;
+    {
+        std::lock_guard<std::mutex> lock(d->historyMutex);
+        for (const auto& [address, watched] : d->watchedStorage) {
+            if (watched == device.get() && address != key) {
+                previous = address;
+            }
+        }
+        if (previous) {
+            d->watchedStorage.erase(*previous);
+        }
+    }
+    
+    bool found;
+    {
+        std::lock_guard<std::mutex> lock(d->captureMutex);
+        // Re-enumerated: the old address is gone
+        if (previous) {
+            d->exfiltration.removeDevice(*previous >> 8, *previous & 0xFF);
+        }
+        found = d->registerStorageWrites(id, config.get());
+        if (found) {
+            d->exfiltration.setPolicy(id.busNumber, id.deviceAddress, policy);
+        }
+    }
+    if (!found) return false;
+    
+    {
+        std::lock_guard<std::mutex> lock(d->historyMutex);
+        d->watchedStorage[key] = device.get();
+    }
+    
+    if (d->reader && !d->reader->isRunning() && !d->reader->start()) {
+        LOG_WARNING("USB capture unavailable, writes to " + device->description() +
+                    " are not watched");
+    }
+    return true;
+}
+
+void ProtocolAnalyzer::unwatchExfiltration(std::shared_ptr<UsbDevice> device) {
+    if (!device) return;
+    
+    auto id = device->identifier();
+    bool monitored;
+    {
+        std::lock_guard<std::mutex> lock(d->historyMutex);
+        if (std::erase_if(d->watchedStorage, [&device](const auto& entry) {
+                return entry.second == device.get();
+            }) == 0) {
+            return;
+        }
+        monitored = d->transferHistory.count(device.get()) > 0;
+    }
+    
+    if (!monitored) {
+        std::lock_guard<std::mutex> lock(d->captureMutex);
+        d->exfiltration.removeDevice(id.busNumber, id.deviceAddress);
     }
 }
 
@@ -234,9 +747,11 @@ std::vector<TransferInfo> ProtocolAnalyzer::getRecentTransfers(
         TransferInfo info;
         info.timestamp = it->timestamp;
         info.endpointAddress = it->endpointAddress;
-        info.dataSize = it->data.size();
+        info.dataSize = it->length;
         info.isInput = it->isInput;
         info.status = it->status;
+        info.latency = it->latency;
+        info.payload = it->payload;
         result.push_back(info);
     }
     
@@ -265,4 +780,151 @@ void ProtocolAnalyzer::setMaxHistorySize(size_t size) {
     }
 }
 
+void ProtocolAnalyzer::setCaptureSource(UsbmonReader* reader) {
+    if (!reader || d->reader) return;
+    
+    reader->addHandler([this](const UrbEvent& event) {
+        d->handleUrb(event);
+    });
+    d->reader = reader;
+    
+    // Submissions whose completion was never captured would otherwise
+    // hold their slot in the URB table forever
+    d->expiryTimer = new QTimer(this);
+    connect(d->expiryTimer, &QTimer::timeout, this, [this]() {
+        auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::lock_guard<std::mutex> lock(d->captureMutex);
+        d->matcher.expire(now - int64_t(URB_ORPHAN_TIMEOUT) * 1000000);
+    });
+    d->expiryTimer->start(URB_ORPHAN_TIMEOUT * 1000);
+}
+
+void ProtocolAnalyzer::setBandwidthMonitor(BandwidthMonitor* monitor) {
+    if (d->bandwidth) return;
+    d->bandwidth = monitor;
+}
+
+bool ProtocolAnalyzer::isCapturing() const {
+    return d->reader && d->reader->isRunning();
+}
+
+std::vector<EndpointLatencyStats> ProtocolAnalyzer::getEndpointLatency(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->matcher.endpointStats(id.busNumber, id.deviceAddress);
+}
+
+size_t ProtocolAnalyzer::transfersInFlight() const {
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->matcher.inFlight();
+}
+
+bool ProtocolAnalyzer::isMassStorage(const UsbDevice* device) const {
+    if (!device) return false;
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->massStorage.isMassStorage(id.busNumber, id.deviceAddress);
+}
+
+MassStorageProfile ProtocolAnalyzer::getMassStorageProfile(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->massStorage.profile(id.busNumber, id.deviceAddress);
+}
+
+std::vector<HidEndpointStats> ProtocolAnalyzer::getHidPollingStats(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->hidPolling.endpointStats(id.busNumber, id.deviceAddress);
+}
+
+std::vector<VideoStreamStats> ProtocolAnalyzer::getVideoStreamStats(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->video.streamStats(id.busNumber, id.deviceAddress);
+}
+
+std::vector<AudioStreamStats> ProtocolAnalyzer::getAudioStreamStats(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->audio.streamStats(id.busNumber, id.deviceAddress);
+}
+
+bool ProtocolAnalyzer::isSerialDevice(const UsbDevice* device) const {
+    if (!device) return false;
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->serial.isTracked(id.busNumber, id.deviceAddress);
+}
+
+CdcAcmStats ProtocolAnalyzer::getSerialStats(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->serial.stats(id.busNumber, id.deviceAddress);
+}
+
+std::optional<std::vector<uint8_t>> ProtocolAnalyzer::getPayload(uint64_t handle) const {
+    return d->payloads.read(handle);
+}
+
+const CaptureStore& ProtocolAnalyzer::payloadStore() const {
+    return d->payloads;
+}
+
+void ProtocolAnalyzer::setPayloadDictionaries(bool enabled) {
+    d->payloads.setDictionaryTraining(enabled);
+}
+
+PayloadSearchResult ProtocolAnalyzer::searchPayloads(PayloadQuery query, const UsbDevice* device) const {
+    if (device) {
+        auto id = device->identifier();
+        query.device = Private::addressKey(id.busNumber, id.deviceAddress);
+    }
+    std::call_once(d->payloadSearchOnce, [this] {
+        d->payloadSearch = std::make_unique<PayloadSearch>(d->payloads);
+    });
+    return d->payloadSearch->find(query);
+}
+
+std::vector<EndpointPeriod> ProtocolAnalyzer::getEndpointPeriods(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->periodicity.periods(id.busNumber, id.deviceAddress);
+}
+
+ExfiltrationStats ProtocolAnalyzer::getExfiltrationStats(const UsbDevice* device) const {
+    if (!device) return {};
+    
+    auto id = device->identifier();
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    return d->exfiltration.stats(id.busNumber, id.deviceAddress);
+}
+
+void ProtocolAnalyzer::setExfiltrationPolicy(const UsbDevice* device, const ExfiltrationPolicy& policy) {
+    std::lock_guard<std::mutex> lock(d->captureMutex);
+    if (!device) {
+        d->exfiltration.setDefaultPolicy(policy);
+        return;
+    }
+    auto id = device->identifier();
+    d->exfiltration.setPolicy(id.busNumber, id.deviceAddress, policy);
+}
+
 } // namespace usb_monitor
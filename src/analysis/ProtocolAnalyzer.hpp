@@ -1,13 +1,26 @@
 // src/analysis/ProtocolAnalyzer.hpp
 #pragma once
+#include "UrbMatcher.hpp"
+#include "MassStorageProfiler.hpp"
+#include "HidPollingAnalyzer.hpp"
+#include "VideoStreamAnalyzer.hpp"
+#include "AudioStreamAnalyzer.hpp"
+#include "CdcAcmTracker.hpp"
+#include "PeriodicityDetector.hpp"
+#include "ExfiltrationDetector.hpp"
+#include "../capture/PayloadSearch.hpp"
 #include <QObject>
 #include <memory>
 #include <chrono>
+#include <optional>
 #include <vector>
 
 namespace usb_monitor {
 
 class UsbDevice;
+class UsbmonReader;
+class BandwidthMonitor;
+class CaptureStore;
 
 struct TransferInfo {
     std::chrono::steady_clock::time_point timestamp;
@@ -15,6 +28,8 @@ struct TransferInfo {
     size_t dataSize;
     bool isInput;
     int status;
+    std::chrono::microseconds latency;  // Submit to complete; zero without capture
+    uint64_t payload;                   // CaptureStore handle, or CaptureStore::NO_PAYLOAD
 };
 
 struct ProtocolPattern {
@@ -23,6 +38,7 @@ struct ProtocolPattern {
     uint8_t primaryEndpoint;
     bool hasRegularTransferSizes;
     std::vector<uint8_t> problematicEndpoints;
+    std::vector<EndpointPeriod> periodicEndpoints;  // From capture only
 };
 
 class ProtocolAnalyzer : public QObject {
@@ -40,10 +56,67 @@ public:
     
     void clearHistory(const UsbDevice* device);
     void setMaxHistorySize(size_t size);
+    
+    // Real transfers from usbmon instead of descriptor polling. Submissions
+    // and completions are matched by URB id for per-transfer latency. Set
+    // once, before the reader is started; the reader must outlive this.
+    void setCaptureSource(UsbmonReader* reader);
+    
+    // Counts captured transfers of monitored devices towards their
+    // bandwidth, in place of those made through their own handle. Set once,
+    // before the reader is started; the monitor must outlive the capture.
+    void setBandwidthMonitor(BandwidthMonitor* monitor);
+    bool isCapturing() const;
+    
+    std::vector<EndpointLatencyStats> getEndpointLatency(const UsbDevice* device) const;
+    size_t transfersInFlight() const;
+    
+    // SCSI command profile, for devices seen speaking Bulk-Only Transport
+    bool isMassStorage(const UsbDevice* device) const;
+    MassStorageProfile getMassStorageProfile(const UsbDevice* device) const;
+    
+    // Report rate and jitter of the device's HID interrupt IN endpoints
+    std::vector<HidEndpointStats> getHidPollingStats(const UsbDevice* device) const;
+    
+    // Frame rate, sizes and losses of the device's UVC video streams
+    std::vector<VideoStreamStats> getVideoStreamStats(const UsbDevice* device) const;
+    
+    // Continuity and clock drift of the device's USB audio streams
+    std::vector<AudioStreamStats> getAudioStreamStats(const UsbDevice* device) const;
+    
+    // Line settings, byte rates and request round trips of CDC-ACM devices
+    bool isSerialDevice(const UsbDevice* device) const;
+    CdcAcmStats getSerialStats(const UsbDevice* device) const;
+    
+    // Endpoints whose captured traffic has a period, polling or bursts
+    std::vector<EndpointPeriod> getEndpointPeriods(const UsbDevice* device) const;
+    
+    // Captured payload snippets, compressed in blocks in the background.
+    // Handles come from TransferInfo::payload; the store gives block-wise
+    // access to everything still within its memory budget.
+    std::optional<std::vector<uint8_t>> getPayload(uint64_t handle) const;
+    const CaptureStore& payloadStore() const;
+    void setPayloadDictionaries(bool enabled);
+    
+    // Byte signatures in the stored payloads, of one device if given
+    PayloadSearchResult searchPayloads(PayloadQuery query, const UsbDevice* device = nullptr) const;
+    
+    // Write volume and entropy on mass storage; a null device sets the
+    // policy for devices without their own
+    ExfiltrationStats getExfiltrationStats(const UsbDevice* device) const;
+    void setExfiltrationPolicy(const UsbDevice* device, const ExfiltrationPolicy& policy);
+    
+    // Watches only the mass storage writes of a device, for every device
+    // on arrival rather than the ones opened for analysis. Starts the
+    // capture source if needed; false if the device has no bulk OUT
+    // endpoint on a mass storage interface.
+    bool watchExfiltration(std::shared_ptr<UsbDevice> device, const ExfiltrationPolicy& policy);
+    void unwatchExfiltration(std::shared_ptr<UsbDevice> device);
 
 signals:
     void protocolPatternDetected(const ProtocolPattern& pattern);
     void transferError(const UsbDevice* device, uint8_t endpoint, int status);
+    void exfiltrationSuspected(const UsbDevice* device, const ExfiltrationAlert& alert);
 
 private:
     class Private;
@@ -0,0 +1,102 @@
+// src/analysis/StreamingDetector.cpp
+#include "StreamingDetector.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace usb_monitor {
+
+namespace {
+// A season bin needs this many samples before it replaces the overall mean
+constexpr size_t SEASON_BIN_WARMUP = 3;
+} // namespace
+
+void StreamingDetector::Moments::update(double value, double alpha) {
+    if (count++ == 0) {
+        mean = value;
+        variance = 0.0;
+        return;
+    }
+    // West's incremental EWMA variance
+    double delta = value - mean;
+    mean += alpha * delta;
+    variance = (1.0 - alpha) * (variance + alpha * delta * delta);
+}
+
+StreamingDetector::StreamingDetector(const DetectorConfig& config)
+    : config(config)
+    , season(config.seasonBins) {
+}
+
+double StreamingDetector::deviation() const {
+    return std::max(std::sqrt(residual.variance), config.minDeviation);
+}
+
+void StreamingDetector::reset() {
+    level = Moments{};
+    residual = Moments{};
+    std::fill(season.begin(), season.end(), Moments{});
+    cusumHigh = cusumLow = 0.0;
+}
+
+StreamingDetector::Moments* StreamingDetector::seasonBin(std::chrono::system_clock::time_point when) {
+    if (season.empty()) return nullptr;
+    
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(when.time_since_epoch()).count();
+    auto length = std::max<int64_t>(config.seasonLength.count(), 1);
+    auto offset = ((seconds % length) + length) % length;
+    return &season[offset * season.size() / length];
+}
+
+DetectorResult StreamingDetector::update(double value, std::chrono::system_clock::time_point when) {
+    DetectorResult result;
+    result.value = value;
+    
+    Moments* bin = seasonBin(when);
+    bool seasonal = bin && bin->count >= SEASON_BIN_WARMUP;
+    result.expected = seasonal ? bin->mean : level.mean;
+    
+    double sigma = deviation();
+    double z = level.count ? (value - result.expected) / sigma : 0.0;
+    bool warm = level.count >= config.warmup;
+    
+    if (warm) {
+        // Winsorized, so a lone outlier is a spike rather than a shift
+        double step = std::clamp(z, -config.spikeThreshold, config.spikeThreshold);
+        cusumHigh = std::max(0.0, cusumHigh + step - config.cusumDrift);
+        cusumLow = std::max(0.0, cusumLow - step - config.cusumDrift);
+        
+        if (cusumHigh > config.cusumThreshold || cusumLow > config.cusumThreshold) {
+            result.kind = cusumHigh > cusumLow ? AnomalyKind::LevelShiftUp
+                                                 : AnomalyKind::LevelShiftDown;
+            result.score = std::max(cusumHigh, cusumLow);
+            
+            // Relearn around the new level instead of alarming forever. The
+            // season bins are kept; they adapt unclamped during the warmup.
+            level = Moments{};
+            residual = Moments{};
+            cusumHigh = cusumLow = 0.0;
+            level.update(value, config.alpha);
+            if (bin) bin->update(value, config.alpha);
+            return result;
+        }
+        if (std::abs(z) > config.spikeThreshold) {
+            result.kind = AnomalyKind::Spike;
+            result.score = z;
+        }
+    }
+    
+    // A spike only nudges the baseline: clamp it to the spike threshold
+    double limit = config.spikeThreshold * sigma;
+    double learned = warm ? std::clamp(value, result.expected - limit, result.expected + limit)
+                          : value;
+    if (level.count) {
+        residual.update(learned - result.expected, config.alpha);
+    }
+    level.update(learned, config.alpha);
+    if (bin) {
+        bin->update(learned, config.alpha);
+    }
+    return result;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,70 @@
+// src/analysis/StreamingDetector.hpp
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace usb_monitor {
+
+struct DetectorConfig {
+    double alpha{0.05};             // EWMA weight of a new sample
+    double spikeThreshold{4.0};     // |z| that counts as a spike
+    double cusumDrift{0.5};         // CUSUM slack k, in standard deviations
+    double cusumThreshold{8.0};     // CUSUM decision level h
+    double minDeviation{1.0};       // Floor for the standard deviation, metric units
+    size_t warmup{30};              // Samples before anything is reported
+    size_t seasonBins{0};           // 0 disables the seasonal baseline
+    std::chrono::seconds seasonLength{std::chrono::hours(24)};
+};
+
+enum class AnomalyKind {
+    None,
+    Spike,          // One sample far from the baseline
+    LevelShiftUp,   // Sustained move detected by CUSUM
+    LevelShiftDown
+};
+
+struct DetectorResult {
+    AnomalyKind kind{AnomalyKind::None};
+    double value{0.0};
+    double expected{0.0};
+    double score{0.0};              // z-score, or CUSUM statistic for shifts
+};
+
+// Streaming anomaly detector for one metric: O(1) work per sample and
+// constant memory. The baseline is an EWMA mean and variance, optionally
+// per time-of-season bin (e.g. hour of day) so daily rhythms are not
+// reported. Residuals are tested for spikes by z-score and for level
+// shifts by two-sided CUSUM; after a shift the baseline restarts from the
+// new level.
+class StreamingDetector {
+public:
+    explicit StreamingDetector(const DetectorConfig& config = DetectorConfig());
+
+    DetectorResult update(double value, std::chrono::system_clock::time_point when);
+    
+    double mean() const { return level.mean; }
+    double deviation() const;
+    size_t samples() const { return level.count; }
+    void reset();
+
+private:
+    struct Moments {
+        double mean{0.0};
+        double variance{0.0};
+        size_t count{0};
+        
+        void update(double value, double alpha);
+    };
+    
+    Moments* seasonBin(std::chrono::system_clock::time_point when);
+
+    DetectorConfig config;
+    Moments level;
+    Moments residual;
+    std::vector<Moments> season;
+    double cusumHigh{0.0};
+    double cusumLow{0.0};
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,289 @@
+// src/analysis/UrbMatcher.cpp
+#include "UrbMatcher.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace usb_monitor {
+
+size_t LatencyHistogram::bucketOf(uint64_t micros) {
+    if (micros < SUB_BUCKETS) return micros;
+    
+    // Octave from the top bit, sub-bucket from the two bits below it
+    size_t octave = std::bit_width(micros) - 1;
+    size_t sub = (micros >> (octave - 2)) & (SUB_BUCKETS - 1);
+    return std::min((octave - 1) * SUB_BUCKETS + sub, BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    
+    size_t octave = bucket / SUB_BUCKETS + 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (octave - 2);
+}
+
+void LatencyHistogram::add(uint64_t micros) {
+    counts[bucketOf(micros)]++;
+    samples++;
+    sum += micros;
+    smallest = std::min(smallest, micros);
+    largest = std::max(largest, micros);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (samples == 0) return 0;
+    
+    auto rank = static_cast<uint64_t>(fraction * (samples - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            // Report the bucket's upper edge, clamped to what was observed
+            uint64_t upper = bucket + 1 < BUCKETS ? bucketLowerBound(bucket + 1) - 1 : largest;
+            return std::clamp(upper, smallest, largest);
+        }
+    }
+    return largest;
+}
+
+void UrbMatcher::EndpointState::advanceSlot(int64_t now) {
+    int64_t current = now / (int64_t(URB_DEPTH_SLOT) * 1000);
+    if (slot < 0) {
+        slot = current;
+        history[current % URB_DEPTH_SLOTS] = depth;
+        return;
+    }
+    if (current <= slot) return;
+    
+    // Slots without events held the depth unchanged
+    int64_t steps = std::min<int64_t>(current - slot, URB_DEPTH_SLOTS);
+    for (int64_t s = current - steps + 1; s <= current; s++) {
+        history[s % URB_DEPTH_SLOTS] = depth;
+    }
+    slot = current;
+}
+
+void UrbMatcher::EndpointState::setDepth(uint32_t newDepth, int64_t now) {
+    advanceSlot(now);
+    if (firstChange < 0) {
+        firstChange = lastChange = now;
+    }
+    if (now > lastChange) {
+        depthIntegral += double(depth) * double(now - lastChange);
+        lastChange = now;
+    }
+    
+    depth = newDepth;
+    peakDepth = std::max(peakDepth, depth);
+    auto& peak = history[slot % URB_DEPTH_SLOTS];
+    peak = std::max(peak, depth);
+}
+
+UrbMatcher::UrbMatcher(size_t capacity)
+    : table(std::bit_ceil(std::max<size_t>(capacity, 16)))
+    , mask(table.size() - 1) {
+}
+
+size_t UrbMatcher::home(uint64_t id) const {
+    // URB ids are kernel pointers: mix the aligned low bits away
+    uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+    return (hash ^ (hash >> 32)) & mask;
+}
+
+UrbMatcher::Pending* UrbMatcher::find(uint64_t id) {
+    for (size_t i = home(id);; i = (i + 1) & mask) {
+        Pending& slot = table[i];
+        if (!slot.used) return nullptr;
+        if (slot.id == id) return &slot;
+    }
+}
+
+void UrbMatcher::erase(Pending* slot) {
+    size_t hole = slot - table.data();
+    
+    // Shift later members of the probe run back so lookups never need
+    // tombstones
+    for (size_t next = (hole + 1) & mask; table[next].used; next = (next + 1) & mask) {
+        size_t want = home(table[next].id);
+        bool movable = hole <= next ? (want <= hole || want > next)
+                                    : (want <= hole && want > next);
+        if (movable) {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+    table[hole].used = false;
+    occupied--;
+}
+
+void UrbMatcher::release(const Pending& pending, int64_t now) {
+    auto it = endpoints.find(pending.endpointKey);
+    if (it != endpoints.end() && it->second.depth > 0) {
+        it->second.setDepth(it->second.depth - 1, now);
+    }
+}
+
+std::optional<MatchedTransfer> UrbMatcher::process(const UrbEvent& event) {
+    lastTimestamp = std::max(lastTimestamp, event.timestamp);
+    uint32_t key = endpointKey(event.busNumber, event.deviceAddress, event.endpoint);
+    
+    switch (event.type) {
+        case 'S': {
+            if (Pending* stale = find(event.id)) {
+                // The id was reused, so its completion was lost
+                unmatchedCount++;
+                release(*stale, event.timestamp);
+                erase(stale);
+            }
+            if (occupied >= table.size() / 4 * 3) {
+                overflowCount++;
+                return std::nullopt;
+            }
+            
+            size_t i = home(event.id);
+            while (table[i].used) i = (i + 1) & mask;
+            table[i] = Pending{event.id, event.timestamp, key, event.length,
+                               event.transferType, true};
+            occupied++;
+            
+            auto& state = endpoints[key];
+            state.transferType = event.transferType;
+            state.setDepth(state.depth + 1, event.timestamp);
+            return std::nullopt;
+        }
+        case 'C': {
+            Pending* slot = find(event.id);
+            if (!slot) {
+                unmatchedCount++;
+                return std::nullopt;
+            }
+            Pending pending = *slot;
+            erase(slot);
+            
+            auto& state = endpoints[pending.endpointKey];
+            int64_t latency = std::max<int64_t>(event.timestamp - pending.submitted, 0);
+            state.latency.add(latency);
+            if (event.status != 0) state.errors++;
+            if (state.depth > 0) state.setDepth(state.depth - 1, event.timestamp);
+            
+            return MatchedTransfer{
+                pending.id,
+                uint16_t(pending.endpointKey >> 16),
+                uint8_t(pending.endpointKey >> 8),
+                uint8_t(pending.endpointKey),
+                pending.transferType,
+                pending.submitted,
+                latency,
+                pending.requested,
+                event.length,
+                event.status
+            };
+        }
+        case 'E': {
+            auto& state = endpoints[key];
+            state.transferType = event.transferType;
+            state.errors++;
+            return std::nullopt;
+        }
+        default:
+            return std::nullopt;
+    }
+}
+
+size_t UrbMatcher::expire(int64_t olderThan) {
+    std::vector<uint64_t> stale;
+    for (const auto& slot : table) {
+        if (slot.used && slot.submitted < olderThan) stale.push_back(slot.id);
+    }
+    
+    for (uint64_t id : stale) {
+        Pending* slot = find(id);
+        release(*slot, lastTimestamp);
+        erase(slot);
+    }
+    unmatchedCount += stale.size();
+    return stale.size();
+}
+
+void UrbMatcher::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    
+    std::vector<uint64_t> pending;
+    for (const auto& slot : table) {
+        if (slot.used && (slot.endpointKey >> 8) == prefix) pending.push_back(slot.id);
+    }
+    for (uint64_t id : pending) {
+        erase(find(id));
+    }
+    
+    std::erase_if(endpoints, [prefix](const auto& entry) {
+        return (entry.first >> 8) == prefix;
+    });
+}
+
+void UrbMatcher::clear() {
+    std::fill(table.begin(), table.end(), Pending{});
+    occupied = 0;
+    endpoints.clear();
+    unmatchedCount = overflowCount = 0;
+    lastTimestamp = 0;
+}
+
+EndpointLatencyStats UrbMatcher::describe(uint32_t key, const EndpointState& state) const {
+    // Bring the depth bookkeeping up to the latest event seen on any endpoint
+    EndpointState now = state;
+    now.advanceSlot(lastTimestamp);
+    double integral = now.depthIntegral + double(now.depth) * double(lastTimestamp - now.lastChange);
+    double elapsed = now.firstChange >= 0 ? double(lastTimestamp - now.firstChange) : 0.0;
+    
+    EndpointLatencyStats stats;
+    stats.busNumber = uint16_t(key >> 16);
+    stats.deviceAddress = uint8_t(key >> 8);
+    stats.endpoint = uint8_t(key);
+    stats.transferType = now.transferType;
+    stats.completed = now.latency.count();
+    stats.errors = now.errors;
+    stats.meanLatency = now.latency.mean();
+    stats.minLatency = now.latency.min();
+    stats.p50Latency = now.latency.percentile(0.50);
+    stats.p90Latency = now.latency.percentile(0.90);
+    stats.p99Latency = now.latency.percentile(0.99);
+    stats.maxLatency = now.latency.max();
+    stats.inFlight = now.depth;
+    stats.peakInFlight = now.peakDepth;
+    stats.averageInFlight = elapsed > 0 ? integral / elapsed : now.depth;
+    stats.histogram = now.latency.buckets();
+    
+    stats.depthHistory.reserve(URB_DEPTH_SLOTS);
+    if (now.slot >= 0) {
+        for (int64_t s = now.slot - URB_DEPTH_SLOTS + 1; s <= now.slot; s++) {
+            stats.depthHistory.push_back(s >= 0 ? now.history[s % URB_DEPTH_SLOTS] : 0);
+        }
+    }
+    return stats;
+}
+
+std::vector<EndpointLatencyStats> UrbMatcher::endpointStats(uint16_t busNumber,
+                                                            uint8_t deviceAddress) const {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    
+    std::vector<EndpointLatencyStats> result;
+    for (const auto& [key, state] : endpoints) {
+        if ((key >> 8) == prefix) result.push_back(describe(key, state));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.endpoint < b.endpoint;
+    });
+    return result;
+}
+
+std::vector<EndpointLatencyStats> UrbMatcher::allStats() const {
+    std::vector<EndpointLatencyStats> result;
+    result.reserve(endpoints.size());
+    for (const auto& [key, state] : endpoints) {
+        result.push_back(describe(key, state));
+    }
+    return result;
+}
+
+} // namespace usb_monitor
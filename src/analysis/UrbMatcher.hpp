@@ -0,0 +1,141 @@
+// src/analysis/UrbMatcher.hpp
+#pragma once
+#include "../capture/UrbEvent.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+// Log-linear latency histogram: four buckets per power of two, so any
+// percentile is within 25% of the true value, in fixed memory
+class LatencyHistogram {
+public:
+    static constexpr size_t SUB_BUCKETS = 4;
+    static constexpr size_t BUCKETS = SUB_BUCKETS * 40;
+
+    void add(uint64_t micros);
+    
+    uint64_t count() const { return samples; }
+    uint64_t min() const { return samples ? smallest : 0; }
+    uint64_t max() const { return largest; }
+    double mean() const { return samples ? double(sum) / samples : 0.0; }
+    uint64_t percentile(double fraction) const;
+    const std::array<uint32_t, BUCKETS>& buckets() const { return counts; }
+    
+    static size_t bucketOf(uint64_t micros);
+    static uint64_t bucketLowerBound(size_t bucket);
+
+private:
+    std::array<uint32_t, BUCKETS> counts{};
+    uint64_t samples{0};
+    uint64_t sum{0};
+    uint64_t smallest{UINT64_MAX};
+    uint64_t largest{0};
+};
+
+struct MatchedTransfer {
+    uint64_t id;
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t endpoint;
+    uint8_t transferType;
+    int64_t submitted;          // us since the epoch
+    int64_t latency;            // us from S to C
+    uint32_t requested;
+    uint32_t actual;
+    int32_t status;
+};
+
+struct EndpointLatencyStats {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t endpoint;
+    uint8_t transferType;
+    uint64_t completed;
+    uint64_t errors;
+    double meanLatency;         // us
+    uint64_t minLatency;
+    uint64_t p50Latency;
+    uint64_t p90Latency;
+    uint64_t p99Latency;
+    uint64_t maxLatency;
+    uint32_t inFlight;
+    uint32_t peakInFlight;
+    double averageInFlight;     // Time-weighted
+    std::vector<uint32_t> depthHistory;  // Peak depth per URB_DEPTH_SLOT, oldest first
+    std::array<uint32_t, LatencyHistogram::BUCKETS> histogram;
+};
+
+// Pairs usbmon submissions with their completions by URB id. Pending URBs
+// live in an open-addressed table (linear probing, backward-shift delete),
+// so each event is O(1) with no allocation on the hot path.
+class UrbMatcher {
+public:
+    explicit UrbMatcher(size_t capacity = URB_TABLE_CAPACITY);
+
+    std::optional<MatchedTransfer> process(const UrbEvent& event);
+    
+    // Drops submissions whose completion never arrived (capture overrun)
+    size_t expire(int64_t olderThan);
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+    void clear();
+    
+    std::vector<EndpointLatencyStats> endpointStats(uint16_t busNumber, uint8_t deviceAddress) const;
+    std::vector<EndpointLatencyStats> allStats() const;
+    
+    size_t inFlight() const { return occupied; }
+    size_t capacity() const { return table.size(); }
+    uint64_t unmatched() const { return unmatchedCount; }
+    uint64_t overflows() const { return overflowCount; }
+
+private:
+    struct Pending {
+        uint64_t id;
+        int64_t submitted;
+        uint32_t endpointKey;
+        uint32_t requested;
+        uint8_t transferType;
+        bool used;
+    };
+    
+    struct EndpointState {
+        uint8_t transferType{0};
+        LatencyHistogram latency;
+        uint64_t errors{0};
+        uint32_t depth{0};
+        uint32_t peakDepth{0};
+        int64_t firstChange{-1};
+        int64_t lastChange{0};
+        double depthIntegral{0.0};
+        int64_t slot{-1};
+        std::array<uint32_t, URB_DEPTH_SLOTS> history{};
+        
+        void setDepth(uint32_t newDepth, int64_t now);
+        void advanceSlot(int64_t now);
+    };
+    
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    size_t home(uint64_t id) const;
+    Pending* find(uint64_t id);
+    void erase(Pending* slot);
+    void release(const Pending& pending, int64_t now);
+    EndpointLatencyStats describe(uint32_t key, const EndpointState& state) const;
+
+    std::vector<Pending> table;
+    size_t mask;
+    size_t occupied{0};
+    std::unordered_map<uint32_t, EndpointState> endpoints;
+    int64_t lastTimestamp{0};
+    uint64_t unmatchedCount{0};
+    uint64_t overflowCount{0};
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,224 @@
+// src/analysis/VideoStreamAnalyzer.cpp
+#include "VideoStreamAnalyzer.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+#include <cmath>
+
+namespace usb_monitor {
+
+namespace {
+
+// bmHeaderInfo bits of the UVC payload header
+constexpr uint8_t UVC_FID = 0x01;
+constexpr uint8_t UVC_EOF = 0x02;
+constexpr uint8_t UVC_PTS = 0x04;
+constexpr uint8_t UVC_SCR = 0x08;
+constexpr uint8_t UVC_ERR = 0x40;
+
+// Intervals this far past the typical one mean frames went missing
+constexpr double DROP_FACTOR = 1.5;
+constexpr uint64_t CADENCE_WARMUP = 8;
+constexpr double CADENCE_ALPHA = 1.0 / 16;
+
+RateWindow<>::Clock::time_point toTimePoint(int64_t micros) {
+    return RateWindow<>::Clock::time_point(std::chrono::microseconds(micros));
+}
+
+} // namespace
+
+void VideoStreamAnalyzer::StreamState::payload(const uint8_t* data, uint32_t available,
+                                               uint32_t length, int64_t timestamp) {
+    // Empty isochronous packets are the device having nothing to send
+    if (length == 0) return;
+    
+    payloads++;
+    uint8_t headerLength = available >= 2 ? data[0] : 0;
+    if (headerLength < 2 || headerLength > length || headerLength > available) {
+        invalidHeaders++;
+        damage();
+        return;
+    }
+    
+    uint8_t info = data[1];
+    int payloadFid = info & UVC_FID;
+    if (frameOpen && payloadFid != fid) {
+        // FID toggled without an EOF on the previous frame
+        finishFrame();
+    }
+    fid = payloadFid;
+    
+    if (!frameOpen) {
+        frameOpen = true;
+        frameStart = timestamp;
+        framePtsValid = false;
+    }
+    if ((info & UVC_PTS) && headerLength >= 6) {
+        hasPts = true;
+        if (!framePtsValid) {
+            framePts = uint32_t(data[2]) | uint32_t(data[3]) << 8 |
+                       uint32_t(data[4]) << 16 | uint32_t(data[5]) << 24;
+            framePtsValid = true;
+        }
+    }
+    if (info & UVC_SCR) hasScr = true;
+    if (info & UVC_ERR) {
+        erroredPayloads++;
+        damage();
+    }
+    
+    uint32_t bytes = length - headerLength;
+    frameBytes += bytes;
+    window.add(bytes, 0, toTimePoint(timestamp));
+    
+    if (info & UVC_EOF) finishFrame();
+}
+
+void VideoStreamAnalyzer::StreamState::finishFrame() {
+    frames++;
+    frameSizes.add(frameBytes);
+    window.add(0, 1, toTimePoint(frameStart));
+    if (frameDamaged) truncated++;
+    
+    // Device PTS when its clock is known, else the capture time of the
+    // frame's first payload
+    int64_t interval = -1;
+    if (clockFrequency && framePtsValid && lastPtsValid) {
+        interval = int64_t(uint32_t(framePts - lastPts) * 1e6 / clockFrequency);
+    } else if (lastFrameStart >= 0 && frameStart >= lastFrameStart) {
+        interval = frameStart - lastFrameStart;
+    }
+    
+    if (interval > 0) {
+        frameIntervals.add(uint64_t(interval));
+        if (frameIntervals.count() >= CADENCE_WARMUP) {
+            // The coarse median keeps gaps out of the smoothed cadence
+            double typical = double(frameIntervals.percentile(0.50));
+            if (interval <= DROP_FACTOR * typical) {
+                nominalInterval = nominalInterval > 0
+                    ? nominalInterval + CADENCE_ALPHA * (interval - nominalInterval)
+                    : double(interval);
+            } else if (nominalInterval > 0) {
+                dropped += std::max<int64_t>(std::llround(interval / nominalInterval) - 1, 0);
+            }
+        }
+    }
+    
+    lastFrameStart = frameStart;
+    lastPts = framePts;
+    lastPtsValid = framePtsValid;
+    frameOpen = false;
+    frameBytes = 0;
+    frameDamaged = false;
+}
+
+void VideoStreamAnalyzer::addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                                      uint32_t clockFrequency) {
+    streams[endpointKey(busNumber, deviceAddress, endpoint)].clockFrequency = clockFrequency;
+}
+
+void VideoStreamAnalyzer::process(const UrbEvent& event) {
+    if (event.type != 'C' || !event.isInput()) return;
+    if (event.transferType != LIBUSB_TRANSFER_TYPE_ISOCHRONOUS &&
+        event.transferType != LIBUSB_TRANSFER_TYPE_BULK) {
+        return;
+    }
+    
+    auto it = streams.find(endpointKey(event.busNumber, event.deviceAddress, event.endpoint));
+    if (it == streams.end()) return;
+    auto& state = it->second;
+    state.transferType = event.transferType;
+    latest = std::max(latest, event.timestamp);
+    
+    if (event.transferType == LIBUSB_TRANSFER_TYPE_BULK) {
+        // Each bulk transfer carries one payload
+        if (event.status != 0) {
+            state.damage();
+            return;
+        }
+        uint32_t available = event.data ? event.capturedLength : 0;
+        state.payload(event.data, std::min(available, event.length), event.length,
+                      event.timestamp);
+        return;
+    }
+    
+    // Isochronous packets sit at their own offsets in the transfer buffer
+    for (uint32_t i = 0; i < event.isoPacketCount; i++) {
+        const auto& packet = event.isoPackets[i];
+        state.isoPackets++;
+        if (packet.status != 0) {
+            state.isoPacketErrors++;
+            state.damage();
+            continue;
+        }
+        
+        uint32_t available = 0;
+        if (event.data && packet.offset < event.capturedLength) {
+            available = std::min(packet.length, event.capturedLength - packet.offset);
+        }
+        state.payload(available ? event.data + packet.offset : nullptr, available,
+                      packet.length, event.timestamp);
+    }
+}
+
+VideoStreamStats VideoStreamAnalyzer::describe(uint32_t key, const StreamState& state, int64_t now) {
+    auto window = state.window;
+    window.advance(toTimePoint(now));
+    
+    VideoStreamStats stats;
+    stats.busNumber = uint16_t(key >> 16);
+    stats.deviceAddress = uint8_t(key >> 8);
+    stats.endpoint = uint8_t(key);
+    stats.transferType = state.transferType;
+    stats.frames = state.frames;
+    stats.droppedFrames = state.dropped;
+    stats.truncatedFrames = state.truncated;
+    stats.frameRate = window.packetRate();
+    stats.nominalFrameRate = state.nominalInterval > 0 ? 1e6 / state.nominalInterval : 0.0;
+    stats.throughput = window.rate();
+    stats.minFrameSize = state.frameSizes.min();
+    stats.p50FrameSize = state.frameSizes.percentile(0.50);
+    stats.maxFrameSize = state.frameSizes.max();
+    stats.meanFrameSize = state.frameSizes.mean();
+    stats.payloads = state.payloads;
+    stats.erroredPayloads = state.erroredPayloads;
+    stats.invalidHeaders = state.invalidHeaders;
+    stats.isoPackets = state.isoPackets;
+    stats.isoPacketErrors = state.isoPacketErrors;
+    stats.isoErrorRate = state.isoPackets ? double(state.isoPacketErrors) / state.isoPackets : 0.0;
+    stats.hasPts = state.hasPts;
+    stats.hasScr = state.hasScr;
+    return stats;
+}
+
+std::vector<VideoStreamStats> VideoStreamAnalyzer::streamStats(uint16_t busNumber,
+                                                               uint8_t deviceAddress) const {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    
+    std::vector<VideoStreamStats> result;
+    for (const auto& [key, state] : streams) {
+        if ((key >> 8) == prefix) result.push_back(describe(key, state, latest));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.endpoint < b.endpoint;
+    });
+    return result;
+}
+
+std::vector<VideoStreamStats> VideoStreamAnalyzer::allStats() const {
+    std::vector<VideoStreamStats> result;
+    result.reserve(streams.size());
+    for (const auto& [key, state] : streams) {
+        result.push_back(describe(key, state, latest));
+    }
+    return result;
+}
+
+void VideoStreamAnalyzer::removeDevice(uint16_t busNumber, uint8_t deviceAddress) {
+    uint32_t prefix = endpointKey(busNumber, deviceAddress, 0) >> 8;
+    std::erase_if(streams, [prefix](const auto& entry) {
+        return (entry.first >> 8) == prefix;
+    });
+}
+
+} // namespace usb_monitor
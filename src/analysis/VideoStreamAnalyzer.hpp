@@ -0,0 +1,102 @@
+// src/analysis/VideoStreamAnalyzer.hpp
+#pragma once
+#include "UrbMatcher.hpp"
+#include "../capture/UrbEvent.hpp"
+#include "../core/RateWindow.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace usb_monitor {
+
+struct VideoStreamStats {
+    uint16_t busNumber;
+    uint8_t deviceAddress;
+    uint8_t endpoint;
+    uint8_t transferType;       // Isochronous or bulk
+    uint64_t frames;
+    uint64_t droppedFrames;     // Missing from the frame cadence
+    uint64_t truncatedFrames;   // ERR bit, bad headers or failed iso packets
+    double frameRate;           // Frames/s over the recent window
+    double nominalFrameRate;    // From the frame cadence, gaps excluded
+    double throughput;          // Payload bytes/s over the recent window
+    uint64_t minFrameSize;
+    uint64_t p50FrameSize;
+    uint64_t maxFrameSize;
+    double meanFrameSize;
+    uint64_t payloads;
+    uint64_t erroredPayloads;   // ERR bit set by the device
+    uint64_t invalidHeaders;
+    uint64_t isoPackets;
+    uint64_t isoPacketErrors;
+    double isoErrorRate;
+    bool hasPts;
+    bool hasScr;
+};
+
+// Follows UVC payload headers (FID/EOF/ERR, PTS/SCR) on video streaming
+// endpoints and accounts frames as they go by. Only headers are read and
+// nothing is retained, so the per-packet cost is a few compares.
+class VideoStreamAnalyzer {
+public:
+    // dwClockFrequency of the VideoControl interface turns PTS deltas into
+    // device-side frame intervals; 0 falls back to capture timestamps
+    void addEndpoint(uint16_t busNumber, uint8_t deviceAddress, uint8_t endpoint,
+                     uint32_t clockFrequency = 0);
+    void process(const UrbEvent& event);
+    
+    std::vector<VideoStreamStats> streamStats(uint16_t busNumber, uint8_t deviceAddress) const;
+    std::vector<VideoStreamStats> allStats() const;
+    void removeDevice(uint16_t busNumber, uint8_t deviceAddress);
+
+private:
+    struct StreamState {
+        uint32_t clockFrequency{0};
+        uint8_t transferType{0};
+        
+        // Frame being assembled
+        int fid{-1};
+        bool frameOpen{false};
+        uint64_t frameBytes{0};
+        int64_t frameStart{0};
+        uint32_t framePts{0};
+        bool framePtsValid{false};
+        bool frameDamaged{false};
+        
+        // Previous completed frame, for the cadence
+        int64_t lastFrameStart{-1};
+        uint32_t lastPts{0};
+        bool lastPtsValid{false};
+        
+        uint64_t frames{0};
+        uint64_t dropped{0};
+        uint64_t truncated{0};
+        uint64_t payloads{0};
+        uint64_t erroredPayloads{0};
+        uint64_t invalidHeaders{0};
+        uint64_t isoPackets{0};
+        uint64_t isoPacketErrors{0};
+        bool hasPts{false};
+        bool hasScr{false};
+        LatencyHistogram frameSizes;
+        LatencyHistogram frameIntervals;    // us
+        double nominalInterval{0.0};        // Smoothed, gaps excluded
+        RateWindow<> window;        // Payload bytes and frames
+        
+        // available is how much of the payload was captured
+        void payload(const uint8_t* data, uint32_t available, uint32_t length, int64_t timestamp);
+        void damage() { frameDamaged = true; }
+        void finishFrame();
+    };
+    
+    static uint32_t endpointKey(uint16_t bus, uint8_t address, uint8_t endpoint) {
+        return (uint32_t(bus) << 16) | (uint32_t(address) << 8) | endpoint;
+    }
+    
+    static VideoStreamStats describe(uint32_t key, const StreamState& state, int64_t now);
+
+    std::unordered_map<uint32_t, StreamState> streams;
+    int64_t latest{0};
+};
+
+} // namespace usb_monitor
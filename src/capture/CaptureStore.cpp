@@ -0,0 +1,469 @@
+// src/capture/CaptureStore.cpp
+#include "CaptureStore.hpp"
+#include "../core/WorkerPool.hpp"
+#include <zstd.h>
+#include <zdict.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr uint32_t MAX_BLOCK_RECORDS = 0xFFFF;
+
+struct Dictionary {
+    std::vector<uint8_t> bytes;
+    ZSTD_CDict* compress{nullptr};
+    ZSTD_DDict* decompress{nullptr};
+    
+    ~Dictionary() {
+        ZSTD_freeCDict(compress);
+        ZSTD_freeDDict(decompress);
+    }
+};
+
+using Bytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+constexpr size_t MAX_BLOCK_ENDPOINTS = 32;
+
+void appendVarint(std::vector<uint8_t>& block, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        block.push_back(byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+uint64_t readVarint(const std::vector<uint8_t>& block, size_t& position) {
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = block[position++];
+        value |= uint64_t(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && position < block.size() && shift < 64);
+    return value;
+}
+
+// Records are packed as the zigzag timestamp delta to the previous record,
+// device and endpoint, then a LEB128 length and the bytes
+void appendRecord(std::vector<uint8_t>& block, int64_t& previous, const CaptureTag& tag,
+                  const uint8_t* data, size_t length) {
+    int64_t delta = tag.timestamp - previous;
+    previous = tag.timestamp;
+    appendVarint(block, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+    block.push_back(uint8_t(tag.device));
+    block.push_back(uint8_t(tag.device >> 8));
+    block.push_back(tag.endpoint);
+    appendVarint(block, length);
+    block.insert(block.end(), data, data + length);
+}
+
+template <typename Visit>
+void forEachRecord(const std::vector<uint8_t>& block, Visit visit) {
+    size_t position = 0;
+    uint32_t index = 0;
+    int64_t timestamp = 0;
+    while (position + 4 < block.size()) {
+        uint64_t zigzag = readVarint(block, position);
+        timestamp += int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        if (position + 4 > block.size()) return;
+        
+        CaptureTag tag{timestamp, uint16_t(block[position] | (block[position + 1] << 8)),
+                       block[position + 2]};
+        position += 3;
+        size_t length = std::min<size_t>(readVarint(block, position), block.size() - position);
+        if (!visit(index++, tag, block.data() + position, length)) return;
+        position += length;
+    }
+}
+
+struct ContextDeleter {
+    void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+    void operator()(ZSTD_DCtx* context) const { ZSTD_freeDCtx(context); }
+};
+
+ZSTD_CCtx* compressionContext() {
+    thread_local std::unique_ptr<ZSTD_CCtx, ContextDeleter> context(ZSTD_createCCtx());
+    return context.get();
+}
+
+ZSTD_DCtx* decompressionContext() {
+    thread_local std::unique_ptr<ZSTD_DCtx, ContextDeleter> context(ZSTD_createDCtx());
+    return context.get();
+}
+
+} // namespace
+
+class CaptureStore::Private {
+public:
+    struct Block {
+        uint64_t index{0};
+        uint8_t deviceClass{0};
+        uint32_t records{0};
+        size_t rawSize{0};
+        int64_t firstTimestamp{0};
+        int64_t lastTimestamp{0};
+        int64_t previousTimestamp{0};   // Delta base while filling
+        std::vector<uint32_t> endpoints;
+        bool manyEndpoints{false};
+        std::vector<uint8_t> open;      // Filling; empty once sealed
+        Bytes raw;                      // Sealed, and kept if it did not compress
+        Bytes compressed;
+        std::shared_ptr<const Dictionary> dictionary;
+        bool sealed{false};
+        bool settled{false};            // The compressor is done with it
+        bool evicted{false};
+    };
+    
+    struct ClassState {
+        std::shared_ptr<Block> open;
+        std::shared_ptr<const Dictionary> dictionary;
+        std::vector<Bytes> trainingSet;
+        bool training{false};
+    };
+    
+    mutable std::mutex mutex;
+    std::map<uint64_t, std::shared_ptr<Block>> blocks;
+    std::map<uint8_t, ClassState> classes;
+    uint64_t nextBlock{0};
+    size_t budget{CAPTURE_MEMORY_BUDGET};
+    bool trainDictionaries{false};
+    
+    uint64_t records{0};
+    uint64_t rawBytes{0};
+    uint64_t held{0};
+    uint64_t evicted{0};
+    uint64_t pending{0};
+    uint64_t compressedRaw{0};          // Raw size of blocks that compressed
+    uint64_t compressedBytes{0};
+    
+    // Last block decompressed for reading
+    mutable std::mutex cacheMutex;
+    mutable uint64_t cachedIndex{UINT64_MAX};
+    mutable Bytes cached;
+    
+    // Declared last so it drains before the rest is destroyed
+    std::unique_ptr<WorkerPool> compressor;
+    
+    static size_t storedSize(const Block& block) {
+        if (!block.sealed) return block.open.size();
+        return block.compressed ? block.compressed->size() : block.rawSize;
+    }
+    
+    // Locked
+    void seal(ClassState& state) {
+        auto block = std::move(state.open);
+        if (!block) return;
+        
+        auto raw = std::make_shared<const std::vector<uint8_t>>(std::move(block->open));
+        block->open = {};
+        block->raw = raw;
+        block->rawSize = raw->size();
+        block->sealed = true;
+        block->dictionary = state.dictionary;
+        pending++;
+        
+        compressor->submit([this, block, raw, dictionary = state.dictionary] {
+            compress(block, *raw, dictionary.get());
+        });
+        
+        if (trainDictionaries && !state.dictionary && !state.training) {
+            state.trainingSet.push_back(raw);
+            if (state.trainingSet.size() >= size_t(CAPTURE_DICT_TRAIN_BLOCKS)) {
+                state.training = true;
+                compressor->submit([this, deviceClass = block->deviceClass,
+                                    samples = std::move(state.trainingSet)] {
+                    train(deviceClass, samples);
+                });
+                state.trainingSet.clear();
+            }
+        }
+    }
+    
+    // Locked; oldest sealed blocks go first
+    void evict() {
+        auto it = blocks.begin();
+        while (held > budget && it != blocks.end()) {
+            if (!it->second->sealed) {
+                ++it;
+                continue;
+            }
+            auto& block = *it->second;
+            held -= storedSize(block);
+            block.evicted = true;
+            if (!block.settled) pending--;
+            evicted++;
+            it = blocks.erase(it);
+        }
+    }
+    
+    // Compressor thread
+    void compress(const std::shared_ptr<Block>& block, const std::vector<uint8_t>& raw,
+                  const Dictionary* dictionary) {
+        std::vector<uint8_t> output(ZSTD_compressBound(raw.size()));
+        size_t size = dictionary
+            ? ZSTD_compress_usingCDict(compressionContext(), output.data(), output.size(),
+                                       raw.data(), raw.size(), dictionary->compress)
+            : ZSTD_compressCCtx(compressionContext(), output.data(), output.size(),
+                                raw.data(), raw.size(), CAPTURE_ZSTD_LEVEL);
+        // Blocks that fail or do not shrink stay raw
+        bool useful = !ZSTD_isError(size) && size < raw.size();
+        output.resize(useful ? size : 0);
+        output.shrink_to_fit();
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (block->evicted) return;
+        
+        block->settled = true;
+        pending--;
+        if (useful) {
+            held -= block->rawSize;
+            held += output.size();
+            compressedRaw += block->rawSize;
+            compressedBytes += output.size();
+            block->compressed = std::make_shared<const std::vector<uint8_t>>(std::move(output));
+            block->raw.reset();
+        } else {
+            block->dictionary.reset();
+        }
+    }
+    
+    // Compressor thread
+    void train(uint8_t deviceClass, const std::vector<Bytes>& blocksToSample) {
+        std::vector<uint8_t> samples;
+        std::vector<size_t> sizes;
+        for (const auto& raw : blocksToSample) {
+            forEachRecord(*raw, [&](uint32_t, const CaptureTag&, const uint8_t* data, size_t length) {
+                if (length == 0) return true;
+                samples.insert(samples.end(), data, data + length);
+                sizes.push_back(length);
+                return true;
+            });
+        }
+        
+        auto dictionary = std::make_shared<Dictionary>();
+        dictionary->bytes.resize(CAPTURE_DICT_SIZE);
+        size_t size = sizes.empty() ? 0 : ZDICT_trainFromBuffer(
+            dictionary->bytes.data(), dictionary->bytes.size(),
+            samples.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+        
+        // Too few or too uniform samples; the class does without
+        if (size == 0 || ZDICT_isError(size)) return;
+        dictionary->bytes.resize(size);
+        dictionary->compress = ZSTD_createCDict(dictionary->bytes.data(), size, CAPTURE_ZSTD_LEVEL);
+        dictionary->decompress = ZSTD_createDDict(dictionary->bytes.data(), size);
+        if (!dictionary->compress || !dictionary->decompress) return;
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        classes[deviceClass].dictionary = std::move(dictionary);
+    }
+    
+    // The block's records, decompressing outside the locks. Point reads
+    // go through a one-block cache; scans do not, to run side by side.
+    Bytes blockData(uint64_t index, bool useCache) const {
+        std::shared_ptr<Block> block;
+        Bytes raw;
+        Bytes compressed;
+        std::shared_ptr<const Dictionary> dictionary;
+        size_t rawSize;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = blocks.find(index);
+            if (it == blocks.end()) return nullptr;
+            
+            block = it->second;
+            if (!block->sealed) return std::make_shared<const std::vector<uint8_t>>(block->open);
+            raw = block->raw;
+            compressed = block->compressed;
+            dictionary = block->dictionary;
+            rawSize = block->rawSize;
+        }
+        if (raw) return raw;
+        
+        if (useCache) {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            if (cachedIndex == index) return cached;
+        }
+        
+        std::vector<uint8_t> output(rawSize);
+        size_t size = dictionary
+            ? ZSTD_decompress_usingDDict(decompressionContext(), output.data(), output.size(),
+                                         compressed->data(), compressed->size(), dictionary->decompress)
+            : ZSTD_decompressDCtx(decompressionContext(), output.data(), output.size(),
+                                  compressed->data(), compressed->size());
+        if (ZSTD_isError(size) || size != rawSize) return nullptr;
+        auto data = std::make_shared<const std::vector<uint8_t>>(std::move(output));
+        
+        if (useCache) {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            cachedIndex = index;
+            cached = data;
+        }
+        return data;
+    }
+};
+
+CaptureStore::CaptureStore(size_t memoryBudget)
+    : d(std::make_unique<Private>()) {
+    d->budget = memoryBudget;
+    d->compressor = std::make_unique<WorkerPool>(1);
+}
+
+CaptureStore::~CaptureStore() {
+    // Pending jobs refer to the private state
+    d->compressor.reset();
+}
+
+void CaptureStore::setDictionaryTraining(bool enabled) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->trainDictionaries = enabled;
+}
+
+void CaptureStore::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->budget = bytes;
+    d->evict();
+}
+
+uint64_t CaptureStore::append(uint8_t deviceClass, const uint8_t* data, size_t length,
+                              const CaptureTag& tag) {
+    length = std::min<size_t>(length, CAPTURE_SNAPLEN);
+    
+    std::lock_guard<std::mutex> lock(d->mutex);
+    auto& state = d->classes[deviceClass];
+    if (!state.open) {
+        state.open = std::make_shared<Private::Block>();
+        state.open->index = d->nextBlock++;
+        state.open->deviceClass = deviceClass;
+        state.open->open.reserve(CAPTURE_BLOCK_SIZE + CAPTURE_SNAPLEN + 8);
+        d->blocks.emplace(state.open->index, state.open);
+    }
+    
+    auto& block = *state.open;
+    size_t before = block.open.size();
+    appendRecord(block.open, block.previousTimestamp, tag, data, length);
+    
+    if (block.records == 0) {
+        block.firstTimestamp = block.lastTimestamp = tag.timestamp;
+    } else {
+        block.firstTimestamp = std::min(block.firstTimestamp, tag.timestamp);
+        block.lastTimestamp = std::max(block.lastTimestamp, tag.timestamp);
+    }
+    if (!block.manyEndpoints) {
+        uint32_t key = (uint32_t(tag.device) << 8) | tag.endpoint;
+        auto at = std::lower_bound(block.endpoints.begin(), block.endpoints.end(), key);
+        if (at == block.endpoints.end() || *at != key) {
+            if (block.endpoints.size() < MAX_BLOCK_ENDPOINTS) {
+                block.endpoints.insert(at, key);
+            } else {
+                block.manyEndpoints = true;
+                block.endpoints.clear();
+            }
+        }
+    }
+    uint64_t handle = (block.index << 16) | block.records++;
+    
+    d->records++;
+    d->rawBytes += length;
+    d->held += block.open.size() - before;
+    
+    if (block.open.size() >= size_t(CAPTURE_BLOCK_SIZE) || block.records == MAX_BLOCK_RECORDS) {
+        d->seal(state);
+    }
+    d->evict();
+    return handle;
+}
+
+std::optional<std::vector<uint8_t>> CaptureStore::read(uint64_t handle) const {
+    if (handle == NO_PAYLOAD) return std::nullopt;
+    
+    auto data = d->blockData(blockOf(handle), true);
+    if (!data) return std::nullopt;
+    
+    uint32_t wanted = uint32_t(handle & 0xFFFF);
+    std::optional<std::vector<uint8_t>> result;
+    forEachRecord(*data, [&](uint32_t index, const CaptureTag&, const uint8_t* bytes, size_t length) {
+        if (index != wanted) return true;
+        result.emplace(bytes, bytes + length);
+        return false;
+    });
+    return result;
+}
+
+uint64_t CaptureStore::firstBlock() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->blocks.empty() ? d->nextBlock : d->blocks.begin()->first;
+}
+
+uint64_t CaptureStore::endBlock() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->nextBlock;
+}
+
+std::vector<std::vector<uint8_t>> CaptureStore::readBlock(uint64_t block) const {
+    std::vector<std::vector<uint8_t>> result;
+    auto data = d->blockData(block, true);
+    if (!data) return result;
+    
+    forEachRecord(*data, [&](uint32_t, const CaptureTag&, const uint8_t* bytes, size_t length) {
+        result.emplace_back(bytes, bytes + length);
+        return true;
+    });
+    return result;
+}
+
+std::vector<CaptureBlockInfo> CaptureStore::blockInfo() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    std::vector<CaptureBlockInfo> result;
+    result.reserve(d->blocks.size());
+    for (const auto& [index, block] : d->blocks) {
+        result.push_back(CaptureBlockInfo{index, block->deviceClass, block->records,
+                                          block->firstTimestamp, block->lastTimestamp,
+                                          block->endpoints});
+    }
+    return result;
+}
+
+bool CaptureStore::scanBlock(uint64_t block,
+                             const std::function<bool(const CaptureRecord&)>& visit) const {
+    auto data = d->blockData(block, false);
+    if (!data) return false;
+    
+    forEachRecord(*data, [&](uint32_t index, const CaptureTag& tag, const uint8_t* bytes, size_t length) {
+        return visit(CaptureRecord{(block << 16) | index, tag, bytes, length});
+    });
+    return true;
+}
+
+void CaptureStore::flush() {
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        for (auto& [deviceClass, state] : d->classes) {
+            d->seal(state);
+        }
+    }
+    d->compressor->waitIdle();
+}
+
+CaptureStoreStats CaptureStore::stats() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    
+    CaptureStoreStats stats{};
+    stats.records = d->records;
+    stats.rawBytes = d->rawBytes;
+    stats.storedBytes = d->held;
+    stats.blocks = d->blocks.size();
+    stats.evictedBlocks = d->evicted;
+    stats.pendingBlocks = d->pending;
+    stats.ratio = d->compressedBytes ? double(d->compressedRaw) / d->compressedBytes : 1.0;
+    for (const auto& [deviceClass, state] : d->classes) {
+        if (state.dictionary) stats.dictionaries++;
+    }
+    return stats;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,92 @@
+// src/capture/CaptureStore.hpp
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace usb_monitor {
+
+struct CaptureStoreStats {
+    uint64_t records;
+    uint64_t rawBytes;          // Snippet bytes appended
+    uint64_t storedBytes;       // Held now, compressed or not
+    uint64_t blocks;            // Held now
+    uint64_t evictedBlocks;     // Dropped to stay within the budget
+    uint64_t pendingBlocks;     // Sealed, waiting for the compressor
+    double ratio;               // Raw over compressed, for compressed blocks
+    size_t dictionaries;        // Device classes with a trained dictionary
+};
+
+// Where a payload came from
+struct CaptureTag {
+    int64_t timestamp{0};           // us since the epoch
+    uint16_t device{0};             // (bus << 8) | address
+    uint8_t endpoint{0};
+};
+
+struct CaptureRecord {
+    uint64_t handle;
+    CaptureTag tag;
+    const uint8_t* data;
+    size_t length;
+};
+
+// What a block holds, known without decompressing it
+struct CaptureBlockInfo {
+    uint64_t index;
+    uint8_t deviceClass;
+    uint32_t records;
+    int64_t firstTimestamp;
+    int64_t lastTimestamp;
+    std::vector<uint32_t> endpoints;    // (device << 8) | endpoint, sorted; empty if too many
+};
+
+// Payload snippets of captured transfers, packed into blocks that are
+// zstd-compressed on a background thread once full. Handles stay valid
+// until their block is evicted for the memory budget; blocks are numbered
+// in order and can be read back whole. With dictionary training on, each
+// device class gets a dictionary trained on its first blocks, which suits
+// the short, repetitive payloads of USB protocols.
+class CaptureStore {
+public:
+    static constexpr uint64_t NO_PAYLOAD = UINT64_MAX;
+    
+    explicit CaptureStore(size_t memoryBudget = CAPTURE_MEMORY_BUDGET);
+    ~CaptureStore();
+
+    CaptureStore(const CaptureStore&) = delete;
+    CaptureStore& operator=(const CaptureStore&) = delete;
+    
+    void setDictionaryTraining(bool enabled);
+    void setMemoryBudget(size_t bytes);
+    
+    // Keeps the first CAPTURE_SNAPLEN bytes; returns the record's handle
+    uint64_t append(uint8_t deviceClass, const uint8_t* data, size_t length,
+                    const CaptureTag& tag = {});
+    std::optional<std::vector<uint8_t>> read(uint64_t handle) const;
+    
+    // Blocks [firstBlock, endBlock) are held
+    uint64_t firstBlock() const;
+    uint64_t endBlock() const;
+    std::vector<std::vector<uint8_t>> readBlock(uint64_t block) const;
+    static uint64_t blockOf(uint64_t handle) { return handle >> 16; }
+    std::vector<CaptureBlockInfo> blockInfo() const;
+    
+    // Visits the block's records in order until visit returns false. Does
+    // not go through the read cache, so blocks can be scanned in parallel.
+    bool scanBlock(uint64_t block, const std::function<bool(const CaptureRecord&)>& visit) const;
+    
+    // Seals the open blocks and waits for the compressor
+    void flush();
+    CaptureStoreStats stats() const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
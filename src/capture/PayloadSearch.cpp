@@ -0,0 +1,280 @@
+// src/capture/PayloadSearch.cpp
+#include "PayloadSearch.hpp"
+#include "CaptureStore.hpp"
+#include "../core/WorkerPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <tuple>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace usb_monitor {
+
+namespace {
+
+struct Pattern {
+    const uint8_t* bytes;
+    size_t length;
+    uint16_t index;
+#if defined(__SSE2__)
+    __m128i first{};
+    __m128i last{};
+#endif
+};
+
+bool matchesAt(const uint8_t* data, const Pattern& pattern) {
+    // First and last bytes are already known to match
+    return pattern.length <= 2 ||
+           std::memcmp(data + 1, pattern.bytes + 1, pattern.length - 2) == 0;
+}
+
+bool candidateAt(const uint8_t* data, const Pattern& pattern) {
+    return data[0] == pattern.bytes[0] && data[pattern.length - 1] == pattern.bytes[pattern.length - 1] &&
+           matchesAt(data, pattern);
+}
+
+// Reports the first offset of each pattern found in the payload. A
+// pattern drops out once found, so the common no-match case is the one
+// the inner loop is built for.
+template <typename Found>
+void findPatterns(const uint8_t* data, size_t length, const std::vector<Pattern>& patterns,
+                  std::vector<uint8_t>& done, Found found) {
+    std::fill(done.begin(), done.end(), 0);
+    size_t remaining = patterns.size();
+    size_t position = 0;
+
+#if defined(__SSE2__)
+    for (; position + 16 <= length && remaining; position += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        for (size_t p = 0; p < patterns.size(); p++) {
+            const auto& pattern = patterns[p];
+            if (done[p] || position + pattern.length > length) continue;
+            
+            uint32_t mask;
+            if (position + pattern.length - 1 + 16 <= length) {
+                __m128i tail = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data + position + pattern.length - 1));
+                mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, pattern.first),
+                                                       _mm_cmpeq_epi8(tail, pattern.last)));
+                while (mask) {
+                    size_t at = position + __builtin_ctz(mask);
+                    if (matchesAt(data + at, pattern)) {
+                        found(pattern.index, at);
+                        done[p] = 1;
+                        remaining--;
+                        break;
+                    }
+                    mask &= mask - 1;
+                }
+                continue;
+            }
+            
+            // The pattern's tail runs past the payload; finish it byte-wise
+            for (size_t at = position; at + pattern.length <= length; at++) {
+                if (candidateAt(data + at, pattern)) {
+                    found(pattern.index, at);
+                    done[p] = 1;
+                    remaining--;
+                    break;
+                }
+            }
+            if (!done[p]) {
+                done[p] = 1;
+                remaining--;
+            }
+        }
+    }
+#endif
+    
+    for (size_t p = 0; p < patterns.size() && remaining; p++) {
+        if (done[p]) continue;
+        const auto& pattern = patterns[p];
+        for (size_t at = position; at + pattern.length <= length; at++) {
+            if (candidateAt(data + at, pattern)) {
+                found(pattern.index, at);
+                break;
+            }
+        }
+    }
+}
+
+bool blockWanted(const CaptureBlockInfo& block, const PayloadQuery& query) {
+    if (block.records == 0) return false;
+    if (block.lastTimestamp < query.from || block.firstTimestamp > query.until) return false;
+    if (query.deviceClass && block.deviceClass != *query.deviceClass) return false;
+    
+    // An empty list means too many endpoints were mixed to keep one
+    if (!query.device || block.endpoints.empty()) return true;
+    uint32_t low = uint32_t(*query.device) << 8;
+    if (query.endpoint) {
+        return std::binary_search(block.endpoints.begin(), block.endpoints.end(), low | *query.endpoint);
+    }
+    auto it = std::lower_bound(block.endpoints.begin(), block.endpoints.end(), low);
+    return it != block.endpoints.end() && *it < low + 0x100;
+}
+
+// Orders matches by capture time, then by where they were appended
+struct Earlier {
+    bool operator()(const PayloadMatch& a, const PayloadMatch& b) const {
+        return std::tie(a.timestamp, a.handle, a.pattern) < std::tie(b.timestamp, b.handle, b.pattern);
+    }
+};
+
+// Latest time a match can have and still be among the earliest maxMatches.
+// Lowered as blocks find matches; records after it are skipped unscanned.
+struct Cutoff {
+    std::atomic<int64_t> timestamp{std::numeric_limits<int64_t>::max()};
+    std::mutex mutex;
+    std::vector<int64_t> earliest;      // Max-heap of the earliest match times of finished blocks
+    
+    void lower(int64_t to) {
+        int64_t current = timestamp.load(std::memory_order_relaxed);
+        while (to < current && !timestamp.compare_exchange_weak(current, to, std::memory_order_relaxed)) {
+        }
+    }
+    
+    void add(const std::vector<PayloadMatch>& matches, size_t limit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& match : matches) {
+            if (earliest.size() < limit) {
+                earliest.push_back(match.timestamp);
+                std::push_heap(earliest.begin(), earliest.end());
+            } else if (match.timestamp < earliest.front()) {
+                std::pop_heap(earliest.begin(), earliest.end());
+                earliest.back() = match.timestamp;
+                std::push_heap(earliest.begin(), earliest.end());
+            }
+        }
+        if (earliest.size() == limit) lower(earliest.front());
+    }
+};
+
+} // namespace
+
+class PayloadSearch::Private {
+public:
+    const CaptureStore& store;
+    mutable std::mutex searchMutex;     // One search at a time owns the pool
+    std::unique_ptr<WorkerPool> pool;
+    
+    explicit Private(const CaptureStore& store) : store(store) {}
+    
+    struct BlockResult {
+        std::vector<PayloadMatch> matches;      // Max-heap by Earlier of the block's earliest
+        uint64_t records{0};
+        uint64_t bytes{0};
+        bool scanned{false};
+    };
+    
+    // Worker thread. Keeps the block's earliest maxMatches; records are not
+    // assumed to be in time order within a block.
+    void scan(const CaptureBlockInfo& block, const PayloadQuery& query, const std::vector<Pattern>& patterns,
+              Cutoff& cutoff, BlockResult& result) const {
+        if (block.firstTimestamp > cutoff.timestamp.load(std::memory_order_relaxed)) return;
+        
+        Earlier earlier;
+        auto& kept = result.matches;
+        std::vector<uint8_t> done(patterns.size());
+        result.scanned = store.scanBlock(block.index, [&](const CaptureRecord& record) {
+            const auto& tag = record.tag;
+            if (tag.timestamp < query.from || tag.timestamp > query.until) return true;
+            if (query.device && tag.device != *query.device) return true;
+            if (query.endpoint && tag.endpoint != *query.endpoint) return true;
+            if (tag.timestamp > cutoff.timestamp.load(std::memory_order_relaxed)) return true;
+            
+            result.records++;
+            result.bytes += record.length;
+            findPatterns(record.data, record.length, patterns, done, [&](uint16_t pattern, size_t offset) {
+                PayloadMatch match{record.handle, tag.timestamp, tag.device, tag.endpoint, pattern,
+                                   uint16_t(offset)};
+                if (kept.size() < query.maxMatches) {
+                    kept.push_back(match);
+                    std::push_heap(kept.begin(), kept.end(), earlier);
+                } else if (earlier(match, kept.front())) {
+                    std::pop_heap(kept.begin(), kept.end(), earlier);
+                    kept.back() = match;
+                    std::push_heap(kept.begin(), kept.end(), earlier);
+                } else {
+                    return;
+                }
+                if (kept.size() == query.maxMatches) cutoff.lower(kept.front().timestamp);
+            });
+            return true;
+        });
+        cutoff.add(kept, query.maxMatches);
+    }
+};
+
+PayloadSearch::PayloadSearch(const CaptureStore& store, size_t threadCount)
+    : d(std::make_unique<Private>(store)) {
+    d->pool = std::make_unique<WorkerPool>(threadCount);
+}
+
+PayloadSearch::~PayloadSearch() = default;
+
+PayloadSearchResult PayloadSearch::find(const PayloadQuery& query) const {
+    PayloadSearchResult result;
+    
+    std::vector<Pattern> patterns;
+    for (size_t i = 0; i < query.patterns.size(); i++) {
+        const auto& bytes = query.patterns[i];
+        if (bytes.empty()) continue;
+        
+        Pattern pattern{bytes.data(), bytes.size(), uint16_t(i)};
+#if defined(__SSE2__)
+        pattern.first = _mm_set1_epi8(char(bytes.front()));
+        pattern.last = _mm_set1_epi8(char(bytes.back()));
+#endif
+        patterns.push_back(pattern);
+    }
+    if (patterns.empty() || query.maxMatches == 0) return result;
+    
+    auto info = d->store.blockInfo();
+    std::vector<const CaptureBlockInfo*> wanted;
+    for (const auto& block : info) {
+        if (blockWanted(block, query)) {
+            wanted.push_back(&block);
+        } else {
+            result.blocksSkipped++;
+        }
+    }
+    
+    // Earliest blocks first, so the cutoff drops early and rules out the rest
+    std::stable_sort(wanted.begin(), wanted.end(), [](const CaptureBlockInfo* a, const CaptureBlockInfo* b) {
+        return a->firstTimestamp < b->firstTimestamp;
+    });
+    
+    std::vector<Private::BlockResult> blocks(wanted.size());
+    Cutoff cutoff;
+    {
+        std::lock_guard<std::mutex> lock(d->searchMutex);
+        for (size_t i = 0; i < wanted.size(); i++) {
+            d->pool->submit([this, &query, &patterns, &cutoff, &blocks, block = wanted[i], i] {
+                d->scan(*block, query, patterns, cutoff, blocks[i]);
+            });
+        }
+        d->pool->waitIdle();
+    }
+    
+    for (auto& block : blocks) {
+        if (block.scanned) result.blocksScanned++;
+        result.recordsScanned += block.records;
+        result.bytesScanned += block.bytes;
+        result.matches.insert(result.matches.end(), block.matches.begin(), block.matches.end());
+    }
+    
+    // Blocks of different classes fill side by side
+    std::sort(result.matches.begin(), result.matches.end(), Earlier{});
+    if (result.matches.size() >= query.maxMatches) {
+        result.truncated = true;
+        result.matches.resize(query.maxMatches);
+    }
+    return result;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,63 @@
+// src/capture/PayloadSearch.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace usb_monitor {
+
+class CaptureStore;
+
+struct PayloadQuery {
+    std::vector<std::vector<uint8_t>> patterns;     // Any of these, byte for byte
+    std::optional<uint16_t> device;                 // (bus << 8) | address
+    std::optional<uint8_t> endpoint;
+    std::optional<uint8_t> deviceClass;
+    int64_t from{std::numeric_limits<int64_t>::min()};      // us since the epoch
+    int64_t until{std::numeric_limits<int64_t>::max()};
+    size_t maxMatches{10000};                       // The earliest this many are kept
+};
+
+// First occurrence of one pattern in one payload
+struct PayloadMatch {
+    uint64_t handle;
+    int64_t timestamp;
+    uint16_t device;
+    uint8_t endpoint;
+    uint16_t pattern;           // Index into PayloadQuery::patterns
+    uint16_t offset;
+};
+
+struct PayloadSearchResult {
+    std::vector<PayloadMatch> matches;      // In capture order: by timestamp, then handle
+    uint64_t blocksScanned{0};
+    uint64_t blocksSkipped{0};              // Ruled out by the prefilters undecompressed
+    uint64_t recordsScanned{0};
+    uint64_t bytesScanned{0};
+    bool truncated{false};                  // Reached maxMatches; later matches may be missing
+};
+
+// Byte signature search over a capture store. Blocks are ruled out by
+// time, class and endpoint from their summaries, the rest decompressed
+// and scanned in parallel. Each block is matched against all patterns in
+// one pass, with SIMD comparing the first and last byte of every pattern
+// at 16 offsets at once and only candidates checked in full.
+class PayloadSearch {
+public:
+    explicit PayloadSearch(const CaptureStore& store, size_t threadCount = 0);
+    ~PayloadSearch();
+
+    PayloadSearch(const PayloadSearch&) = delete;
+    PayloadSearch& operator=(const PayloadSearch&) = delete;
+
+    PayloadSearchResult find(const PayloadQuery& query) const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
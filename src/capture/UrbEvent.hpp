@@ -0,0 +1,39 @@
+// src/capture/UrbEvent.hpp
+#pragma once
+#include <cstdint>
+
+namespace usb_monitor {
+
+// usbmon's per-packet isochronous descriptor; offsets are into UrbEvent::data
+struct IsoPacketDescriptor {
+    int32_t status;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t padding;
+};
+
+// One usbmon record. 'S' is a URB submission, 'C' its completion and 'E'
+// a submission that failed. The payload is only valid for the duration
+// of the handler call.
+struct UrbEvent {
+    uint64_t id{0};                 // URB address, shared by S and C
+    char type{0};
+    uint8_t transferType{0};        // LIBUSB_TRANSFER_TYPE_*
+    uint8_t endpoint{0};            // bEndpointAddress, direction in bit 7
+    uint8_t deviceAddress{0};
+    uint16_t busNumber{0};
+    int64_t timestamp{0};           // us since the epoch
+    int32_t status{0};              // -errno on completion
+    uint32_t length{0};             // Requested (S) or actual (C) length
+    uint8_t setup[8]{};
+    bool hasSetup{false};           // Control submissions only
+    int32_t interval{0};            // Interrupt and isochronous, in (micro)frames
+    const uint8_t* data{nullptr};
+    uint32_t capturedLength{0};     // Bytes available at 'data'
+    const IsoPacketDescriptor* isoPackets{nullptr};
+    uint32_t isoPacketCount{0};
+    
+    bool isInput() const { return endpoint & 0x80; }
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,273 @@
+// src/capture/UsbmonReader.cpp
+#include "UsbmonReader.hpp"
+#include "../core/Logger.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace usb_monitor {
+
+namespace {
+
+// Kernel ABI from Documentation/usb/usbmon.rst
+struct UsbmonPacket {
+    uint64_t id;
+    unsigned char type;
+    unsigned char xferType;
+    unsigned char epnum;
+    unsigned char devnum;
+    uint16_t busnum;
+    char flagSetup;
+    char flagData;
+    int64_t tsSec;
+    int32_t tsUsec;
+    int32_t status;
+    uint32_t length;
+    uint32_t lenCap;
+    union {
+        unsigned char setup[8];
+        struct {
+            int32_t errorCount;
+            int32_t numdesc;
+        } iso;
+    } s;
+    int32_t interval;
+    int32_t startFrame;
+    uint32_t xferFlags;
+    uint32_t ndesc;
+};
+static_assert(sizeof(UsbmonPacket) == 64, "usbmon binary header is 64 bytes");
+static_assert(sizeof(IsoPacketDescriptor) == 16, "usbmon iso descriptor is 16 bytes");
+
+struct UsbmonStats {
+    uint32_t queued;
+    uint32_t dropped;
+};
+
+struct UsbmonMfetch {
+    uint32_t* offvec;
+    uint32_t nfetch;
+    uint32_t nflush;
+};
+
+constexpr unsigned long MON_IOC_MAGIC = 0x92;
+constexpr unsigned long MON_IOCQ_RING_SIZE = _IO(MON_IOC_MAGIC, 5);
+constexpr unsigned long MON_IOCG_STATS = _IOR(MON_IOC_MAGIC, 3, UsbmonStats);
+constexpr unsigned long MON_IOCX_MFETCH = _IOWR(MON_IOC_MAGIC, 7, UsbmonMfetch);
+
+// usbmon numbers transfer types ISO, interrupt, control, bulk
+constexpr uint8_t TRANSFER_TYPES[4] = {
+    LIBUSB_TRANSFER_TYPE_ISOCHRONOUS,
+    LIBUSB_TRANSFER_TYPE_INTERRUPT,
+    LIBUSB_TRANSFER_TYPE_CONTROL,
+    LIBUSB_TRANSFER_TYPE_BULK
+};
+
+// Ring filler records that pad the ring at wrap-around
+constexpr unsigned char FILLER_TYPE = '@';
+
+// How often the capture thread checks for stop() while idle
+constexpr int POLL_TIMEOUT = 100; // ms
+
+} // namespace
+
+class UsbmonReader::Private {
+public:
+    int fd{-1};
+    uint8_t* ring{nullptr};
+    size_t ringSize{0};
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> eventsRead{0};
+    std::vector<EventHandler> handlers;
+    UsbmonReader* q_ptr{nullptr};
+    
+    // MON_IOCG_STATS hands over the drops since the previous read and
+    // resets the kernel's count, so they are summed here
+    std::mutex statsMutex;      // Guards fd against close() and dropped
+    uint64_t dropped{0};
+    
+    // Caller holds statsMutex
+    void collectDropped() {
+        UsbmonStats stats{};
+        if (fd >= 0 && ioctl(fd, MON_IOCG_STATS, &stats) == 0) {
+            dropped += stats.dropped;
+        }
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        collectDropped();
+        if (ring) {
+            munmap(ring, ringSize);
+            ring = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    
+    void dispatch(const UsbmonPacket& packet) {
+        UrbEvent event;
+        event.id = packet.id;
+        event.type = static_cast<char>(packet.type);
+        event.transferType = TRANSFER_TYPES[packet.xferType & 3];
+        event.endpoint = packet.epnum;
+        event.deviceAddress = packet.devnum;
+        event.busNumber = packet.busnum;
+        event.timestamp = packet.tsSec * 1000000 + packet.tsUsec;
+        event.status = packet.status;
+        event.length = packet.length;
+        event.interval = packet.interval;
+        
+        // flag_setup is 0 when the setup packet was captured
+        if (packet.type == 'S' && packet.flagSetup == 0) {
+            std::memcpy(event.setup, packet.s.setup, sizeof(event.setup));
+            event.hasSetup = true;
+        }
+        
+        // Isochronous frame descriptors sit between the header and the data
+        auto* payload = reinterpret_cast<const uint8_t*>(&packet + 1);
+        if (event.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS && packet.ndesc > 0) {
+            event.isoPackets = reinterpret_cast<const IsoPacketDescriptor*>(payload);
+            event.isoPacketCount = packet.ndesc;
+            payload += packet.ndesc * sizeof(IsoPacketDescriptor);
+        }
+        
+        // flag_data is 0 when a payload was captured
+        if (packet.flagData == 0 && packet.lenCap > 0) {
+            event.data = payload;
+            event.capturedLength = packet.lenCap;
+        }
+        
+        for (const auto& handler : handlers) {
+            handler(event);
+        }
+    }
+    
+    void run() {
+        std::vector<uint32_t> offsets(USBMON_RING_BATCH);
+        uint32_t flush = 0;
+        
+        while (running) {
+            pollfd pfd{fd, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, POLL_TIMEOUT);
+            if (ready < 0 && errno != EINTR) {
+                reportError(std::string("usbmon poll failed: ") + std::strerror(errno));
+                break;
+            }
+            if (ready <= 0) continue;
+            
+            // Release the previous batch and fetch the next in one call
+            UsbmonMfetch fetch{offsets.data(), static_cast<uint32_t>(offsets.size()), flush};
+            if (ioctl(fd, MON_IOCX_MFETCH, &fetch) < 0) {
+                flush = 0;
+                if (errno == EAGAIN || errno == EINTR) continue;
+                reportError(std::string("usbmon fetch failed: ") + std::strerror(errno));
+                break;
+            }
+            
+            for (uint32_t i = 0; i < fetch.nfetch; i++) {
+                auto* packet = reinterpret_cast<const UsbmonPacket*>(ring + offsets[i]);
+                if (packet->type != FILLER_TYPE) {
+                    dispatch(*packet);
+                }
+            }
+            eventsRead += fetch.nfetch;
+            flush = fetch.nfetch;
+        }
+        running = false;
+    }
+    
+    void reportError(const std::string& message) {
+        LOG_ERROR(message);
+        QMetaObject::invokeMethod(q_ptr, [q = q_ptr, message]() {
+            emit q->errorOccurred(message);
+        }, Qt::QueuedConnection);
+    }
+};
+
+UsbmonReader::UsbmonReader(QObject* parent)
+    : QObject(parent)
+    , d(std::make_unique<Private>()) {
+    d->q_ptr = this;
+}
+
+UsbmonReader::~UsbmonReader() {
+    stop();
+}
+
+bool UsbmonReader::start(int busNumber) {
+    if (isRunning()) return true;
+    stop(); // Reap a capture thread that ended on an error
+    
+    std::string path = "/dev/usbmon" + std::to_string(busNumber);
+    int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        emit errorOccurred("Cannot open " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(d->statsMutex);
+        d->fd = fd;
+    }
+    
+    int ringSize = ioctl(d->fd, MON_IOCQ_RING_SIZE);
+    if (ringSize <= 0) {
+        emit errorOccurred("Cannot query usbmon ring size");
+        d->close();
+        return false;
+    }
+    
+    void* ring = mmap(nullptr, ringSize, PROT_READ, MAP_SHARED, d->fd, 0);
+    if (ring == MAP_FAILED) {
+        emit errorOccurred(std::string("Cannot map usbmon ring: ") + std::strerror(errno));
+        d->close();
+        return false;
+    }
+    d->ring = static_cast<uint8_t*>(ring);
+    d->ringSize = ringSize;
+    
+    d->running = true;
+    d->thread = std::thread([this]() { d->run(); });
+    return true;
+}
+
+void UsbmonReader::stop() {
+    d->running = false;
+    if (d->thread.joinable()) {
+        d->thread.join();
+    }
+    d->close();
+}
+
+bool UsbmonReader::isRunning() const {
+    return d->running;
+}
+
+void UsbmonReader::addHandler(EventHandler handler) {
+    d->handlers.push_back(std::move(handler));
+}
+
+uint64_t UsbmonReader::eventsRead() const {
+    return d->eventsRead;
+}
+
+uint64_t UsbmonReader::eventsDropped() const {
+    std::lock_guard<std::mutex> lock(d->statsMutex);
+    d->collectDropped();
+    return d->dropped;
+}
+
+} // namespace usb_monitor
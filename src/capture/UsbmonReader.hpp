@@ -0,0 +1,43 @@
+// src/capture/UsbmonReader.hpp
+#pragma once
+#include "UrbEvent.hpp"
+#include <QObject>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace usb_monitor {
+
+// Reads URB events from the Linux usbmon binary interface (/dev/usbmonN).
+// Events are fetched in batches straight out of the kernel's mmap'd ring,
+// and handlers see payloads in place without a copy.
+class UsbmonReader : public QObject {
+    Q_OBJECT
+
+public:
+    // Runs on the capture thread; must not block
+    using EventHandler = std::function<void(const UrbEvent& event)>;
+
+    explicit UsbmonReader(QObject* parent = nullptr);
+    ~UsbmonReader();
+
+    // Bus 0 captures every bus. Handlers must be added before start().
+    bool start(int busNumber = 0);
+    void stop();
+    bool isRunning() const;
+    
+    void addHandler(EventHandler handler);
+    
+    // Totals over every capture this reader has run
+    uint64_t eventsRead() const;
+    uint64_t eventsDropped() const;
+
+signals:
+    void errorOccurred(const std::string& error);
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,118 @@
+#include "BandwidthLedger.hpp"
+#include <algorithm>
+
+namespace usb_monitor {
+
+void BandwidthLedger::open(const void* device) {
+    accounts.try_emplace(device);
+}
+
+void BandwidthLedger::erase(const void* device) {
+    accounts.erase(device);
+}
+
+void BandwidthLedger::reset(const void* device) {
+    auto it = accounts.find(device);
+    if (it != accounts.end()) {
+        it->second = Account{};
+    }
+}
+
+bool BandwidthLedger::contains(const void* device) const {
+    return accounts.find(device) != accounts.end();
+}
+
+void BandwidthLedger::record(const void* device, const libusb_config_descriptor* config,
+                             uint8_t address, uint64_t bytes, Clock::time_point now) {
+    auto& account = accounts[device];
+    auto it = account.endpoints.find(address);
+    if (it == account.endpoints.end()) {
+        it = account.endpoints.emplace(address, describeEndpoint(account, config, address)).first;
+    }
+    auto& endpoint = it->second;
+    
+    uint64_t packets = endpoint.maxPacketSize
+        ? (bytes + endpoint.maxPacketSize - 1) / endpoint.maxPacketSize
+        : 1;
+    packets = std::max<uint64_t>(packets, 1);  // A zero-length packet is still a packet
+    
+    endpoint.window.add(bytes, packets, now);
+    account.interfaces[endpoint.interfaceNumber].window.add(bytes, packets, now);
+    if (address & LIBUSB_ENDPOINT_IN) {
+        account.reads.add(bytes, packets, now);
+    } else {
+        account.writes.add(bytes, packets, now);
+    }
+}
+
+BandwidthStats BandwidthLedger::collect(const void* device, Clock::time_point now) {
+    auto it = accounts.find(device);
+    return it != accounts.end() ? collect(it->second, now) : BandwidthStats{};
+}
+
+BandwidthStats BandwidthLedger::sample(const void* device, Clock::time_point now, bool& active) {
+    auto& account = accounts[device];
+    BandwidthStats stats = collect(account, now);
+    
+    uint64_t total = stats.bytesRead + stats.bytesWritten;
+    active = total != account.sampledBytes;
+    account.sampledBytes = total;
+    return stats;
+}
+
+BandwidthStats BandwidthLedger::collect(Account& account, Clock::time_point now) {
+    BandwidthStats stats{};
+    account.reads.advance(now);
+    account.writes.advance(now);
+    stats.bytesRead = account.reads.totalBytes();
+    stats.bytesWritten = account.writes.totalBytes();
+    stats.readSpeed = account.reads.rate();
+    stats.writeSpeed = account.writes.rate();
+    
+    stats.endpoints.reserve(account.endpoints.size());
+    for (auto& [address, endpoint] : account.endpoints) {
+        endpoint.window.advance(now);
+        stats.endpoints.push_back(EndpointBandwidth{
+            address, endpoint.interfaceNumber, endpoint.transferType,
+            endpoint.window.totalBytes(), endpoint.window.totalPackets(),
+            endpoint.window.rate(), endpoint.window.packetRate(),
+            endpoint.window.peakRate()});
+    }
+    
+    stats.interfaces.reserve(account.interfaces.size());
+    for (auto& [number, interface] : account.interfaces) {
+        interface.window.advance(now);
+        stats.interfaces.push_back(InterfaceBandwidth{
+            number, interface.interfaceClass, interface.window.totalBytes(),
+            interface.window.rate(), interface.window.peakRate()});
+    }
+    return stats;
+}
+
+// Finds which interface owns an endpoint, looking at every altsetting
+BandwidthLedger::EndpointStats BandwidthLedger::describeEndpoint(
+    Account& account, const libusb_config_descriptor* config, uint8_t address) {
+    EndpointStats endpoint;
+    if (!config) return endpoint;
+    
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        const libusb_interface* interface = &config->interface[i];
+        for (int j = 0; j < interface->num_altsetting; j++) {
+            const libusb_interface_descriptor* setting = &interface->altsetting[j];
+            for (int k = 0; k < setting->bNumEndpoints; k++) {
+                const libusb_endpoint_descriptor* desc = &setting->endpoint[k];
+                if (desc->bEndpointAddress != address) continue;
+                
+                endpoint.interfaceNumber = setting->bInterfaceNumber;
+                endpoint.transferType = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+                endpoint.maxPacketSize = desc->wMaxPacketSize & 0x7FF;
+                account.interfaces[setting->bInterfaceNumber].interfaceClass =
+                    setting->bInterfaceClass;
+                return endpoint;
+            }
+        }
+    }
+    return endpoint;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,68 @@
+#pragma once
+#include "RateWindow.hpp"
+#include <usb-monitor/Types.hpp>
+#include <libusb-1.0/libusb.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+
+namespace usb_monitor {
+
+// Per-device transfer accounting behind BandwidthMonitor: sliding-window
+// rates per direction, endpoint and interface. An endpoint is attributed to
+// its interface from the configuration descriptor the first time it is seen.
+//
+// Not thread-safe; the owner serializes access.
+class BandwidthLedger {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    // Starts an empty account, keeping any existing one
+    void open(const void* device);
+    void erase(const void* device);
+    void reset(const void* device);
+    bool contains(const void* device) const;
+    
+    // config may be null, which leaves new endpoints on interface 0
+    void record(const void* device, const libusb_config_descriptor* config, uint8_t endpoint,
+                uint64_t bytes, Clock::time_point now);
+    
+    // Totals, rates and the per-endpoint and per-interface breakdown. The
+    // speed class is left for the caller, which knows the device.
+    BandwidthStats collect(const void* device, Clock::time_point now);
+    
+    // collect(), also telling whether traffic was recorded since the
+    // previous sample
+    BandwidthStats sample(const void* device, Clock::time_point now, bool& active);
+
+private:
+    using Window = RateWindow<>;
+    
+    struct EndpointStats {
+        uint8_t interfaceNumber{0};
+        uint8_t transferType{0};
+        uint16_t maxPacketSize{0};
+        Window window;
+    };
+    
+    struct InterfaceStats {
+        uint8_t interfaceClass{0};
+        Window window;
+    };
+    
+    struct Account {
+        Window reads;
+        Window writes;
+        std::map<uint8_t, EndpointStats> endpoints;   // Keyed by bEndpointAddress
+        std::map<uint8_t, InterfaceStats> interfaces; // Keyed by bInterfaceNumber
+        uint64_t sampledBytes{0};                     // Totals at the last sample
+    };
+    
+    static EndpointStats describeEndpoint(Account& account, const libusb_config_descriptor* config,
+                                          uint8_t address);
+    static BandwidthStats collect(Account& account, Clock::time_point now);
+    
+    std::map<const void*, Account> accounts;
+};
+
+} // namespace usb_monitor
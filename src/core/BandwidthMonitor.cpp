@@ -1,170 +1,282 @@
 #include "BandwidthMonitor.hpp"
 #include "UsbDevice.hpp"
+#include "BandwidthLedger.hpp"
+#include "BusBandwidthScheduler.hpp"
+#include "SamplingScheduler.hpp"
 #include <usb-monitor/Constants.hpp>
 #include <QTimer>
 #include <map>
+#include <set>
 #include <mutex>
-#include <deque>
+#include <algorithm>
 #include <chrono>
 
 namespace usb_monitor {
 
-struct TransferStats {
-    std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>> readHistory;
-    std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>> writeHistory;
-    uint64_t totalBytesRead{0};
-    uint64_t totalBytesWritten{0};
-};
-
 class BandwidthMonitor::Private {
 	friend class BandwidthMonitor;
 	
 public:
-    std::map<const UsbDevice*, TransferStats> deviceStats;
-    std::map<const UsbDevice*, QTimer*> monitoringTimers;
+    BandwidthLedger ledger;
+    std::set<const UsbDevice*> captureFed;     // Counted from usbmon instead of our pool
+    std::map<const UsbDevice*, SamplingScheduler::SourceId> samplingSources;
+    std::map<const UsbDevice*, std::weak_ptr<UsbDevice>> observed;
+    SamplingScheduler* sampler{nullptr};
+    std::unique_ptr<SamplingScheduler> ownSampler;
+    QTimer* tickTimer{nullptr};
     std::mutex statsMutex;
+    BusBandwidthScheduler periodic;
+    mutable std::mutex periodicMutex;
     BandwidthMonitor* q_ptr;
     
-    void updateDeviceBandwidth(const UsbDevice* device) {
-        if (!device || !device->isOpen()) return;
-        
-        auto now = std::chrono::steady_clock::now();
-        auto& stats = deviceStats[device];
-        
-        // Get endpoint descriptors to monitor transfer activity
-        libusb_device* dev = device->nativeDevice();
-        libusb_config_descriptor* config;
-        if (libusb_get_active_config_descriptor(dev, &config) == 0) {
-            for (int i = 0; i < config->bNumInterfaces; i++) {
-                const libusb_interface* interface = &config->interface[i];
-                for (int j = 0; j < interface->num_altsetting; j++) {
-                    const libusb_interface_descriptor* setting = &interface->altsetting[j];
-                    
-                    for (int k = 0; k < setting->bNumEndpoints; k++) {
-                        const libusb_endpoint_descriptor* endpoint = &setting->endpoint[k];
-                        
-                        // Check endpoint direction and update stats
-                        if (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_IN) {
-                            // IN endpoint (device to host)
-                            updateTransferStats(stats.readHistory, stats.totalBytesRead,
-                                             endpoint->wMaxPacketSize, now);
-                        } else {
-                            // OUT endpoint (host to device)
-                            updateTransferStats(stats.writeHistory, stats.totalBytesWritten,
-                                             endpoint->wMaxPacketSize, now);
-                        }
-                    }
-                }
-            }
-            libusb_free_config_descriptor(config);
-        }
+    // Returns true if traffic was recorded since the previous sample
+    bool updateDeviceBandwidth(const UsbDevice* device) {
+        if (!device || !device->nativeDevice()) return false;
         
-        // Calculate current bandwidth stats
         BandwidthStats bwStats;
-        bwStats.bytesRead = stats.totalBytesRead;
-        bwStats.bytesWritten = stats.totalBytesWritten;
-        bwStats.readSpeed = calculateSpeed(stats.readHistory);
-        bwStats.writeSpeed = calculateSpeed(stats.writeHistory);
-        bwStats.speedClass = libusb_get_device_speed(dev);
+        bool active;
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            bwStats = ledger.sample(device, std::chrono::steady_clock::now(), active);
+        }
+        bwStats.speedClass = libusb_get_device_speed(device->nativeDevice());
         
         if (q_ptr) {
             Q_EMIT q_ptr->statsUpdated(device, bwStats);
         }
+        return active;
+    }
+    
+    // Completions from the device's own transfer pool, on the event thread
+    void recordPooled(const UsbDevice* device, uint8_t endpoint, uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (captureFed.count(device)) return;
+        auto config = device->configDescriptor();
+        ledger.record(device, config.get(), endpoint, bytes, std::chrono::steady_clock::now());
+    }
+    
+    SamplingScheduler* samplingScheduler(QObject* owner) {
+        if (!sampler) {
+            // Standalone use: drive a private scheduler from our own tick
+            ownSampler = std::make_unique<SamplingScheduler>();
+            sampler = ownSampler.get();
+            tickTimer = new QTimer(owner);
+            QObject::connect(tickTimer, &QTimer::timeout, [this]() { sampler->tick(); });
+            tickTimer->start(SAMPLING_TICK);
+        }
+        return sampler;
+    }
+    
+    struct PeriodicTarget {
+        std::string busKey;
+        BusSpeed speed{BusSpeed::Full};
+    };
+    
+    static BusSpeed busSpeed(int speed) {
+        switch (speed) {
+        case LIBUSB_SPEED_LOW: return BusSpeed::Low;
+        case LIBUSB_SPEED_HIGH: return BusSpeed::High;
+        case LIBUSB_SPEED_SUPER: return BusSpeed::Super;
+        case LIBUSB_SPEED_SUPER_PLUS: return BusSpeed::SuperPlus;
+        default: return BusSpeed::Full;
+        }
     }
     
-private:
-    void updateTransferStats(std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>>& history,
-                            uint64_t& totalBytes,
-                            uint16_t maxPacketSize,
-                            std::chrono::steady_clock::time_point now) {
-        // Simulate some transfer activity for demonstration
-        // In a real implementation, you'd track actual transfers
-        totalBytes += maxPacketSize;
-        history.emplace_back(now, totalBytes);
+    // Full- and low-speed devices behind a high-speed hub are scheduled by
+    // that hub's transaction translator, which has its own frame budget.
+    // Multi-TT hubs are treated as single-TT, which errs on the safe side.
+    static PeriodicTarget periodicTarget(const UsbDevice* device) {
+        PeriodicTarget target;
+        libusb_device* dev = device->nativeDevice();
+        target.speed = busSpeed(libusb_get_device_speed(dev));
+        target.busKey = "bus " + std::to_string(libusb_get_bus_number(dev));
         
-        // Keep only last 5 seconds of history
-        while (!history.empty() && 
-               std::chrono::duration_cast<std::chrono::milliseconds>(
-                   now - history.front().first).count() > BANDWIDTH_WINDOW) {
-            history.pop_front();
+        if (target.speed == BusSpeed::Low || target.speed == BusSpeed::Full) {
+            for (libusb_device* hub = libusb_get_parent(dev); hub; hub = libusb_get_parent(hub)) {
+                if (libusb_get_device_speed(hub) == LIBUSB_SPEED_HIGH) {
+                    target.busKey += " tt " + UsbDevice::portPathOf(hub);
+                    break;
+                }
+            }
         }
+        return target;
     }
     
-    double calculateSpeed(const std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>>& history) {
-        if (history.size() < 2) return 0.0;
+    // The result points into config, so keep config held while using it
+    static const libusb_interface_descriptor* findAltSetting(const libusb_config_descriptor* config,
+                                                             int interfaceNumber, int altSetting) {
+        if (!config) return nullptr;
         
-        auto timeSpan = std::chrono::duration_cast<std::chrono::milliseconds>(
-            history.back().first - history.front().first).count() / 1000.0;
-        auto byteSpan = history.back().second - history.front().second;
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            const libusb_interface* interface = &config->interface[i];
+            for (int j = 0; j < interface->num_altsetting; j++) {
+                const libusb_interface_descriptor* setting = &interface->altsetting[j];
+                if (setting->bInterfaceNumber == interfaceNumber &&
+                    setting->bAlternateSetting == altSetting) {
+                    return setting;
+                }
+            }
+        }
+        return nullptr;
+    }
+    
+    static std::vector<PeriodicEndpoint> periodicEndpoints(const libusb_interface_descriptor* setting,
+                                                           BusSpeed speed) {
+        std::vector<PeriodicEndpoint> endpoints;
+        for (int k = 0; k < setting->bNumEndpoints; k++) {
+            const libusb_endpoint_descriptor* desc = &setting->endpoint[k];
+            uint8_t type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+            if (type != LIBUSB_TRANSFER_TYPE_ISOCHRONOUS && type != LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+                continue;
+            }
+            
+            PeriodicEndpoint endpoint;
+            endpoint.address = desc->bEndpointAddress;
+            endpoint.isochronous = type == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS;
+            uint32_t maxPacket = desc->wMaxPacketSize & 0x7FF;
+            uint32_t exponent = std::clamp<int>(desc->bInterval, 1, 16) - 1;
+            
+            if (speed == BusSpeed::Super || speed == BusSpeed::SuperPlus) {
+                endpoint.interval = 1u << exponent;
+                endpoint.bytesPerInterval = maxPacket;
+                libusb_ss_endpoint_companion_descriptor* companion = nullptr;
+                if (libusb_get_ss_endpoint_companion_descriptor(nullptr, desc, &companion) == 0) {
+                    uint32_t mult = endpoint.isochronous ? (companion->bmAttributes & 0x3) + 1 : 1;
+                    endpoint.packetsPerInterval = (companion->bMaxBurst + 1) * mult;
+                    endpoint.bytesPerInterval = companion->wBytesPerInterval;
+                    libusb_free_ss_endpoint_companion_descriptor(companion);
+                }
+            } else if (speed == BusSpeed::High) {
+                // wMaxPacketSize bits 12:11 add transactions per microframe
+                endpoint.interval = 1u << exponent;
+                endpoint.packetsPerInterval = ((desc->wMaxPacketSize >> 11) & 0x3) + 1;
+                endpoint.bytesPerInterval = maxPacket * endpoint.packetsPerInterval;
+            } else {
+                endpoint.interval = endpoint.isochronous ? 1u << exponent
+                                                         : std::max<uint32_t>(desc->bInterval, 1);
+                endpoint.bytesPerInterval = maxPacket;
+            }
+            endpoints.push_back(endpoint);
+        }
+        return endpoints;
+    }
+    
+    // Reserves the default altsetting of every interface, as configured on
+    // enumeration. Returns false if some interface did not fit.
+    bool reserveDefaults(const UsbDevice* device) {
+        auto config = device->configDescriptor();
+        if (!config || !device->nativeDevice()) return true;
         
-        return timeSpan > 0.0 ? byteSpan / timeSpan : 0.0;
+        auto target = periodicTarget(device);
+        bool fits = true;
+        std::lock_guard<std::mutex> lock(periodicMutex);
+        for (int i = 0; i < config->bNumInterfaces; i++) {
+            const libusb_interface* interface = &config->interface[i];
+            if (interface->num_altsetting == 0) continue;
+            const libusb_interface_descriptor* setting = &interface->altsetting[0];
+            fits &= periodic.reserve(target.busKey, target.speed, device->stableId(),
+                                     setting->bInterfaceNumber,
+                                     periodicEndpoints(setting, target.speed));
+        }
+        return fits;
     }
+    
 };
 
 BandwidthMonitor::BandwidthMonitor(QObject* parent)
     : QObject(parent)
     , d(std::make_unique<Private>()) {
+    d->q_ptr = this;
 }
 
 BandwidthMonitor::~BandwidthMonitor() {
-    // Clean up monitoring timers
-    for (auto& pair : d->monitoringTimers) {
-        pair.second->stop();
-        delete pair.second;
+    // A shared scheduler outlives us; drop our samplers from it
+    if (d->sampler) {
+        for (const auto& [device, source] : d->samplingSources) {
+            d->sampler->remove(source);
+        }
     }
+    
+    // Devices may outlive us too; stop their pools reporting here
+    for (const auto& [device, weak] : d->observed) {
+        if (auto live = weak.lock()) {
+            live->setTransferObserver(nullptr);
+        }
+    }
+}
+
+void BandwidthMonitor::setSamplingScheduler(SamplingScheduler* scheduler) {
+    if (!d->samplingSources.empty() || !scheduler) return;
+    
+    d->sampler = scheduler;
+    d->ownSampler.reset();
+    delete d->tickTimer;
+    d->tickTimer = nullptr;
 }
 
 void BandwidthMonitor::startMonitoring(std::shared_ptr<UsbDevice> device) {
     if (!device) return;
     
     // Check if already monitoring
-    if (d->monitoringTimers.find(device.get()) != d->monitoringTimers.end()) {
+    if (d->samplingSources.find(device.get()) != d->samplingSources.end()) {
         return;
     }
     
-    // Create timer for periodic updates
-    QTimer* timer = new QTimer(this);
-    timer->setInterval(100); // Update every 100ms for smoother readings
+    // Sampled adaptively: quick while traffic flows, backing off when idle
+    auto* sampler = d->samplingScheduler(this);
+    d->samplingSources[device.get()] = sampler->add(
+        device.get(), std::chrono::milliseconds(SAMPLING_MIN_INTERVAL * 2),
+        [this, dev = device.get()]() { return d->updateDeviceBandwidth(dev); });
     
-    connect(timer, &QTimer::timeout, [this, dev = device.get()]() {
-        d->updateDeviceBandwidth(dev);
-    });
+    if (!d->reserveDefaults(device.get())) {
+        emit errorOccurred("Not enough periodic bandwidth for " + device->description());
+    }
     
-    d->monitoringTimers[device.get()] = timer;
-    timer->start();
+    // Transfers made through our own handle are counted as they complete
+    device->setTransferObserver([this, dev = device.get()](uint8_t endpoint, uint64_t bytes) {
+        d->recordPooled(dev, endpoint, bytes);
+    });
+    d->observed[device.get()] = device;
     
-    // Initialize stats
+    // Initialize stats, keeping any history from a suspended session
     std::lock_guard<std::mutex> lock(d->statsMutex);
-    d->deviceStats[device.get()] = TransferStats{};
+    d->ledger.open(device.get());
 }
 
 void BandwidthMonitor::stopMonitoring(std::shared_ptr<UsbDevice> device) {
     if (!device) return;
     
-    auto it = d->monitoringTimers.find(device.get());
-    if (it != d->monitoringTimers.end()) {
-        it->second->stop();
-        delete it->second;
-        d->monitoringTimers.erase(it);
-    }
+    suspendMonitoring(device);
     
-    {
-        std::lock_guard<std::mutex> lock(d->statsMutex);
-        d->deviceStats.erase(device.get());
+    std::lock_guard<std::mutex> lock(d->statsMutex);
+    d->ledger.erase(device.get());
+    d->captureFed.erase(device.get());
+}
+
+void BandwidthMonitor::suspendMonitoring(std::shared_ptr<UsbDevice> device) {
+    if (!device) return;
+    
+    auto it = d->samplingSources.find(device.get());
+    if (it != d->samplingSources.end()) {
+        d->sampler->remove(it->second);
+        d->samplingSources.erase(it);
     }
+    
+    // Once this returns the pool no longer calls into us for the device
+    device->setTransferObserver(nullptr);
+    d->observed.erase(device.get());
+    
+    // A departed device holds no bus time
+    std::lock_guard<std::mutex> lock(d->periodicMutex);
+    d->periodic.release(device->stableId());
 }
 
 BandwidthStats BandwidthMonitor::getDeviceStats(const UsbDevice* device) const {
     BandwidthStats stats{};
     std::lock_guard<std::mutex> lock(d->statsMutex);
     
-    auto it = d->deviceStats.find(device);
-    if (it != d->deviceStats.end()) {
-        const auto& transferStats = it->second;
-        stats.bytesRead = transferStats.totalBytesRead;
-        stats.bytesWritten = transferStats.totalBytesWritten;
-        stats.readSpeed = d->calculateSpeed(transferStats.readHistory);
-        stats.writeSpeed = d->calculateSpeed(transferStats.writeHistory);
+    if (d->ledger.contains(device)) {
+        stats = d->ledger.collect(device, std::chrono::steady_clock::now());
         if (device->nativeDevice()) {
             stats.speedClass = libusb_get_device_speed(device->nativeDevice());
         }
@@ -172,12 +284,76 @@ BandwidthStats BandwidthMonitor::getDeviceStats(const UsbDevice* device) const {
     return stats;
 }
 
-void BandwidthMonitor::resetStats(const UsbDevice* device) {
+void BandwidthMonitor::recordTransfer(const UsbDevice* device, uint8_t endpoint, uint64_t bytes) {
+    if (!device) return;
+    
+    std::lock_guard<std::mutex> lock(d->statsMutex);
+    auto config = device->configDescriptor();
+    d->ledger.record(device, config.get(), endpoint, bytes, std::chrono::steady_clock::now());
+}
+
+void BandwidthMonitor::setCaptureFeed(const UsbDevice* device, bool enabled) {
+    if (!device) return;
+    
     std::lock_guard<std::mutex> lock(d->statsMutex);
-    auto it = d->deviceStats.find(device);
-    if (it != d->deviceStats.end()) {
-        it->second = TransferStats{};
+    if (enabled) {
+        d->captureFed.insert(device);
+    } else {
+        d->captureFed.erase(device);
+    }
+}
+
+bool BandwidthMonitor::canActivate(const UsbDevice* device, int interfaceNumber,
+                                   int altSetting) const {
+    if (!device || !device->nativeDevice()) return false;
+    
+    auto config = device->configDescriptor();
+    const libusb_interface_descriptor* setting =
+        Private::findAltSetting(config.get(), interfaceNumber, altSetting);
+    if (!setting) return false;
+    
+    auto target = Private::periodicTarget(device);
+    std::lock_guard<std::mutex> lock(d->periodicMutex);
+    return d->periodic.canFit(target.busKey, target.speed, device->stableId(), interfaceNumber,
+                              Private::periodicEndpoints(setting, target.speed));
+}
+
+bool BandwidthMonitor::activateAltSetting(const UsbDevice* device, int interfaceNumber,
+                                          int altSetting) {
+    if (!device || !device->nativeDevice()) return false;
+    
+    auto config = device->configDescriptor();
+    const libusb_interface_descriptor* setting =
+        Private::findAltSetting(config.get(), interfaceNumber, altSetting);
+    if (!setting) {
+        emit errorOccurred("No altsetting " + std::to_string(altSetting) +
+                          " on interface " + std::to_string(interfaceNumber));
+        return false;
+    }
+    
+    auto target = Private::periodicTarget(device);
+    BusReservation usage;
+    {
+        std::lock_guard<std::mutex> lock(d->periodicMutex);
+        if (!d->periodic.reserve(target.busKey, target.speed, device->stableId(), interfaceNumber,
+                                 Private::periodicEndpoints(setting, target.speed))) {
+            return false;
+        }
+        usage = d->periodic.usage(target.busKey);
     }
+    
+    emit periodicBandwidthChanged(usage);
+    return true;
+}
+
+std::vector<BusReservation> BandwidthMonitor::periodicReservations() const {
+    std::lock_guard<std::mutex> lock(d->periodicMutex);
+    return d->periodic.allUsage();
+}
+
+void BandwidthMonitor::resetStats(const UsbDevice* device) {
+    std::lock_guard<std::mutex> lock(d->statsMutex);
+    d->ledger.reset(device);
 }
 
 }
@@ -1,11 +1,15 @@
 #pragma once
 #include <QObject>
+#include <cstdint>
 #include <memory>
 #include "usb-monitor/Types.hpp"
+#include "BusBandwidthScheduler.hpp"
+#include <vector>
 
 namespace usb_monitor {
 
 class UsbDevice;
+class SamplingScheduler;
 
 class BandwidthMonitor : public QObject {
     Q_OBJECT
@@ -14,14 +18,39 @@ public:
     explicit BandwidthMonitor(QObject* parent = nullptr);
     ~BandwidthMonitor();
 
+    // Shares one adaptive sampling tick with other monitors. Without one a
+    // private scheduler is used. Must be set before monitoring starts.
+    void setSamplingScheduler(SamplingScheduler* scheduler);
+    
     void startMonitoring(std::shared_ptr<UsbDevice> device);
     void stopMonitoring(std::shared_ptr<UsbDevice> device);
+    // Stops sampling but keeps history for a later startMonitoring()
+    void suspendMonitoring(std::shared_ptr<UsbDevice> device);
+    
+    // Counts a completed transfer against its endpoint and interface; safe
+    // to call from any thread. Transfers through a monitored device's own
+    // handle are counted without this.
+    void recordTransfer(const UsbDevice* device, uint8_t endpoint, uint64_t bytes);
+    
+    // While usbmon feeds a device's traffic in through recordTransfer(), its
+    // own-handle transfers are already part of that and are not counted
+    void setCaptureFeed(const UsbDevice* device, bool enabled);
     
     BandwidthStats getDeviceStats(const UsbDevice* device) const;
     void resetStats(const UsbDevice* device);
     
+    // Periodic (isochronous/interrupt) bandwidth. Devices reserve their
+    // default altsettings when monitoring starts and release them when it
+    // stops. canActivate() predicts whether switching an interface to an
+    // altsetting would fit its bus; activateAltSetting() records the switch
+    // and should be called before the device is actually switched.
+    bool canActivate(const UsbDevice* device, int interfaceNumber, int altSetting) const;
+    bool activateAltSetting(const UsbDevice* device, int interfaceNumber, int altSetting);
+    std::vector<BusReservation> periodicReservations() const;
+    
 signals:
     void statsUpdated(const UsbDevice* device, const BandwidthStats& stats);
+    void periodicBandwidthChanged(const BusReservation& usage);
     void errorOccurred(const std::string& error);
 
 private:
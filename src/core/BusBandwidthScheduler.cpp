@@ -0,0 +1,246 @@
+#include "BusBandwidthScheduler.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr double HOST_DELAY = 1000.0;     // ns, host controller turnaround
+constexpr double HUB_LS_SETUP = 333.0;    // ns
+
+// Worst-case bit stuffing, USB 2.0 section 5.11.3
+double bitStuffTime(double bytes) {
+    return std::floor(3.167 + 7.0 * 8.0 * bytes / 6.0);
+}
+
+bool isSuperSpeed(BusSpeed speed) {
+    return speed == BusSpeed::Super || speed == BusSpeed::SuperPlus;
+}
+
+bool isMicroframed(BusSpeed speed) {
+    return speed == BusSpeed::High || isSuperSpeed(speed);
+}
+
+} // namespace
+
+double BusBandwidthScheduler::periodicBudget(BusSpeed speed) {
+    switch (speed) {
+    case BusSpeed::Low:
+    case BusSpeed::Full:
+        return 1000000.0 * 0.9;   // 90% of a 1 ms frame
+    case BusSpeed::High:
+        return 125000.0 * 0.8;    // 80% of a 125 us microframe
+    case BusSpeed::Super:
+    case BusSpeed::SuperPlus:
+        return 125000.0 * 0.9;    // 90% of a service interval
+    }
+    return 0.0;
+}
+
+double BusBandwidthScheduler::busTime(BusSpeed speed, const PeriodicEndpoint& endpoint, bool input) {
+    double packets = std::max<uint32_t>(endpoint.packetsPerInterval, 1);
+    double bytes = endpoint.bytesPerInterval / packets;
+    
+    switch (speed) {
+    case BusSpeed::Low: {
+        double base = input ? 64060.0 : 64107.0;
+        double perBit = input ? 676.67 : 667.0;
+        return packets * (base + 2 * HUB_LS_SETUP + perBit * bitStuffTime(bytes) + HOST_DELAY);
+    }
+    case BusSpeed::Full: {
+        double base = endpoint.isochronous ? (input ? 7268.0 : 6265.0) : 9107.0;
+        return packets * (base + 83.54 * bitStuffTime(bytes) + HOST_DELAY);
+    }
+    case BusSpeed::High: {
+        double overhead = (endpoint.isochronous ? 38.0 : 55.0) * 8 * 2.083;
+        return packets * (overhead + 2.083 * bitStuffTime(bytes) + HOST_DELAY);
+    }
+    case BusSpeed::Super:
+    case BusSpeed::SuperPlus: {
+        // 8b/10b at 5 Gb/s is 2 ns per byte; 128b/132b at 10 Gb/s about 0.825.
+        // Each packet carries a 20-byte header plus framing.
+        double nsPerByte = speed == BusSpeed::Super ? 2.0 : 0.825;
+        return (endpoint.bytesPerInterval + packets * 32.0) * nsPerByte + HOST_DELAY;
+    }
+    }
+    return 0.0;
+}
+
+uint32_t BusBandwidthScheduler::horizon(BusSpeed speed) {
+    return isMicroframed(speed) ? MICROFRAME_HORIZON : FRAME_HORIZON;
+}
+
+uint32_t BusBandwidthScheduler::schedulePeriod(BusSpeed speed, uint32_t interval) {
+    // Host controllers round periods down to a power of two; longer ones
+    // than the horizon are scheduled as if they were the horizon
+    uint32_t period = 1;
+    while (period * 2 <= std::max<uint32_t>(interval, 1)) {
+        period *= 2;
+    }
+    return std::min(period, horizon(speed));
+}
+
+bool BusBandwidthScheduler::place(const std::vector<double>& load, double budget, uint32_t period,
+                                  double time, uint32_t& phase) {
+    double bestPeak = budget + 1.0;
+    for (uint32_t candidate = 0; candidate < period; ++candidate) {
+        double peak = 0.0;
+        for (size_t slot = candidate; slot < load.size(); slot += period) {
+            peak = std::max(peak, load[slot]);
+        }
+        if (peak + time <= budget && peak < bestPeak) {
+            bestPeak = peak;
+            phase = candidate;
+        }
+    }
+    return bestPeak <= budget;
+}
+
+void BusBandwidthScheduler::apply(std::vector<double>& load, const Placement& placement,
+                                  double sign) {
+    for (size_t slot = placement.phase; slot < load.size(); slot += placement.period) {
+        load[slot] += sign * placement.time;
+    }
+}
+
+bool BusBandwidthScheduler::tryPlace(Bus& bus, BusSpeed speed, const std::string& busKey,
+                                     const std::vector<PeriodicEndpoint>& endpoints,
+                                     std::vector<Placement>& placements) const {
+    double budget = periodicBudget(bus.speed);
+    
+    // Place the most frequent, then the largest, endpoints first
+    std::vector<const PeriodicEndpoint*> order;
+    for (const auto& endpoint : endpoints) {
+        order.push_back(&endpoint);
+    }
+    std::sort(order.begin(), order.end(), [](const auto* a, const auto* b) {
+        if (a->interval != b->interval) return a->interval < b->interval;
+        return a->bytesPerInterval > b->bytesPerInterval;
+    });
+    
+    for (const auto* endpoint : order) {
+        Placement placement;
+        placement.busKey = busKey;
+        placement.period = schedulePeriod(bus.speed, endpoint->interval);
+        placement.time = busTime(speed, *endpoint, endpoint->address & 0x80);
+        if (!place(bus.load, budget, placement.period, placement.time, placement.phase)) {
+            for (auto it = placements.rbegin(); it != placements.rend(); ++it) {
+                apply(bus.load, *it, -1.0);
+            }
+            placements.clear();
+            return false;
+        }
+        apply(bus.load, placement, 1.0);
+        placements.push_back(placement);
+    }
+    return true;
+}
+
+bool BusBandwidthScheduler::canFit(const std::string& busKey, BusSpeed speed,
+                                   const std::string& owner, int interfaceNumber,
+                                   const std::vector<PeriodicEndpoint>& endpoints) const {
+    // Work on a copy of the bus with this interface's current share removed
+    Bus bus;
+    auto busIt = buses.find(busKey);
+    if (busIt != buses.end()) {
+        bus = busIt->second;
+    } else {
+        bus.speed = speed;
+        bus.load.assign(horizon(speed), 0.0);
+    }
+    
+    auto it = reservations.find({owner, interfaceNumber});
+    if (it != reservations.end()) {
+        for (const auto& placement : it->second) {
+            if (placement.busKey == busKey) {
+                apply(bus.load, placement, -1.0);
+            }
+        }
+    }
+    
+    std::vector<Placement> placements;
+    return tryPlace(bus, speed, busKey, endpoints, placements);
+}
+
+bool BusBandwidthScheduler::reserve(const std::string& busKey, BusSpeed speed,
+                                    const std::string& owner, int interfaceNumber,
+                                    const std::vector<PeriodicEndpoint>& endpoints) {
+    if (!canFit(busKey, speed, owner, interfaceNumber, endpoints)) {
+        return false;
+    }
+    
+    release(owner, interfaceNumber);
+    if (endpoints.empty()) {
+        return true;
+    }
+    
+    auto& bus = buses[busKey];
+    if (bus.load.empty()) {
+        bus.speed = speed;
+        bus.load.assign(horizon(speed), 0.0);
+    }
+    
+    std::vector<Placement> placements;
+    tryPlace(bus, speed, busKey, endpoints, placements);
+    bus.endpointCount += placements.size();
+    reservations[{owner, interfaceNumber}] = std::move(placements);
+    return true;
+}
+
+void BusBandwidthScheduler::release(const std::string& owner, int interfaceNumber) {
+    auto it = reservations.find({owner, interfaceNumber});
+    if (it == reservations.end()) return;
+    
+    for (const auto& placement : it->second) {
+        auto busIt = buses.find(placement.busKey);
+        if (busIt == buses.end()) continue;
+        
+        apply(busIt->second.load, placement, -1.0);
+        if (--busIt->second.endpointCount == 0) {
+            buses.erase(busIt);
+        }
+    }
+    reservations.erase(it);
+}
+
+void BusBandwidthScheduler::release(const std::string& owner) {
+    auto it = reservations.lower_bound({owner, INT_MIN});
+    while (it != reservations.end() && it->first.first == owner) {
+        int interfaceNumber = it->first.second;
+        ++it;
+        release(owner, interfaceNumber);
+    }
+}
+
+BusReservation BusBandwidthScheduler::usage(const std::string& busKey) const {
+    BusReservation usage;
+    usage.busKey = busKey;
+    
+    auto it = buses.find(busKey);
+    if (it == buses.end()) return usage;
+    
+    const auto& bus = it->second;
+    usage.speed = bus.speed;
+    usage.budget = periodicBudget(bus.speed);
+    usage.endpointCount = bus.endpointCount;
+    for (double load : bus.load) {
+        usage.peakLoad = std::max(usage.peakLoad, load);
+        usage.averageLoad += load;
+    }
+    if (!bus.load.empty()) {
+        usage.averageLoad /= bus.load.size();
+    }
+    return usage;
+}
+
+std::vector<BusReservation> BusBandwidthScheduler::allUsage() const {
+    std::vector<BusReservation> result;
+    for (const auto& [busKey, bus] : buses) {
+        result.push_back(usage(busKey));
+    }
+    return result;
+}
+
+} // namespace usb_monitor
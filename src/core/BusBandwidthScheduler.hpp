@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+enum class BusSpeed { Low, Full, High, Super, SuperPlus };
+
+// One periodic (isochronous or interrupt) endpoint as the host schedules it
+struct PeriodicEndpoint {
+    uint8_t address{0};
+    bool isochronous{false};
+    uint32_t bytesPerInterval{0}; // Payload per service interval, all transactions
+    uint32_t packetsPerInterval{1};
+    uint32_t interval{1};         // Frames (LS/FS) or microframes (HS/SS)
+};
+
+struct BusReservation {
+    std::string busKey;
+    BusSpeed speed{BusSpeed::Full};
+    double budget{0.0};           // Periodic ns available per (micro)frame
+    double peakLoad{0.0};         // ns in the busiest (micro)frame
+    double averageLoad{0.0};      // ns per (micro)frame
+    size_t endpointCount{0};
+    
+    double peakPercent() const { return budget > 0 ? peakLoad * 100.0 / budget : 0.0; }
+};
+
+// Periodic bandwidth bookkeeping per bus, following the USB 2.0 (5.11.3)
+// bus time formulas and the 90% (FS/LS) and 80% (HS) periodic limits, and
+// USB 3.x wBytesPerInterval with a 90% limit. Each endpoint is placed at
+// the phase that keeps the busiest (micro)frame lowest, as host controller
+// drivers do, so a prediction accounts for collisions, not just averages.
+//
+// Reservations are owned by (owner, interface), so an altsetting change
+// replaces just that interface's endpoints and hotplug touches only the
+// device that came or went.
+class BusBandwidthScheduler {
+public:
+    // Slots scheduled per bus: 32 frames, or 32 frames of 8 microframes
+    static constexpr uint32_t FRAME_HORIZON = 32;
+    static constexpr uint32_t MICROFRAME_HORIZON = FRAME_HORIZON * 8;
+    
+    // Would these endpoints fit if they replaced the current reservation
+    // of owner/interface?
+    bool canFit(const std::string& busKey, BusSpeed speed, const std::string& owner,
+                int interfaceNumber, const std::vector<PeriodicEndpoint>& endpoints) const;
+    
+    // Replaces the reservation of owner/interface; on false nothing changed
+    bool reserve(const std::string& busKey, BusSpeed speed, const std::string& owner,
+                 int interfaceNumber, const std::vector<PeriodicEndpoint>& endpoints);
+    void release(const std::string& owner, int interfaceNumber);
+    void release(const std::string& owner);
+    
+    BusReservation usage(const std::string& busKey) const;
+    std::vector<BusReservation> allUsage() const;
+    
+    // Time one service interval of the endpoint takes on the wire, in ns
+    static double busTime(BusSpeed speed, const PeriodicEndpoint& endpoint, bool input);
+    static double periodicBudget(BusSpeed speed);
+
+private:
+    struct Placement {
+        std::string busKey;
+        uint32_t phase{0};
+        uint32_t period{1};
+        double time{0.0};
+    };
+    
+    struct Bus {
+        BusSpeed speed{BusSpeed::Full};
+        std::vector<double> load;   // ns reserved in each (micro)frame
+        size_t endpointCount{0};
+    };
+    
+    using OwnerKey = std::pair<std::string, int>;
+    
+    static uint32_t horizon(BusSpeed speed);
+    static uint32_t schedulePeriod(BusSpeed speed, uint32_t interval);
+    
+    // Best phase for the endpoint, or false if none stays in budget
+    static bool place(const std::vector<double>& load, double budget, uint32_t period,
+                      double time, uint32_t& phase);
+    static void apply(std::vector<double>& load, const Placement& placement, double sign);
+    
+    bool tryPlace(Bus& bus, BusSpeed speed, const std::string& busKey,
+                  const std::vector<PeriodicEndpoint>& endpoints,
+                  std::vector<Placement>& placements) const;
+    
+    std::map<std::string, Bus> buses;
+    std::map<OwnerKey, std::vector<Placement>> reservations;
+};
+
+} // namespace usb_monitor
@@ -2,12 +2,23 @@
 #include "UsbDevice.hpp"
 #include "PowerManager.hpp"
 #include "BandwidthMonitor.hpp"
+#include "WorkerPool.hpp"
+#include "IdentityCache.hpp"
+#include "Logger.hpp"
 #include <usb-monitor/Constants.hpp>
+#include <QCoreApplication>
 #include <QTimer>
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <atomic>
 #include <map>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <mutex>
+#include <sys/time.h>
 
 namespace usb_monitor {
 
@@ -16,12 +27,66 @@ public:
     libusb_context* context{nullptr};
     std::map<std::string, std::shared_ptr<UsbDevice>> devices;
     std::mutex devicesMutex;
+    
+    // Readers take the current snapshot, and with it its generation, with
+    // a single atomic load; writers republish it under devicesMutex after
+    // every registry change
+    std::shared_ptr<const DeviceSnapshot> snapshot{std::make_shared<DeviceSnapshot>()};
+    
+    void publishSnapshot() {
+        auto next = std::make_shared<DeviceSnapshot>();
+        // Writers are serialized, so the current generation cannot move here
+        next->generation = snapshot->generation + 1;
+        next->devices.reserve(devices.size());
+        for (const auto& [_, device] : devices) {
+            next->devices.push_back(device);
+        }
+        
+        std::atomic_store_explicit(&snapshot,
+                                   std::shared_ptr<const DeviceSnapshot>(std::move(next)),
+                                   std::memory_order_release);
+    }
     QTimer* pollTimer{nullptr};
+    QTimer* debounceTimer{nullptr};
+    HotplugDebouncer debouncer;
+    bool enumerating{false};
+    
+    // One adaptive tick samples every device for both monitors; declared
+    // ahead of them so it outlives their samplers
+    SamplingScheduler sampler;
+    QTimer* samplingTimer{nullptr};
     std::unique_ptr<PowerManager> powerMgr;
     std::unique_ptr<BandwidthMonitor> bwMonitor;
     bool hotplugSupported{false};
     libusb_hotplug_callback_handle hotplugHandle;
-
+    
+    // Drives hotplug callbacks and asynchronous transfer completions
+    std::thread eventThread;
+    std::atomic<bool> handlingEvents{false};
+    
+    void eventLoop() {
+        while (handlingEvents) {
+            timeval timeout{0, 100000};
+            libusb_handle_events_timeout_completed(context, &timeout, nullptr);
+        }
+    }
+    
+    // Arrival pipeline: descriptor reads and arrival stages run on the pool,
+    // finished devices wait in readyArrivals until the whole burst is done
+    std::unique_ptr<WorkerPool> arrivalPool;
+    std::vector<std::function<void(UsbDevice*)>> arrivalStages;
+    std::vector<std::pair<std::string, std::shared_ptr<UsbDevice>>> readyArrivals;
+    std::set<std::string> pendingArrivals;
+    std::set<std::string> cancelledArrivals;
+    std::function<bool(const std::shared_ptr<UsbDevice>&)> admissionCheck;
+    std::set<std::string> refused;      // Deauthorized, still on the bus
+    size_t arrivalsInFlight{0};
+    std::chrono::steady_clock::time_point batchStart;
+    ArrivalBatchStats lastBatch;
+    
+    // Logical devices that left recently, for re-plugs to pick up again
+    IdentityCache departed;
+    
     // Hotplug callback wrapper
     static int LIBUSB_CALL hotplugCallback(libusb_context*, 
                                          libusb_device* device,
@@ -29,9 +94,9 @@ public:
                                          void* user_data) {
         auto manager = static_cast<DeviceManager*>(user_data);
         if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
-            manager->handleDeviceArrival(device);
+            manager->queueHotplugEvent(device, true);
         } else if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
-            manager->handleDeviceRemoval(device);
+            manager->queueHotplugEvent(device, false);
         }
         return 0;
     }
@@ -50,11 +115,22 @@ DeviceManager::DeviceManager(QObject* parent)
     // Create managers
     d->powerMgr = std::make_unique<PowerManager>(d->context, this);
     d->bwMonitor = std::make_unique<BandwidthMonitor>();
+    d->powerMgr->setSamplingScheduler(&d->sampler);
+    d->bwMonitor->setSamplingScheduler(&d->sampler);
+    d->arrivalPool = std::make_unique<WorkerPool>(MAX_ARRIVAL_WORKERS);
     
     // Setup polling timer as fallback
     d->pollTimer = new QTimer(this);
     connect(d->pollTimer, &QTimer::timeout, this, &DeviceManager::pollDevices);
     
+    d->samplingTimer = new QTimer(this);
+    connect(d->samplingTimer, &QTimer::timeout, this, [this]() { d->sampler.tick(); });
+    d->samplingTimer->start(SAMPLING_TICK);
+    
+    // Settles debounced hotplug events; only runs while ports are pending
+    d->debounceTimer = new QTimer(this);
+    connect(d->debounceTimer, &QTimer::timeout, this, &DeviceManager::settleHotplugEvents);
+    
     // Try to setup hotplug support
     setupHotplugSupport();
     
@@ -62,6 +138,9 @@ DeviceManager::DeviceManager(QObject* parent)
     if (!d->hotplugSupported) {
         d->pollTimer->start(POLLING_INTERVAL);
     }
+    
+    d->handlingEvents = true;
+    d->eventThread = std::thread([this]() { d->eventLoop(); });
 }
 
 DeviceManager::~DeviceManager() {
@@ -70,14 +149,49 @@ DeviceManager::~DeviceManager() {
         d->pollTimer->stop();
     }
     
+    if (d->debounceTimer) {
+        d->debounceTimer->stop();
+    }
+    
+    if (d->samplingTimer) {
+        d->samplingTimer->stop();
+    }
+    
     if (d->hotplugSupported) {
         libusb_hotplug_deregister_callback(d->context, d->hotplugHandle);
     }
     
-    // Cleanup devices
+    for (const auto& port : d->debouncer.takeAll()) {
+        if (port.departed) libusb_unref_device(port.departed);
+        if (port.arrived) libusb_unref_device(port.arrived);
+    }
+    
+    // Drain the arrival pipeline before the context goes away, along with
+    // the results it queued for us
+    d->arrivalPool.reset();
+    QCoreApplication::removePostedEvents(this);
+    
+    // Cleanup devices. Closing them waits for their transfers, so the
+    // event thread must still be running here.
     {
-        std::lock_guard<std::mutex> lock(d->devicesMutex);
-        d->devices.clear();
+        decltype(d->readyArrivals) readyArrivals;
+        std::vector<std::shared_ptr<UsbDevice>> departed;
+        decltype(d->devices) devices;
+        {
+            std::lock_guard<std::mutex> lock(d->devicesMutex);
+            readyArrivals.swap(d->readyArrivals);
+            departed = d->departed.takeAll();
+            devices.swap(d->devices);
+            d->publishSnapshot();
+        }
+        for (const auto& [_, device] : devices) {
+            device->cancelTransfers();
+        }
+    }
+    
+    d->handlingEvents = false;
+    if (d->eventThread.joinable()) {
+        d->eventThread.join();
     }
     
     // Cleanup libusb
@@ -88,30 +202,71 @@ DeviceManager::~DeviceManager() {
 }
 
 std::vector<std::shared_ptr<UsbDevice>> DeviceManager::getConnectedDevices() const {
-    std::vector<std::shared_ptr<UsbDevice>> result;
-    std::lock_guard<std::mutex> lock(d->devicesMutex);
-    
-    result.reserve(d->devices.size());
-    for (const auto& [_, device] : d->devices) {
-        result.push_back(device);
-    }
-    
-    return result;
+    return deviceSnapshot()->devices;
+}
+
+std::shared_ptr<const DeviceSnapshot> DeviceManager::deviceSnapshot() const {
+    return std::atomic_load_explicit(&d->snapshot, std::memory_order_acquire);
+}
+
+uint64_t DeviceManager::generation() const {
+    return deviceSnapshot()->generation;
 }
 
 PowerManager* DeviceManager::powerManager() const {
     return d->powerMgr.get();
 }
 
+SamplingScheduler* DeviceManager::samplingScheduler() const {
+    return &d->sampler;
+}
+
 BandwidthMonitor* DeviceManager::bandwidthMonitor() const {
     return d->bwMonitor.get();
 }
 
+void DeviceManager::registerArrivalStage(std::function<void(UsbDevice*)> stage) {
+    std::lock_guard<std::mutex> lock(d->devicesMutex);
+    d->arrivalStages.push_back(std::move(stage));
+}
+
+void DeviceManager::setAdmissionCheck(std::function<bool(const std::shared_ptr<UsbDevice>&)> check) {
+    std::lock_guard<std::mutex> lock(d->devicesMutex);
+    d->admissionCheck = std::move(check);
+}
+
+void DeviceManager::processPendingArrivals() {
+    if (d->arrivalPool) {
+        d->arrivalPool->waitIdle();
+    }
+    commitArrivals();
+}
+
+ArrivalBatchStats DeviceManager::lastArrivalBatch() const {
+    std::lock_guard<std::mutex> lock(d->devicesMutex);
+    return d->lastBatch;
+}
+
+void DeviceManager::setDebounceWindow(std::chrono::milliseconds window) {
+    d->debouncer.setWindow(window);
+}
+
+std::chrono::milliseconds DeviceManager::debounceWindow() const {
+    return d->debouncer.window();
+}
+
+std::vector<PortHealth> DeviceManager::portHealth() const {
+    return d->debouncer.portHealth();
+}
+
 void DeviceManager::setupHotplugSupport() {
     if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
         return;
     }
     
+    // Devices already present are reported synchronously during
+    // registration and skip the debouncer
+    d->enumerating = true;
     int result = libusb_hotplug_register_callback(
         d->context,
         static_cast<libusb_hotplug_event>(
@@ -125,6 +280,7 @@ void DeviceManager::setupHotplugSupport() {
         this,
         &d->hotplugHandle
     );
+    d->enumerating = false;
     
     if (result == LIBUSB_SUCCESS) {
         d->hotplugSupported = true;
@@ -141,85 +297,420 @@ void DeviceManager::pollDevices() {
     }
     
     // Track current devices to detect removals
-    std::map<std::string, bool> currentDevices;
+    std::map<std::string, libusb_device*> currentDevices;
     {
         std::lock_guard<std::mutex> lock(d->devicesMutex);
-        for (const auto& [id, _] : d->devices) {
-            currentDevices[id] = false;
+        for (const auto& [id, device] : d->devices) {
+            currentDevices[id] = nullptr;
         }
     }
     
-    // Check for new/existing devices
+    // Queue new devices; the arrival pipeline drops ones it already knows
     for (ssize_t i = 0; i < count; i++) {
         libusb_device* device = list[i];
         std::string id = getDeviceIdentifier(device);
         
-        std::lock_guard<std::mutex> lock(d->devicesMutex);
-        if (d->devices.find(id) == d->devices.end()) {
-            // New device
+        auto it = currentDevices.find(id);
+        if (it == currentDevices.end()) {
             handleDeviceArrival(device);
         }
-        currentDevices[id] = true;
+        currentDevices[id] = device;
     }
     
     // Check for removed devices
-    for (const auto& [id, present] : currentDevices) {
-        if (!present) {
-            std::lock_guard<std::mutex> lock(d->devicesMutex);
+    std::vector<std::shared_ptr<UsbDevice>> removed;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        std::erase_if(d->refused, [&currentDevices](const std::string& id) {
+            return currentDevices.find(id) == currentDevices.end();
+        });
+        for (const auto& [id, present] : currentDevices) {
+            if (present) continue;
             auto it = d->devices.find(id);
             if (it != d->devices.end()) {
-                handleDeviceRemoval(it->second->nativeDevice());
+                removed.push_back(it->second);
             }
         }
     }
+    for (const auto& device : removed) {
+        handleDeviceRemoval(device->nativeDevice());
+    }
     
     libusb_free_device_list(list, 1);
 }
 
+void DeviceManager::queueHotplugEvent(libusb_device* device, bool arrived) {
+    auto window = d->debouncer.window();
+    if (d->enumerating || window.count() == 0) {
+        if (arrived) {
+            handleDeviceArrival(device);
+            return;
+        }
+        
+        // Removal stops QTimer-based monitors, so it runs on our thread
+        libusb_ref_device(device);
+        QMetaObject::invokeMethod(this, [this, device]() {
+            handleDeviceRemoval(device);
+            libusb_unref_device(device);
+        }, Qt::QueuedConnection);
+        return;
+    }
+    
+    // The debouncer holds a reference until the port settles
+    libusb_ref_device(device);
+    std::vector<libusb_device*> displaced;
+    bool opened = d->debouncer.recordEvent(UsbDevice::portPathOf(device), device, arrived,
+                                           std::chrono::steady_clock::now(), displaced);
+    for (auto* dev : displaced) {
+        libusb_unref_device(dev);
+    }
+    
+    if (opened) {
+        auto interval = std::max<int>(10, static_cast<int>(window.count() / 4));
+        QMetaObject::invokeMethod(this, [this, interval]() {
+            if (!d->debounceTimer->isActive()) {
+                d->debounceTimer->start(interval);
+            }
+        }, Qt::QueuedConnection);
+    }
+}
+
+void DeviceManager::settleHotplugEvents() {
+    for (const auto& port : d->debouncer.takeSettled(std::chrono::steady_clock::now())) {
+        if (port.departed && port.arrived) {
+            handleReenumeration(port.departed, port.arrived);
+        } else if (port.departed) {
+            handleDeviceRemoval(port.departed);
+        } else if (port.arrived) {
+            handleDeviceArrival(port.arrived);
+        }
+        
+        if (port.flaps > 0) {
+            emit portFlapping(port.portPath, port.flaps);
+        }
+        
+        if (port.departed) libusb_unref_device(port.departed);
+        if (port.arrived) libusb_unref_device(port.arrived);
+    }
+    
+    if (!d->debouncer.hasPending()) {
+        d->debounceTimer->stop();
+    }
+}
+
+void DeviceManager::handleReenumeration(libusb_device* departed, libusb_device* arrived) {
+    std::string oldId = getDeviceIdentifier(departed);
+    std::string newId = getDeviceIdentifier(arrived);
+    
+    std::shared_ptr<UsbDevice> existing;
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        auto it = d->devices.find(oldId);
+        if (it != d->devices.end()) {
+            existing = it->second;
+        }
+        known = d->devices.find(newId) != d->devices.end() ||
+                d->pendingArrivals.find(newId) != d->pendingArrivals.end() ||
+                d->refused.find(newId) != d->refused.end();
+        
+        // Pending like any arrival, so a removal meanwhile cancels it
+        if (existing && !known) {
+            d->pendingArrivals.insert(newId);
+            d->cancelledArrivals.erase(newId);
+        }
+    }
+    
+    if (!existing || known) {
+        handleDeviceRemoval(departed);
+        handleDeviceArrival(arrived);
+        return;
+    }
+    
+    // VID:PID alone would take a different unit of the same model, or the
+    // same one after a firmware update, for the old device. The stable id
+    // also covers serial and descriptor hash (the port is the same here).
+    // Reading them blocks, so the probe runs on the arrival pool.
+    auto probe = std::make_shared<UsbDevice>(arrived, d->context);
+    d->arrivalPool->submit([this, existing, probe, oldId, newId]() {
+        probe->loadDescriptors();
+        bool sameDevice = probe->stableId() == existing->stableId();
+        
+        QMetaObject::invokeMethod(this, [this, existing, probe, oldId, newId, sameDevice]() {
+            finishReenumeration(existing, probe, oldId, newId, sameDevice);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DeviceManager::finishReenumeration(const std::shared_ptr<UsbDevice>& existing,
+                                        const std::shared_ptr<UsbDevice>& probe,
+                                        const std::string& oldId, const std::string& newId,
+                                        bool sameDevice) {
+    bool cancelled;
+    bool present;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->pendingArrivals.erase(newId);
+        cancelled = d->cancelledArrivals.erase(newId) > 0;
+        auto it = d->devices.find(oldId);
+        present = it != d->devices.end() && it->second == existing;
+    }
+    
+    // The new instance left again while it was probed
+    if (cancelled) {
+        removeDevice(oldId);
+        return;
+    }
+    
+    if (!sameDevice || !present) {
+        removeDevice(oldId);
+        handleDeviceArrival(probe->nativeDevice());
+        return;
+    }
+    
+    // Same port, same descriptors: the check sees what the new one would
+    if (!admit(existing)) {
+        removeDevice(oldId);
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->refused.insert(newId);
+        return;
+    }
+    
+    // Same device came back on the same port: keep its UsbDevice and
+    // monitors, only the registry key (bus address) changes. It is out of
+    // the published snapshot while rebind() replaces its descriptors.
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->devices.erase(oldId);
+        d->publishSnapshot();
+    }
+    existing->rebind(probe->nativeDevice());
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->devices[newId] = existing;
+        d->publishSnapshot();
+    }
+    
+    emit deviceReenumerated(existing);
+}
+
 void DeviceManager::handleDeviceArrival(libusb_device* device) {
     std::string id = getDeviceIdentifier(device);
     
-    // Check if device already exists
+    // Check if device already exists or is already being prepared
     {
         std::lock_guard<std::mutex> lock(d->devicesMutex);
-        if (d->devices.find(id) != d->devices.end()) {
+        if (d->devices.find(id) != d->devices.end() ||
+            d->pendingArrivals.find(id) != d->pendingArrivals.end() ||
+            d->refused.find(id) != d->refused.end()) {
             return;
         }
+        
+        d->pendingArrivals.insert(id);
+        d->cancelledArrivals.erase(id);
+        if (d->arrivalsInFlight++ == 0) {
+            d->batchStart = std::chrono::steady_clock::now();
+        }
     }
     
-    // Create new device object
+    // Keep the device alive until the worker has wrapped it
+    libusb_ref_device(device);
+    d->arrivalPool->submit([this, device, id]() {
+        prepareArrival(device, id);
+    });
+}
+
+void DeviceManager::prepareArrival(libusb_device* device, const std::string& id) {
+    // Runs on the arrival pool: everything here only reads descriptors
     auto usbDevice = std::make_shared<UsbDevice>(device, d->context);
+    libusb_unref_device(device);
     
-    // Start monitoring
-    d->powerMgr->startMonitoring(usbDevice);
-    d->bwMonitor->startMonitoring(usbDevice);
+    usbDevice->loadDescriptors();
     
-    // Add to devices map
+    std::vector<std::function<void(UsbDevice*)>> stages;
     {
         std::lock_guard<std::mutex> lock(d->devicesMutex);
-        d->devices[id] = usbDevice;
+        stages = d->arrivalStages;
+    }
+    for (const auto& stage : stages) {
+        stage(usbDevice.get());
     }
     
-    emit deviceAdded(usbDevice);
+    // Created on a worker thread; hand the QObject over to ours
+    usbDevice->moveToThread(thread());
+    
+    bool lastInBatch;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->readyArrivals.emplace_back(id, std::move(usbDevice));
+        lastInBatch = --d->arrivalsInFlight == 0;
+    }
+    
+    if (lastInBatch) {
+        QMetaObject::invokeMethod(this, [this]() { commitArrivals(); },
+                                  Qt::QueuedConnection);
+    }
 }
 
-void DeviceManager::handleDeviceRemoval(libusb_device* device) {
-    std::string id = getDeviceIdentifier(device);
+void DeviceManager::commitArrivals() {
+    std::vector<std::pair<std::string, std::shared_ptr<UsbDevice>>> candidates;
+    std::vector<std::shared_ptr<UsbDevice>> added;
+    std::vector<std::shared_ptr<UsbDevice>> expired;
+    std::vector<std::tuple<std::string, std::shared_ptr<UsbDevice>, std::shared_ptr<UsbDevice>>> reattached;
+    size_t fresh = 0;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        if (d->readyArrivals.empty()) return;
+        
+        // Identities past their retention must not be handed back
+        expired = d->departed.prune(std::chrono::steady_clock::now());
+        
+        for (auto& [id, usbDevice] : d->readyArrivals) {
+            // Left again before it was committed
+            if (d->cancelledArrivals.erase(id) > 0) {
+                d->pendingArrivals.erase(id);
+                continue;
+            }
+            
+            if (auto known = d->departed.take(usbDevice->stableId())) {
+                reattached.push_back({id, std::move(known), usbDevice});
+                continue;
+            }
+            
+            candidates.emplace_back(id, usbDevice);
+        }
+        d->readyArrivals.clear();
+    }
+    
+    // Known logical devices move onto the new libusb_device and the freshly
+    // built object is dropped. rebind() may wait for transfers, so it runs
+    // unlocked; the device is in no published snapshot until committed.
+    fresh = candidates.size();
+    for (auto& [id, known, usbDevice] : reattached) {
+        known->rebind(usbDevice->nativeDevice());
+        candidates.emplace_back(id, std::move(known));
+    }
+    reattached.clear();
+    
+    // Unlocked, as the check may log and emit. The candidates stay pending
+    // meanwhile, so a removal still cancels them.
+    std::vector<bool> admitted;
+    admitted.reserve(candidates.size());
+    for (const auto& [id, usbDevice] : candidates) {
+        admitted.push_back(admit(usbDevice));
+    }
+    
+    size_t reattachedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        added.reserve(candidates.size());
+        for (size_t i = 0; i < candidates.size(); i++) {
+            const auto& [id, usbDevice] = candidates[i];
+            d->pendingArrivals.erase(id);
+            if (d->cancelledArrivals.erase(id) > 0) continue;
+            
+            if (!admitted[i]) {
+                d->refused.insert(id);
+                continue;
+            }
+            
+            d->devices[id] = usbDevice;
+            added.push_back(usbDevice);
+            if (i >= fresh) reattachedCount++;
+        }
+        
+        if (!added.empty()) {
+            d->publishSnapshot();
+        }
+        
+        d->lastBatch.deviceCount = added.size();
+        d->lastBatch.reattachedCount = reattachedCount;
+        d->lastBatch.timeToAllReady = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - d->batchStart);
+    }
+    
+    // Refused known devices will not come back under this identity
+    for (size_t i = fresh; i < candidates.size(); i++) {
+        if (!admitted[i]) {
+            expired.push_back(candidates[i].second);
+        }
+    }
+    
+    for (const auto& device : expired) {
+        d->bwMonitor->stopMonitoring(device);
+    }
     
+    if (added.empty()) return;
+    
+    // Monitors own QTimers, so they are started here on the manager's thread
+    for (const auto& usbDevice : added) {
+        d->powerMgr->startMonitoring(usbDevice);
+        d->bwMonitor->startMonitoring(usbDevice);
+        emit deviceAdded(usbDevice);
+    }
+    
+    emit devicesAdded(added);
+    
+    LOG_DEBUG("Committed " + std::to_string(added.size()) + " device(s) in " +
+              std::to_string(lastArrivalBatch().timeToAllReady.count()) + " us");
+}
+
+bool DeviceManager::admit(const std::shared_ptr<UsbDevice>& device) {
+    std::function<bool(const std::shared_ptr<UsbDevice>&)> check;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        check = d->admissionCheck;
+    }
+    if (!check || check(device)) return true;
+    
+    if (device->setAuthorized(false)) {
+        LOG_WARNING("Refused " + device->description() + " on port " + device->portPath() +
+                    ", deauthorized");
+    } else {
+        LOG_WARNING("Refused " + device->description() + " on port " + device->portPath() +
+                    ", but could not deauthorize it");
+    }
+    return false;
+}
+
+void DeviceManager::handleDeviceRemoval(libusb_device* device) {
+    removeDevice(getDeviceIdentifier(device));
+}
+
+void DeviceManager::removeDevice(const std::string& id) {
     std::shared_ptr<UsbDevice> removedDevice;
     {
         std::lock_guard<std::mutex> lock(d->devicesMutex);
+        if (d->pendingArrivals.find(id) != d->pendingArrivals.end()) {
+            d->cancelledArrivals.insert(id);
+        }
+        d->refused.erase(id);
+        
         auto it = d->devices.find(id);
         if (it != d->devices.end()) {
             removedDevice = it->second;
             d->devices.erase(it);
+            d->publishSnapshot();
         }
     }
     
     if (removedDevice) {
+        removedDevice->cancelTransfers();
+        
         // Stop monitoring
         d->powerMgr->stopMonitoring(removedDevice);
-        d->bwMonitor->stopMonitoring(removedDevice);
+        d->bwMonitor->suspendMonitoring(removedDevice);
+        
+        // Retain the logical device so a re-enumeration can pick it up again
+        std::vector<std::shared_ptr<UsbDevice>> expired;
+        {
+            std::lock_guard<std::mutex> lock(d->devicesMutex);
+            expired = d->departed.retain(removedDevice->stableId(), removedDevice,
+                                         std::chrono::steady_clock::now());
+        }
+        for (const auto& device : expired) {
+            d->bwMonitor->stopMonitoring(device);
+        }
         
         emit deviceRemoved(removedDevice);
     }
@@ -1,5 +1,9 @@
 #pragma once
+#include "HotplugDebouncer.hpp"
+#include "SamplingScheduler.hpp"
 #include <QObject>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -13,6 +17,18 @@ class UsbDevice;
 class PowerManager;
 class BandwidthMonitor;
 
+// Immutable view of the registry, rebuilt only when devices come or go
+struct DeviceSnapshot {
+    uint64_t generation{0};
+    std::vector<std::shared_ptr<UsbDevice>> devices;
+};
+
+struct ArrivalBatchStats {
+    size_t deviceCount{0};
+    size_t reattachedCount{0};                   // Matched a departed identity
+    std::chrono::microseconds timeToAllReady{0}; // First arrival to commit
+};
+
 class DeviceManager : public QObject {
     Q_OBJECT
 
@@ -21,21 +37,56 @@ public:
     ~DeviceManager();
 
     std::vector<std::shared_ptr<UsbDevice>> getConnectedDevices() const;
+    std::shared_ptr<const DeviceSnapshot> deviceSnapshot() const;
+    uint64_t generation() const;
     PowerManager* powerManager() const;
     BandwidthMonitor* bandwidthMonitor() const;
+    SamplingScheduler* samplingScheduler() const;
+    
+    // Arrival pipeline. Stages run on the arrival worker pool against the
+    // freshly read descriptors, before the device is committed, so they
+    // must be thread-safe and must not touch the UI.
+    void registerArrivalStage(std::function<void(UsbDevice*)> stage);
+    
+    // Decides on every arrival and re-enumeration before it is committed,
+    // on the manager's thread. A refused device is deauthorized in sysfs
+    // and kept out of the registry until it leaves the bus. The check must
+    // not block; anything waiting on the user has to happen after it.
+    void setAdmissionCheck(std::function<bool(const std::shared_ptr<UsbDevice>&)> check);
+    void processPendingArrivals();
+    ArrivalBatchStats lastArrivalBatch() const;
+    
+    // Hotplug events are coalesced per port; a zero window disables this
+    void setDebounceWindow(std::chrono::milliseconds window);
+    std::chrono::milliseconds debounceWindow() const;
+    std::vector<PortHealth> portHealth() const;
 
 public slots:
     void pollDevices();
 
 signals:
     void deviceAdded(std::shared_ptr<UsbDevice> device);
+    void devicesAdded(const std::vector<std::shared_ptr<UsbDevice>>& devices);
     void deviceRemoved(std::shared_ptr<UsbDevice> device);
+    void deviceReenumerated(std::shared_ptr<UsbDevice> device);
+    void portFlapping(const std::string& portPath, uint32_t flapCount);
     void error(const std::string& message);
 
 private:
     void setupHotplugSupport();
+    void queueHotplugEvent(libusb_device* device, bool arrived);
+    void settleHotplugEvents();
     void handleDeviceArrival(libusb_device* device);
     void handleDeviceRemoval(libusb_device* device);
+    void removeDevice(const std::string& id);
+    void handleReenumeration(libusb_device* departed, libusb_device* arrived);
+    void finishReenumeration(const std::shared_ptr<UsbDevice>& existing,
+                             const std::shared_ptr<UsbDevice>& probe,
+                             const std::string& oldId, const std::string& newId,
+                             bool sameDevice);
+    void prepareArrival(libusb_device* device, const std::string& id);
+    void commitArrivals();
+    bool admit(const std::shared_ptr<UsbDevice>& device);
     std::string getDeviceIdentifier(libusb_device* device);
 
     class Private;
@@ -0,0 +1,139 @@
+#include "DeviceSession.hpp"
+#include <usb-monitor/Constants.hpp>
+
+namespace usb_monitor {
+
+namespace {
+
+// Fire-and-forget wrapper: starts eagerly and frees its own frame at the end
+struct DetachedSession {
+    struct promise_type {
+        DetachedSession get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+DetachedSession runSession(Task<void> session,
+                           SessionScheduler::CompletionHandler onComplete,
+                           std::function<void(std::exception_ptr)> finished) {
+    std::exception_ptr exception;
+    try {
+        co_await session;
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    
+    if (onComplete) {
+        onComplete(exception);
+    }
+    finished(exception);
+}
+
+} // namespace
+
+TransferAwaitable::TransferAwaitable(TransferTarget* target, Kind kind, uint8_t endpoint,
+                                     const uint8_t* data, size_t length, unsigned int timeout)
+    : target(target)
+    , kind(kind)
+    , endpoint(endpoint)
+    , data(data)
+    , length(length)
+    , timeout(timeout) {
+}
+
+TransferAwaitable::TransferAwaitable(TransferTarget* target, uint8_t requestType, uint8_t request,
+                                     uint16_t value, uint16_t index,
+                                     const uint8_t* data, uint16_t length, unsigned int timeout)
+    : target(target)
+    , kind(Kind::Control)
+    , endpoint(requestType)
+    , request(request)
+    , value(value)
+    , index(index)
+    , data(data)
+    , length(length)
+    , timeout(timeout) {
+}
+
+bool TransferAwaitable::await_suspend(std::coroutine_handle<> awaiting) {
+    handle = awaiting;
+    
+    // The completion may resume the coroutine on the event thread before
+    // submit returns, so nothing here may touch *this after a success
+    auto callback = [this](const TransferCompletion& completion) { complete(completion); };
+    bool submitted = false;
+    switch (kind) {
+    case Kind::Control:
+        submitted = target->submitControl(endpoint, request, value, index, data,
+                                          static_cast<uint16_t>(length), callback, timeout);
+        break;
+    case Kind::Bulk:
+        submitted = target->submitBulk(endpoint, data, length, callback, timeout);
+        break;
+    case Kind::Interrupt:
+        submitted = target->submitInterrupt(endpoint, data, length, callback, timeout);
+        break;
+    }
+    
+    if (!submitted) {
+        result.status = LIBUSB_ERROR_IO;
+        return false;  // Resume immediately with the error
+    }
+    return true;
+}
+
+void TransferAwaitable::complete(const TransferCompletion& completion) {
+    result.status = completion.status;
+    if ((endpoint & LIBUSB_ENDPOINT_IN) && completion.data && completion.actualLength > 0) {
+        result.data.assign(completion.data, completion.data + completion.actualLength);
+    }
+    TransferPool::resumeAfterRelease(handle);
+}
+
+SessionScheduler::~SessionScheduler() {
+    // Sessions keep the state alive, so giving up here is safe
+    waitAll(std::chrono::milliseconds(DEFAULT_TIMEOUT));
+}
+
+void SessionScheduler::spawn(Task<void> session, CompletionHandler onComplete) {
+    state->active++;
+    runSession(std::move(session), std::move(onComplete),
+               [shared = state](std::exception_ptr exception) {
+        shared->sessionFinished(exception);
+    });
+}
+
+size_t SessionScheduler::activeSessions() const {
+    return state->active.load();
+}
+
+size_t SessionScheduler::completedSessions() const {
+    return state->completed.load();
+}
+
+size_t SessionScheduler::failedSessions() const {
+    return state->failed.load();
+}
+
+bool SessionScheduler::waitAll(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    return state->idle.wait_for(lock, timeout, [this] { return state->active.load() == 0; });
+}
+
+void SessionScheduler::State::sessionFinished(std::exception_ptr exception) {
+    if (exception) {
+        failed++;
+    } else {
+        completed++;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--active == 0) {
+        idle.notify_all();
+    }
+}
+
+} // namespace usb_monitor
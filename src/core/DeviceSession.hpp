@@ -0,0 +1,196 @@
+#pragma once
+#include "TransferPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace usb_monitor {
+
+// Submits pooled transfers and calls back once each one completes; the
+// device's open handle in UsbDevice, a stand-in bus in tests
+class TransferTarget {
+public:
+    virtual ~TransferTarget() = default;
+
+    virtual bool submitControl(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                               const uint8_t* data, uint16_t length,
+                               TransferCallback callback, unsigned int timeout) = 0;
+    virtual bool submitBulk(uint8_t endpoint, const uint8_t* data, size_t length,
+                            TransferCallback callback, unsigned int timeout) = 0;
+    virtual bool submitInterrupt(uint8_t endpoint, const uint8_t* data, size_t length,
+                                 TransferCallback callback, unsigned int timeout) = 0;
+};
+
+// Suspends the awaiting coroutine until one pooled transfer completes. The
+// coroutine resumes on the libusb event thread.
+class TransferAwaitable {
+public:
+    enum class Kind { Control, Bulk, Interrupt };
+
+    TransferAwaitable(TransferTarget* target, Kind kind, uint8_t endpoint,
+                      const uint8_t* data, size_t length, unsigned int timeout);
+    TransferAwaitable(TransferTarget* target, uint8_t requestType, uint8_t request,
+                      uint16_t value, uint16_t index,
+                      const uint8_t* data, uint16_t length, unsigned int timeout);
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    TransferResult await_resume() { return std::move(result); }
+
+private:
+    void complete(const TransferCompletion& completion);
+
+    TransferTarget* target;
+    Kind kind;
+    uint8_t endpoint;
+    uint8_t request{0};
+    uint16_t value{0};
+    uint16_t index{0};
+    const uint8_t* data;
+    size_t length;
+    unsigned int timeout;
+    std::coroutine_handle<> handle;
+    TransferResult result;
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+} // namespace detail
+
+// Lazily started coroutine; awaiting it runs it and resumes the awaiter
+// when it finishes (symmetric transfer, no extra thread hops)
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+    T await_resume() {
+        auto& promise = handle.promise();
+        if (promise.exception) {
+            std::rethrow_exception(promise.exception);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*promise.value);
+        }
+    }
+
+private:
+    Handle handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// Runs detached device sessions. A session starts on the calling thread and
+// continues on the libusb event thread after each transfer, so any number
+// of sessions share the event thread instead of owning one each. Sessions
+// still suspended when the scheduler goes away finish without it.
+class SessionScheduler {
+public:
+    using CompletionHandler = std::function<void(std::exception_ptr)>;
+
+    SessionScheduler() = default;
+    ~SessionScheduler();
+
+    SessionScheduler(const SessionScheduler&) = delete;
+    SessionScheduler& operator=(const SessionScheduler&) = delete;
+
+    void spawn(Task<void> session, CompletionHandler onComplete = {});
+
+    size_t activeSessions() const;
+    size_t completedSessions() const;
+    size_t failedSessions() const;
+    bool waitAll(std::chrono::milliseconds timeout);
+
+private:
+    // Shared with every running session, which counts itself out here even
+    // after the scheduler is gone
+    struct State {
+        std::atomic<size_t> active{0};
+        std::atomic<size_t> completed{0};
+        std::atomic<size_t> failed{0};
+        std::mutex mutex;
+        std::condition_variable idle;
+
+        void sessionFinished(std::exception_ptr exception);
+    };
+
+    std::shared_ptr<State> state{std::make_shared<State>()};
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,138 @@
+#include "HotplugDebouncer.hpp"
+#include <mutex>
+#include <unordered_map>
+
+namespace usb_monitor {
+
+struct PendingPort {
+    libusb_device* departed{nullptr};
+    libusb_device* arrived{nullptr};
+    bool lastWasArrival{false};
+    uint32_t flaps{0};
+    HotplugDebouncer::Clock::time_point lastEvent;
+};
+
+class HotplugDebouncer::Private {
+public:
+    std::chrono::milliseconds window;
+    std::unordered_map<std::string, PendingPort> pending;
+    std::unordered_map<std::string, PortHealth> health;
+    mutable std::mutex mutex;
+    
+    SettledPort settle(const std::string& portPath, const PendingPort& port) const {
+        SettledPort settled;
+        settled.portPath = portPath;
+        settled.departed = port.departed;
+        settled.arrived = port.arrived;
+        settled.flaps = port.flaps;
+        return settled;
+    }
+};
+
+HotplugDebouncer::HotplugDebouncer(std::chrono::milliseconds window)
+    : d(std::make_unique<Private>()) {
+    d->window = window;
+}
+
+HotplugDebouncer::~HotplugDebouncer() = default;
+
+void HotplugDebouncer::setWindow(std::chrono::milliseconds window) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->window = window;
+}
+
+std::chrono::milliseconds HotplugDebouncer::window() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->window;
+}
+
+bool HotplugDebouncer::recordEvent(const std::string& portPath,
+                                   libusb_device* device,
+                                   bool arrived,
+                                   Clock::time_point now,
+                                   std::vector<libusb_device*>& displaced) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    
+    bool opened = d->pending.empty();
+    auto [it, inserted] = d->pending.try_emplace(portPath);
+    auto& port = it->second;
+    
+    auto& health = d->health[portPath];
+    health.portPath = portPath;
+    health.eventCount++;
+    health.lastEvent = now;
+    
+    if (!inserted && port.lastWasArrival != arrived) {
+        port.flaps++;
+        health.flapCount++;
+    }
+    
+    if (arrived) {
+        // A newer arrival supersedes one that never settled
+        if (port.arrived) {
+            displaced.push_back(port.arrived);
+        }
+        port.arrived = device;
+    } else if (port.arrived) {
+        // Arrived and left inside the window: neither side needs to be seen
+        displaced.push_back(port.arrived);
+        displaced.push_back(device);
+        port.arrived = nullptr;
+    } else if (inserted) {
+        port.departed = device;
+    } else {
+        displaced.push_back(device);
+    }
+    
+    port.lastWasArrival = arrived;
+    port.lastEvent = now;
+    return opened;
+}
+
+std::vector<SettledPort> HotplugDebouncer::takeSettled(Clock::time_point now) {
+    std::vector<SettledPort> result;
+    std::lock_guard<std::mutex> lock(d->mutex);
+    
+    for (auto it = d->pending.begin(); it != d->pending.end();) {
+        if (now - it->second.lastEvent >= d->window) {
+            result.push_back(d->settle(it->first, it->second));
+            it = d->pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    return result;
+}
+
+std::vector<SettledPort> HotplugDebouncer::takeAll() {
+    std::vector<SettledPort> result;
+    std::lock_guard<std::mutex> lock(d->mutex);
+    
+    result.reserve(d->pending.size());
+    for (const auto& [portPath, port] : d->pending) {
+        result.push_back(d->settle(portPath, port));
+    }
+    d->pending.clear();
+    
+    return result;
+}
+
+bool HotplugDebouncer::hasPending() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return !d->pending.empty();
+}
+
+std::vector<PortHealth> HotplugDebouncer::portHealth() const {
+    std::vector<PortHealth> result;
+    std::lock_guard<std::mutex> lock(d->mutex);
+    
+    result.reserve(d->health.size());
+    for (const auto& [_, health] : d->health) {
+        result.push_back(health);
+    }
+    
+    return result;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,60 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct libusb_device;
+
+namespace usb_monitor {
+
+struct PortHealth {
+    std::string portPath;
+    uint64_t eventCount{0};
+    uint64_t flapCount{0};  // Arrive/leave reversals inside a debounce window
+    std::chrono::steady_clock::time_point lastEvent;
+};
+
+// Net effect of all hotplug events on a port once it has been quiet for a
+// full window
+struct SettledPort {
+    std::string portPath;
+    libusb_device* departed{nullptr}; // Device that was there before the window
+    libusb_device* arrived{nullptr};  // Device left standing after the window
+    uint32_t flaps{0};
+};
+
+// Coalesces hotplug events per port. The debouncer does not touch libusb
+// reference counts: the caller refs a device before recording it and unrefs
+// whatever is handed back, either as displaced or inside a SettledPort.
+class HotplugDebouncer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit HotplugDebouncer(
+        std::chrono::milliseconds window = std::chrono::milliseconds(HOTPLUG_DEBOUNCE_WINDOW));
+    ~HotplugDebouncer();
+
+    void setWindow(std::chrono::milliseconds window);
+    std::chrono::milliseconds window() const;
+
+    // Returns true if this event opened a new window on an idle debouncer
+    bool recordEvent(const std::string& portPath,
+                     libusb_device* device,
+                     bool arrived,
+                     Clock::time_point now,
+                     std::vector<libusb_device*>& displaced);
+    std::vector<SettledPort> takeSettled(Clock::time_point now);
+    std::vector<SettledPort> takeAll();
+    bool hasPending() const;
+
+    std::vector<PortHealth> portHealth() const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,89 @@
+#include "IdentityCache.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace usb_monitor {
+
+struct DepartedDevice {
+    std::shared_ptr<UsbDevice> device;
+    IdentityCache::Clock::time_point departedAt;
+};
+
+class IdentityCache::Private {
+public:
+    std::chrono::seconds retention;
+    size_t capacity;
+    std::unordered_map<std::string, DepartedDevice> departed;
+};
+
+IdentityCache::IdentityCache(std::chrono::seconds retention, size_t capacity)
+    : d(std::make_unique<Private>()) {
+    d->retention = retention;
+    d->capacity = capacity;
+}
+
+IdentityCache::~IdentityCache() = default;
+
+std::vector<std::shared_ptr<UsbDevice>> IdentityCache::retain(const std::string& stableId,
+                                                              std::shared_ptr<UsbDevice> device,
+                                                              Clock::time_point now) {
+    std::vector<std::shared_ptr<UsbDevice>> expired;
+    auto& entry = d->departed[stableId];
+    if (entry.device && entry.device != device) {
+        expired.push_back(std::move(entry.device));
+    }
+    entry = DepartedDevice{std::move(device), now};
+    
+    auto pruned = prune(now);
+    expired.insert(expired.end(), pruned.begin(), pruned.end());
+    return expired;
+}
+
+std::shared_ptr<UsbDevice> IdentityCache::take(const std::string& stableId) {
+    auto it = d->departed.find(stableId);
+    if (it == d->departed.end()) return nullptr;
+    
+    auto device = std::move(it->second.device);
+    d->departed.erase(it);
+    return device;
+}
+
+std::vector<std::shared_ptr<UsbDevice>> IdentityCache::prune(Clock::time_point now) {
+    std::vector<std::shared_ptr<UsbDevice>> expired;
+    
+    for (auto it = d->departed.begin(); it != d->departed.end();) {
+        if (now - it->second.departedAt > d->retention) {
+            expired.push_back(std::move(it->second.device));
+            it = d->departed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    while (d->departed.size() > d->capacity) {
+        auto oldest = std::min_element(d->departed.begin(), d->departed.end(),
+            [](const auto& a, const auto& b) {
+                return a.second.departedAt < b.second.departedAt;
+            });
+        expired.push_back(std::move(oldest->second.device));
+        d->departed.erase(oldest);
+    }
+    
+    return expired;
+}
+
+std::vector<std::shared_ptr<UsbDevice>> IdentityCache::takeAll() {
+    std::vector<std::shared_ptr<UsbDevice>> all;
+    all.reserve(d->departed.size());
+    for (auto& [_, entry] : d->departed) {
+        all.push_back(std::move(entry.device));
+    }
+    d->departed.clear();
+    return all;
+}
+
+size_t IdentityCache::size() const {
+    return d->departed.size();
+}
+
+} // namespace usb_monitor
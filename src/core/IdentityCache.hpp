@@ -0,0 +1,42 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+class UsbDevice;
+
+// Logical devices that left recently, by stable id, so a matching arrival
+// can get the old UsbDevice back and stats and authorization carry over.
+// Entries expire after the retention time; past the capacity the oldest
+// is evicted. Devices that drop out are handed back so the caller can
+// release their history. Not locked: the owner serializes access.
+class IdentityCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit IdentityCache(std::chrono::seconds retention = std::chrono::seconds(IDENTITY_RETENTION),
+                           size_t capacity = MAX_RETAINED_IDENTITIES);
+    ~IdentityCache();
+
+    // Returns the devices that expired or were evicted to make room
+    std::vector<std::shared_ptr<UsbDevice>> retain(const std::string& stableId,
+                                                   std::shared_ptr<UsbDevice> device,
+                                                   Clock::time_point now);
+    // Hands back and forgets the device retained under stableId, if any
+    std::shared_ptr<UsbDevice> take(const std::string& stableId);
+    std::vector<std::shared_ptr<UsbDevice>> prune(Clock::time_point now);
+    std::vector<std::shared_ptr<UsbDevice>> takeAll();
+
+    size_t size() const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
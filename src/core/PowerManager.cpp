@@ -1,5 +1,6 @@
 #include "PowerManager.hpp"
 #include "UsbDevice.hpp"
+#include "SamplingScheduler.hpp"
 #include <QTimer>
 #include <map>
 #include <mutex>
@@ -10,12 +11,16 @@ class PowerManager::Private {
 public:
     libusb_context* context{nullptr};
     std::map<const UsbDevice*, PowerStats> deviceStats;
-    std::map<const UsbDevice*, QTimer*> monitoringTimers;
+    std::map<const UsbDevice*, SamplingScheduler::SourceId> samplingSources;
+    SamplingScheduler* sampler{nullptr};
+    std::unique_ptr<SamplingScheduler> ownSampler;
+    QTimer* tickTimer{nullptr};
     std::mutex statsMutex;
     PowerManager* q_ptr;
 
-    void updateDevicePower(const UsbDevice* device) {
-        if (!device || !device->isOpen()) return;
+    // Returns true if the readings changed since the previous sample
+    bool updateDevicePower(const UsbDevice* device) {
+        if (!device || !device->isOpen()) return false;
         
         PowerStats stats{};
         libusb_device_handle* handle = device->nativeHandle();
@@ -33,13 +38,35 @@ public:
         }
 
         // Store the stats
+        bool changed;
         {
             std::lock_guard<std::mutex> lock(statsMutex);
-            deviceStats[device] = stats;
+            auto [it, inserted] = deviceStats.try_emplace(device, stats);
+            const PowerStats& previous = it->second;
+            changed = inserted ||
+                      previous.currentUsage != stats.currentUsage ||
+                      previous.voltage != stats.voltage ||
+                      previous.powerUsage != stats.powerUsage ||
+                      previous.selfPowered != stats.selfPowered ||
+                      previous.maxPower != stats.maxPower;
+            it->second = stats;
         }
 
         // Emit the signal through the main class
         Q_EMIT q_ptr->powerStatsUpdated(device, stats);
+        return changed;
+    }
+    
+    SamplingScheduler* samplingScheduler(QObject* owner) {
+        if (!sampler) {
+            // Standalone use: drive a private scheduler from our own tick
+            ownSampler = std::make_unique<SamplingScheduler>();
+            sampler = ownSampler.get();
+            tickTimer = new QTimer(owner);
+            QObject::connect(tickTimer, &QTimer::timeout, [this]() { sampler->tick(); });
+            tickTimer->start(SAMPLING_TICK);
+        }
+        return sampler;
     }
 };
 
@@ -50,26 +77,37 @@ PowerManager::PowerManager(libusb_context* context, QObject* parent)
     d->q_ptr = this;
 }
 
-PowerManager::~PowerManager() = default;
+PowerManager::~PowerManager() {
+    // A shared scheduler outlives us; drop our samplers from it
+    if (d->sampler) {
+        for (const auto& [device, source] : d->samplingSources) {
+            d->sampler->remove(source);
+        }
+    }
+}
+
+void PowerManager::setSamplingScheduler(SamplingScheduler* scheduler) {
+    if (!d->samplingSources.empty() || !scheduler) return;
+    
+    d->sampler = scheduler;
+    d->ownSampler.reset();
+    delete d->tickTimer;
+    d->tickTimer = nullptr;
+}
 
 void PowerManager::startMonitoring(std::shared_ptr<UsbDevice> device) {
     if (!device) return;
     
     // Check if already monitoring
-    if (d->monitoringTimers.find(device.get()) != d->monitoringTimers.end()) {
+    if (d->samplingSources.find(device.get()) != d->samplingSources.end()) {
         return;
     }
     
-    // Create timer for periodic updates
-    QTimer* timer = new QTimer(this);
-    timer->setInterval(1000); // Update every second
-    
-    connect(timer, &QTimer::timeout, [this, dev = device.get()]() {
-        d->updateDevicePower(dev);
-    });
-    
-    d->monitoringTimers[device.get()] = timer;
-    timer->start();
+    // Power readings rarely change, so these back off quickly when idle
+    auto* sampler = d->samplingScheduler(this);
+    d->samplingSources[device.get()] = sampler->add(
+        device.get(), std::chrono::milliseconds(1000),
+        [this, dev = device.get()]() { return d->updateDevicePower(dev); });
     
     // Get initial power stats
     d->updateDevicePower(device.get());
@@ -78,11 +116,10 @@ void PowerManager::startMonitoring(std::shared_ptr<UsbDevice> device) {
 void PowerManager::stopMonitoring(std::shared_ptr<UsbDevice> device) {
     if (!device) return;
     
-    auto it = d->monitoringTimers.find(device.get());
-    if (it != d->monitoringTimers.end()) {
-        it->second->stop();
-        delete it->second;
-        d->monitoringTimers.erase(it);
+    auto it = d->samplingSources.find(device.get());
+    if (it != d->samplingSources.end()) {
+        d->sampler->remove(it->second);
+        d->samplingSources.erase(it);
     }
     
     {
@@ -7,6 +7,7 @@
 namespace usb_monitor {
 
 class UsbDevice;
+class SamplingScheduler;
 
 class PowerManager : public QObject {
     Q_OBJECT
@@ -15,6 +16,10 @@ public:
     explicit PowerManager(libusb_context* context, QObject* parent = nullptr);
     ~PowerManager();
 
+    // Shares one adaptive sampling tick with other monitors. Without one a
+    // private scheduler is used. Must be set before monitoring starts.
+    void setSamplingScheduler(SamplingScheduler* scheduler);
+    
     void startMonitoring(std::shared_ptr<UsbDevice> device);
     void stopMonitoring(std::shared_ptr<UsbDevice> device);
     
@@ -0,0 +1,95 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace usb_monitor {
+
+// Byte and packet counts over a sliding window of fixed-width time buckets.
+// Recording and reading are O(1) amortized and the memory use is constant.
+template <size_t Buckets = RATE_WINDOW_BUCKETS, int BucketMs = RATE_BUCKET_WIDTH>
+class RateWindow {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    static constexpr double windowSeconds() { return Buckets * BucketMs / 1000.0; }
+    
+    void add(uint64_t bytes, uint64_t packets, Clock::time_point now) {
+        advance(now);
+        auto& bucket = buckets[head % Buckets];
+        bucket.bytes += bytes;
+        bucket.packets += packets;
+        bytesInWindow += bytes;
+        packetsInWindow += packets;
+        bytesSeen += bytes;
+        packetsSeen += packets;
+        peakBucket = std::max(peakBucket, bucket.bytes);
+    }
+    
+    // Expires buckets older than the window; call before reading rates
+    void advance(Clock::time_point now) {
+        int64_t index = bucketIndex(now);
+        if (!started) {
+            started = true;
+            head = first = index;
+            return;
+        }
+        if (index <= head) return;
+        
+        if (index - head >= static_cast<int64_t>(Buckets)) {
+            buckets.fill(Bucket{});
+            bytesInWindow = packetsInWindow = 0;
+        } else {
+            for (int64_t i = head + 1; i <= index; ++i) {
+                auto& bucket = buckets[i % Buckets];
+                bytesInWindow -= bucket.bytes;
+                packetsInWindow -= bucket.packets;
+                bucket = Bucket{};
+            }
+        }
+        head = index;
+    }
+    
+    // Bytes/sec over the window, or over the time since the first sample
+    // while the window is still filling
+    double rate() const { return bytesInWindow / span(); }
+    double packetRate() const { return packetsInWindow / span(); }
+    
+    // Highest single-bucket rate seen, bytes/sec
+    double peakRate() const { return peakBucket * 1000.0 / BucketMs; }
+    
+    uint64_t windowBytes() const { return bytesInWindow; }
+    uint64_t totalBytes() const { return bytesSeen; }
+    uint64_t totalPackets() const { return packetsSeen; }
+    
+private:
+    struct Bucket {
+        uint64_t bytes{0};
+        uint64_t packets{0};
+    };
+    
+    static int64_t bucketIndex(Clock::time_point now) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()).count() / BucketMs;
+    }
+    
+    double span() const {
+        if (!started) return windowSeconds();
+        auto filled = std::min<int64_t>(head - first + 1, Buckets);
+        return filled * BucketMs / 1000.0;
+    }
+    
+    std::array<Bucket, Buckets> buckets{};
+    int64_t head{0};
+    int64_t first{0};
+    bool started{false};
+    uint64_t bytesInWindow{0};
+    uint64_t packetsInWindow{0};
+    uint64_t bytesSeen{0};
+    uint64_t packetsSeen{0};
+    uint64_t peakBucket{0};
+};
+
+} // namespace usb_monitor
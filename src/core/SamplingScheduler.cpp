@@ -0,0 +1,164 @@
+#include "SamplingScheduler.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace usb_monitor {
+
+SamplingScheduler::SamplingScheduler(const SamplingPolicy& policy, CostClock costClock)
+    : currentPolicy(policy)
+    , costClock(std::move(costClock)) {
+}
+
+void SamplingScheduler::setPolicy(const SamplingPolicy& policy) {
+    currentPolicy = policy;
+}
+
+SamplingPolicy SamplingScheduler::policy() const {
+    return currentPolicy;
+}
+
+SamplingScheduler::SourceId SamplingScheduler::add(const void* target,
+                                                   std::chrono::milliseconds interval,
+                                                   Sampler sampler) {
+    SourceId id = nextId++;
+    auto& source = sources[id];
+    source.target = target;
+    source.sampler = std::move(sampler);
+    source.interval = std::clamp(interval, currentPolicy.minInterval, currentPolicy.maxInterval);
+    
+    // Sample straight away so a new device shows numbers on the next tick
+    schedule(id, source, Clock::now());
+    return id;
+}
+
+void SamplingScheduler::remove(SourceId id) {
+    auto it = sources.find(id);
+    if (it == sources.end()) return;
+    
+    dueOrder.erase({it->second.due, id});
+    sources.erase(it);
+}
+
+void SamplingScheduler::removeTarget(const void* target) {
+    for (auto it = sources.begin(); it != sources.end();) {
+        if (it->second.target == target) {
+            dueOrder.erase({it->second.due, it->first});
+            it = sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    visibleTargets.erase(target);
+}
+
+void SamplingScheduler::setVisible(const void* target, bool visible) {
+    bool changed = visible ? visibleTargets.insert(target).second : visibleTargets.erase(target) > 0;
+    if (!changed || !visible) return;
+    
+    // Pull a newly visible device's samples forward
+    auto now = Clock::now();
+    for (auto& [id, source] : sources) {
+        if (source.target == target && source.due > now + currentPolicy.visibleInterval) {
+            schedule(id, source, now);
+        }
+    }
+}
+
+bool SamplingScheduler::isVisible(const void* target) const {
+    return visibleTargets.count(target) > 0;
+}
+
+std::chrono::milliseconds SamplingScheduler::interval(SourceId id) const {
+    auto it = sources.find(id);
+    return it != sources.end() ? effectiveInterval(it->second) : std::chrono::milliseconds(0);
+}
+
+std::chrono::milliseconds SamplingScheduler::effectiveInterval(const Source& source) const {
+    if (visibleTargets.count(source.target)) {
+        return std::min(source.interval, currentPolicy.visibleInterval);
+    }
+    return source.interval;
+}
+
+void SamplingScheduler::schedule(SourceId id, Source& source, Clock::time_point due) {
+    dueOrder.erase({source.due, id});
+    source.due = due;
+    dueOrder.insert({due, id});
+}
+
+size_t SamplingScheduler::tick(Clock::time_point now) {
+    // The budget for this tick is the budgeted share of the time since the
+    // last one, but always enough for at least one sample
+    auto elapsed = lastTick.time_since_epoch().count() == 0
+        ? currentPolicy.minInterval
+        : std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastTick);
+    lastTick = now;
+    double budget = std::max(currentPolicy.cpuBudget * std::chrono::duration<double, std::nano>(elapsed).count(),
+                             costEstimate);
+    
+    std::vector<SourceId> due;
+    for (auto it = dueOrder.begin(); it != dueOrder.end() && it->first <= now; ++it) {
+        due.push_back(it->second);
+    }
+    std::stable_sort(due.begin(), due.end(), [this](SourceId a, SourceId b) {
+        return visibleTargets.count(sources[a].target) > visibleTargets.count(sources[b].target);
+    });
+    
+    size_t ran = 0;
+    double spent = 0.0;
+    for (SourceId id : due) {
+        if (spent + costEstimate > budget && ran > 0) {
+            deferredSamples += due.size() - ran;
+            break;
+        }
+        
+        auto it = sources.find(id);
+        if (it == sources.end()) continue;  // Removed by an earlier sampler
+        
+        auto start = costClock();
+        bool active = it->second.sampler ? it->second.sampler() : false;
+        double cost = std::chrono::duration<double, std::nano>(costClock() - start).count();
+        
+        spent += cost;
+        costEstimate = costEstimate == 0.0 ? cost : costEstimate * 0.9 + cost * 0.1;
+        work.add(static_cast<uint64_t>(cost), 1, now);
+        totalSamples++;
+        ran++;
+        
+        // The sampler may have removed its own source
+        it = sources.find(id);
+        if (it == sources.end()) continue;
+        
+        auto& source = it->second;
+        source.active = active;
+        source.interval = active ? std::max(source.interval / 2, currentPolicy.minInterval)
+                                 : std::min(source.interval * 2, currentPolicy.maxInterval);
+        schedule(id, source, now + effectiveInterval(source));
+    }
+    return ran;
+}
+
+SamplingMetrics SamplingScheduler::metrics(Clock::time_point now) {
+    SamplingMetrics metrics;
+    work.advance(now);
+    
+    metrics.sources = sources.size();
+    metrics.samplesPerSecond = work.packetRate();
+    metrics.cpuFraction = work.rate() / 1e9;
+    metrics.totalSamples = totalSamples;
+    metrics.deferredSamples = deferredSamples;
+    
+    std::chrono::milliseconds total{0};
+    for (const auto& [id, source] : sources) {
+        if (source.active) metrics.activeSources++;
+        if (visibleTargets.count(source.target)) metrics.visibleSources++;
+        total += effectiveInterval(source);
+    }
+    if (!sources.empty()) {
+        metrics.averageInterval = total / static_cast<int64_t>(sources.size());
+    }
+    return metrics;
+}
+
+} // namespace usb_monitor
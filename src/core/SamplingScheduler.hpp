@@ -0,0 +1,93 @@
+#pragma once
+#include "RateWindow.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+
+namespace usb_monitor {
+
+struct SamplingPolicy {
+    std::chrono::milliseconds minInterval{SAMPLING_MIN_INTERVAL};
+    std::chrono::milliseconds maxInterval{SAMPLING_MAX_INTERVAL};
+    std::chrono::milliseconds visibleInterval{SAMPLING_VISIBLE_INTERVAL}; // Ceiling while visible
+    double cpuBudget{SAMPLING_CPU_BUDGET};  // Fraction of one core spent sampling
+};
+
+struct SamplingMetrics {
+    size_t sources{0};
+    size_t activeSources{0};      // Saw activity on their last sample
+    size_t visibleSources{0};
+    double samplesPerSecond{0.0};
+    double cpuFraction{0.0};      // Time inside samplers / wall time
+    uint64_t totalSamples{0};
+    uint64_t deferredSamples{0};  // Pushed to a later tick by the CPU budget
+    std::chrono::milliseconds averageInterval{0};
+};
+
+// Drives every periodic sampler from one tick instead of a timer per device.
+// A sampler reports whether it saw activity: active sources speed up
+// towards minInterval, idle ones back off towards maxInterval, and sources
+// visible in the UI never wait longer than visibleInterval. Each tick runs
+// due samplers, visible and most overdue first, until the CPU budget for
+// that tick is spent; the rest wait for the next tick.
+//
+// Not thread-safe; call from the thread that owns the tick timer.
+class SamplingScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Sampler = std::function<bool()>;  // Returns true on activity
+    using SourceId = uint64_t;
+    using CostClock = std::function<Clock::time_point()>;  // Times each sampler call
+
+    explicit SamplingScheduler(const SamplingPolicy& policy = SamplingPolicy(),
+                               CostClock costClock = Clock::now);
+
+    void setPolicy(const SamplingPolicy& policy);
+    SamplingPolicy policy() const;
+
+    // target groups sources (e.g. one device's power and bandwidth samplers)
+    // for visibility; interval is where the adaptive interval starts
+    SourceId add(const void* target, std::chrono::milliseconds interval, Sampler sampler);
+    void remove(SourceId id);
+    void removeTarget(const void* target);
+    
+    void setVisible(const void* target, bool visible);
+    bool isVisible(const void* target) const;
+    std::chrono::milliseconds interval(SourceId id) const;
+
+    // Runs due samplers; returns how many ran
+    size_t tick(Clock::time_point now = Clock::now());
+    
+    SamplingMetrics metrics(Clock::time_point now = Clock::now());
+
+private:
+    struct Source {
+        const void* target{nullptr};
+        Sampler sampler;
+        std::chrono::milliseconds interval{0};
+        Clock::time_point due;
+        bool active{false};
+    };
+    
+    std::chrono::milliseconds effectiveInterval(const Source& source) const;
+    void schedule(SourceId id, Source& source, Clock::time_point due);
+
+    SamplingPolicy currentPolicy;
+    CostClock costClock;
+    std::map<SourceId, Source> sources;
+    std::set<std::pair<Clock::time_point, SourceId>> dueOrder;
+    std::set<const void*> visibleTargets;
+    SourceId nextId{1};
+    
+    double costEstimate{0.0};         // ns per sample, moving average
+    Clock::time_point lastTick;
+    RateWindow<> work;                // Bytes are ns spent, packets are samples
+    uint64_t totalSamples{0};
+    uint64_t deferredSamples{0};
+};
+
+} // namespace usb_monitor
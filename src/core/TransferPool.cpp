@@ -0,0 +1,205 @@
+#include "TransferPool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <utility>
+#include <mutex>
+
+namespace usb_monitor {
+
+namespace {
+// Coroutine waiting to run once the current completion has freed its slot
+thread_local std::coroutine_handle<> pendingResume;
+} // namespace
+
+class TransferPool::Private {
+public:
+    // Reached through libusb_transfer::user_data. While the transfer is in
+    // flight, keepAlive holds the pool's state for the completion.
+    struct SlotContext {
+        Private* owner{nullptr};
+        PooledTransfer* slot{nullptr};
+        std::shared_ptr<Private> keepAlive;
+    };
+    
+    ~Private() {
+        // Only reached once no transfer is in flight
+        for (auto& slot : slots) {
+            libusb_free_transfer(slot->transfer);
+        }
+    }
+    
+    TransferBackend backend;
+    TransferObserver observer;
+    std::vector<std::unique_ptr<PooledTransfer>> slots;
+    std::vector<SlotContext> contexts;
+    std::vector<PooledTransfer*> freeSlots;
+    size_t inFlight{0};
+    mutable std::mutex poolMutex;
+    std::condition_variable idle;
+};
+
+TransferPool::TransferPool(size_t count, size_t bufferSize, int isoPackets, TransferBackend backend)
+    : d(std::make_shared<Private>()) {
+    
+    d->backend = std::move(backend);
+    d->slots.reserve(count);
+    d->contexts.resize(count);
+    d->freeSlots.reserve(count);
+    
+    for (size_t i = 0; i < count; i++) {
+        auto slot = std::make_unique<PooledTransfer>();
+        slot->transfer = libusb_alloc_transfer(isoPackets);
+        if (!slot->transfer) break;
+        
+        slot->buffer.resize(bufferSize + LIBUSB_CONTROL_SETUP_SIZE);
+        d->contexts[i] = Private::SlotContext{d.get(), slot.get(), nullptr};
+        slot->transfer->user_data = &d->contexts[i];
+        
+        d->freeSlots.push_back(slot.get());
+        d->slots.push_back(std::move(slot));
+    }
+}
+
+TransferPool::~TransferPool() {
+    // Give cancelled transfers the usual time to call back. Any still in
+    // flight after that keep the slots alive and free them when they land.
+    cancelAll();
+    waitIdle(std::chrono::milliseconds(DEFAULT_TIMEOUT));
+}
+
+PooledTransfer* TransferPool::acquire(size_t bufferLength) {
+    PooledTransfer* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(d->poolMutex);
+        if (d->freeSlots.empty()) return nullptr;
+        
+        slot = d->freeSlots.back();
+        d->freeSlots.pop_back();
+    }
+    
+    if (slot->buffer.size() < bufferLength) {
+        slot->buffer.resize(bufferLength);
+    }
+    return slot;
+}
+
+void TransferPool::release(PooledTransfer* slot) {
+    if (!slot) return;
+    
+    slot->callback = nullptr;
+    std::lock_guard<std::mutex> lock(d->poolMutex);
+    d->freeSlots.push_back(slot);
+}
+
+int TransferPool::submit(PooledTransfer* slot, TransferCallback callback) {
+    auto context = static_cast<Private::SlotContext*>(slot->transfer->user_data);
+    slot->callback = std::move(callback);
+    slot->transfer->callback = &TransferPool::onTransferComplete;
+    
+    {
+        std::lock_guard<std::mutex> lock(d->poolMutex);
+        slot->inFlight = true;
+        context->keepAlive = d;
+        d->inFlight++;
+    }
+    
+    int ret = d->backend.submit(slot->transfer);
+    if (ret != LIBUSB_SUCCESS) {
+        {
+            std::lock_guard<std::mutex> lock(d->poolMutex);
+            slot->inFlight = false;
+            context->keepAlive.reset();
+            d->inFlight--;
+        }
+        release(slot);
+    }
+    return ret;
+}
+
+void TransferPool::setObserver(TransferObserver observer) {
+    std::lock_guard<std::mutex> lock(d->poolMutex);
+    d->observer = std::move(observer);
+}
+
+void TransferPool::cancelAll() {
+    std::lock_guard<std::mutex> lock(d->poolMutex);
+    for (auto& slot : d->slots) {
+        if (slot->inFlight) {
+            d->backend.cancel(slot->transfer);
+        }
+    }
+}
+
+bool TransferPool::waitIdle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(d->poolMutex);
+    return d->idle.wait_for(lock, timeout, [this] { return d->inFlight == 0; });
+}
+
+size_t TransferPool::inFlight() const {
+    std::lock_guard<std::mutex> lock(d->poolMutex);
+    return d->inFlight;
+}
+
+size_t TransferPool::capacity() const {
+    return d->slots.size();
+}
+
+void LIBUSB_CALL TransferPool::onTransferComplete(libusb_transfer* transfer) {
+    auto context = static_cast<Private::SlotContext*>(transfer->user_data);
+    auto owner = context->owner;
+    auto slot = context->slot;
+    
+    TransferCompletion completion;
+    completion.status = transfer->status;
+    completion.actualLength = transfer->actual_length;
+    completion.data = transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL
+        ? libusb_control_transfer_get_data(transfer)
+        : transfer->buffer;
+    completion.numIsoPackets = transfer->num_iso_packets;
+    completion.isoPackets = transfer->num_iso_packets > 0 ? transfer->iso_packet_desc : nullptr;
+    
+    // Isochronous transfers report what moved per packet
+    uint64_t moved = 0;
+    if (transfer->type == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) {
+        for (int i = 0; i < transfer->num_iso_packets; i++) {
+            moved += transfer->iso_packet_desc[i].actual_length;
+        }
+    } else {
+        moved = uint64_t(std::max(transfer->actual_length, 0));
+    }
+    
+    // The slot stays reserved while the callback reads its buffer
+    {
+        TransferCallback callback = std::move(slot->callback);
+        slot->callback = nullptr;
+        if (callback) {
+            callback(completion);
+        }
+    }
+    
+    // Hand the slot back. If the pool itself is gone, the last of these
+    // references frees the slots once this function returns.
+    std::shared_ptr<Private> keepAlive;
+    {
+        std::lock_guard<std::mutex> lock(owner->poolMutex);
+        keepAlive = std::move(context->keepAlive);
+        if (owner->observer && (completion.status == LIBUSB_TRANSFER_COMPLETED || moved > 0)) {
+            owner->observer(transfer->endpoint, moved);
+        }
+        slot->inFlight = false;
+        owner->freeSlots.push_back(slot);
+        if (--owner->inFlight == 0) {
+            owner->idle.notify_all();
+        }
+    }
+    
+    if (auto handle = std::exchange(pendingResume, {})) {
+        handle.resume();
+    }
+}
+
+void TransferPool::resumeAfterRelease(std::coroutine_handle<> handle) {
+    pendingResume = handle;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,93 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <libusb-1.0/libusb.h>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace usb_monitor {
+
+// What a completion callback sees. Pointers refer to the pooled buffer and
+// are only valid for the duration of the callback.
+struct TransferCompletion {
+    int status{LIBUSB_TRANSFER_ERROR};  // libusb_transfer_status
+    int actualLength{0};
+    const uint8_t* data{nullptr};
+    int numIsoPackets{0};
+    const libusb_iso_packet_descriptor* isoPackets{nullptr};
+};
+
+struct TransferResult {
+    int status{LIBUSB_TRANSFER_ERROR}; // libusb_transfer_status, or LIBUSB_ERROR_* if never submitted
+    std::vector<uint8_t> data;         // Received bytes for IN transfers
+    
+    bool ok() const { return status == LIBUSB_TRANSFER_COMPLETED; }
+};
+
+using TransferCallback = std::function<void(const TransferCompletion&)>;
+
+// Sees each transfer that completed or moved data, by endpoint address and
+// bytes moved. Runs on the event thread under the pool's lock, so it must
+// be quick and must not call back into the pool.
+using TransferObserver = std::function<void(uint8_t endpoint, uint64_t bytes)>;
+
+struct PooledTransfer {
+    libusb_transfer* transfer{nullptr};
+    std::vector<uint8_t> buffer;
+    TransferCallback callback;
+    bool inFlight{false};
+};
+
+// Where pooled transfers are submitted and cancelled: libusb itself, or a
+// stand-in bus in tests that completes transfers through their callback
+struct TransferBackend {
+    std::function<int(libusb_transfer*)> submit{libusb_submit_transfer};
+    std::function<int(libusb_transfer*)> cancel{libusb_cancel_transfer};
+};
+
+// Preallocated libusb_transfer objects and buffers for one device handle.
+// Completions run on whichever thread is handling libusb events. Every
+// transfer in flight shares ownership of the slots and buffers, so they
+// outlive a pool destroyed before libusb has called back.
+class TransferPool {
+public:
+    explicit TransferPool(size_t count = TRANSFER_POOL_SIZE,
+                          size_t bufferSize = TRANSFER_BUFFER_SIZE,
+                          int isoPackets = MAX_ISO_PACKETS,
+                          TransferBackend backend = {});
+    ~TransferPool();
+
+    TransferPool(const TransferPool&) = delete;
+    TransferPool& operator=(const TransferPool&) = delete;
+
+    // Returns nullptr when every slot is in flight. The buffer is grown if
+    // needed and then stays at that size for later users of the slot.
+    PooledTransfer* acquire(size_t bufferLength);
+    void release(PooledTransfer* slot);
+
+    // Fills in the libusb callback and submits; releases the slot on failure
+    int submit(PooledTransfer* slot, TransferCallback callback);
+
+    // Once this returns the previous observer is no longer called
+    void setObserver(TransferObserver observer);
+    
+    void cancelAll();
+    bool waitIdle(std::chrono::milliseconds timeout);
+    size_t inFlight() const;
+    size_t capacity() const;
+
+    // Called from a completion callback: resumes the coroutine once the slot
+    // is back in the pool, so the session may submit again or close the device
+    static void resumeAfterRelease(std::coroutine_handle<> handle);
+
+private:
+    static void LIBUSB_CALL onTransferComplete(libusb_transfer* transfer);
+
+    class Private;
+    std::shared_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -1,29 +1,118 @@
 #include "UsbDevice.hpp"
+#include "UsbSysfs.hpp"
 #include <usb-monitor/Constants.hpp>
 #include <QDebug>
+#include <cstring>
+#include <iomanip>
 #include <sstream>
 
 namespace usb_monitor {
 
+// Everything read from the device's descriptors, built whole and never
+// changed afterwards. rebind() publishes a new block instead of editing this
+// one, so readers on other threads keep a consistent copy while they hold it.
+struct DescriptorState {
+    libusb_device* device{nullptr};  // Referenced for the life of the block
+    libusb_device_descriptor descriptor{};
+    libusb_config_descriptor* config{nullptr};
+    DeviceIdentifier identifier{};
+    std::string manufacturer;
+    std::string product;
+    std::string serialNumber;
+    std::string portPath;
+    std::string stableId;
+    uint64_t descriptorHash{0};
+    
+    explicit DescriptorState(libusb_device* dev) : device(dev) {
+        libusb_ref_device(device);
+        if (libusb_get_device_descriptor(device, &descriptor) == 0) {
+            identifier.busNumber = libusb_get_bus_number(device);
+            identifier.deviceAddress = libusb_get_device_address(device);
+            identifier.vendorId = descriptor.idVendor;
+            identifier.productId = descriptor.idProduct;
+        }
+        portPath = UsbDevice::portPathOf(device);
+    }
+    
+    ~DescriptorState() {
+        if (config) libusb_free_config_descriptor(config);
+        libusb_unref_device(device);
+    }
+    
+    DescriptorState(const DescriptorState&) = delete;
+    DescriptorState& operator=(const DescriptorState&) = delete;
+    
+    // FNV-1a over the device descriptor and the interface/endpoint layout
+    // of the active configuration
+    void updateDescriptorHash() {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&hash](uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                hash ^= (value >> (i * 8)) & 0xFF;
+                hash *= 1099511628211ULL;
+            }
+        };
+        
+        mix(descriptor.bcdUSB);
+        mix(descriptor.bDeviceClass);
+        mix(descriptor.bDeviceSubClass);
+        mix(descriptor.bDeviceProtocol);
+        mix(descriptor.idVendor);
+        mix(descriptor.idProduct);
+        mix(descriptor.bcdDevice);
+        mix(descriptor.bNumConfigurations);
+        
+        if (config) {
+            mix(config->bNumInterfaces);
+            mix(config->bmAttributes);
+            mix(config->MaxPower);
+            for (int i = 0; i < config->bNumInterfaces; i++) {
+                const libusb_interface* interface = &config->interface[i];
+                for (int j = 0; j < interface->num_altsetting; j++) {
+                    const libusb_interface_descriptor* setting = &interface->altsetting[j];
+                    mix(setting->bInterfaceClass);
+                    mix(setting->bInterfaceSubClass);
+                    mix(setting->bInterfaceProtocol);
+                    for (int k = 0; k < setting->bNumEndpoints; k++) {
+                        mix(setting->endpoint[k].bEndpointAddress);
+                        mix(setting->endpoint[k].bmAttributes);
+                        mix(setting->endpoint[k].wMaxPacketSize);
+                    }
+                }
+            }
+        }
+        
+        descriptorHash = hash;
+    }
+    
+    void updateStableId() {
+        std::stringstream ss;
+        ss << portPath << "|" << serialNumber << "|"
+           << std::hex << std::setw(16) << std::setfill('0') << descriptorHash;
+        stableId = ss.str();
+    }
+};
+
 class UsbDevice::Private {
 public:
-    libusb_device* device{nullptr};
+    std::shared_ptr<const DescriptorState> state;  // atomic_load/atomic_store only
     libusb_device_handle* handle{nullptr};
     libusb_context* context{nullptr};
-    libusb_device_descriptor descriptor{};
-    DeviceIdentifier identifier{};
+    std::unique_ptr<TransferPool> transfers;
+    TransferObserver transferObserver;  // Handed to each pool on open()
     PowerStats powerStats{};
     BandwidthStats bandwidthStats{};
     bool isOpened{false};
     
-    void updateIdentifier() {
-        identifier.busNumber = libusb_get_bus_number(device);
-        identifier.deviceAddress = libusb_get_device_address(device);
-        identifier.vendorId = descriptor.idVendor;
-        identifier.productId = descriptor.idProduct;
+    std::shared_ptr<const DescriptorState> current() const {
+        return std::atomic_load_explicit(&state, std::memory_order_acquire);
     }
     
-    std::string getStringDescriptor(uint8_t index) {
+    void publish(std::shared_ptr<const DescriptorState> next) {
+        std::atomic_store_explicit(&state, std::move(next), std::memory_order_release);
+    }
+    
+    std::string getStringDescriptor(uint8_t index) const {
         if (!handle || index == 0) return "";
         
         unsigned char buffer[MAX_STRING_LENGTH];
@@ -33,39 +122,99 @@ public:
         if (ret < 0) return "";
         return std::string(reinterpret_cast<char*>(buffer), ret);
     }
+    
+    // Fills in the configuration and strings of a block not yet published
+    void describe(DescriptorState& next) const {
+        if (libusb_get_active_config_descriptor(next.device, &next.config) != LIBUSB_SUCCESS) {
+            next.config = nullptr;
+        }
+        
+        // Prefer the device's own string descriptors; fall back to the strings
+        // the kernel already read so unopened devices still get a name
+        if (handle) {
+            next.manufacturer = getStringDescriptor(next.descriptor.iManufacturer);
+            next.product = getStringDescriptor(next.descriptor.iProduct);
+            next.serialNumber = getStringDescriptor(next.descriptor.iSerialNumber);
+        } else {
+            next.manufacturer = readUsbAttribute(next.portPath, "manufacturer");
+            next.product = readUsbAttribute(next.portPath, "product");
+            next.serialNumber = readUsbAttribute(next.portPath, "serial");
+        }
+        
+        next.updateDescriptorHash();
+        next.updateStableId();
+    }
+    
+    PooledTransfer* acquireTransfer(size_t bufferLength) {
+        if (!handle || !transfers) return nullptr;
+        return transfers->acquire(bufferLength);
+    }
+    
+    // Shared by the submit* calls; fill_* helpers clobber user_data, so the
+    // pool's per-slot context is passed straight back in
+    int fillAndSubmit(PooledTransfer* slot, uint8_t endpoint, uint8_t type,
+                      const uint8_t* data, size_t length, unsigned int timeout,
+                      TransferCallback callback) {
+        libusb_transfer* transfer = slot->transfer;
+        if (data && !(endpoint & LIBUSB_ENDPOINT_IN)) {
+            std::memcpy(slot->buffer.data(), data, length);
+        }
+        
+        if (type == LIBUSB_TRANSFER_TYPE_BULK) {
+            libusb_fill_bulk_transfer(transfer, handle, endpoint, slot->buffer.data(),
+                                      static_cast<int>(length), nullptr,
+                                      transfer->user_data, timeout);
+        } else {
+            libusb_fill_interrupt_transfer(transfer, handle, endpoint, slot->buffer.data(),
+                                           static_cast<int>(length), nullptr,
+                                           transfer->user_data, timeout);
+        }
+        transfer->num_iso_packets = 0;
+        
+        return transfers->submit(slot, std::move(callback));
+    }
+    
+    static TransferCallback promiseCallback(std::shared_ptr<std::promise<TransferResult>> promise,
+                                            bool isInput) {
+        return [promise, isInput](const TransferCompletion& completion) {
+            TransferResult result;
+            result.status = completion.status;
+            if (isInput && completion.data && completion.actualLength > 0) {
+                result.data.assign(completion.data, completion.data + completion.actualLength);
+            }
+            promise->set_value(std::move(result));
+        };
+    }
 };
 
 UsbDevice::UsbDevice(libusb_device* device, libusb_context* context, QObject* parent)
     : QObject(parent)
     , d(std::make_unique<Private>()) {
     
-    d->device = device;
     d->context = context;
-    libusb_ref_device(device);
-    
-    if (libusb_get_device_descriptor(device, &d->descriptor) == 0) {
-        d->updateIdentifier();
-    }
+    d->publish(std::make_shared<const DescriptorState>(device));
 }
 
 UsbDevice::~UsbDevice() {
     close();
-    if (d->device) {
-        libusb_unref_device(d->device);
-    }
 }
 
 DeviceIdentifier UsbDevice::identifier() const {
-    return d->identifier;
+    return d->current()->identifier;
 }
 
 std::string UsbDevice::description() const {
+    auto state = d->current();
     std::stringstream ss;
     
-    if (d->handle) {
-        std::string manufacturer = d->getStringDescriptor(d->descriptor.iManufacturer);
-        std::string product = d->getStringDescriptor(d->descriptor.iProduct);
-        std::string serial = d->getStringDescriptor(d->descriptor.iSerialNumber);
+    if (!state->manufacturer.empty() || !state->product.empty()) {
+        if (!state->manufacturer.empty()) ss << state->manufacturer << " ";
+        if (!state->product.empty()) ss << state->product << " ";
+        if (!state->serialNumber.empty()) ss << "(" << state->serialNumber << ")";
+    } else if (d->handle) {
+        std::string manufacturer = d->getStringDescriptor(state->descriptor.iManufacturer);
+        std::string product = d->getStringDescriptor(state->descriptor.iProduct);
+        std::string serial = d->getStringDescriptor(state->descriptor.iSerialNumber);
         
         if (!manufacturer.empty()) ss << manufacturer << " ";
         if (!product.empty()) ss << product << " ";
@@ -75,21 +224,82 @@ std::string UsbDevice::description() const {
     if (ss.str().empty()) {
         ss << "Unknown Device "
            << std::hex << std::uppercase
-           << d->descriptor.idVendor << ":"
-           << d->descriptor.idProduct;
+           << state->descriptor.idVendor << ":"
+           << state->descriptor.idProduct;
     }
     
     return ss.str();
 }
 
 DeviceClass UsbDevice::deviceClass() const {
-    return static_cast<DeviceClass>(d->descriptor.bDeviceClass);
+    return static_cast<DeviceClass>(d->current()->descriptor.bDeviceClass);
+}
+
+bool UsbDevice::loadDescriptors() {
+    auto next = std::make_shared<DescriptorState>(d->current()->device);
+    d->describe(*next);
+    bool loaded = next->config != nullptr;
+    d->publish(std::move(next));
+    return loaded;
+}
+
+libusb_device_descriptor UsbDevice::deviceDescriptor() const {
+    return d->current()->descriptor;
+}
+
+std::shared_ptr<const libusb_config_descriptor> UsbDevice::configDescriptor() const {
+    auto state = d->current();
+    if (!state->config) return nullptr;
+    
+    // Shares ownership of the whole block, so a rebind can't free it under us
+    const libusb_config_descriptor* config = state->config;
+    return std::shared_ptr<const libusb_config_descriptor>(std::move(state), config);
+}
+
+std::string UsbDevice::manufacturer() const {
+    return d->current()->manufacturer;
+}
+
+std::string UsbDevice::product() const {
+    return d->current()->product;
+}
+
+std::string UsbDevice::serialNumber() const {
+    return d->current()->serialNumber;
+}
+
+std::string UsbDevice::portPath() const {
+    return d->current()->portPath;
+}
+
+std::string UsbDevice::sysfsPath() const {
+    return usbSysfsRoot() + "/" + portPath();
+}
+
+bool UsbDevice::setInterfaceAuthorized(uint8_t interfaceNumber, bool authorized) {
+    auto state = d->current();
+    if (!state->config) return false;
+    
+    return setUsbInterfaceAuthorized(state->portPath, state->config->bConfigurationValue,
+                                     interfaceNumber, authorized);
+}
+
+bool UsbDevice::setAuthorized(bool authorized) {
+    return setUsbDeviceAuthorized(portPath(), authorized);
+}
+
+uint64_t UsbDevice::descriptorHash() const {
+    return d->current()->descriptorHash;
+}
+
+std::string UsbDevice::stableId() const {
+    return d->current()->stableId;
 }
 
 bool UsbDevice::open() {
     if (d->isOpened) return true;
     
-    int ret = libusb_open(d->device, &d->handle);
+    int ret = libusb_open(d->current()->device, &d->handle);
     if (ret != LIBUSB_SUCCESS) {
         emit errorOccurred("Failed to open device: " + 
                           std::string(libusb_error_name(ret)));
@@ -97,10 +307,20 @@ bool UsbDevice::open() {
     }
     
     d->isOpened = true;
+    d->transfers = std::make_unique<TransferPool>();
+    d->transfers->setObserver(d->transferObserver);
     return true;
 }
 
 void UsbDevice::close() {
+    // In-flight transfers must complete before their handle goes away; this
+    // relies on the event thread, so never close from a completion callback
+    if (d->transfers) {
+        d->transfers->cancelAll();
+        d->transfers->waitIdle(std::chrono::milliseconds(DEFAULT_TIMEOUT));
+        d->transfers.reset();
+    }
+    
     if (d->handle) {
         libusb_close(d->handle);
         d->handle = nullptr;
@@ -112,6 +332,23 @@ bool UsbDevice::isOpen() const {
     return d->isOpened;
 }
 
+void UsbDevice::rebind(libusb_device* device) {
+    if (!device || device == d->current()->device) return;
+    
+    bool wasOpen = d->isOpened;
+    close();
+    
+    // Readers see either the old block or the complete new one; the old
+    // one, with its config and device reference, lives until they drop it
+    auto next = std::make_shared<DescriptorState>(device);
+    d->describe(*next);
+    d->publish(std::move(next));
+    
+    if (wasOpen && open()) {
+        loadDescriptors();
+    }
+}
+
 bool UsbDevice::reset() {
     if (!d->handle) return false;
     
@@ -160,6 +397,171 @@ bool UsbDevice::releaseInterface(int interface) {
     return true;
 }
 
+bool UsbDevice::submitControl(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                              const uint8_t* data, uint16_t length,
+                              TransferCallback callback, unsigned int timeout) {
+    auto slot = d->acquireTransfer(LIBUSB_CONTROL_SETUP_SIZE + length);
+    if (!slot) return false;
+    
+    unsigned char* buffer = slot->buffer.data();
+    libusb_fill_control_setup(buffer, requestType, request, value, index, length);
+    if (data && !(requestType & LIBUSB_ENDPOINT_IN)) {
+        std::memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+    }
+    libusb_fill_control_transfer(slot->transfer, d->handle, buffer, nullptr,
+                                 slot->transfer->user_data, timeout);
+    slot->transfer->num_iso_packets = 0;
+    
+    int ret = d->transfers->submit(slot, std::move(callback));
+    if (ret != LIBUSB_SUCCESS) {
+        emit errorOccurred("Failed to submit control transfer: " +
+                          std::string(libusb_error_name(ret)));
+        return false;
+    }
+    return true;
+}
+
+bool UsbDevice::submitBulk(uint8_t endpoint, const uint8_t* data, size_t length,
+                           TransferCallback callback, unsigned int timeout) {
+    auto slot = d->acquireTransfer(length);
+    if (!slot) return false;
+    
+    int ret = d->fillAndSubmit(slot, endpoint, LIBUSB_TRANSFER_TYPE_BULK,
+                               data, length, timeout, std::move(callback));
+    if (ret != LIBUSB_SUCCESS) {
+        emit errorOccurred("Failed to submit bulk transfer: " +
+                          std::string(libusb_error_name(ret)));
+        return false;
+    }
+    return true;
+}
+
+bool UsbDevice::submitInterrupt(uint8_t endpoint, const uint8_t* data, size_t length,
+                                TransferCallback callback, unsigned int timeout) {
+    auto slot = d->acquireTransfer(length);
+    if (!slot) return false;
+    
+    int ret = d->fillAndSubmit(slot, endpoint, LIBUSB_TRANSFER_TYPE_INTERRUPT,
+                               data, length, timeout, std::move(callback));
+    if (ret != LIBUSB_SUCCESS) {
+        emit errorOccurred("Failed to submit interrupt transfer: " +
+                          std::string(libusb_error_name(ret)));
+        return false;
+    }
+    return true;
+}
+
+bool UsbDevice::submitIso(uint8_t endpoint, const uint8_t* data, int numPackets, int packetSize,
+                          TransferCallback callback, unsigned int timeout) {
+    if (numPackets <= 0 || numPackets > MAX_ISO_PACKETS || packetSize <= 0) return false;
+    
+    size_t length = static_cast<size_t>(numPackets) * packetSize;
+    auto slot = d->acquireTransfer(length);
+    if (!slot) return false;
+    
+    if (data && !(endpoint & LIBUSB_ENDPOINT_IN)) {
+        std::memcpy(slot->buffer.data(), data, length);
+    }
+    libusb_fill_iso_transfer(slot->transfer, d->handle, endpoint, slot->buffer.data(),
+                             static_cast<int>(length), numPackets, nullptr,
+                             slot->transfer->user_data, timeout);
+    libusb_set_iso_packet_lengths(slot->transfer, packetSize);
+    
+    int ret = d->transfers->submit(slot, std::move(callback));
+    if (ret != LIBUSB_SUCCESS) {
+        emit errorOccurred("Failed to submit isochronous transfer: " +
+                          std::string(libusb_error_name(ret)));
+        return false;
+    }
+    return true;
+}
+
+std::future<TransferResult> UsbDevice::controlTransfer(uint8_t requestType, uint8_t request,
+                                                       uint16_t value, uint16_t index,
+                                                       const uint8_t* data, uint16_t length,
+                                                       unsigned int timeout) {
+    auto promise = std::make_shared<std::promise<TransferResult>>();
+    auto future = promise->get_future();
+    
+    if (!submitControl(requestType, request, value, index, data, length,
+                       Private::promiseCallback(promise, requestType & LIBUSB_ENDPOINT_IN),
+                       timeout)) {
+        TransferResult result;
+        result.status = LIBUSB_ERROR_IO;
+        promise->set_value(std::move(result));
+    }
+    return future;
+}
+
+std::future<TransferResult> UsbDevice::bulkTransfer(uint8_t endpoint, const uint8_t* data,
+                                                    size_t length, unsigned int timeout) {
+    auto promise = std::make_shared<std::promise<TransferResult>>();
+    auto future = promise->get_future();
+    
+    if (!submitBulk(endpoint, data, length,
+                    Private::promiseCallback(promise, endpoint & LIBUSB_ENDPOINT_IN),
+                    timeout)) {
+        TransferResult result;
+        result.status = LIBUSB_ERROR_IO;
+        promise->set_value(std::move(result));
+    }
+    return future;
+}
+
+std::future<TransferResult> UsbDevice::interruptTransfer(uint8_t endpoint, const uint8_t* data,
+                                                         size_t length, unsigned int timeout) {
+    auto promise = std::make_shared<std::promise<TransferResult>>();
+    auto future = promise->get_future();
+    
+    if (!submitInterrupt(endpoint, data, length,
+                         Private::promiseCallback(promise, endpoint & LIBUSB_ENDPOINT_IN),
+                         timeout)) {
+        TransferResult result;
+        result.status = LIBUSB_ERROR_IO;
+        promise->set_value(std::move(result));
+    }
+    return future;
+}
+
+TransferAwaitable UsbDevice::control(uint8_t requestType, uint8_t request, uint16_t value,
+                                     uint16_t index, const uint8_t* data, uint16_t length,
+                                     unsigned int timeout) {
+    return TransferAwaitable(this, requestType, request, value, index, data, length, timeout);
+}
+
+TransferAwaitable UsbDevice::bulkRead(uint8_t endpoint, size_t length, unsigned int timeout) {
+    return TransferAwaitable(this, TransferAwaitable::Kind::Bulk, endpoint | LIBUSB_ENDPOINT_IN,
+                             nullptr, length, timeout);
+}
+
+TransferAwaitable UsbDevice::bulkWrite(uint8_t endpoint, const uint8_t* data, size_t length,
+                                       unsigned int timeout) {
+    return TransferAwaitable(this, TransferAwaitable::Kind::Bulk, endpoint & ~LIBUSB_ENDPOINT_IN,
+                             data, length, timeout);
+}
+
+TransferAwaitable UsbDevice::interruptRead(uint8_t endpoint, size_t length, unsigned int timeout) {
+    return TransferAwaitable(this, TransferAwaitable::Kind::Interrupt, endpoint | LIBUSB_ENDPOINT_IN,
+                             nullptr, length, timeout);
+}
+
+void UsbDevice::setTransferObserver(TransferObserver observer) {
+    d->transferObserver = std::move(observer);
+    if (d->transfers) {
+        d->transfers->setObserver(d->transferObserver);
+    }
+}
+
+void UsbDevice::cancelTransfers() {
+    if (d->transfers) {
+        d->transfers->cancelAll();
+    }
+}
+
+size_t UsbDevice::pendingTransfers() const {
+    return d->transfers ? d->transfers->inFlight() : 0;
+}
+
 PowerStats UsbDevice::getPowerStats() const {
     return d->powerStats;
 }
@@ -168,8 +570,26 @@ BandwidthStats UsbDevice::getBandwidthStats() const {
     return d->bandwidthStats;
 }
 
+std::string UsbDevice::portPathOf(libusb_device* device) {
+    uint8_t ports[7];
+    int count = libusb_get_port_numbers(device, ports, sizeof(ports));
+    
+    std::stringstream ss;
+    if (count <= 0) {
+        // Root hubs are named usbN in sysfs
+        ss << "usb" << static_cast<int>(libusb_get_bus_number(device));
+        return ss.str();
+    }
+    
+    ss << static_cast<int>(libusb_get_bus_number(device));
+    for (int i = 0; i < count; i++) {
+        ss << (i == 0 ? "-" : ".") << static_cast<int>(ports[i]);
+    }
+    return ss.str();
+}
+
 libusb_device* UsbDevice::nativeDevice() const {
-    return d->device;
+    return d->current()->device;
 }
 
 libusb_device_handle* UsbDevice::nativeHandle() const {
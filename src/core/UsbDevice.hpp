@@ -1,13 +1,17 @@
 #pragma once
 #include <usb-monitor/Types.hpp>
+#include <usb-monitor/Constants.hpp>
+#include "TransferPool.hpp"
+#include "DeviceSession.hpp"
 #include <libusb-1.0/libusb.h>
 #include <QObject>
+#include <future>
 #include <memory>
 #include <string>
 
 namespace usb_monitor {
 
-class UsbDevice : public QObject {
+class UsbDevice : public QObject, public TransferTarget {
     Q_OBJECT
 
 public:
@@ -18,15 +22,87 @@ public:
     std::string description() const;
     DeviceClass deviceClass() const;
     
+    // Descriptor cache, filled by loadDescriptors() so later readers don't
+    // have to go back to libusb or the device. Safe from any thread: rebind()
+    // swaps in a new cache, and a held config stays valid until released.
+    bool loadDescriptors();
+    libusb_device_descriptor deviceDescriptor() const;
+    std::shared_ptr<const libusb_config_descriptor> configDescriptor() const;
+    std::string manufacturer() const;
+    std::string product() const;
+    std::string serialNumber() const;
+    std::string portPath() const;
+    std::string sysfsPath() const;
+    
+    // Writes the interface's sysfs authorized attribute, which the kernel
+    // honours by unbinding the driver and refusing to rebind; needs root
+    bool setInterfaceAuthorized(uint8_t interfaceNumber, bool authorized);
+    
+    // The same for the whole device: deauthorized, it is unconfigured and
+    // no driver binds to any of its interfaces
+    bool setAuthorized(bool authorized);
+    uint64_t descriptorHash() const;
+    
+    // Survives re-enumeration: port path + serial + descriptor hash
+    std::string stableId() const;
+    
+    static std::string portPathOf(libusb_device* device);
+    
     bool open();
     void close();
     bool isOpen() const;
     
+    // Point this object at a re-enumerated instance of the same device,
+    // keeping everything keyed on it (stats, authorization) intact
+    void rebind(libusb_device* device);
+    
     bool reset();
     bool setConfiguration(int config);
     bool claimInterface(int interface);
     bool releaseInterface(int interface);
     
+    // Asynchronous transfers on the open handle, backed by a per-device pool
+    // of preallocated libusb_transfers. Callbacks run on the libusb event
+    // thread. For IN transfers data may be null and length is the read size.
+    bool submitControl(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                       const uint8_t* data, uint16_t length,
+                       TransferCallback callback, unsigned int timeout = DEFAULT_TIMEOUT) override;
+    bool submitBulk(uint8_t endpoint, const uint8_t* data, size_t length,
+                    TransferCallback callback, unsigned int timeout = DEFAULT_TIMEOUT) override;
+    bool submitInterrupt(uint8_t endpoint, const uint8_t* data, size_t length,
+                         TransferCallback callback, unsigned int timeout = DEFAULT_TIMEOUT) override;
+    bool submitIso(uint8_t endpoint, const uint8_t* data, int numPackets, int packetSize,
+                   TransferCallback callback, unsigned int timeout = DEFAULT_TIMEOUT);
+    
+    std::future<TransferResult> controlTransfer(uint8_t requestType, uint8_t request,
+                                                uint16_t value, uint16_t index,
+                                                const uint8_t* data, uint16_t length,
+                                                unsigned int timeout = DEFAULT_TIMEOUT);
+    std::future<TransferResult> bulkTransfer(uint8_t endpoint, const uint8_t* data, size_t length,
+                                             unsigned int timeout = DEFAULT_TIMEOUT);
+    std::future<TransferResult> interruptTransfer(uint8_t endpoint, const uint8_t* data, size_t length,
+                                                  unsigned int timeout = DEFAULT_TIMEOUT);
+    
+    // Coroutine forms of the same transfers: co_await suspends the session
+    // without blocking a thread and resumes it on the libusb event thread
+    TransferAwaitable control(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                              const uint8_t* data = nullptr, uint16_t length = 0,
+                              unsigned int timeout = DEFAULT_TIMEOUT);
+    TransferAwaitable bulkRead(uint8_t endpoint, size_t length,
+                               unsigned int timeout = DEFAULT_TIMEOUT);
+    TransferAwaitable bulkWrite(uint8_t endpoint, const uint8_t* data, size_t length,
+                                unsigned int timeout = DEFAULT_TIMEOUT);
+    TransferAwaitable interruptRead(uint8_t endpoint, size_t length,
+                                    unsigned int timeout = DEFAULT_TIMEOUT);
+    
+    // Sees every completed transfer on the open handle, now and after later
+    // open() calls; see TransferObserver for where it runs
+    void setTransferObserver(TransferObserver observer);
+    
+    // Cancelled transfers still complete, with LIBUSB_TRANSFER_CANCELLED
+    void cancelTransfers();
+    size_t pendingTransfers() const;
+    
     PowerStats getPowerStats() const;
     BandwidthStats getBandwidthStats() const;
     
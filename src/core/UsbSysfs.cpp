@@ -0,0 +1,162 @@
+#include "UsbSysfs.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace usb_monitor {
+
+namespace {
+
+std::mutex rootMutex;
+std::string root = "/sys/bus/usb/devices";
+
+// Buses whose interface_authorized_default we turned off, with the paths
+// laid out beforehand: restoring may run in a signal handler, where only
+// open() and write() are safe
+struct HeldBus {
+    char path[256];
+};
+
+constexpr size_t MAX_HELD_BUSES = 64;
+HeldBus heldBuses[MAX_HELD_BUSES];
+std::atomic<size_t> heldCount{0};
+std::mutex holdMutex;
+
+constexpr int FATAL_SIGNALS[] = {SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGABRT,
+                                 SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+
+// Async-signal-safe
+void restoreHeldBuses() {
+    size_t count = heldCount.exchange(0);
+    for (size_t i = 0; i < count; i++) {
+        int fd = ::open(heldBuses[i].path, O_WRONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        ssize_t written = ::write(fd, "1", 1);
+        (void)written;
+        ::close(fd);
+    }
+}
+
+void restoreAndReraise(int signal) {
+    restoreHeldBuses();
+    
+    // SA_RESETHAND put the default action back
+    ::raise(signal);
+}
+
+// Only signals nobody else handles; the rest are the application's
+void installRestoreHandlers() {
+    std::atexit(restoreHeldBuses);
+    
+    for (int signal : FATAL_SIGNALS) {
+        struct sigaction current {};
+        if (::sigaction(signal, nullptr, &current) != 0) continue;
+        if ((current.sa_flags & SA_SIGINFO) || current.sa_handler != SIG_DFL) continue;
+        
+        struct sigaction action {};
+        action.sa_handler = restoreAndReraise;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESETHAND;
+        ::sigaction(signal, &action, nullptr);
+    }
+}
+
+} // namespace
+
+std::string usbSysfsRoot() {
+    std::lock_guard<std::mutex> lock(rootMutex);
+    return root;
+}
+
+void setUsbSysfsRoot(std::string path) {
+    std::lock_guard<std::mutex> lock(rootMutex);
+    root = std::move(path);
+}
+
+std::string readUsbAttribute(const std::string& node, const std::string& name) {
+    if (node.empty()) return "";
+    
+    std::ifstream file(usbSysfsRoot() + "/" + node + "/" + name);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+bool writeUsbAttribute(const std::string& node, const std::string& name, const std::string& value) {
+    if (node.empty()) return false;
+    
+    std::ofstream file(usbSysfsRoot() + "/" + node + "/" + name);
+    if (!file) return false;
+    
+    file << value;
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+bool setUsbDeviceAuthorized(const std::string& portPath, bool authorized) {
+    // e.g. /sys/bus/usb/devices/1-2/authorized
+    return writeUsbAttribute(portPath, "authorized", authorized ? "1" : "0");
+}
+
+bool setUsbInterfaceAuthorized(const std::string& portPath, uint8_t configuration,
+                               uint8_t interfaceNumber, bool authorized) {
+    if (portPath.empty()) return false;
+    
+    // e.g. /sys/bus/usb/devices/1-2/1-2:1.0/authorized
+    std::string interface = portPath + ":" + std::to_string(configuration) + "." +
+                            std::to_string(interfaceNumber);
+    return writeUsbAttribute(portPath + "/" + interface, "authorized", authorized ? "1" : "0");
+}
+
+size_t holdUsbInterfaceAuthorizedDefault() {
+    std::lock_guard<std::mutex> lock(holdMutex);
+    static std::once_flag handlersOnce;
+    std::call_once(handlersOnce, installRestoreHandlers);
+    
+    std::string sysfs = usbSysfsRoot();
+    std::error_code error;
+    std::filesystem::directory_iterator it(sysfs, error);
+    if (error) return 0;
+    
+    size_t count = heldCount.load();
+    size_t off = 0;
+    for (const auto& entry : it) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("usb", 0) != 0) continue;
+        
+        // Buses already off, held or set so by the system, stay as they are
+        auto value = readUsbAttribute(name, "interface_authorized_default");
+        if (value == "0") {
+            off++;
+            continue;
+        }
+        if (value != "1") continue;
+        
+        std::string path = sysfs + "/" + name + "/interface_authorized_default";
+        if (count >= MAX_HELD_BUSES || path.size() >= sizeof(HeldBus::path)) continue;
+        if (!writeUsbAttribute(name, "interface_authorized_default", "0")) continue;
+        
+        // Published before the count, so a handler only sees whole paths
+        std::memcpy(heldBuses[count].path, path.c_str(), path.size() + 1);
+        heldCount.store(++count);
+        off++;
+    }
+    return off;
+}
+
+void restoreUsbInterfaceAuthorizedDefault() {
+    std::lock_guard<std::mutex> lock(holdMutex);
+    restoreHeldBuses();
+}
+
+bool usbInterfaceAuthorizedDefaultHeld() {
+    return heldCount.load() > 0;
+}
+
+} // namespace usb_monitor
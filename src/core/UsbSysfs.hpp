@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace usb_monitor {
+
+// The USB device tree in sysfs, /sys/bus/usb/devices unless pointed
+// elsewhere, as tests do with a fake tree. Devices are named by port path
+// ("1-2.3", root hubs "usb1"), their interfaces "1-2.3:1.0" for
+// configuration 1, interface 0. Writes need root.
+std::string usbSysfsRoot();
+void setUsbSysfsRoot(std::string root);
+
+// First line of an attribute, empty if it cannot be read
+std::string readUsbAttribute(const std::string& node, const std::string& name);
+bool writeUsbAttribute(const std::string& node, const std::string& name, const std::string& value);
+
+// The kernel's authorized attributes: a deauthorized device stays
+// unconfigured, a deauthorized interface unbound, until set again
+bool setUsbDeviceAuthorized(const std::string& portPath, bool authorized);
+bool setUsbInterfaceAuthorized(const std::string& portPath, uint8_t configuration,
+                               uint8_t interfaceNumber, bool authorized);
+
+// Turns interface_authorized_default off on every bus that has it on,
+// until restored. The buses are put back at exit and on fatal signals
+// too, so a crash does not leave new devices unusable system-wide.
+// Returns the buses that have it off afterwards.
+size_t holdUsbInterfaceAuthorizedDefault();
+void restoreUsbInterfaceAuthorizedDefault();
+bool usbInterfaceAuthorizedDefaultHeld();
+
+} // namespace usb_monitor
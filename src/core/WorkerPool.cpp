@@ -0,0 +1,98 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace usb_monitor {
+
+class WorkerPool::Private {
+public:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    mutable std::mutex jobsMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable idle;
+    size_t activeJobs{0};
+    bool stopping{false};
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(jobsMutex);
+                jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return; // Stopping and fully drained
+                
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                activeJobs++;
+            }
+            
+            job();
+            
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex);
+                activeJobs--;
+                if (jobs.empty() && activeJobs == 0) {
+                    idle.notify_all();
+                }
+            }
+        }
+    }
+};
+
+WorkerPool::WorkerPool(size_t threadCount)
+    : d(std::make_unique<Private>()) {
+    
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    d->threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        d->threads.emplace_back([this] { d->workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(d->jobsMutex);
+        d->stopping = true;
+    }
+    d->jobAvailable.notify_all();
+    
+    for (auto& thread : d->threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+    if (!job) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(d->jobsMutex);
+        d->jobs.push_back(std::move(job));
+    }
+    d->jobAvailable.notify_one();
+}
+
+void WorkerPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(d->jobsMutex);
+    d->idle.wait(lock, [this] { return d->jobs.empty() && d->activeJobs == 0; });
+}
+
+size_t WorkerPool::threadCount() const {
+    return d->threads.size();
+}
+
+size_t WorkerPool::pendingJobs() const {
+    std::lock_guard<std::mutex> lock(d->jobsMutex);
+    return d->jobs.size() + d->activeJobs;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,28 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+namespace usb_monitor {
+
+// Fixed-size pool of worker threads draining a shared FIFO job queue.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threadCount = 0); // 0 = hardware concurrency
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> job);
+    void waitIdle();
+
+    size_t threadCount() const;
+    size_t pendingJobs() const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,390 @@
+#include "FlashEngine.hpp"
+#include "../core/UsbDevice.hpp"
+#include "../core/Logger.hpp"
+#include <QMetaObject>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace usb_monitor {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Resumes sleeping sessions (DFU poll timeouts, retry backoff) from a
+// single timer thread
+class DelayQueue {
+public:
+    DelayQueue() : thread([this] { run(); }) {}
+    
+    ~DelayQueue() {
+        stop();
+    }
+    
+    // Wakes whatever is still sleeping so its session can run down; later
+    // schedule() calls return false
+    void stop() {
+        std::vector<std::coroutine_handle<>> leftover;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!queue.empty()) {
+                leftover.push_back(queue.top().handle);
+                queue.pop();
+            }
+        }
+        for (auto handle : leftover) {
+            handle.resume();
+        }
+    }
+    
+    // Returns false once stopping, in which case the caller does not suspend
+    bool schedule(Clock::time_point deadline, std::coroutine_handle<> handle) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return false;
+            queue.push(Entry{deadline, handle});
+        }
+        wake.notify_one();
+        return true;
+    }
+    
+private:
+    struct Entry {
+        Clock::time_point deadline;
+        std::coroutine_handle<> handle;
+        
+        bool operator>(const Entry& other) const { return deadline > other.deadline; }
+    };
+    
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (queue.empty()) {
+                wake.wait(lock);
+                continue;
+            }
+            auto deadline = queue.top().deadline;
+            if (Clock::now() < deadline) {
+                wake.wait_until(lock, deadline);
+                continue;
+            }
+            auto handle = queue.top().handle;
+            queue.pop();
+            
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+    }
+    
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping{false};
+    std::thread thread;
+};
+
+class DelayAwaitable {
+public:
+    DelayAwaitable(DelayQueue* queue, uint32_t milliseconds)
+        : queue(queue), milliseconds(milliseconds) {}
+    
+    bool await_ready() const noexcept { return milliseconds == 0; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        return queue->schedule(Clock::now() + std::chrono::milliseconds(milliseconds), handle);
+    }
+    void await_resume() const noexcept {}
+    
+private:
+    DelayQueue* queue;
+    uint32_t milliseconds;
+};
+
+// A device transfer that fails fast instead once the engine is cancelled
+class LinkTransfer {
+public:
+    LinkTransfer() = default;
+    explicit LinkTransfer(TransferAwaitable transfer) : transfer(std::move(transfer)) {}
+    
+    bool await_ready() const noexcept { return !transfer; }
+    bool await_suspend(std::coroutine_handle<> handle) { return transfer->await_suspend(handle); }
+    TransferResult await_resume() {
+        if (!transfer) {
+            TransferResult result;
+            result.status = LIBUSB_TRANSFER_CANCELLED;
+            return result;
+        }
+        return transfer->await_resume();
+    }
+    
+private:
+    std::optional<TransferAwaitable> transfer;
+};
+
+// The Link the flashing protocols run over
+struct DeviceLink {
+    UsbDevice* device{nullptr};
+    DelayQueue* delays{nullptr};
+    const std::atomic<bool>* cancelled{nullptr};
+    
+    LinkTransfer control(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                         const uint8_t* data, uint16_t length, unsigned int timeout) {
+        if (cancelled->load()) {
+            return LinkTransfer();
+        }
+        return LinkTransfer(device->control(requestType, request, value, index,
+                                            data, length, timeout));
+    }
+    
+    PipelinedWrite writePipelined(uint8_t endpoint, const uint8_t* data, size_t length,
+                                  size_t blockSize, size_t depth, unsigned int timeout,
+                                  std::function<void(size_t)> onBytes) {
+        return PipelinedWrite(device, cancelled, endpoint, data, length,
+                              blockSize, depth, timeout, std::move(onBytes));
+    }
+    
+    DelayAwaitable delay(uint32_t milliseconds) {
+        return DelayAwaitable(delays, cancelled->load() ? 0 : milliseconds);
+    }
+};
+
+struct FlashSession {
+    std::shared_ptr<UsbDevice> device;
+    std::shared_ptr<const std::vector<uint8_t>> image;
+    FlashOptions options;
+    DeviceLink link;
+    FlashOutcome outcome;
+    int attempts{0};
+    size_t lastWritten{0};
+    int lastPercent{-1};
+};
+
+Task<void> runFlashSession(FlashSession* session, FlashProgress progress) {
+    session->outcome = co_await flashImage(session->link, *session->image, session->options,
+                                           std::move(progress), session->attempts);
+}
+
+} // namespace
+
+class FlashEngine::Private {
+public:
+    std::shared_ptr<const std::vector<uint8_t>> image{std::make_shared<std::vector<uint8_t>>()};
+    FlashOptions options;
+    std::atomic<bool> cancelled{false};
+    FlashQueue queue;
+    
+    // Queued devices are kept alive here, running ones by their session.
+    // Progress callbacks on the event thread only touch the queue.
+    mutable std::mutex devicesMutex;
+    std::map<FlashQueue::Key, std::shared_ptr<UsbDevice>> queued;
+    std::map<UsbDevice*, std::unique_ptr<FlashSession>> sessions;
+    
+    std::unique_ptr<DelayQueue> delays{std::make_unique<DelayQueue>()};
+    SessionScheduler scheduler;
+};
+
+FlashEngine::FlashEngine(QObject* parent)
+    : QObject(parent)
+    , d(std::make_unique<Private>()) {
+}
+
+FlashEngine::~FlashEngine() {
+    cancel();
+    
+    // Sessions sleeping in the delay queue are woken and fail fast. They
+    // point into this engine, so every one must run down before it goes
+    // away; their transfers are cancelled and complete on the event thread.
+    d->delays->stop();
+    while (!d->scheduler.waitAll(std::chrono::milliseconds(DEFAULT_TIMEOUT * 5))) {
+        LOG_WARNING("Flash sessions still running at shutdown, waiting for " +
+                    std::to_string(d->scheduler.activeSessions()));
+    }
+    
+    for (auto& [device, session] : d->sessions) {
+        device->releaseInterface(session->options.interfaceNumber);
+    }
+}
+
+void FlashEngine::setImage(std::vector<uint8_t> image) {
+    d->image = std::make_shared<const std::vector<uint8_t>>(std::move(image));
+}
+
+void FlashEngine::setOptions(const FlashOptions& options) {
+    d->options = options;
+}
+
+FlashOptions FlashEngine::options() const {
+    return d->options;
+}
+
+void FlashEngine::setSessionsPerBus(size_t sessions) {
+    d->queue.setSessionsPerBus(sessions);
+    startPending();
+}
+
+size_t FlashEngine::sessionsPerBus() const {
+    return d->queue.sessionsPerBus();
+}
+
+bool FlashEngine::enqueue(std::shared_ptr<UsbDevice> device) {
+    if (!device) return false;
+    if (d->image->empty()) {
+        emit flashError("No firmware image set");
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        bool newRun = !d->queue.isRunning();
+        if (!d->queue.enqueue(device.get(), device->identifier().busNumber, Clock::now())) {
+            return false;
+        }
+        if (newRun) {
+            d->cancelled = false;
+        }
+        d->queued[device.get()] = device;
+    }
+    
+    startPending();
+    return true;
+}
+
+void FlashEngine::cancel() {
+    std::vector<std::shared_ptr<UsbDevice>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->cancelled = true;
+        for (auto key : d->queue.cancel(Clock::now())) {
+            auto it = d->queued.find(key);
+            if (it != d->queued.end()) {
+                dropped.push_back(std::move(it->second));
+                d->queued.erase(it);
+            }
+        }
+        for (auto& [device, session] : d->sessions) {
+            device->cancelTransfers();
+        }
+    }
+    
+    for (const auto& device : dropped) {
+        emit flashComplete(device, false, "Cancelled");
+    }
+    if (!dropped.empty() && !isRunning()) {
+        emit allComplete(stats());
+    }
+}
+
+bool FlashEngine::isRunning() const {
+    return d->queue.isRunning();
+}
+
+FlashStats FlashEngine::stats() const {
+    return d->queue.stats(Clock::now());
+}
+
+void FlashEngine::startPending() {
+    for (;;) {
+        std::shared_ptr<UsbDevice> device;
+        {
+            std::lock_guard<std::mutex> lock(d->devicesMutex);
+            auto key = d->queue.startNext(Clock::now());
+            if (!key) return;
+            
+            auto it = d->queued.find(*key);
+            device = std::move(it->second);
+            d->queued.erase(it);
+        }
+        startSession(device);
+    }
+}
+
+void FlashEngine::startSession(std::shared_ptr<UsbDevice> device) {
+    if (!device->isOpen() && !device->open()) {
+        finishSession(device, FlashOutcome{false, "Failed to open device"}, 0);
+        return;
+    }
+    if (!device->claimInterface(d->options.interfaceNumber)) {
+        finishSession(device, FlashOutcome{false, "Failed to claim interface"}, 0);
+        return;
+    }
+    
+    auto session = std::make_unique<FlashSession>();
+    session->device = device;
+    session->image = d->image;
+    session->options = d->options;
+    session->link = DeviceLink{device.get(), d->delays.get(), &d->cancelled};
+    FlashSession* raw = session.get();
+    
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        d->sessions[device.get()] = std::move(session);
+    }
+    
+    // Progress arrives on the event thread; UI updates are throttled to one
+    // per percent and posted back to this object's thread
+    auto progress = [this, raw](size_t written, size_t total) {
+        if (written < raw->lastWritten) {
+            raw->lastWritten = 0;  // A retry started over
+        }
+        d->queue.addBytes(raw->device.get(), written - raw->lastWritten);
+        raw->lastWritten = written;
+        
+        int percent = total ? static_cast<int>(written * 100 / total) : 100;
+        if (percent != raw->lastPercent) {
+            raw->lastPercent = percent;
+            auto device = raw->device;
+            QMetaObject::invokeMethod(this, [this, device, percent]() {
+                emit flashProgress(device, percent);
+            }, Qt::QueuedConnection);
+        }
+    };
+    
+    d->scheduler.spawn(runFlashSession(raw, progress),
+        [this, device, raw](std::exception_ptr exception) {
+            FlashOutcome outcome = raw->outcome;
+            if (exception) {
+                outcome = FlashOutcome{false, "Flash session aborted"};
+            }
+            int attempts = raw->attempts;
+            QMetaObject::invokeMethod(this, [this, device, outcome, attempts]() {
+                finishSession(device, outcome, attempts);
+            }, Qt::QueuedConnection);
+        });
+}
+
+void FlashEngine::finishSession(std::shared_ptr<UsbDevice> device, const FlashOutcome& outcome,
+                                int attempts) {
+    {
+        std::lock_guard<std::mutex> lock(d->devicesMutex);
+        auto it = d->sessions.find(device.get());
+        if (it != d->sessions.end()) {
+            device->releaseInterface(it->second->options.interfaceNumber);
+            d->sessions.erase(it);
+        }
+    }
+    bool allDone = d->queue.finish(device.get(), outcome.ok, attempts, Clock::now());
+    
+    if (!outcome.ok) {
+        LOG_WARNING("Flashing " + device->description() + " failed: " + outcome.error);
+    }
+    emit flashComplete(device, outcome.ok, outcome.error);
+    
+    startPending();
+    if (allDone) {
+        emit allComplete(stats());
+    }
+}
+
+} // namespace usb_monitor
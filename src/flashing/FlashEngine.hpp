@@ -0,0 +1,56 @@
+#pragma once
+#include "FlashProtocols.hpp"
+#include "FlashQueue.hpp"
+#include <QObject>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+class UsbDevice;
+
+// Flashes one image to many devices at once. Every device runs as a
+// coroutine session on the libusb event thread, so the number of devices
+// is bounded by the per-bus session limit rather than by threads. Which
+// device starts when is up to its FlashQueue.
+class FlashEngine : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FlashEngine(QObject* parent = nullptr);
+    ~FlashEngine();
+
+    // Configuration, applied to sessions started afterwards
+    void setImage(std::vector<uint8_t> image);
+    void setOptions(const FlashOptions& options);
+    FlashOptions options() const;
+    
+    // Devices sharing a bus share its bandwidth; sessions beyond this limit
+    // wait, and queued devices are started on the least loaded bus first
+    void setSessionsPerBus(size_t sessions);
+    size_t sessionsPerBus() const;
+
+    // The device is opened and its interface claimed when its session starts
+    bool enqueue(std::shared_ptr<UsbDevice> device);
+    void cancel();
+    bool isRunning() const;
+    
+    FlashStats stats() const;
+
+signals:
+    void flashProgress(std::shared_ptr<UsbDevice> device, int percentComplete);
+    void flashComplete(std::shared_ptr<UsbDevice> device, bool success, const std::string& error);
+    void allComplete(const FlashStats& stats);
+    void flashError(const std::string& error);
+
+private:
+    void startPending();
+    void startSession(std::shared_ptr<UsbDevice> device);
+    void finishSession(std::shared_ptr<UsbDevice> device, const FlashOutcome& outcome, int attempts);
+    
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
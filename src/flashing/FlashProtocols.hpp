@@ -0,0 +1,339 @@
+#pragma once
+#include "../core/DeviceSession.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+// Device-independent flashing protocols. Each is a coroutine over a Link
+// that provides:
+//   control(requestType, request, value, index, data, length, timeout)
+//   writePipelined(endpoint, data, length, blockSize, depth, timeout, onBytes)
+//   delay(milliseconds)
+// every one awaitable. Link, image and options must outlive the task.
+
+enum class FlashProtocol {
+    Dfu,        // USB DFU 1.1 download
+    VendorBulk  // Vendor start request, pipelined bulk OUT, vendor status request
+};
+
+struct FlashOptions {
+    FlashProtocol protocol{FlashProtocol::Dfu};
+    int interfaceNumber{0};
+    size_t blockSize{FLASH_BLOCK_SIZE};
+    size_t pipelineDepth{FLASH_PIPELINE_DEPTH};
+    int maxRetries{FLASH_MAX_RETRIES};
+    unsigned int timeout{DEFAULT_TIMEOUT};
+    
+    // VendorBulk only
+    uint8_t outEndpoint{0x01};
+    uint8_t startRequest{0x01};   // wValue/wIndex carry the image size
+    uint8_t statusRequest{0x02};  // Returns one byte, zero on success
+};
+
+struct FlashOutcome {
+    bool ok{false};
+    std::string error;
+};
+
+// Called with bytes written so far; runs on whichever thread resumed the session
+using FlashProgress = std::function<void(size_t written, size_t total)>;
+
+// DFU 1.1 class requests and states (DFU spec sections 3 and 6.1.2)
+enum class DfuRequest : uint8_t {
+    Detach = 0,
+    Download = 1,
+    Upload = 2,
+    GetStatus = 3,
+    ClearStatus = 4,
+    GetState = 5,
+    Abort = 6
+};
+
+enum class DfuState : uint8_t {
+    AppIdle = 0,
+    AppDetach = 1,
+    Idle = 2,
+    DownloadSync = 3,
+    DownloadBusy = 4,
+    DownloadIdle = 5,
+    ManifestSync = 6,
+    Manifest = 7,
+    ManifestWaitReset = 8,
+    UploadIdle = 9,
+    Error = 10
+};
+
+struct DfuStatus {
+    uint8_t status{0};       // bStatus, zero is OK
+    uint32_t pollTimeout{0}; // ms before the next GETSTATUS
+    DfuState state{DfuState::Error};
+};
+
+constexpr uint8_t DFU_REQUEST_OUT = 0x21;    // Class, interface, host to device
+constexpr uint8_t DFU_REQUEST_IN = 0xA1;
+constexpr uint8_t VENDOR_REQUEST_OUT = 0x41; // Vendor, interface
+constexpr uint8_t VENDOR_REQUEST_IN = 0xC1;
+
+inline std::optional<DfuStatus> parseDfuStatus(const TransferResult& result) {
+    if (!result.ok() || result.data.size() < 6) {
+        return std::nullopt;
+    }
+    DfuStatus status;
+    status.status = result.data[0];
+    status.pollTimeout = result.data[1] | (result.data[2] << 8) | (result.data[3] << 16);
+    status.state = static_cast<DfuState>(result.data[4]);
+    return status;
+}
+
+template <typename Link>
+Task<std::optional<DfuStatus>> dfuGetStatus(Link& link, const FlashOptions& options) {
+    auto result = co_await link.control(DFU_REQUEST_IN, static_cast<uint8_t>(DfuRequest::GetStatus),
+                                        0, options.interfaceNumber, nullptr, 6, options.timeout);
+    co_return parseDfuStatus(result);
+}
+
+template <typename Link>
+Task<bool> dfuRequest(Link& link, const FlashOptions& options, DfuRequest request,
+                      uint16_t value = 0, const uint8_t* data = nullptr, uint16_t length = 0) {
+    auto result = co_await link.control(DFU_REQUEST_OUT, static_cast<uint8_t>(request), value,
+                                        options.interfaceNumber, data, length, options.timeout);
+    co_return result.ok();
+}
+
+// Polls GETSTATUS, honouring bwPollTimeout, until the device leaves the
+// busy states. Returns nullopt if the device stops answering.
+template <typename Link>
+Task<std::optional<DfuStatus>> dfuWaitReady(Link& link, const FlashOptions& options) {
+    for (int poll = 0; poll < DFU_MAX_POLLS; ++poll) {
+        auto status = co_await dfuGetStatus(link, options);
+        if (!status) {
+            co_return std::nullopt;
+        }
+        if (status->state != DfuState::DownloadBusy &&
+            status->state != DfuState::DownloadSync &&
+            status->state != DfuState::Manifest &&
+            status->state != DfuState::ManifestSync) {
+            co_return status;
+        }
+        co_await link.delay(status->pollTimeout);
+    }
+    co_return std::nullopt;
+}
+
+template <typename Link>
+Task<FlashOutcome> dfuDownload(Link& link, const std::vector<uint8_t>& image,
+                               const FlashOptions& options, FlashProgress progress) {
+    // Start from dfuIDLE whatever a previous attempt left behind
+    auto status = co_await dfuGetStatus(link, options);
+    if (!status) {
+        co_return FlashOutcome{false, "DFU GETSTATUS failed"};
+    }
+    if (status->state == DfuState::Error) {
+        co_await dfuRequest(link, options, DfuRequest::ClearStatus);
+    } else if (status->state != DfuState::Idle) {
+        co_await dfuRequest(link, options, DfuRequest::Abort);
+    }
+    
+    uint16_t block = 0;
+    for (size_t offset = 0; offset < image.size(); offset += options.blockSize, ++block) {
+        size_t length = std::min(options.blockSize, image.size() - offset);
+        if (!co_await dfuRequest(link, options, DfuRequest::Download, block,
+                                 image.data() + offset, static_cast<uint16_t>(length))) {
+            co_return FlashOutcome{false, "DFU DNLOAD failed at block " + std::to_string(block)};
+        }
+        
+        status = co_await dfuWaitReady(link, options);
+        if (!status || status->state != DfuState::DownloadIdle) {
+            co_return FlashOutcome{false, "DFU device rejected block " + std::to_string(block)};
+        }
+        if (progress) {
+            progress(offset + length, image.size());
+        }
+    }
+    
+    // A zero-length DNLOAD ends the download and starts manifestation
+    if (!co_await dfuRequest(link, options, DfuRequest::Download, block)) {
+        co_return FlashOutcome{false, "DFU manifestation request failed"};
+    }
+    
+    status = co_await dfuWaitReady(link, options);
+    if (!status) {
+        // Devices that are not manifestation tolerant reset here
+        co_return FlashOutcome{true, {}};
+    }
+    if (status->state == DfuState::Idle || status->state == DfuState::ManifestWaitReset) {
+        co_return FlashOutcome{true, {}};
+    }
+    co_return FlashOutcome{false, "DFU manifestation failed with status " +
+                                  std::to_string(status->status)};
+}
+
+template <typename Link>
+Task<FlashOutcome> vendorBulkDownload(Link& link, const std::vector<uint8_t>& image,
+                                      const FlashOptions& options, FlashProgress progress) {
+    auto size = static_cast<uint32_t>(image.size());
+    auto start = co_await link.control(VENDOR_REQUEST_OUT, options.startRequest,
+                                       size & 0xFFFF, size >> 16, nullptr, 0, options.timeout);
+    if (!start.ok()) {
+        co_return FlashOutcome{false, "Vendor start request failed"};
+    }
+    
+    auto written = co_await link.writePipelined(
+        options.outEndpoint, image.data(), image.size(), options.blockSize,
+        options.pipelineDepth, options.timeout,
+        [&progress, total = image.size()](size_t bytes) {
+            if (progress) progress(bytes, total);
+        });
+    if (!written.ok()) {
+        co_return FlashOutcome{false, "Bulk download failed"};
+    }
+    
+    auto result = co_await link.control(VENDOR_REQUEST_IN, options.statusRequest, 0,
+                                        options.interfaceNumber, nullptr, 1, options.timeout);
+    if (!result.ok() || result.data.empty()) {
+        co_return FlashOutcome{false, "Vendor status request failed"};
+    }
+    if (result.data[0] != 0) {
+        co_return FlashOutcome{false, "Device reported status " + std::to_string(result.data[0])};
+    }
+    co_return FlashOutcome{true, {}};
+}
+
+// Runs the configured protocol, restarting the whole download after a
+// failure. attempts receives the number of tries made.
+template <typename Link>
+Task<FlashOutcome> flashImage(Link& link, const std::vector<uint8_t>& image,
+                              const FlashOptions& options, FlashProgress progress, int& attempts) {
+    FlashOutcome outcome;
+    for (attempts = 1;; ++attempts) {
+        if (options.protocol == FlashProtocol::Dfu) {
+            outcome = co_await dfuDownload(link, image, options, progress);
+        } else {
+            outcome = co_await vendorBulkDownload(link, image, options, progress);
+        }
+        if (outcome.ok || attempts > options.maxRetries) {
+            break;
+        }
+        co_await link.delay(FLASH_RETRY_BACKOFF);
+    }
+    co_return outcome;
+}
+
+// writePipelined() for Links over a TransferTarget. Keeps up to depth bulk
+// OUT blocks in flight and resumes the session when the last one completes;
+// a failed or short block fails the whole write. The submitting thread holds one reference of its
+// own so a completion racing await_suspend cannot resume the session early.
+class PipelinedWrite {
+public:
+    PipelinedWrite(TransferTarget* device, const std::atomic<bool>* cancelled,
+                   uint8_t endpoint, const uint8_t* data, size_t length,
+                   size_t blockSize, size_t depth, unsigned int timeout,
+                   std::function<void(size_t)> onBytes)
+        : device(device)
+        , cancelled(cancelled)
+        , endpoint(endpoint & ~LIBUSB_ENDPOINT_IN)
+        , data(data)
+        , length(length)
+        , blockSize(std::max<size_t>(blockSize, 1))
+        , depth(std::clamp<size_t>(depth, 1, TRANSFER_POOL_SIZE))
+        , timeout(timeout)
+        , onBytes(std::move(onBytes)) {
+        result.status = LIBUSB_TRANSFER_COMPLETED;
+    }
+    
+    bool await_ready() const noexcept { return length == 0; }
+    
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+        std::lock_guard<std::mutex> lock(mutex);
+        handle = awaiting;
+        outstanding = 1;
+        fillLocked();
+        return --outstanding != 0;
+    }
+    
+    TransferResult await_resume() { return std::move(result); }
+    
+private:
+    void fillLocked() {
+        while (inFlight < depth && next < length && result.ok()) {
+            if (cancelled->load()) {
+                result.status = LIBUSB_TRANSFER_CANCELLED;
+                return;
+            }
+            
+            size_t block = std::min(blockSize, length - next);
+            bool submitted = device->submitBulk(endpoint, data + next, block,
+                [this, block](const TransferCompletion& completion) {
+                    complete(completion, block);
+                }, timeout);
+            if (!submitted) {
+                // Out of pool slots is fine while others are still in flight
+                if (inFlight == 0) {
+                    result.status = LIBUSB_ERROR_IO;
+                }
+                return;
+            }
+            next += block;
+            inFlight++;
+            outstanding++;
+        }
+    }
+    
+    void complete(const TransferCompletion& completion, size_t block) {
+        bool finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight--;
+            outstanding--;
+            if (completion.status != LIBUSB_TRANSFER_COMPLETED) {
+                if (result.ok()) {
+                    result.status = completion.status;
+                }
+            } else if (static_cast<size_t>(completion.actualLength) != block) {
+                // Completed, but the device took only part of the block
+                if (result.ok()) {
+                    result.status = LIBUSB_TRANSFER_ERROR;
+                }
+            } else {
+                written += block;
+                if (onBytes) {
+                    onBytes(written);
+                }
+            }
+            fillLocked();
+            finished = outstanding == 0;
+        }
+        
+        if (finished) {
+            TransferPool::resumeAfterRelease(handle);
+        }
+    }
+    
+    TransferTarget* device;
+    const std::atomic<bool>* cancelled;
+    uint8_t endpoint;
+    const uint8_t* data;
+    size_t length;
+    size_t blockSize;
+    size_t depth;
+    unsigned int timeout;
+    std::function<void(size_t)> onBytes;
+    
+    std::mutex mutex;
+    std::coroutine_handle<> handle;
+    size_t next{0};
+    size_t written{0};
+    size_t inFlight{0};
+    size_t outstanding{0};
+    TransferResult result;
+};
+
+} // namespace usb_monitor
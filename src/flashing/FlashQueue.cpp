@@ -0,0 +1,218 @@
+#include "FlashQueue.hpp"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+namespace usb_monitor {
+
+namespace {
+
+struct BusState {
+    std::deque<FlashQueue::Key> pending;
+    size_t active{0};
+    uint64_t bytesWritten{0};
+    std::chrono::milliseconds busyTime{0};
+    FlashQueue::Clock::time_point busySince;
+};
+
+} // namespace
+
+class FlashQueue::Private {
+public:
+    size_t sessionsPerBus{FLASH_SESSIONS_PER_BUS};
+    bool cancelled{false};
+    
+    std::map<uint8_t, BusState> buses;
+    std::map<Key, uint8_t> running;
+    size_t completed{0};
+    size_t failed{0};
+    size_t retries{0};
+    bool started{false};
+    Clock::time_point startTime;
+    Clock::time_point endTime;
+    mutable std::mutex mutex;
+    
+    size_t queuedCount() const {
+        size_t queued = 0;
+        for (const auto& [bus, state] : buses) {
+            queued += state.pending.size();
+        }
+        return queued;
+    }
+    
+    bool isQueuedOrRunning(Key key) const {
+        if (running.count(key)) return true;
+        for (const auto& [bus, state] : buses) {
+            if (std::find(state.pending.begin(), state.pending.end(), key) != state.pending.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // The bus with queued devices, spare session capacity and the fewest
+    // sessions running; ties go to the lowest bus number
+    std::pair<const uint8_t, BusState>* leastLoadedBus() {
+        std::pair<const uint8_t, BusState>* best = nullptr;
+        for (auto& entry : buses) {
+            const auto& state = entry.second;
+            if (state.pending.empty() || state.active >= sessionsPerBus) continue;
+            if (!best || state.active < best->second.active) {
+                best = &entry;
+            }
+        }
+        return best;
+    }
+};
+
+FlashQueue::FlashQueue(size_t sessionsPerBus)
+    : d(std::make_unique<Private>()) {
+    d->sessionsPerBus = std::max<size_t>(sessionsPerBus, 1);
+}
+
+FlashQueue::~FlashQueue() = default;
+
+void FlashQueue::setSessionsPerBus(size_t sessions) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->sessionsPerBus = std::max<size_t>(sessions, 1);
+}
+
+size_t FlashQueue::sessionsPerBus() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->sessionsPerBus;
+}
+
+bool FlashQueue::enqueue(Key key, uint8_t bus, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (d->isQueuedOrRunning(key)) {
+        return false;
+    }
+    if (d->running.empty() && d->queuedCount() == 0) {
+        // A new run
+        d->cancelled = false;
+        d->started = true;
+        d->startTime = now;
+        d->completed = d->failed = d->retries = 0;
+        d->buses.clear();
+    }
+    d->buses[bus].pending.push_back(key);
+    return true;
+}
+
+std::optional<FlashQueue::Key> FlashQueue::startNext(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (d->cancelled) return std::nullopt;
+    
+    auto* bus = d->leastLoadedBus();
+    if (!bus) return std::nullopt;
+    
+    auto& state = bus->second;
+    Key key = state.pending.front();
+    state.pending.pop_front();
+    if (state.active++ == 0) {
+        state.busySince = now;
+    }
+    d->running[key] = bus->first;
+    return key;
+}
+
+void FlashQueue::addBytes(Key key, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    auto it = d->running.find(key);
+    if (it != d->running.end()) {
+        d->buses[it->second].bytesWritten += bytes;
+    }
+}
+
+bool FlashQueue::finish(Key key, bool ok, int attempts, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    auto it = d->running.find(key);
+    if (it == d->running.end()) return false;
+    
+    auto& state = d->buses[it->second];
+    if (--state.active == 0) {
+        state.busyTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - state.busySince);
+    }
+    d->running.erase(it);
+    
+    if (ok) {
+        d->completed++;
+    } else {
+        d->failed++;
+    }
+    if (attempts > 1) {
+        d->retries += attempts - 1;
+    }
+    
+    bool allDone = d->running.empty() && d->queuedCount() == 0;
+    if (allDone) {
+        d->endTime = now;
+    }
+    return allDone;
+}
+
+std::vector<FlashQueue::Key> FlashQueue::cancel(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->cancelled = true;
+    
+    std::vector<Key> dropped;
+    for (auto& [bus, state] : d->buses) {
+        dropped.insert(dropped.end(), state.pending.begin(), state.pending.end());
+        state.pending.clear();
+    }
+    if (!dropped.empty() && d->running.empty()) {
+        d->endTime = now;
+    }
+    return dropped;
+}
+
+bool FlashQueue::isCancelled() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->cancelled;
+}
+
+bool FlashQueue::isRunning() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return !d->running.empty() || d->queuedCount() > 0;
+}
+
+FlashStats FlashQueue::stats(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    FlashStats stats;
+    
+    stats.active = d->running.size();
+    stats.completed = d->completed;
+    stats.failed = d->failed;
+    stats.retries = d->retries;
+    
+    for (const auto& [bus, state] : d->buses) {
+        BusFlashStats busStats;
+        busStats.activeSessions = state.active;
+        busStats.queuedSessions = state.pending.size();
+        busStats.bytesWritten = state.bytesWritten;
+        
+        auto busy = state.busyTime;
+        if (state.active > 0) {
+            busy += std::chrono::duration_cast<std::chrono::milliseconds>(now - state.busySince);
+        }
+        if (busy.count() > 0) {
+            busStats.throughput = state.bytesWritten * 1000.0 / busy.count();
+        }
+        
+        stats.queued += busStats.queuedSessions;
+        stats.bytesWritten += busStats.bytesWritten;
+        stats.buses[bus] = busStats;
+    }
+    
+    if (d->started) {
+        auto end = (stats.active > 0 || stats.queued > 0) ? now : d->endTime;
+        stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - d->startTime);
+        if (stats.elapsed.count() > 0) {
+            stats.devicesPerHour = d->completed * 3600000.0 / stats.elapsed.count();
+        }
+    }
+    return stats;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,77 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace usb_monitor {
+
+struct BusFlashStats {
+    size_t activeSessions{0};
+    size_t queuedSessions{0};
+    uint64_t bytesWritten{0};
+    double throughput{0.0};     // bytes/sec while the bus had sessions running
+};
+
+struct FlashStats {
+    size_t queued{0};
+    size_t active{0};
+    size_t completed{0};
+    size_t failed{0};
+    size_t retries{0};
+    uint64_t bytesWritten{0};
+    double devicesPerHour{0.0};
+    std::chrono::milliseconds elapsed{0};
+    std::map<uint8_t, BusFlashStats> buses;
+};
+
+// Which device the flash engine starts next, and the counters of the run.
+// Devices are opaque keys queued per bus; a session is started on the
+// least loaded bus with spare capacity. Times are passed in, so runs can
+// be replayed on a virtual clock. Thread-safe.
+class FlashQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Key = const void*;
+
+    explicit FlashQueue(size_t sessionsPerBus = FLASH_SESSIONS_PER_BUS);
+    ~FlashQueue();
+
+    FlashQueue(const FlashQueue&) = delete;
+    FlashQueue& operator=(const FlashQueue&) = delete;
+
+    void setSessionsPerBus(size_t sessions);
+    size_t sessionsPerBus() const;
+
+    // Enqueueing into an idle queue starts a new run and resets the
+    // counters. False if the key is already queued or running.
+    bool enqueue(Key key, uint8_t bus, Clock::time_point now);
+
+    // Takes the next device to start and counts it running on its bus;
+    // nothing once every bus is full or the run is cancelled
+    std::optional<Key> startNext(Clock::time_point now);
+
+    // Bytes a running device wrote since its last report
+    void addBytes(Key key, uint64_t bytes);
+
+    // A running device is done; attempts beyond the first count as
+    // retries. Returns true if that was the last device of the run.
+    bool finish(Key key, bool ok, int attempts, Clock::time_point now);
+
+    // Drops everything queued, returning it; running devices finish
+    // through finish() as usual. The next run clears this.
+    std::vector<Key> cancel(Clock::time_point now);
+    bool isCancelled() const;
+
+    bool isRunning() const;
+    FlashStats stats(Clock::time_point now) const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -15,6 +15,11 @@ public:
     DeviceManager* manager{nullptr};
     std::map<const UsbDevice*, QTreeWidgetItem*> deviceItems;
     QTimer* updateTimer{nullptr};
+    
+    // Item/device pairs for the stats timer, rebuilt when the registry
+    // generation moves
+    std::vector<std::pair<QTreeWidgetItem*, std::shared_ptr<UsbDevice>>> rows;
+    uint64_t rowsGeneration{0};
 };
 
 DeviceTreeWidget::DeviceTreeWidget(QWidget* parent)
@@ -57,16 +62,18 @@ void DeviceTreeWidget::setDeviceManager(DeviceManager* manager) {
     d->manager = manager;
     
     if (manager) {
-        connect(manager, &DeviceManager::deviceAdded,
-                this, &DeviceTreeWidget::handleDeviceAdded);
+        connect(manager, &DeviceManager::devicesAdded,
+                this, &DeviceTreeWidget::handleDevicesAdded);
         connect(manager, &DeviceManager::deviceRemoved,
                 this, &DeviceTreeWidget::handleDeviceRemoved);
         
         // Load initial devices
         clear();
         d->deviceItems.clear();
+        d->rows.clear();
+        d->rowsGeneration = 0;
         
-        for (const auto& device : manager->getConnectedDevices()) {
+        for (const auto& device : manager->deviceSnapshot()->devices) {
             handleDeviceAdded(device);
         }
     }
@@ -77,8 +84,10 @@ void DeviceTreeWidget::refresh() {
     
     clear();
     d->deviceItems.clear();
+    d->rows.clear();
+    d->rowsGeneration = 0;
     
-    for (const auto& device : d->manager->getConnectedDevices()) {
+    for (const auto& device : d->manager->deviceSnapshot()->devices) {
         handleDeviceAdded(device);
     }
 }
@@ -88,6 +97,20 @@ void DeviceTreeWidget::handleDeviceAdded(std::shared_ptr<UsbDevice> device) {
     createDeviceItem(device);
 }
 
+void DeviceTreeWidget::handleDevicesAdded(const std::vector<std::shared_ptr<UsbDevice>>& devices) {
+    // Insert the whole hotplug burst with sorting and repaints suspended
+    bool sorting = isSortingEnabled();
+    setUpdatesEnabled(false);
+    setSortingEnabled(false);
+    
+    for (const auto& device : devices) {
+        handleDeviceAdded(device);
+    }
+    
+    setSortingEnabled(sorting);
+    setUpdatesEnabled(true);
+}
+
 void DeviceTreeWidget::handleDeviceRemoved(std::shared_ptr<UsbDevice> device) {
     if (!device) return;
     
@@ -95,6 +118,12 @@ void DeviceTreeWidget::handleDeviceRemoved(std::shared_ptr<UsbDevice> device) {
     if (it != d->deviceItems.end()) {
         delete it->second;
         d->deviceItems.erase(it);
+        d->rows.clear();
+        d->rowsGeneration = 0;
+    }
+    
+    if (d->manager) {
+        d->manager->samplingScheduler()->setVisible(device.get(), false);
     }
 }
 
@@ -106,15 +135,11 @@ void DeviceTreeWidget::handleItemSelectionChanged() {
     }
     
     auto item = items.first();
-    for (const auto& pair : d->deviceItems) {
-        if (pair.second == item) {
-            // Find the corresponding device from the manager
-            for (const auto& device : d->manager->getConnectedDevices()) {
-                if (device.get() == pair.first) {
-                    emit deviceSelected(device);
-                    return;
-                }
-            }
+    auto snapshot = d->manager->deviceSnapshot();
+    for (const auto& device : snapshot->devices) {
+        if (findDeviceItem(device.get()) == item) {
+            emit deviceSelected(device);
+            return;
         }
     }
 }
@@ -173,13 +198,28 @@ void DeviceTreeWidget::updateDeviceItem(QTreeWidgetItem* item, const std::shared
 }
 
 void DeviceTreeWidget::updateDeviceStats() {
-    for (const auto& pair : d->deviceItems) {
-        for (const auto& device : d->manager->getConnectedDevices()) {
-            if (device.get() == pair.first) {
-                updateDeviceItem(pair.second, device);
-                break;
+    if (!d->manager) return;
+    
+    if (d->rowsGeneration != d->manager->generation()) {
+        auto snapshot = d->manager->deviceSnapshot();
+        d->rows.clear();
+        d->rows.reserve(snapshot->devices.size());
+        for (const auto& device : snapshot->devices) {
+            if (auto item = findDeviceItem(device.get())) {
+                d->rows.emplace_back(item, device);
             }
         }
+        d->rowsGeneration = snapshot->generation;
+    }
+    
+    // Rows on screen get sampled more often than the rest
+    auto* sampler = d->manager->samplingScheduler();
+    QRect visibleArea = viewport()->rect();
+    bool shown = isVisible();
+    for (const auto& [item, device] : d->rows) {
+        updateDeviceItem(item, device);
+        sampler->setVisible(device.get(),
+                            shown && visualItemRect(item).intersects(visibleArea));
     }
 }
 
@@ -2,6 +2,7 @@
 #pragma once
 #include <QTreeWidget>
 #include <memory>
+#include <vector>
 
 namespace usb_monitor {
 
@@ -25,6 +26,7 @@ signals:
 
 private slots:
     void handleDeviceAdded(std::shared_ptr<UsbDevice> device);
+    void handleDevicesAdded(const std::vector<std::shared_ptr<UsbDevice>>& devices);
     void handleDeviceRemoved(std::shared_ptr<UsbDevice> device);
     void handleItemSelectionChanged();
     void updateDeviceStats();
@@ -7,7 +7,11 @@
 #include "../security/SecurityManager.hpp"
 #include "../analysis/ProtocolAnalyzer.hpp"
 #include "../analysis/BenchmarkTool.hpp"
+#include "../analysis/AnomalyDetector.hpp"
+#include "../capture/UsbmonReader.hpp"
+#include "../flashing/FlashEngine.hpp"
 #include "../utils/ConfigManager.hpp"
+#include "../utils/AnalysisReport.hpp"
 
 #include <QMenuBar>
 #include <QToolBar>
@@ -17,6 +21,12 @@
 #include <QSettings>
 #include <QCloseEvent>
 #include <QApplication>
+#include <QPlainTextEdit>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
 
 namespace usb_monitor {
 
@@ -25,14 +35,21 @@ public:
     std::unique_ptr<DeviceManager> deviceManager;
     std::unique_ptr<SecurityManager> securityManager;
     std::unique_ptr<ProtocolAnalyzer> protocolAnalyzer;
+    std::unique_ptr<UsbmonReader> usbmonReader;
     std::unique_ptr<BenchmarkTool> benchmarkTool;
+    std::unique_ptr<AnomalyDetector> anomalyDetector;
     std::unique_ptr<ConfigManager> configManager;
     std::unique_ptr<SystemTrayIcon> systemTrayIcon;
     
+    // Its sessions run on the device manager's event thread, so it goes first
+    std::unique_ptr<FlashEngine> flashEngine;
+    
     DeviceTreeWidget* deviceTree{nullptr};
     TopologyView* topologyView{nullptr};
     QDockWidget* detailsDock{nullptr};
     QDockWidget* analysisDock{nullptr};
+    QPlainTextEdit* analysisView{nullptr};
+    QTimer* analysisTimer{nullptr};
     
     std::shared_ptr<UsbDevice> selectedDevice;
 };
@@ -48,8 +65,11 @@ MainWindow::MainWindow(QWidget* parent)
     d->deviceManager = std::make_unique<DeviceManager>();
     d->securityManager = std::make_unique<SecurityManager>();
     d->protocolAnalyzer = std::make_unique<ProtocolAnalyzer>();
+    d->usbmonReader = std::make_unique<UsbmonReader>();
     d->benchmarkTool = std::make_unique<BenchmarkTool>();
+    d->anomalyDetector = std::make_unique<AnomalyDetector>();
     d->configManager = std::make_unique<ConfigManager>();
+    d->flashEngine = std::make_unique<FlashEngine>();
     
     setupUi();
     loadSettings();
@@ -63,6 +83,10 @@ MainWindow::MainWindow(QWidget* parent)
 
 MainWindow::~MainWindow() = default;
 
+SecurityManager* MainWindow::securityManager() const {
+    return d->securityManager.get();
+}
+
 void MainWindow::setupUi() {
     setupMenus();
     setupToolbar();
@@ -100,6 +124,7 @@ void MainWindow::setupMenus() {
     toolsMenu->addAction("&Security Settings...", this, &MainWindow::showSecuritySettings);
     toolsMenu->addAction("&Protocol Analysis", this, &MainWindow::showProtocolAnalysis);
     toolsMenu->addAction("&Benchmark", this, &MainWindow::runBenchmark);
+    toolsMenu->addAction("&Flash Firmware...", this, &MainWindow::flashFirmware);
     
     // Help menu
     auto helpMenu = menuBar()->addMenu("&Help");
@@ -131,6 +156,20 @@ void MainWindow::setupDockWidgets() {
     d->analysisDock = new QDockWidget("Analysis", this);
     d->analysisDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
     addDockWidget(Qt::RightDockWidgetArea, d->analysisDock);
+    
+    d->analysisView = new QPlainTextEdit(d->analysisDock);
+    d->analysisView->setReadOnly(true);
+    d->analysisView->setFont(QFont("monospace"));
+    d->analysisDock->setWidget(d->analysisView);
+    
+    // Refreshes the capture analysis of the selected device
+    d->analysisTimer = new QTimer(this);
+    connect(d->analysisTimer, &QTimer::timeout, this, [this]() {
+        if (!d->selectedDevice) return;
+        std::string report = formatDeviceAnalysis(*d->protocolAnalyzer, *d->selectedDevice);
+        d->analysisView->setPlainText(report.empty() ? "Waiting for captured transfers..."
+                                                     : QString::fromStdString(report));
+    });
 }
 
 void MainWindow::setupStatusBar() {
@@ -147,10 +186,14 @@ void MainWindow::setupDeviceMonitoring() {
             this, &MainWindow::handleDeviceSelected);
     
     // Update status bar with device events
-    connect(d->deviceManager.get(), &DeviceManager::deviceAdded,
-            this, [this](const std::shared_ptr<UsbDevice>& device) {
-        statusBar()->showMessage("Device connected: " + 
-                               QString::fromStdString(device->description()), 3000);
+    connect(d->deviceManager.get(), &DeviceManager::devicesAdded,
+            this, [this](const std::vector<std::shared_ptr<UsbDevice>>& devices) {
+        if (devices.size() == 1) {
+            statusBar()->showMessage("Device connected: " + 
+                                   QString::fromStdString(devices.front()->description()), 3000);
+        } else {
+            statusBar()->showMessage(QString("%1 devices connected").arg(devices.size()), 3000);
+        }
     });
     
     connect(d->deviceManager.get(), &DeviceManager::deviceRemoved,
@@ -158,6 +201,62 @@ void MainWindow::setupDeviceMonitoring() {
         statusBar()->showMessage("Device disconnected: " + 
                                QString::fromStdString(device->description()), 3000);
     });
+    
+    // Re-enumeration floods: per-port arrival and descriptor-change limits,
+    // enforced by the device manager once the security manager is attached
+    connect(d->securityManager.get(), &SecurityManager::portBlocked,
+            this, [this](const std::string& portPath, const std::string& reason) {
+        statusBar()->showMessage(QString("Port %1 blocked: %2")
+                                 .arg(QString::fromStdString(portPath))
+                                 .arg(QString::fromStdString(reason)), 10000);
+    });
+    
+    // Streaming anomaly detection on bandwidth, errors and hotplug churn
+    d->anomalyDetector->attach(d->deviceManager.get(), d->protocolAnalyzer.get());
+    connect(d->anomalyDetector.get(), &AnomalyDetector::anomalyDetected,
+            this, [this](const AnomalyEvent& event) {
+        static const char* metrics[] = {"throughput", "error rate", "hotplug frequency"};
+        QString what = event.kind == AnomalyKind::Spike ? "spike" : "level shift";
+        statusBar()->showMessage(QString("Anomaly: %1 %2 on %3 (%4, expected %5)")
+                                 .arg(metrics[static_cast<int>(event.metric)])
+                                 .arg(what)
+                                 .arg(QString::fromStdString(event.source))
+                                 .arg(event.value, 0, 'f', 1)
+                                 .arg(event.expected, 0, 'f', 1), 5000);
+    });
+    
+    // Large high-entropy writes to mass storage, watched from arrival on.
+    // Real capture needs usbmon and read access to /dev/usbmon*; without
+    // it the analyzer falls back to descriptor polling.
+    d->protocolAnalyzer->setCaptureSource(d->usbmonReader.get());
+    d->protocolAnalyzer->setBandwidthMonitor(d->deviceManager->bandwidthMonitor());
+    d->securityManager->attach(d->deviceManager.get(), d->protocolAnalyzer.get());
+    connect(d->protocolAnalyzer.get(), &ProtocolAnalyzer::exfiltrationSuspected,
+            this, [this](const UsbDevice* device, const ExfiltrationAlert&) {
+        statusBar()->showMessage("Possible data exfiltration: " +
+                                 QString::fromStdString(device->description()), 10000);
+    });
+    
+    // Firmware flashing runs in the background; progress goes to the status bar
+    connect(d->flashEngine.get(), &FlashEngine::flashProgress,
+            this, [this](std::shared_ptr<UsbDevice> device, int percent) {
+        statusBar()->showMessage(QString("Flashing %1: %2%")
+                                 .arg(QString::fromStdString(device->description()))
+                                 .arg(percent), 3000);
+    });
+    connect(d->flashEngine.get(), &FlashEngine::flashError,
+            this, [this](const std::string& error) {
+        statusBar()->showMessage("Flashing failed: " + QString::fromStdString(error), 10000);
+    });
+    connect(d->flashEngine.get(), &FlashEngine::allComplete,
+            this, [this](const FlashStats& stats) {
+        statusBar()->showMessage(QString("Flashing done: %1 flashed, %2 failed, %3 retries, "
+                                         "%4 devices/hour")
+                                 .arg(stats.completed)
+                                 .arg(stats.failed)
+                                 .arg(stats.retries)
+                                 .arg(stats.devicesPerHour, 0, 'f', 0), 30000);
+    });
 }
 
 void MainWindow::handleDeviceSelected(const std::shared_ptr<UsbDevice>& device) {
@@ -220,6 +319,14 @@ void MainWindow::showProtocolAnalysis() {
         QMessageBox::information(this, "Information", "Please select a device first.");
         return;
     }
+    
+    if (!d->usbmonReader->isRunning() && !d->usbmonReader->start()) {
+        statusBar()->showMessage("USB capture unavailable, load usbmon and check permissions", 5000);
+    }
+    d->protocolAnalyzer->startMonitoring(d->selectedDevice);
+    d->analysisDock->show();
+    d->analysisTimer->start(1000);
+    
     // Show protocol analysis interface
     // Implementation depends on ProtocolAnalysisWidget class
 }
@@ -233,6 +340,65 @@ void MainWindow::runBenchmark() {
     // Implementation depends on BenchmarkDialog class
 }
 
+void MainWindow::flashFirmware() {
+    if (!d->selectedDevice) {
+        QMessageBox::information(this, "Information", "Please select a device first.");
+        return;
+    }
+    if (d->flashEngine->isRunning()) {
+        QMessageBox::information(this, "Information", "Flashing is already in progress.");
+        return;
+    }
+    
+    QString path = QFileDialog::getOpenFileName(this, "Firmware Image");
+    if (path.isEmpty()) return;
+    
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, "Flash Firmware", "Cannot read " + path);
+        return;
+    }
+    QByteArray image = file.readAll();
+    
+    QStringList protocols = {"DFU 1.1", "Vendor bulk"};
+    bool ok = false;
+    QString protocol = QInputDialog::getItem(this, "Flash Firmware", "Protocol:",
+                                             protocols, 0, false, &ok);
+    if (!ok) return;
+    
+    // The image goes to every connected device of the selected model
+    auto id = d->selectedDevice->identifier();
+    std::vector<std::shared_ptr<UsbDevice>> targets;
+    for (const auto& device : d->deviceManager->deviceSnapshot()->devices) {
+        auto other = device->identifier();
+        if (other.vendorId == id.vendorId && other.productId == id.productId) {
+            targets.push_back(device);
+        }
+    }
+    
+    auto answer = QMessageBox::question(this, "Flash Firmware",
+        QString("Flash %1 (%2 bytes) to %3 connected device(s) with ID %4:%5?")
+            .arg(QFileInfo(path).fileName())
+            .arg(image.size())
+            .arg(targets.size())
+            .arg(id.vendorId, 4, 16, QChar('0'))
+            .arg(id.productId, 4, 16, QChar('0')));
+    if (answer != QMessageBox::Yes) return;
+    
+    FlashOptions options;
+    options.protocol = protocol == protocols[0] ? FlashProtocol::Dfu : FlashProtocol::VendorBulk;
+    d->flashEngine->setOptions(options);
+    d->flashEngine->setImage(std::vector<uint8_t>(image.begin(), image.end()));
+    
+    size_t queued = 0;
+    for (const auto& device : targets) {
+        if (d->flashEngine->enqueue(device)) {
+            queued++;
+        }
+    }
+    statusBar()->showMessage(QString("Flashing %1 device(s)").arg(queued), 5000);
+}
+
 void MainWindow::exportData() {
     // Show export dialog
     // Implementation depends on ExportDialog class
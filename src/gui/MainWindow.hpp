@@ -19,6 +19,8 @@ class MainWindow : public QMainWindow {
 public:
     explicit MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
+    
+    SecurityManager* securityManager() const;
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -32,6 +34,7 @@ private slots:
     void showSecuritySettings();
     void showProtocolAnalysis();
     void runBenchmark();
+    void flashFirmware();
     void exportData();
     void showSettings();
     void showAbout();
@@ -33,7 +33,7 @@ public:
     double zoomLevel{1.0};
     QTimer* layoutTimer{nullptr};
     
-    void createDeviceNode(const std::shared_ptr<UsbDevice>& device) {
+    void createDeviceNode(const std::shared_ptr<UsbDevice>& device, bool relayout = true) {
         if (!device) return;
         
         DeviceNode node;
@@ -57,7 +57,9 @@ public:
         node.y = rand() % 400 - 200;
         
         nodes[device.get()] = node;
-        updateLayout();
+        if (relayout) {
+            updateLayout();
+        }
     }
     
     void removeDeviceNode(const UsbDevice* device) {
@@ -191,8 +193,8 @@ void TopologyView::setDeviceManager(DeviceManager* manager) {
     d->manager = manager;
     
     if (manager) {
-        connect(manager, &DeviceManager::deviceAdded,
-                this, &TopologyView::handleDeviceAdded);
+        connect(manager, &DeviceManager::devicesAdded,
+                this, &TopologyView::handleDevicesAdded);
         connect(manager, &DeviceManager::deviceRemoved,
                 this, &TopologyView::handleDeviceRemoved);
         
@@ -211,9 +213,10 @@ void TopologyView::refresh() {
     d->nodes.clear();
     
     // Create nodes for all devices
-    for (const auto& device : d->manager->getConnectedDevices()) {
-        d->createDeviceNode(device);
+    for (const auto& device : d->manager->deviceSnapshot()->devices) {
+        d->createDeviceNode(device, false);
     }
+    d->updateLayout();
     
     // Center the view
     d->scene->setSceneRect(d->scene->itemsBoundingRect());
@@ -224,6 +227,14 @@ void TopologyView::handleDeviceAdded(std::shared_ptr<UsbDevice> device) {
     d->createDeviceNode(device);
 }
 
+void TopologyView::handleDevicesAdded(const std::vector<std::shared_ptr<UsbDevice>>& devices) {
+    // One layout pass for the whole hotplug burst
+    for (const auto& device : devices) {
+        d->createDeviceNode(device, false);
+    }
+    d->updateLayout();
+}
+
 void TopologyView::handleDeviceRemoved(std::shared_ptr<UsbDevice> device) {
     if (device) {
         d->removeDeviceNode(device.get());
@@ -2,6 +2,7 @@
 #pragma once
 #include <QGraphicsView>
 #include <memory>
+#include <vector>
 
 namespace usb_monitor {
 
@@ -34,6 +35,7 @@ protected:
 
 private slots:
     void handleDeviceAdded(std::shared_ptr<UsbDevice> device);
+    void handleDevicesAdded(const std::vector<std::shared_ptr<UsbDevice>>& devices);
     void handleDeviceRemoved(std::shared_ptr<UsbDevice> device);
     void updateLayout();
 
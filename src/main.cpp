@@ -2,11 +2,14 @@
 #include "core/DeviceManager.hpp"
 #include "utils/ConfigManager.hpp"
 #include "core/Logger.hpp"
+#include "utils/HeadlessRunner.hpp"
+#include "security/SecurityManager.hpp"
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
 #include <QMessageBox>
 #include <QDir>
+#include <cstring>
 #include <iostream>
 
 using namespace usb_monitor;
@@ -44,6 +47,38 @@ void setupCommandLineParser(QCommandLineParser& parser) {
         "1"
     );
     parser.addOption(logLevelOption);
+
+    QCommandLineOption securityConfigOption(
+        QStringList() << "s" << "security-config",
+        "Specify security rules and policies file path.",
+        "security-config"
+    );
+    parser.addOption(securityConfigOption);
+
+    QCommandLineOption headlessOption(
+        "headless",
+        "Capture with usbmon without a window and print the analysis to stdout."
+    );
+    parser.addOption(headlessOption);
+
+    QCommandLineOption durationOption(
+        QStringList() << "d" << "duration",
+        "Headless capture duration in seconds.",
+        "seconds",
+        "10"
+    );
+    parser.addOption(durationOption);
+}
+
+// Headless mode must not need a display, so this is decided before the
+// application object exists
+bool isHeadless(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void initializeLogger(const QCommandLineParser& parser) {
@@ -105,6 +140,20 @@ bool loadConfiguration(ConfigManager& config, const QCommandLineParser& parser)
     return true;
 }
 
+bool loadSecurityConfiguration(SecurityManager& security, const QCommandLineParser& parser) {
+    if (!parser.isSet("security-config")) {
+        return true;
+    }
+
+    std::string path = parser.value("security-config").toStdString();
+    if (!security.loadSecurityConfig(path)) {
+        LOG_WARNING("Failed to load security configuration from " + path);
+        return false;
+    }
+    LOG_INFO("Loaded security configuration from " + path);
+    return true;
+}
+
 void handleUnexpectedExceptions() {
     try {
         throw;  // Rethrow the current exception
@@ -129,16 +178,21 @@ int main(int argc, char *argv[]) {
     });
 
     try {
-        QApplication app(argc, argv);
-        app.setApplicationName("USB Device Monitor");
-        app.setApplicationVersion("2.0.0");
-        app.setOrganizationName("USB Monitor Project");
-        app.setOrganizationDomain("usb-monitor.org");
+        std::unique_ptr<QCoreApplication> app;
+        if (isHeadless(argc, argv)) {
+            app = std::make_unique<QCoreApplication>(argc, argv);
+        } else {
+            app = std::make_unique<QApplication>(argc, argv);
+        }
+        app->setApplicationName("USB Device Monitor");
+        app->setApplicationVersion("2.0.0");
+        app->setOrganizationName("USB Monitor Project");
+        app->setOrganizationDomain("usb-monitor.org");
 
         // Parse command line arguments
         QCommandLineParser parser;
         setupCommandLineParser(parser);
-        parser.process(app);
+        parser.process(*app);
 
         // Initialize logger
         initializeLogger(parser);
@@ -149,8 +203,23 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        if (parser.isSet("headless")) {
+            HeadlessRunner runner(std::chrono::seconds(parser.value("duration").toInt()));
+            QObject::connect(&runner, &HeadlessRunner::finished, app.get(), [](int exitCode) {
+                QCoreApplication::exit(exitCode);
+            });
+            if (!loadSecurityConfiguration(*runner.securityManager(), parser) ||
+                !runner.start()) {
+                return 1;
+            }
+            return app->exec();
+        }
+
         // Create and show main window
         MainWindow mainWindow;
+        if (!loadSecurityConfiguration(*mainWindow.securityManager(), parser)) {
+            return 1;
+        }
         if (!parser.isSet("minimized")) {
             mainWindow.show();
         }
@@ -160,7 +229,7 @@ int main(int argc, char *argv[]) {
 
         LOG_INFO("Application initialized successfully");
 
-        return app.exec();
+        return app->exec();
 
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
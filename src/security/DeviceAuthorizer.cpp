@@ -32,6 +32,35 @@ public:
         }
     }
     
+    // Locked
+    void record(DeviceAuthState& state, const AuthorizationResult& result) {
+        if (result.authorized) {
+            state.isAuthorized = true;
+        }
+        state.history.push_back(result);
+        pruneHistory(state);
+    }
+    
+    static QString promptText(const UsbDevice* device) {
+        auto description = QString::fromStdString(device->description());
+        auto id = device->identifier();
+        
+        return QString("Do you want to authorize the following USB device?\n\n"
+                       "Device: %1\n"
+                       "Vendor ID: 0x%2\n"
+                       "Product ID: 0x%3\n"
+                       "Bus: %4 Address: %5")
+                       .arg(description)
+                       .arg(id.vendorId, 4, 16, QChar('0'))
+                       .arg(id.productId, 4, 16, QChar('0'))
+                       .arg(id.busNumber)
+                       .arg(id.deviceAddress);
+    }
+    
+    static bool canPrompt() {
+        return qobject_cast<QApplication*>(QCoreApplication::instance()) != nullptr;
+    }
+    
     bool isAuthorizationExpired(const DeviceAuthState& state) const {
         if (!state.isAuthorized) return true;
         
@@ -107,7 +136,7 @@ AuthorizationResult DeviceAuthorizer::authorizeDevice(UsbDevice* device) {
         return d->createResult(false, "Invalid device", AuthorizationMethod::Automatic);
     }
     
-    std::lock_guard<std::mutex> lock(d->stateMutex);
+    std::unique_lock<std::mutex> lock(d->stateMutex);
     auto& state = d->deviceStates[device];
     
     // Check if already authorized and not expired
@@ -123,9 +152,6 @@ AuthorizationResult DeviceAuthorizer::authorizeDevice(UsbDevice* device) {
     
     // Try automatic authorization for known devices
     if (d->policy.autoAuthorizeKnownDevices) {
-        auto id = device->identifier();
-        auto desc = device->description();
-        
         // Check if this is a common/known device type
         bool isKnownDevice = false;
         switch (device->deviceClass()) {
@@ -142,73 +168,109 @@ AuthorizationResult DeviceAuthorizer::authorizeDevice(UsbDevice* device) {
         if (isKnownDevice) {
             result = d->createResult(true, "Known device type", 
                                    AuthorizationMethod::Automatic);
-            state.isAuthorized = true;
-            state.history.push_back(result);
-            d->pruneHistory(state);
-            return result;
-        }
-    }
-    
-    // Check system policies
-    if (d->policy.enforceSystemPolicies) {
-        if (!checkSystemPolicies(device)) {
-            result = d->createResult(false, "System policy violation",
-                                   AuthorizationMethod::SystemPolicy);
-            state.history.push_back(result);
-            d->pruneHistory(state);
-            return result;
-        }
-    }
-    
-    // Check device certificate
-    if (d->policy.checkDeviceCertificates) {
-        if (!validateDeviceCertificate(device)) {
-            result = d->createResult(false, "Certificate validation failed",
-                                   AuthorizationMethod::Certificate);
-            state.history.push_back(result);
-            d->pruneHistory(state);
+            d->record(state, result);
             return result;
         }
     }
     
-    // Try custom authorization methods
+    auto policy = d->policy;
     auto id = device->identifier();
     std::string deviceKey = std::to_string(id.vendorId) + ":" + 
                            std::to_string(id.productId);
-                           
+    std::function<AuthorizationResult(UsbDevice*)> customMethod;
     auto methodIt = d->customMethods.find(deviceKey);
     if (methodIt != d->customMethods.end()) {
-        result = methodIt->second(device);
-        if (!result.authorized) {
-            state.history.push_back(result);
-            d->pruneHistory(state);
-            return result;
-        }
+        customMethod = methodIt->second;
     }
     
-    // Prompt user if required
-    if (d->policy.requireUserConfirmation) {
-        result = promptUserForAuthorization(device);
-        state.history.push_back(result);
-        d->pruneHistory(state);
+    // The checks take the lock themselves and the prompt runs a nested
+    // event loop, so neither runs locked; state stays put in the map
+    lock.unlock();
+    
+    auto check = [&]() -> AuthorizationResult {
+        // Check system policies
+        if (policy.enforceSystemPolicies && !checkSystemPolicies(device)) {
+            return d->createResult(false, "System policy violation",
+                                 AuthorizationMethod::SystemPolicy);
+        }
         
-        if (result.authorized) {
-            state.isAuthorized = true;
+        // Check device certificate
+        if (policy.checkDeviceCertificates && !validateDeviceCertificate(device)) {
+            return d->createResult(false, "Certificate validation failed",
+                                 AuthorizationMethod::Certificate);
         }
         
-        return result;
-    }
-    
-    // Default to authorized if all checks pass
-    result = d->createResult(true, "All checks passed",
-                           AuthorizationMethod::Automatic);
-    state.isAuthorized = true;
-    state.history.push_back(result);
-    d->pruneHistory(state);
-    
+        // Try custom authorization methods
+        if (customMethod) {
+            auto custom = customMethod(device);
+            if (!custom.authorized) return custom;
+        }
+        
+        // Prompt user if required
+        if (policy.requireUserConfirmation) {
+            return promptUserForAuthorization(device);
+        }
+        
+        // Default to authorized if all checks pass
+        return d->createResult(true, "All checks passed",
+                             AuthorizationMethod::Automatic);
+    };
+    result = check();
+    
+    lock.lock();
+    d->record(state, result);
     return result;
 }
 
+void DeviceAuthorizer::requestUserAuthorization(
+    const std::shared_ptr<UsbDevice>& device,
+    std::function<void(const AuthorizationResult&)> done) {
+    if (!device) return;
+    
+    // The dialog belongs to the GUI thread; the device may leave meanwhile
+    std::weak_ptr<UsbDevice> weak = device;
+    QString message = Private::promptText(device.get());
+    auto timeout = getAuthorizationPolicy().authorizationTimeout;
+    
+    QMetaObject::invokeMethod(this, [this, weak, message, timeout, done = std::move(done)]() {
+        auto finish = [this, weak, done](const AuthorizationResult& result) {
+            if (auto held = weak.lock()) {
+                std::lock_guard<std::mutex> lock(d->stateMutex);
+                auto& state = d->deviceStates[held.get()];
+                state.isAuthorized = false;
+                state.lastAuthAttempt = result.timestamp;
+                d->record(state, result);
+            }
+            done(result);
+        };
+        
+        // Headless runs have nobody to ask
+        if (!Private::canPrompt()) {
+            finish(d->createResult(false, "No user to confirm authorization",
+                                   AuthorizationMethod::UserPrompt));
+            return;
+        }
+        
+        auto* box = new QMessageBox(QMessageBox::Question,
+                                    "USB Device Authorization",
+                                    message,
+                                    QMessageBox::Yes | QMessageBox::No);
+        box->setAttribute(Qt::WA_DeleteOnClose);
+        
+        if (timeout.count() > 0) {
+            QTimer::singleShot(timeout, box, &QMessageBox::reject);
+        }
+        
+        connect(box, &QMessageBox::finished, this, [this, box, finish](int) {
+            bool authorized = box->standardButton(box->clickedButton()) == QMessageBox::Yes;
+            finish(d->createResult(authorized,
+                                   authorized ? "User authorized device" : "User denied authorization",
+                                   AuthorizationMethod::UserPrompt));
+        });
+        box->open();
+    }, Qt::QueuedConnection);
+}
+
 void DeviceAuthorizer::revokeAuthorization(UsbDevice* device) {
     if (!device) return;
     
@@ -353,30 +415,22 @@ AuthorizationResult DeviceAuthorizer::promptUserForAuthorization(UsbDevice* devi
                              AuthorizationMethod::UserPrompt);
     }
     
-    // Create message box for user prompt
-    auto description = QString::fromStdString(device->description());
-    auto id = device->identifier();
-    
-    QString message = QString("Do you want to authorize the following USB device?\n\n"
-                            "Device: %1\n"
-                            "Vendor ID: 0x%2\n"
-                            "Product ID: 0x%3\n"
-                            "Bus: %4 Address: %5")
-                            .arg(description)
-                            .arg(id.vendorId, 4, 16, QChar('0'))
-                            .arg(id.productId, 4, 16, QChar('0'))
-                            .arg(id.busNumber)
-                            .arg(id.deviceAddress);
+    // Headless runs have nobody to ask
+    if (!Private::canPrompt()) {
+        return d->createResult(false, "No user to confirm authorization",
+                             AuthorizationMethod::UserPrompt);
+    }
     
     QMessageBox box(QMessageBox::Question,
                    "USB Device Authorization",
-                   message,
+                   Private::promptText(device),
                    QMessageBox::Yes | QMessageBox::No);
     
     // Set timeout if specified
     QTimer timer;
-    if (d->policy.authorizationTimeout.count() > 0) {
-        timer.setInterval(d->policy.authorizationTimeout);
+    auto timeout = getAuthorizationPolicy().authorizationTimeout;
+    if (timeout.count() > 0) {
+        timer.setInterval(timeout);
         timer.setSingleShot(true);
         QObject::connect(&timer, &QTimer::timeout,
                         &box, &QMessageBox::reject);
@@ -1,5 +1,6 @@
 #pragma once
 #include <QObject>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -41,6 +42,13 @@ public:
 
     // Authorization control
     AuthorizationResult authorizeDevice(UsbDevice* device);
+    
+    // Asks the user without blocking the caller. done runs on this
+    // object's thread once the question is answered or times out, or at
+    // once with a denial when there is no user to ask. No lock is held
+    // while the question is open.
+    void requestUserAuthorization(const std::shared_ptr<UsbDevice>& device,
+                                  std::function<void(const AuthorizationResult&)> done);
     void revokeAuthorization(UsbDevice* device);
     bool isAuthorized(const UsbDevice* device) const;
     
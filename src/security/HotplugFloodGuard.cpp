@@ -0,0 +1,224 @@
+#include "HotplugFloodGuard.hpp"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace usb_monitor {
+
+namespace {
+
+uint64_t mix(uint64_t value) {
+    // splitmix64 finalizer
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// Count-min sketch over a sliding window of time slots. Each slot has its
+// own counter rows and is cleared when its turn comes round again; an
+// estimate adds up the slots still inside the window.
+class SlidingCountMin {
+public:
+    using Clock = HotplugFloodGuard::Clock;
+
+    static constexpr size_t DEPTH = 4;
+    static constexpr size_t WIDTH = 256;
+    static constexpr size_t SLOTS = 10;
+
+    void reset(Clock::duration window) {
+        slotWidth = std::max<Clock::duration>(window / SLOTS, std::chrono::milliseconds(1));
+        counters.fill(0);
+        slotIds.fill(-1);
+    }
+
+    void add(uint64_t key, uint32_t count, Clock::time_point now) {
+        int64_t slot = slotOf(now);
+        size_t index = size_t(slot % int64_t(SLOTS));
+        uint32_t* rows = &counters[index * DEPTH * WIDTH];
+        if (slotIds[index] != slot) {
+            std::fill(rows, rows + DEPTH * WIDTH, 0);
+            slotIds[index] = slot;
+        }
+        for (size_t row = 0; row < DEPTH; row++) {
+            uint32_t& counter = rows[row * WIDTH + column(key, row)];
+            counter = uint32_t(std::min<uint64_t>(uint64_t(counter) + count, UINT32_MAX));
+        }
+    }
+
+    uint32_t estimate(uint64_t key, Clock::time_point now) const {
+        int64_t slot = slotOf(now);
+        uint64_t best = UINT64_MAX;
+        for (size_t row = 0; row < DEPTH; row++) {
+            uint64_t sum = 0;
+            size_t col = column(key, row);
+            for (size_t index = 0; index < SLOTS; index++) {
+                if (slotIds[index] <= slot - int64_t(SLOTS) || slotIds[index] > slot) continue;
+                sum += counters[(index * DEPTH + row) * WIDTH + col];
+            }
+            best = std::min(best, sum);
+        }
+        return uint32_t(std::min<uint64_t>(best, UINT32_MAX));
+    }
+
+private:
+    int64_t slotOf(Clock::time_point now) const {
+        return now.time_since_epoch() / slotWidth;
+    }
+
+    static size_t column(uint64_t key, size_t row) {
+        return size_t(mix(key ^ (row * 0xC2B2AE3D27D4EB4Full)) & (WIDTH - 1));
+    }
+
+    Clock::duration slotWidth{std::chrono::seconds(1)};
+    std::array<uint32_t, SLOTS * DEPTH * WIDTH> counters{};
+    std::array<int64_t, SLOTS> slotIds{};
+};
+
+// Last device seen per port, direct-mapped; a collision only forgets a
+// port's previous device, it never invents a change
+struct LastDescriptor {
+    uint64_t port{0};
+    uint64_t descriptor{0};
+};
+
+constexpr size_t DESCRIPTOR_TABLE_SIZE = 1024;
+
+} // namespace
+
+class HotplugFloodGuard::Private {
+public:
+    FloodThresholds thresholds;
+    SlidingCountMin arrivals;
+    SlidingCountMin changes;
+    std::array<LastDescriptor, DESCRIPTOR_TABLE_SIZE> lastDescriptor{};
+    std::unordered_map<std::string, Clock::time_point> blocked;     // Until when
+
+    double logTokens{0.0};
+    Clock::time_point lastRefill{};
+    uint64_t suppressed{0};
+    mutable std::mutex mutex;
+
+    static uint64_t portKey(const std::string& portPath) {
+        return mix(std::hash<std::string>{}(portPath));
+    }
+
+    void reset() {
+        arrivals.reset(thresholds.window);
+        changes.reset(thresholds.window);
+        lastDescriptor.fill(LastDescriptor{});
+        logTokens = thresholds.logRate;
+        lastRefill = Clock::time_point{};
+    }
+
+    // Locked
+    bool blockedAt(const std::string& portPath, Clock::time_point now) const {
+        auto it = blocked.find(portPath);
+        return it != blocked.end() && it->second > now;
+    }
+
+    // Locked; a token bucket holding up to one second of logging
+    bool takeLogToken(Clock::time_point now) {
+        if (lastRefill != Clock::time_point{} && now > lastRefill) {
+            double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+            logTokens = std::min<double>(logTokens + elapsed * thresholds.logRate, thresholds.logRate);
+        }
+        lastRefill = std::max(lastRefill, now);
+        if (logTokens < 1.0) return false;
+        logTokens -= 1.0;
+        return true;
+    }
+};
+
+HotplugFloodGuard::HotplugFloodGuard(const FloodThresholds& thresholds)
+    : d(std::make_unique<Private>()) {
+    d->thresholds = thresholds;
+    d->reset();
+}
+
+HotplugFloodGuard::~HotplugFloodGuard() = default;
+
+void HotplugFloodGuard::setThresholds(const FloodThresholds& thresholds) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    bool resize = thresholds.window != d->thresholds.window;
+    d->thresholds = thresholds;
+    if (resize) {
+        d->reset();
+    }
+}
+
+FloodThresholds HotplugFloodGuard::thresholds() const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->thresholds;
+}
+
+FloodDecision HotplugFloodGuard::recordArrival(const std::string& portPath, uint64_t descriptorHash,
+                                               Clock::time_point now, uint32_t count) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    FloodDecision decision;
+    uint64_t key = Private::portKey(portPath);
+
+    d->arrivals.add(key, count, now);
+    decision.arrivals = d->arrivals.estimate(key, now);
+
+    if (descriptorHash) {
+        auto& last = d->lastDescriptor[key % DESCRIPTOR_TABLE_SIZE];
+        if (last.port == key && last.descriptor != descriptorHash) {
+            d->changes.add(key, 1, now);
+            decision.descriptorChanged = true;
+        }
+        last = LastDescriptor{key, descriptorHash};
+    }
+    decision.descriptorChanges = d->changes.estimate(key, now);
+
+    auto previous = d->blocked.find(portPath);
+    bool wasBlocked = previous != d->blocked.end() && previous->second > now;
+    if (previous != d->blocked.end() && !wasBlocked) {
+        d->blocked.erase(previous);
+    }
+    if (!wasBlocked && (decision.arrivals > d->thresholds.arrivals ||
+                        decision.descriptorChanges > d->thresholds.descriptorChanges)) {
+        d->blocked[portPath] = now + d->thresholds.blockFor;
+        decision.newlyBlocked = true;
+    }
+    decision.blocked = wasBlocked || decision.newlyBlocked;
+
+    // Arrivals on a blocked port are only counted; the block said it all
+    decision.log = decision.newlyBlocked || (!decision.blocked && d->takeLogToken(now));
+    if (decision.log) {
+        decision.suppressed = d->suppressed;
+        d->suppressed = 0;
+    } else {
+        d->suppressed += count;
+    }
+    return decision;
+}
+
+bool HotplugFloodGuard::isBlocked(const std::string& portPath, Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->blockedAt(portPath, now);
+}
+
+void HotplugFloodGuard::unblock(const std::string& portPath) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->blocked.erase(portPath);
+}
+
+std::vector<std::string> HotplugFloodGuard::blockedPorts(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    std::vector<std::string> result;
+    for (const auto& [portPath, until] : d->blocked) {
+        if (until > now) result.push_back(portPath);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+uint32_t HotplugFloodGuard::arrivalEstimate(const std::string& portPath, Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->arrivals.estimate(Private::portKey(portPath), now);
+}
+
+} // namespace usb_monitor
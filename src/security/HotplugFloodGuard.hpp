@@ -0,0 +1,61 @@
+#pragma once
+#include <usb-monitor/Constants.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+struct FloodThresholds {
+    uint32_t arrivals{HOTPLUG_FLOOD_ARRIVALS};
+    uint32_t descriptorChanges{HOTPLUG_FLOOD_DESCRIPTOR_CHANGES};
+    std::chrono::seconds window{HOTPLUG_FLOOD_WINDOW};
+    std::chrono::seconds blockFor{HOTPLUG_FLOOD_BLOCK};
+    uint32_t logRate{HOTPLUG_FLOOD_LOG_RATE};     // Events per second
+};
+
+struct FloodDecision {
+    bool blocked{false};            // The port is blocked, now or already
+    bool newlyBlocked{false};       // This arrival tripped a threshold
+    bool descriptorChanged{false};  // A different device than last time
+    uint32_t arrivals{0};           // Estimated, within the window
+    uint32_t descriptorChanges{0};
+    bool log{false};                // Within the logging budget
+    uint64_t suppressed{0};         // Not logged since the last logged one
+};
+
+// Re-enumeration flood detection. Arrivals and descriptor changes per port
+// are counted in sliding count-min sketches, so memory stays fixed however
+// many ports or devices a flood makes up; the estimates can only err high.
+// Ports over a threshold are blocked for a while. Logging is rate limited
+// across all ports so a flood cannot swamp the event history or the UI;
+// a block is always logged.
+class HotplugFloodGuard {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit HotplugFloodGuard(const FloodThresholds& thresholds = {});
+    ~HotplugFloodGuard();
+
+    void setThresholds(const FloodThresholds& thresholds);
+    FloodThresholds thresholds() const;
+
+    // A descriptor hash of 0 counts the arrivals without comparing devices,
+    // e.g. for flaps the debouncer coalesced
+    FloodDecision recordArrival(const std::string& portPath, uint64_t descriptorHash,
+                                Clock::time_point now, uint32_t count = 1);
+
+    bool isBlocked(const std::string& portPath, Clock::time_point now) const;
+    void unblock(const std::string& portPath);
+    std::vector<std::string> blockedPorts(Clock::time_point now) const;
+
+    uint32_t arrivalEstimate(const std::string& portPath, Clock::time_point now) const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,317 @@
+#include "PolicyIndex.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+namespace usb_monitor {
+
+namespace {
+
+// How a rule's attribute values relate to the device's, with applies()
+// deciding whether one rule value covers one device value
+template <typename Rule, typename Device, typename Applies>
+bool solve(SetOperator op, const std::vector<Rule>& rule, const Device* device, size_t count, Applies applies) {
+    auto covered = [&](const Rule& value) {
+        for (size_t i = 0; i < count; i++) {
+            if (applies(value, device[i])) return true;
+        }
+        return false;
+    };
+    auto coveredByRule = [&](const Device& value) {
+        for (const auto& candidate : rule) {
+            if (applies(candidate, value)) return true;
+        }
+        return false;
+    };
+
+    switch (op) {
+        case SetOperator::AllOf:
+            return std::all_of(rule.begin(), rule.end(), covered);
+        case SetOperator::OneOf:
+            return std::any_of(rule.begin(), rule.end(), covered);
+        case SetOperator::NoneOf:
+            return std::none_of(rule.begin(), rule.end(), covered);
+        case SetOperator::Equals:
+            return rule.size() == count && std::all_of(rule.begin(), rule.end(), covered) &&
+                   std::all_of(device, device + count, coveredByRule);
+        case SetOperator::EqualsOrdered:
+            if (rule.size() != count) return false;
+            for (size_t i = 0; i < count; i++) {
+                if (!applies(rule[i], device[i])) return false;
+            }
+            return true;
+        case SetOperator::MatchAll:
+            return std::all_of(device, device + count, coveredByRule);
+    }
+    return false;
+}
+
+bool sameString(const std::string& rule, const std::string& device) {
+    return rule == device;
+}
+
+bool matchesString(const std::optional<UsbGuardAttribute<std::string>>& attribute, const std::string& value) {
+    return !attribute || solve(attribute->op, attribute->values, &value, 1, sameString);
+}
+
+// Local time of an arrival, looked up once and only if a rule asks
+class TimeOfDay {
+public:
+    explicit TimeOfDay(std::chrono::system_clock::time_point when) : when(when) {}
+
+    uint32_t seconds() {
+        if (!cached) {
+            std::time_t time = std::chrono::system_clock::to_time_t(when);
+            std::tm local{};
+            localtime_r(&time, &local);
+            cached = uint32_t(local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+        }
+        return *cached;
+    }
+
+private:
+    std::chrono::system_clock::time_point when;
+    std::optional<uint32_t> cached;
+};
+
+bool holds(const UsbGuardCondition& condition, TimeOfDay& now) {
+    bool result = true;
+    switch (condition.kind) {
+        case UsbGuardCondition::Kind::True: result = true; break;
+        case UsbGuardCondition::Kind::False: result = false; break;
+        case UsbGuardCondition::Kind::LocalTime: {
+            uint32_t seconds = now.seconds();
+            result = condition.from <= condition.until
+                ? seconds >= condition.from && seconds <= condition.until
+                : seconds >= condition.from || seconds <= condition.until;
+            break;
+        }
+    }
+    return result != condition.negated;
+}
+
+bool matches(const UsbGuardRule& rule, const DeviceArrivalRecord& arrival, TimeOfDay& now) {
+    if (rule.id) {
+        auto applies = [](const UsbGuardId& id, const DeviceArrivalRecord& device) {
+            return (id.anyVendor || id.vendorId == device.vendorId) &&
+                   (id.anyProduct || id.productId == device.productId);
+        };
+        if (!solve(rule.id->op, rule.id->values, &arrival, 1, applies)) return false;
+    }
+    if (!matchesString(rule.serial, arrival.serialNumber) || !matchesString(rule.name, arrival.name) ||
+        !matchesString(rule.viaPort, arrival.portPath) || !matchesString(rule.connectType, arrival.connectType)) {
+        return false;
+    }
+    if (rule.interfaces) {
+        auto applies = [](const UsbGuardInterface& pattern, uint32_t type) {
+            return (type & pattern.mask) == pattern.type;
+        };
+        if (!solve(rule.interfaces->op, rule.interfaces->values, arrival.interfaceTypes.data(),
+                   arrival.interfaceTypes.size(), applies)) {
+            return false;
+        }
+    }
+    if (rule.conditions) {
+        const auto& conditions = rule.conditions->values;
+        auto check = [&now](const UsbGuardCondition& condition) { return holds(condition, now); };
+        switch (rule.conditions->op) {
+            case SetOperator::OneOf:
+                return std::any_of(conditions.begin(), conditions.end(), check);
+            case SetOperator::NoneOf:
+                return std::none_of(conditions.begin(), conditions.end(), check);
+            default:
+                return std::all_of(conditions.begin(), conditions.end(), check);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+const char* verdictName(PolicyVerdict verdict) {
+    switch (verdict) {
+        case PolicyVerdict::Allow: return "allow";
+        case PolicyVerdict::AllowAfterAuthorization: return "allow after authorization";
+        case PolicyVerdict::NotWhitelisted: return "not whitelisted";
+        case PolicyVerdict::InterfaceNotAllowed: return "interface not allowed";
+        case PolicyVerdict::Expired: return "rule expired";
+        case PolicyVerdict::Blocked: return "blocked by rule";
+    }
+    return "unknown";
+}
+
+void InterfaceMask::add(const UsbGuardInterface& pattern) {
+    uint8_t interfaceClass = uint8_t(pattern.type >> 16);
+    uint8_t subclass = uint8_t(pattern.type >> 8);
+    if ((pattern.mask & 0xFF0000) == 0) {
+        classes.set();
+        return;
+    }
+    if ((pattern.mask & 0xFF00) == 0) {
+        classes.set(interfaceClass);
+        return;
+    }
+
+    refined.set(interfaceClass);
+    auto setIn = [](auto& maps, auto key, uint8_t bit) {
+        auto it = std::lower_bound(maps.begin(), maps.end(), key,
+                                   [](const auto& entry, auto value) { return entry.first < value; });
+        if (it == maps.end() || it->first != key) {
+            it = maps.insert(it, {key, std::bitset<256>()});
+        }
+        it->second.set(bit);
+    };
+    if ((pattern.mask & 0xFF) == 0) {
+        setIn(subclasses, interfaceClass, subclass);
+    } else {
+        setIn(protocols, uint16_t(pattern.type >> 8), uint8_t(pattern.type));
+    }
+}
+
+bool InterfaceMask::matches(uint32_t type) const {
+    uint8_t interfaceClass = uint8_t(type >> 16);
+    if (classes.test(interfaceClass)) return true;
+    if (!refined.test(interfaceClass)) return false;
+
+    auto find = [](const auto& maps, auto key) -> const std::bitset<256>* {
+        auto it = std::lower_bound(maps.begin(), maps.end(), key,
+                                   [](const auto& entry, auto value) { return entry.first < value; });
+        return it != maps.end() && it->first == key ? &it->second : nullptr;
+    };
+    auto subclass = find(subclasses, interfaceClass);
+    if (subclass && subclass->test(uint8_t(type >> 8))) return true;
+    auto protocol = find(protocols, uint16_t((type >> 8) & 0xFFFF));
+    return protocol && protocol->test(uint8_t(type));
+}
+
+InterfaceMask InterfaceMask::parse(const std::vector<std::string>& entries) {
+    InterfaceMask mask;
+    for (const auto& entry : entries) {
+        if (auto pattern = parseInterfaceType(entry)) {
+            mask.add(*pattern);
+            continue;
+        }
+        char* end = nullptr;
+        unsigned long value = std::strtoul(entry.c_str(), &end, 16);
+        if (end != entry.c_str() && *end == '\0' && value < 256) {
+            mask.classes.set(value);
+        }
+    }
+    return mask;
+}
+
+PolicyIndex::PolicyIndex(std::vector<SecurityRule> rules, std::vector<UsbGuardRule> imported)
+    : securityRules(std::move(rules))
+    , usbGuardRules(std::move(imported)) {
+    compiledRules.reserve(securityRules.size());
+    byDevice.reserve(securityRules.size());
+    for (uint32_t i = 0; i < securityRules.size(); i++) {
+        const auto& rule = securityRules[i];
+        compiledRules.push_back(Compiled{InterfaceMask::parse(rule.allowedInterfaces),
+                                        InterfaceMask::parse(rule.blockedInterfaces),
+                                        rule.allowedInterfaces.empty()});
+        byDevice.try_emplace(deviceKey(rule.vendorId, rule.productId), i);
+    }
+
+    // A rule goes in the buckets of the ids it names, unless some value is
+    // a full wildcard or the operator can match devices it doesn't name
+    for (uint32_t i = 0; i < usbGuardRules.size(); i++) {
+        const auto& id = usbGuardRules[i].id;
+        bool bucketed = id && id->op != SetOperator::NoneOf &&
+            std::none_of(id->values.begin(), id->values.end(), [](const UsbGuardId& value) { return value.anyVendor; });
+        if (!bucketed) {
+            importedOther.push_back(i);
+            continue;
+        }
+        for (const auto& value : id->values) {
+            auto& bucket = value.anyProduct ? importedByVendor[value.vendorId]
+                                            : importedByDevice[deviceKey(value.vendorId, value.productId)];
+            if (bucket.empty() || bucket.back() != i) bucket.push_back(i);
+        }
+    }
+}
+
+PolicyDecision PolicyIndex::evaluateImported(const DeviceArrivalRecord& arrival) const {
+    static const std::vector<uint32_t> none;
+    auto device = importedByDevice.find(deviceKey(arrival.vendorId, arrival.productId));
+    auto vendor = importedByVendor.find(arrival.vendorId);
+    const std::vector<uint32_t>* buckets[] = {
+        device == importedByDevice.end() ? &none : &device->second,
+        vendor == importedByVendor.end() ? &none : &vendor->second,
+        &importedOther,
+    };
+    size_t next[] = {0, 0, 0};
+    int64_t last = -1;
+    TimeOfDay now(arrival.timestamp);
+
+    // Walk the buckets together in rule order; the first match decides.
+    // A rule listing both a device and its vendor sits in two buckets and
+    // comes up twice in a row.
+    for (;;) {
+        int bucket = -1;
+        for (int b = 0; b < 3; b++) {
+            if (next[b] < buckets[b]->size() &&
+                (bucket < 0 || (*buckets[b])[next[b]] < (*buckets[bucket])[next[bucket]])) {
+                bucket = b;
+            }
+        }
+        if (bucket < 0) break;
+
+        uint32_t index = (*buckets[bucket])[next[bucket]++];
+        if (int64_t(index) == last) continue;
+        last = index;
+
+        const auto& rule = usbGuardRules[index];
+        if (!matches(rule, arrival, now)) continue;
+
+        int number = int(securityRules.size() + index);
+        return {rule.target == RuleTarget::Allow ? PolicyVerdict::Allow : PolicyVerdict::Blocked, number};
+    }
+    return {PolicyVerdict::NotWhitelisted, -1};
+}
+
+PolicyDecision PolicyIndex::evaluate(const DeviceArrivalRecord& arrival) const {
+    auto it = byDevice.find(deviceKey(arrival.vendorId, arrival.productId));
+    if (it == byDevice.end()) {
+        return usbGuardRules.empty() ? PolicyDecision{PolicyVerdict::NotWhitelisted, -1} : evaluateImported(arrival);
+    }
+
+    int index = int(it->second);
+    const auto& rule = securityRules[index];
+    const auto& compiled = compiledRules[index];
+    if (!rule.isWhitelisted) {
+        return {PolicyVerdict::NotWhitelisted, index};
+    }
+
+    // One pass over the interfaces, collecting the denied ones by number
+    uint32_t denied = 0;
+    bool refuse = false;
+    if (!compiled.anyInterface || !compiled.blocked.empty()) {
+        if (arrival.interfaceTypes.empty()) {
+            refuse = (!compiled.anyInterface && (arrival.interfaceClasses & ~compiled.allowed.wholeClasses()).any()) ||
+                     (arrival.interfaceClasses & compiled.blocked.partialClasses()).any();
+        } else {
+            uint32_t present = 0;
+            for (uint32_t type : arrival.interfaceTypes) {
+                uint32_t number = type >> 24;
+                bool deny = (!compiled.anyInterface && !compiled.allowed.matches(type)) || compiled.blocked.matches(type);
+                if (number >= 32) {
+                    refuse = refuse || deny;
+                    continue;
+                }
+                present |= 1u << number;
+                if (deny) denied |= 1u << number;
+            }
+            refuse = refuse || (denied && (!rule.perInterface || denied == present));
+        }
+    }
+    if (refuse) {
+        return {PolicyVerdict::InterfaceNotAllowed, index};
+    }
+    if (rule.expiryDate != std::chrono::system_clock::time_point{} && arrival.timestamp > rule.expiryDate) {
+        return {PolicyVerdict::Expired, index};
+    }
+    return {rule.requireAuthorization ? PolicyVerdict::AllowAfterAuthorization : PolicyVerdict::Allow, index, denied};
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,119 @@
+#pragma once
+#include "SecurityRule.hpp"
+#include "UsbGuardRules.hpp"
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace usb_monitor {
+
+// What a policy decides about one device arrival
+enum class PolicyVerdict : uint8_t {
+    Allow,
+    AllowAfterAuthorization,    // Allowed once the authorizer agrees
+    NotWhitelisted,             // No rule, or a rule that does not whitelist
+    InterfaceNotAllowed,
+    Expired,
+    Blocked                     // Matched a block or reject rule
+};
+
+constexpr size_t POLICY_VERDICTS = 6;
+
+const char* verdictName(PolicyVerdict verdict);
+inline bool isAllowed(PolicyVerdict verdict) {
+    return verdict == PolicyVerdict::Allow || verdict == PolicyVerdict::AllowAfterAuthorization;
+}
+
+// The parts of a device a policy looks at, as seen when it arrived
+struct DeviceArrivalRecord {
+    std::chrono::system_clock::time_point timestamp;
+    uint16_t vendorId{0};
+    uint16_t productId{0};
+    uint8_t deviceClass{0};
+    std::bitset<256> interfaceClasses;  // Of every alternate setting
+    // (number << 24) | (class << 16) | (subclass << 8) | protocol, per
+    // alternate setting in descriptor order
+    std::vector<uint32_t> interfaceTypes;
+    std::string portPath;
+    std::string serialNumber;
+    std::string name;                   // Product string
+    std::string hash;                   // Descriptor hash
+    std::string connectType;            // The port's, as in sysfs: "hotplug", "hardwired", ...
+};
+
+struct PolicyDecision {
+    PolicyVerdict verdict;
+    int rule;                   // Native rules, then imported ones; -1 if none matched
+    uint32_t deniedInterfaces{0};   // By interface number, for allowed devices
+};
+
+// A set of interface types as bitmaps: whole classes in one, and only for
+// classes a pattern narrows down, a subclass bitmap per class and a
+// protocol bitmap per class and subclass
+class InterfaceMask {
+public:
+    void add(const UsbGuardInterface& pattern);
+
+    bool empty() const { return classes.none() && refined.none(); }
+    bool matches(uint32_t type) const;
+
+    // Without interface types only whole classes can be judged: classes
+    // matched in full, and classes matched at least in part
+    const std::bitset<256>& wholeClasses() const { return classes; }
+    std::bitset<256> partialClasses() const { return classes | refined; }
+
+    // "0x08" classes or "08:06:50" types; entries that are neither are skipped
+    static InterfaceMask parse(const std::vector<std::string>& entries);
+
+private:
+    std::bitset<256> classes;
+    std::bitset<256> refined;
+    std::vector<std::pair<uint8_t, std::bitset<256>>> subclasses;      // Sorted by class
+    std::vector<std::pair<uint16_t, std::bitset<256>>> protocols;     // By (class << 8) | subclass
+};
+
+// A rule set compiled for lookup: rules are found by vendor/product in a
+// hash table, first rule wins as in SecurityManager, and interface lists
+// become InterfaceMasks checked in one pass over the interfaces.
+// Imported USBGuard rules come after the native ones and keep their file
+// order; they are bucketed by exact id and by vendor, with the rest in
+// one list, and the buckets a device falls in are merged in rule order.
+// Evaluation is read-only and thread-safe.
+class PolicyIndex {
+public:
+    PolicyIndex() = default;
+    explicit PolicyIndex(std::vector<SecurityRule> rules, std::vector<UsbGuardRule> imported = {});
+
+    PolicyDecision evaluate(const DeviceArrivalRecord& arrival) const;
+
+    const std::vector<SecurityRule>& rules() const { return securityRules; }
+    const std::vector<UsbGuardRule>& importedRules() const { return usbGuardRules; }
+
+private:
+    struct Compiled {
+        InterfaceMask allowed;
+        InterfaceMask blocked;
+        bool anyInterface;
+    };
+
+    PolicyDecision evaluateImported(const DeviceArrivalRecord& arrival) const;
+
+    static uint32_t deviceKey(uint16_t vendorId, uint16_t productId) {
+        return (uint32_t(vendorId) << 16) | productId;
+    }
+
+    std::vector<SecurityRule> securityRules;
+    std::vector<Compiled> compiledRules;
+    std::unordered_map<uint32_t, uint32_t> byDevice;
+
+    std::vector<UsbGuardRule> usbGuardRules;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> importedByDevice;
+    std::unordered_map<uint16_t, std::vector<uint32_t>> importedByVendor;
+    std::vector<uint32_t> importedOther;
+};
+
+} // namespace usb_monitor
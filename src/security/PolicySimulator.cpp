@@ -0,0 +1,244 @@
+#include "PolicySimulator.hpp"
+#include "../core/WorkerPool.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+namespace usb_monitor {
+
+namespace {
+
+constexpr size_t MIN_CHUNK = 4096;
+
+struct ChunkResult {
+    std::array<uint64_t, POLICY_VERDICTS> before{};
+    std::array<uint64_t, POLICY_VERDICTS> after{};
+    std::vector<PolicyChange> changes;
+    std::unordered_map<uint32_t, PolicyChangeSummary> devices;
+    uint64_t changed{0};
+};
+
+bool sameDecision(const PolicyDecision& a, const PolicyDecision& b) {
+    return a.verdict == b.verdict && a.rule == b.rule && a.deniedInterfaces == b.deniedInterfaces;
+}
+
+std::string clean(const std::string& field) {
+    std::string result = field;
+    std::replace_if(result.begin(), result.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+    return result;
+}
+
+} // namespace
+
+class PolicySimulator::Private {
+public:
+    mutable std::mutex runMutex;        // One run at a time owns the pool
+    std::unique_ptr<WorkerPool> pool;
+
+    static void evaluate(const std::vector<DeviceArrivalRecord>& history, size_t begin, size_t end,
+                         const PolicyIndex& current, const PolicyIndex& candidate,
+                         size_t maxChanges, ChunkResult& result) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& arrival = history[i];
+            PolicyDecision before = current.evaluate(arrival);
+            PolicyDecision after = candidate.evaluate(arrival);
+            result.before[size_t(before.verdict)]++;
+            result.after[size_t(after.verdict)]++;
+
+            uint32_t key = (uint32_t(arrival.vendorId) << 16) | arrival.productId;
+            auto [it, inserted] = result.devices.try_emplace(
+                key, PolicyChangeSummary{arrival.vendorId, arrival.productId, 0, 0, 0, 0});
+            auto& summary = it->second;
+            summary.arrivals++;
+            if (sameDecision(before, after)) continue;
+
+            result.changed++;
+            bool wasAllowed = isAllowed(before.verdict);
+            bool nowAllowed = isAllowed(after.verdict);
+            if (!wasAllowed && nowAllowed) {
+                summary.newlyAllowed++;
+            } else if (wasAllowed && !nowAllowed) {
+                summary.newlyBlocked++;
+            } else {
+                summary.otherChanges++;
+            }
+            if (result.changes.size() < maxChanges) {
+                result.changes.push_back(PolicyChange{i, before, after});
+            }
+        }
+    }
+};
+
+PolicySimulator::PolicySimulator(size_t threadCount)
+    : d(std::make_unique<Private>()) {
+    d->pool = std::make_unique<WorkerPool>(threadCount);
+}
+
+PolicySimulator::~PolicySimulator() = default;
+
+SimulationReport PolicySimulator::run(const std::vector<DeviceArrivalRecord>& history,
+                                      const PolicyIndex& current, const PolicyIndex& candidate,
+                                      size_t maxChanges) const {
+    auto started = std::chrono::steady_clock::now();
+    SimulationReport report;
+    report.records = history.size();
+
+    // A few chunks per worker so an uneven history still spreads out
+    size_t chunkSize = std::max(MIN_CHUNK, history.size() / (d->pool->threadCount() * 8) + 1);
+    size_t chunkCount = (history.size() + chunkSize - 1) / chunkSize;
+    std::vector<ChunkResult> chunks(chunkCount);
+    {
+        std::lock_guard<std::mutex> lock(d->runMutex);
+        for (size_t i = 0; i < chunkCount; i++) {
+            size_t begin = i * chunkSize;
+            size_t end = std::min(history.size(), begin + chunkSize);
+            d->pool->submit([&history, &current, &candidate, &chunks, maxChanges, begin, end, i] {
+                Private::evaluate(history, begin, end, current, candidate, maxChanges, chunks[i]);
+            });
+        }
+        d->pool->waitIdle();
+    }
+
+    std::unordered_map<uint32_t, PolicyChangeSummary> devices;
+    for (auto& chunk : chunks) {
+        report.changed += chunk.changed;
+        for (size_t v = 0; v < POLICY_VERDICTS; v++) {
+            report.before[v] += chunk.before[v];
+            report.after[v] += chunk.after[v];
+        }
+        // Chunks are in record order, so the first maxChanges stay in order
+        for (const auto& change : chunk.changes) {
+            if (report.changes.size() >= maxChanges) break;
+            report.changes.push_back(change);
+        }
+        for (const auto& [key, summary] : chunk.devices) {
+            auto [it, inserted] = devices.try_emplace(key, summary);
+            if (inserted) continue;
+            it->second.arrivals += summary.arrivals;
+            it->second.newlyAllowed += summary.newlyAllowed;
+            it->second.newlyBlocked += summary.newlyBlocked;
+            it->second.otherChanges += summary.otherChanges;
+        }
+    }
+
+    for (const auto& [key, summary] : devices) {
+        report.newlyAllowed += summary.newlyAllowed;
+        report.newlyBlocked += summary.newlyBlocked;
+        if (summary.newlyAllowed + summary.newlyBlocked + summary.otherChanges > 0) {
+            report.devices.push_back(summary);
+        }
+    }
+    std::sort(report.devices.begin(), report.devices.end(),
+              [](const PolicyChangeSummary& a, const PolicyChangeSummary& b) {
+                  uint64_t changesA = a.newlyAllowed + a.newlyBlocked + a.otherChanges;
+                  uint64_t changesB = b.newlyAllowed + b.newlyBlocked + b.otherChanges;
+                  if (changesA != changesB) return changesA > changesB;
+                  return std::tie(a.vendorId, a.productId) < std::tie(b.vendorId, b.productId);
+              });
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+void writeArrivalRecord(std::ostream& out, const DeviceArrivalRecord& arrival) {
+    char ids[32];
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(arrival.timestamp.time_since_epoch());
+    std::snprintf(ids, sizeof(ids), "%04x\t%04x\t%02x", arrival.vendorId, arrival.productId,
+                  arrival.deviceClass);
+    out << ms.count() << '\t' << ids << '\t';
+
+    bool first = true;
+    for (size_t c = 0; c < arrival.interfaceClasses.size(); c++) {
+        if (!arrival.interfaceClasses.test(c)) continue;
+        std::snprintf(ids, sizeof(ids), "%s%02zx", first ? "" : ",", c);
+        out << ids;
+        first = false;
+    }
+    out << '\t' << clean(arrival.portPath) << '\t' << clean(arrival.serialNumber) << '\t';
+
+    for (size_t i = 0; i < arrival.interfaceTypes.size(); i++) {
+        std::snprintf(ids, sizeof(ids), "%s%08x", i ? "," : "", arrival.interfaceTypes[i]);
+        out << ids;
+    }
+    out << '\t' << clean(arrival.name) << '\t' << clean(arrival.hash) << '\t'
+        << clean(arrival.connectType) << '\n';
+}
+
+bool writeArrivalHistory(const std::string& path, const std::vector<DeviceArrivalRecord>& history) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) return false;
+
+    for (const auto& arrival : history) {
+        writeArrivalRecord(file, arrival);
+    }
+    return bool(file);
+}
+
+bool appendArrivalHistory(const std::string& path, const std::vector<DeviceArrivalRecord>& arrivals) {
+    std::ofstream file(path, std::ios::app);
+    if (!file) return false;
+
+    for (const auto& arrival : arrivals) {
+        writeArrivalRecord(file, arrival);
+    }
+    return bool(file);
+}
+
+std::optional<std::vector<DeviceArrivalRecord>> readArrivalHistory(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return std::nullopt;
+
+    std::vector<DeviceArrivalRecord> history;
+    std::string line;
+    std::vector<std::string> fields;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+
+        fields.clear();
+        size_t start = 0;
+        for (;;) {
+            size_t tab = line.find('\t', start);
+            fields.push_back(line.substr(start, tab - start));
+            if (tab == std::string::npos) break;
+            start = tab + 1;
+        }
+        // Interface types, name and hash came later, then the connect type
+        if (fields.size() != 7 && fields.size() != 10 && fields.size() != 11) return std::nullopt;
+
+        DeviceArrivalRecord arrival;
+        arrival.timestamp = std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(std::strtoll(fields[0].c_str(), nullptr, 10)));
+        arrival.vendorId = uint16_t(std::strtoul(fields[1].c_str(), nullptr, 16));
+        arrival.productId = uint16_t(std::strtoul(fields[2].c_str(), nullptr, 16));
+        arrival.deviceClass = uint8_t(std::strtoul(fields[3].c_str(), nullptr, 16));
+
+        std::istringstream classes(fields[4]);
+        std::string id;
+        while (std::getline(classes, id, ',')) {
+            unsigned long value = std::strtoul(id.c_str(), nullptr, 16);
+            if (value < 256) arrival.interfaceClasses.set(value);
+        }
+        arrival.portPath = fields[5];
+        arrival.serialNumber = fields[6];
+        if (fields.size() >= 10) {
+            std::istringstream types(fields[7]);
+            while (std::getline(types, id, ',')) {
+                arrival.interfaceTypes.push_back(uint32_t(std::strtoul(id.c_str(), nullptr, 16)));
+            }
+            arrival.name = fields[8];
+            arrival.hash = fields[9];
+        }
+        if (fields.size() == 11) {
+            arrival.connectType = fields[10];
+        }
+        history.push_back(std::move(arrival));
+    }
+    return history;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,70 @@
+#pragma once
+#include "PolicyIndex.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+// One arrival the candidate rules would decide differently
+struct PolicyChange {
+    size_t record;              // Index into the history
+    PolicyDecision before;
+    PolicyDecision after;
+};
+
+// Changed decisions for one vendor/product
+struct PolicyChangeSummary {
+    uint16_t vendorId;
+    uint16_t productId;
+    uint64_t arrivals;          // All of them, changed or not
+    uint64_t newlyAllowed;
+    uint64_t newlyBlocked;
+    uint64_t otherChanges;      // Same outcome, different reason or rule
+};
+
+struct SimulationReport {
+    uint64_t records{0};
+    uint64_t changed{0};
+    uint64_t newlyAllowed{0};
+    uint64_t newlyBlocked{0};
+    std::array<uint64_t, POLICY_VERDICTS> before{};     // By PolicyVerdict
+    std::array<uint64_t, POLICY_VERDICTS> after{};
+    std::vector<PolicyChange> changes;                  // In record order, capped
+    std::vector<PolicyChangeSummary> devices;           // Most changes first
+    double seconds{0.0};
+};
+
+// Dry run of a candidate rule set: every recorded arrival is evaluated
+// against both rule sets and the decisions compared. The history is cut
+// into chunks evaluated in parallel on the simulator's own workers.
+class PolicySimulator {
+public:
+    explicit PolicySimulator(size_t threadCount = 0);
+    ~PolicySimulator();
+
+    PolicySimulator(const PolicySimulator&) = delete;
+    PolicySimulator& operator=(const PolicySimulator&) = delete;
+
+    SimulationReport run(const std::vector<DeviceArrivalRecord>& history,
+                         const PolicyIndex& current, const PolicyIndex& candidate,
+                         size_t maxChanges = 10000) const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+// Arrival history as tab separated lines, one arrival per line. Lines
+// appended to a history file keep it readable as a whole.
+bool writeArrivalHistory(const std::string& path, const std::vector<DeviceArrivalRecord>& history);
+bool appendArrivalHistory(const std::string& path, const std::vector<DeviceArrivalRecord>& arrivals);
+void writeArrivalRecord(std::ostream& out, const DeviceArrivalRecord& arrival);
+std::optional<std::vector<DeviceArrivalRecord>> readArrivalHistory(const std::string& path);
+
+} // namespace usb_monitor
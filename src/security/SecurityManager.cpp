@@ -1,22 +1,80 @@
 #include "SecurityManager.hpp"
 #include "DeviceAuthorizer.hpp"
+#include "HotplugFloodGuard.hpp"
+#include "PolicyIndex.hpp"
+#include "../core/DeviceManager.hpp"
 #include "../core/UsbDevice.hpp"
+#include "../core/UsbSysfs.hpp"
+#include "../core/Logger.hpp"
+#include "../analysis/ProtocolAnalyzer.hpp"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
 #include <QDateTime>
+#include <QTimer>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 #include <mutex>
 #include <deque>
+#include <map>
 
 namespace usb_monitor {
 
+namespace {
+
+QJsonObject exfiltrationToJson(const ExfiltrationPolicy& policy) {
+    QJsonObject object;
+    object["burstBytes"] = static_cast<double>(policy.burstBytes);
+    object["entropyThreshold"] = policy.entropyThreshold;
+    object["highEntropyAllowed"] = policy.highEntropyAllowed;
+    return object;
+}
+
+// Missing fields keep their defaults
+ExfiltrationPolicy exfiltrationFromJson(const QJsonObject& object) {
+    ExfiltrationPolicy policy;
+    if (object.contains("burstBytes")) {
+        policy.burstBytes = static_cast<uint64_t>(object["burstBytes"].toDouble());
+    }
+    if (object.contains("entropyThreshold")) {
+        policy.entropyThreshold = object["entropyThreshold"].toDouble();
+    }
+    policy.highEntropyAllowed = object["highEntropyAllowed"].toBool();
+    return policy;
+}
+
+// The interfaces the rules allow. With interface_authorized_default=0
+// they start out deauthorized too, and only binding them needs a write.
+void setAllowedInterfaces(UsbDevice* device, uint32_t deniedInterfaces, bool authorized) {
+    auto config = device->configDescriptor();
+    if (!config) return;
+    
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        if (config->interface[i].num_altsetting < 1) continue;
+        uint8_t number = config->interface[i].altsetting[0].bInterfaceNumber;
+        if (number < 32 && (deniedInterfaces & (1u << number))) continue;
+        device->setInterfaceAuthorized(number, authorized);
+    }
+}
+
+std::string deviceKeyOf(const UsbDevice* device) {
+    auto id = device->identifier();
+    return std::to_string(id.vendorId) + ":" + std::to_string(id.productId);
+}
+
+} // namespace
+
 struct SecurityState {
     std::vector<SecurityRule> rules;
+    std::vector<UsbGuardRule> importedRules;
     std::deque<SecurityEventInfo> events;
     std::map<std::string, bool> authorizedDevices;
+    std::shared_ptr<const PolicyIndex> index{std::make_shared<const PolicyIndex>()};
+    std::deque<DeviceArrivalRecord> arrivals;
+    ExfiltrationPolicy exfiltration;
+    bool deauthorizeNewInterfaces{false};
     SecurityLevel currentLevel{SecurityLevel::Medium};
     size_t maxEventHistory{10000};
 };
@@ -24,14 +82,71 @@ struct SecurityState {
 class SecurityManager::Private {
 public:
     std::unique_ptr<DeviceAuthorizer> authorizer;
+    HotplugFloodGuard floodGuard;
     SecurityState state;
     mutable std::mutex stateMutex;
+    std::unique_ptr<PolicySimulator> simulator;
+    std::once_flag simulatorOnce;
     SecurityManager* q_ptr;
     
-    bool matchesRule(const SecurityRule& rule, const UsbDevice* device) const {
-        if (!device) return false;
-        auto id = device->identifier();
-        return (rule.vendorId == id.vendorId && rule.productId == id.productId);
+    bool enforcing() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return !state.rules.empty() || !state.importedRules.empty();
+    }
+    
+    // Whether interfaces of new devices should stay unbound system-wide
+    // until the rules are applied to them
+    bool holdingNewInterfaces() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return state.deauthorizeNewInterfaces &&
+               (!state.rules.empty() || !state.importedRules.empty());
+    }
+    
+    // Taken before stateMutex when both are needed
+    mutable std::mutex arrivalLogMutex;
+    std::ofstream arrivalLog;
+    std::string arrivalLogPath;
+    std::vector<DeviceArrivalRecord> pendingArrivals;  // Written by arrivalLogTimer
+    QTimer* arrivalLogTimer{nullptr};
+    
+    // Arrivals are admitted on the manager thread, so they are only queued
+    // here and go to disk together on the next tick
+    void logArrival(const DeviceArrivalRecord& arrival) {
+        std::lock_guard<std::mutex> lock(arrivalLogMutex);
+        if (arrivalLog.is_open()) {
+            pendingArrivals.push_back(arrival);
+        }
+    }
+    
+    // Locked
+    void flushArrivalLog() {
+        if (pendingArrivals.empty()) return;
+        
+        for (const auto& arrival : pendingArrivals) {
+            writeArrivalRecord(arrivalLog, arrival);
+        }
+        pendingArrivals.clear();
+        arrivalLog.flush();
+        if (!arrivalLog) {
+            LOG_WARNING("Cannot append to arrival log " + arrivalLogPath + ", logging stopped");
+            arrivalLog.close();
+            arrivalLogPath.clear();
+        }
+    }
+    
+    // Locked; readers keep the index they took while rules change
+    void compileRules() {
+        state.index = std::make_shared<const PolicyIndex>(state.rules, state.importedRules);
+    }
+    
+    std::shared_ptr<const PolicyIndex> currentIndex() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return state.index;
+    }
+    
+    PolicySimulator& policySimulator() {
+        std::call_once(simulatorOnce, [this] { simulator = std::make_unique<PolicySimulator>(); });
+        return *simulator;
     }
     
     void enforceSecurityLevel(SecurityLevel level) {
@@ -69,51 +184,45 @@ public:
         authorizer->setAuthorizationPolicy(policy);
     }
     
-    bool validateDeviceInterfaces(const UsbDevice* device, const SecurityRule& rule) const {
-        if (rule.allowedInterfaces.empty()) return true;
+    DeviceArrivalRecord arrivalRecord(const UsbDevice* device) const {
+        DeviceArrivalRecord arrival;
+        auto id = device->identifier();
+        arrival.timestamp = std::chrono::system_clock::now();
+        arrival.vendorId = id.vendorId;
+        arrival.productId = id.productId;
+        arrival.deviceClass = static_cast<uint8_t>(device->deviceClass());
+        arrival.portPath = device->portPath();
+        arrival.serialNumber = device->serialNumber();
+        arrival.name = device->product();
         
-        // Get device interfaces
-        libusb_config_descriptor* config;
-        if (libusb_get_active_config_descriptor(device->nativeDevice(), &config) != 0) {
-            return false;
+        std::stringstream hash;
+        hash << std::hex << std::setw(16) << std::setfill('0') << device->descriptorHash();
+        arrival.hash = hash.str();
+        arrival.connectType = readUsbAttribute(device->portPath(), "port/connect_type");
+        
+        auto config = device->configDescriptor();
+        libusb_config_descriptor* active = nullptr;
+        if (!config && libusb_get_active_config_descriptor(device->nativeDevice(), &active) == 0) {
+            config.reset(active, libusb_free_config_descriptor);
+        }
+        if (!config) {
+            // Interfaces we cannot read pass no interface restriction
+            arrival.interfaceClasses.set();
+            return arrival;
         }
         
-        bool valid = true;
         for (int i = 0; i < config->bNumInterfaces; i++) {
             const auto* interface = &config->interface[i];
             for (int j = 0; j < interface->num_altsetting; j++) {
-                const auto* setting = &interface->altsetting[j];
-                
-                // Convert interface class to string identifier
-                std::stringstream ss;
-                ss << "0x" << std::hex << std::uppercase 
-                   << std::setw(2) << std::setfill('0') 
-                   << static_cast<int>(setting->bInterfaceClass);
-                std::string interfaceId = ss.str();
-                
-                // Check if interface is allowed
-                if (std::find(rule.allowedInterfaces.begin(),
-                            rule.allowedInterfaces.end(),
-                            interfaceId) == rule.allowedInterfaces.end()) {
-                    valid = false;
-                    break;
-                }
-            }
-            if (!valid) break;
-        }
-        
-        libusb_free_config_descriptor(config);
-        return valid;
-    }
-    
-    SecurityRule findMatchingRule(const UsbDevice* device) const {
-        std::lock_guard<std::mutex> lock(stateMutex);
-        for (const auto& rule : state.rules) {
-            if (matchesRule(rule, device)) {
-                return rule;
+                const auto& setting = interface->altsetting[j];
+                arrival.interfaceClasses.set(setting.bInterfaceClass);
+                arrival.interfaceTypes.push_back((uint32_t(setting.bInterfaceNumber) << 24) |
+                                                 (uint32_t(setting.bInterfaceClass) << 16) |
+                                                 (uint32_t(setting.bInterfaceSubClass) << 8) |
+                                                 setting.bInterfaceProtocol);
             }
         }
-        return SecurityRule{}; // Return default rule
+        return arrival;
     }
     
     void pruneEventHistory() {
@@ -128,6 +237,14 @@ public:
         
         // Save security level
         root["securityLevel"] = static_cast<int>(state.currentLevel);
+        root["exfiltration"] = exfiltrationToJson(state.exfiltration);
+        root["deauthorizeNewInterfaces"] = state.deauthorizeNewInterfaces;
+        {
+            std::lock_guard<std::mutex> lock(arrivalLogMutex);
+            if (!arrivalLogPath.empty()) {
+                root["arrivalLog"] = QString::fromStdString(arrivalLogPath);
+            }
+        }
         
         // Save rules
         QJsonArray rulesArray;
@@ -145,6 +262,16 @@ public:
             }
             ruleObj["allowedInterfaces"] = interfacesArray;
             
+            QJsonArray blockedArray;
+            for (const auto& iface : rule.blockedInterfaces) {
+                blockedArray.append(QString::fromStdString(iface));
+            }
+            ruleObj["blockedInterfaces"] = blockedArray;
+            ruleObj["perInterface"] = rule.perInterface;
+            if (rule.exfiltration) {
+                ruleObj["exfiltration"] = exfiltrationToJson(*rule.exfiltration);
+            }
+            
             if (rule.expiryDate != std::chrono::system_clock::time_point{}) {
                 auto expiryTime = std::chrono::system_clock::to_time_t(rule.expiryDate);
                 ruleObj["expiryDate"] = QString::fromStdString(
@@ -184,6 +311,10 @@ public:
             q_ptr->setSecurityLevel(level);
         }
         
+        if (root.contains("arrivalLog")) {
+            q_ptr->setArrivalLog(root["arrivalLog"].toString().toStdString());
+        }
+        
         // Load rules
         std::vector<SecurityRule> newRules;
         QJsonArray rulesArray = root["rules"].toArray();
@@ -203,6 +334,15 @@ public:
                 rule.allowedInterfaces.push_back(iface.toString().toStdString());
             }
             
+            QJsonArray blockedArray = ruleObj["blockedInterfaces"].toArray();
+            for (const auto& iface : blockedArray) {
+                rule.blockedInterfaces.push_back(iface.toString().toStdString());
+            }
+            rule.perInterface = ruleObj["perInterface"].toBool();
+            if (ruleObj.contains("exfiltration")) {
+                rule.exfiltration = exfiltrationFromJson(ruleObj["exfiltration"].toObject());
+            }
+            
             if (ruleObj.contains("expiryDate")) {
                 std::istringstream ss(ruleObj["expiryDate"].toString().toStdString());
                 std::tm tm = {};
@@ -216,6 +356,9 @@ public:
         {
             std::lock_guard<std::mutex> lock(stateMutex);
             state.rules = std::move(newRules);
+            state.exfiltration = exfiltrationFromJson(root["exfiltration"].toObject());
+            state.deauthorizeNewInterfaces = root["deauthorizeNewInterfaces"].toBool();
+            compileRules();
         }
         
         return true;
@@ -228,6 +371,13 @@ SecurityManager::SecurityManager(QObject* parent)
     d->q_ptr = this;
     d->authorizer = std::make_unique<DeviceAuthorizer>();
     
+    d->arrivalLogTimer = new QTimer(this);
+    connect(d->arrivalLogTimer, &QTimer::timeout, this, [this]() {
+        std::lock_guard<std::mutex> lock(d->arrivalLogMutex);
+        d->flushArrivalLog();
+    });
+    d->arrivalLogTimer->start(ARRIVAL_LOG_FLUSH_INTERVAL);
+    
     // Connect authorizer signals
     connect(d->authorizer.get(), &DeviceAuthorizer::deviceAuthorized,
             [this](const UsbDevice* device) {
@@ -248,46 +398,75 @@ SecurityManager::SecurityManager(QObject* parent)
     });
 }
 
-SecurityManager::~SecurityManager() = default;
+SecurityManager::~SecurityManager() {
+    {
+        std::lock_guard<std::mutex> lock(d->arrivalLogMutex);
+        d->flushArrivalLog();
+    }
+    
+    // New devices must not stay unusable once nothing authorizes them
+    if (usbInterfaceAuthorizedDefaultHeld()) {
+        restoreUsbInterfaceAuthorizedDefault();
+    }
+}
 
 bool SecurityManager::isDeviceAllowed(const UsbDevice* device) {
+    uint32_t deniedInterfaces = 0;
+    bool needsConfirmation = false;
+    return checkDevice(device, deniedInterfaces, needsConfirmation);
+}
+
+bool SecurityManager::checkDevice(const UsbDevice* device, uint32_t& deniedInterfaces,
+                                  bool& needsConfirmation) {
+    deniedInterfaces = 0;
+    needsConfirmation = false;
     if (!device) return false;
     
+    // Ports blocked for flooding admit nothing until the block lapses
+    if (isPortBlocked(device->portPath())) {
+        return false;
+    }
+    
+    // Evaluate against the compiled rules
+    auto decision = d->currentIndex()->evaluate(d->arrivalRecord(device));
+    deniedInterfaces = decision.deniedInterfaces;
+    
     // Check if device is already authorized
     {
         std::lock_guard<std::mutex> lock(d->stateMutex);
-        auto id = device->identifier();
-        std::string deviceKey = std::to_string(id.vendorId) + ":" + 
-                               std::to_string(id.productId);
-        auto it = d->state.authorizedDevices.find(deviceKey);
+        auto it = d->state.authorizedDevices.find(deviceKeyOf(device));
         if (it != d->state.authorizedDevices.end()) {
             return it->second;
         }
     }
     
-    // Find matching security rule
-    auto rule = d->findMatchingRule(device);
-    
-    // Check whitelist/blacklist
-    if (!rule.isWhitelisted) {
-        logSecurityEvent(SecurityEvent::UnauthorizedAccess, device,
-                        "Device is not whitelisted");
-        return false;
-    }
-    
-    // Validate interfaces
-    if (!d->validateDeviceInterfaces(device, rule)) {
-        logSecurityEvent(SecurityEvent::PolicyViolation, device,
-                        "Device uses unauthorized interfaces");
-        return false;
-    }
-    
-    // Check expiry
-    if (rule.expiryDate != std::chrono::system_clock::time_point{} &&
-        std::chrono::system_clock::now() > rule.expiryDate) {
-        logSecurityEvent(SecurityEvent::PolicyViolation, device,
-                        "Security rule has expired");
-        return false;
+    switch (decision.verdict) {
+        case PolicyVerdict::NotWhitelisted:
+            logSecurityEvent(SecurityEvent::UnauthorizedAccess, device,
+                            "Device is not whitelisted");
+            return false;
+            
+        case PolicyVerdict::InterfaceNotAllowed:
+            logSecurityEvent(SecurityEvent::PolicyViolation, device,
+                            "Device uses unauthorized interfaces");
+            return false;
+            
+        case PolicyVerdict::Expired:
+            logSecurityEvent(SecurityEvent::PolicyViolation, device,
+                            "Security rule has expired");
+            return false;
+            
+        case PolicyVerdict::Blocked:
+            logSecurityEvent(SecurityEvent::UnauthorizedAccess, device,
+                            "Device is blocked by rule");
+            return false;
+            
+        case PolicyVerdict::AllowAfterAuthorization:
+            needsConfirmation = true;
+            break;
+            
+        case PolicyVerdict::Allow:
+            break;
     }
     
     return true;
@@ -297,7 +476,9 @@ bool SecurityManager::authorizeDevice(UsbDevice* device) {
     if (!device) return false;
     
     // Check if device is allowed by security rules
-    if (!isDeviceAllowed(device)) {
+    uint32_t deniedInterfaces = 0;
+    bool needsConfirmation = false;
+    if (!checkDevice(device, deniedInterfaces, needsConfirmation)) {
         emit deviceBlocked(device, "Device is not allowed by security rules");
         return false;
     }
@@ -308,6 +489,10 @@ bool SecurityManager::authorizeDevice(UsbDevice* device) {
         return false;
     }
     
+    // Denied interfaces go first, so no driver binds to them once the
+    // device is authorized
+    deauthorizeInterfaces(device, deniedInterfaces);
+    
     // Attempt authorization
     auto result = d->authorizer->authorizeDevice(device);
     if (!result.authorized) {
@@ -318,15 +503,70 @@ bool SecurityManager::authorizeDevice(UsbDevice* device) {
     // Update authorized devices list
     {
         std::lock_guard<std::mutex> lock(d->stateMutex);
-        auto id = device->identifier();
-        std::string deviceKey = std::to_string(id.vendorId) + ":" + 
-                               std::to_string(id.productId);
-        d->state.authorizedDevices[deviceKey] = true;
+        d->state.authorizedDevices[deviceKeyOf(device)] = true;
     }
     
+    setAllowedInterfaces(device, deniedInterfaces, true);
     return true;
 }
 
+// Manager thread. The rules' verdict alone decides; the authorizer's
+// device class heuristics and protocol checks would refuse what a rule
+// explicitly allows.
+bool SecurityManager::admitDevice(const std::shared_ptr<UsbDevice>& device) {
+    uint32_t deniedInterfaces = 0;
+    bool needsConfirmation = false;
+    if (!checkDevice(device.get(), deniedInterfaces, needsConfirmation)) {
+        emit deviceBlocked(device.get(), "Device is not allowed by security rules");
+        return false;
+    }
+    
+    deauthorizeInterfaces(device.get(), deniedInterfaces);
+    setAllowedInterfaces(device.get(), deniedInterfaces, !needsConfirmation);
+    if (!needsConfirmation) return true;
+    
+    // The rule wants a user's yes first. The device is admitted with its
+    // interfaces held, and asked about once admission is done; a no
+    // deauthorizes the whole device.
+    std::weak_ptr<UsbDevice> weak = device;
+    d->authorizer->requestUserAuthorization(device,
+        [this, weak, deniedInterfaces](const AuthorizationResult& result) {
+        auto held = weak.lock();
+        if (!held) return;
+        
+        if (!result.authorized) {
+            logSecurityEvent(SecurityEvent::AuthorizationDenied, held.get(),
+                            "Authorization failed: " + result.reason);
+            held->setAuthorized(false);
+            emit deviceBlocked(held.get(), result.reason);
+            return;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(d->stateMutex);
+            d->state.authorizedDevices[deviceKeyOf(held.get())] = true;
+        }
+        logSecurityEvent(SecurityEvent::AuthorizationGranted, held.get(),
+                        "Device authorization granted");
+        setAllowedInterfaces(held.get(), deniedInterfaces, true);
+    });
+    return true;
+}
+
+void SecurityManager::deauthorizeInterfaces(UsbDevice* device, uint32_t interfaces) {
+    for (uint8_t number = 0; number < 32; number++) {
+        if (!(interfaces & (1u << number))) continue;
+        
+        if (device->setInterfaceAuthorized(number, false)) {
+            logSecurityEvent(SecurityEvent::PolicyViolation, device,
+                            "Interface " + std::to_string(number) + " deauthorized by rule");
+        } else {
+            logSecurityEvent(SecurityEvent::PolicyViolation, device,
+                            "Could not deauthorize interface " + std::to_string(number));
+        }
+    }
+}
+
 void SecurityManager::revokeAuthorization(UsbDevice* device) {
     if (!device) return;
     
@@ -335,42 +575,45 @@ void SecurityManager::revokeAuthorization(UsbDevice* device) {
     // Update authorized devices list
     {
         std::lock_guard<std::mutex> lock(d->stateMutex);
-        auto id = device->identifier();
-        std::string deviceKey = std::to_string(id.vendorId) + ":" + 
-                               std::to_string(id.productId);
-        d->state.authorizedDevices.erase(deviceKey);
+        d->state.authorizedDevices.erase(deviceKeyOf(device));
     }
 }
 
 void SecurityManager::addSecurityRule(const SecurityRule& rule) {
-    std::lock_guard<std::mutex> lock(d->stateMutex);
-    
-    // Remove any existing rule for the same device
-    auto it = std::remove_if(d->state.rules.begin(), d->state.rules.end(),
-        [&rule](const SecurityRule& existing) {
-            return existing.vendorId == rule.vendorId &&
-                   existing.productId == rule.productId;
-        });
-    d->state.rules.erase(it, d->state.rules.end());
-    
-    // Add new rule
-    d->state.rules.push_back(rule);
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        
+        // Remove any existing rule for the same device
+        auto it = std::remove_if(d->state.rules.begin(), d->state.rules.end(),
+            [&rule](const SecurityRule& existing) {
+                return existing.vendorId == rule.vendorId &&
+                       existing.productId == rule.productId;
+            });
+        d->state.rules.erase(it, d->state.rules.end());
+        
+        // Add new rule
+        d->state.rules.push_back(rule);
+        d->compileRules();
+    }
     
+    // Slots read the state back, so the lock is released first
     emit configurationChanged();
 }
 
 void SecurityManager::removeSecurityRule(uint16_t vendorId, uint16_t productId) {
-    std::lock_guard<std::mutex> lock(d->stateMutex);
-    
-    auto it = std::remove_if(d->state.rules.begin(), d->state.rules.end(),
-        [vendorId, productId](const SecurityRule& rule) {
-            return rule.vendorId == vendorId && rule.productId == productId;
-        });
-    
-    if (it != d->state.rules.end()) {
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        
+        auto it = std::remove_if(d->state.rules.begin(), d->state.rules.end(),
+            [vendorId, productId](const SecurityRule& rule) {
+                return rule.vendorId == vendorId && rule.productId == productId;
+            });
+        if (it == d->state.rules.end()) return;
+        
         d->state.rules.erase(it, d->state.rules.end());
-        emit configurationChanged();
+        d->compileRules();
     }
+    emit configurationChanged();
 }
 
 std::vector<SecurityRule> SecurityManager::getSecurityRules() const {
@@ -379,8 +622,48 @@ std::vector<SecurityRule> SecurityManager::getSecurityRules() const {
 }
 
 void SecurityManager::clearSecurityRules() {
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.rules.clear();
+        d->compileRules();
+    }
+    emit configurationChanged();
+}
+
+bool SecurityManager::importUsbGuardRules(const std::string& filename) {
+    auto ruleSet = readUsbGuardRules(filename);
+    if (!ruleSet) {
+        LOG_WARNING("Cannot read USBGuard rules from " + filename);
+        return false;
+    }
+    if (!ruleSet->errors.empty()) {
+        for (const auto& error : ruleSet->errors) {
+            LOG_WARNING(filename + ":" + std::to_string(error.line) + ": " + error.message);
+        }
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.importedRules = std::move(ruleSet->rules);
+        d->compileRules();
+    }
+    
+    emit configurationChanged();
+    return true;
+}
+
+std::vector<UsbGuardRule> SecurityManager::getImportedRules() const {
     std::lock_guard<std::mutex> lock(d->stateMutex);
-    d->state.rules.clear();
+    return d->state.importedRules;
+}
+
+void SecurityManager::clearImportedRules() {
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.importedRules.clear();
+        d->compileRules();
+    }
     emit configurationChanged();
 }
 
@@ -429,6 +712,230 @@ void SecurityManager::clearSecurityEvents() {
     d->state.events.clear();
 }
 
+void SecurityManager::reportMaliciousActivity(const UsbDevice* device,
+                                              const std::string& description) {
+    logSecurityEvent(SecurityEvent::MaliciousActivityDetected, device, description);
+}
+
+ExfiltrationPolicy SecurityManager::getExfiltrationPolicy(const UsbDevice* device) const {
+    std::lock_guard<std::mutex> lock(d->stateMutex);
+    if (device) {
+        auto id = device->identifier();
+        for (const auto& rule : d->state.rules) {
+            if (rule.vendorId == id.vendorId && rule.productId == id.productId) {
+                if (rule.exfiltration) return *rule.exfiltration;
+                break;
+            }
+        }
+    }
+    return d->state.exfiltration;
+}
+
+ExfiltrationPolicy SecurityManager::getDefaultExfiltrationPolicy() const {
+    std::lock_guard<std::mutex> lock(d->stateMutex);
+    return d->state.exfiltration;
+}
+
+void SecurityManager::setDefaultExfiltrationPolicy(const ExfiltrationPolicy& policy) {
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.exfiltration = policy;
+    }
+    emit configurationChanged();
+}
+
+void SecurityManager::setDeauthorizeNewInterfaces(bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.deauthorizeNewInterfaces = enabled;
+    }
+    emit configurationChanged();
+}
+
+bool SecurityManager::getDeauthorizeNewInterfaces() const {
+    std::lock_guard<std::mutex> lock(d->stateMutex);
+    return d->state.deauthorizeNewInterfaces;
+}
+
+void SecurityManager::attach(DeviceManager* manager, ProtocolAnalyzer* analyzer) {
+    if (!manager) return;
+    
+    // Every arrival passes the flood guard, and the rules once there are
+    // any, before it is committed; the manager deauthorizes what fails.
+    // Only the rules decide here: a device they allow after authorization
+    // is asked about afterwards, without holding up the arrivals.
+    manager->setAdmissionCheck([this](const std::shared_ptr<UsbDevice>& device) {
+        if (!recordDeviceArrival(device.get())) return false;
+        return !d->enforcing() || admitDevice(device);
+    });
+    connect(manager, &DeviceManager::portFlapping,
+            this, [this](const std::string& portPath, uint32_t flaps) {
+        recordPortFlaps(portPath, flaps);
+    });
+    
+    // Opted into by the config: while rules are enforced, interfaces of
+    // new devices stay unbound until the rules allow them. This is every
+    // bus on the system, so it is put back as soon as it is not wanted.
+    auto enforce = [this]() {
+        bool hold = d->holdingNewInterfaces();
+        if (hold == usbInterfaceAuthorizedDefaultHeld()) return;
+        if (!hold) {
+            restoreUsbInterfaceAuthorizedDefault();
+        } else if (holdUsbInterfaceAuthorizedDefault() == 0) {
+            LOG_WARNING("Cannot set interface_authorized_default, interfaces of new devices "
+                        "may bind before the rules are applied");
+        }
+    };
+    connect(this, &SecurityManager::configurationChanged, this, enforce);
+    enforce();
+    
+    if (!analyzer) return;
+    
+    auto watch = [this, analyzer](std::shared_ptr<UsbDevice> device) {
+        analyzer->watchExfiltration(device, getExfiltrationPolicy(device.get()));
+    };
+    connect(manager, &DeviceManager::deviceAdded, this, watch);
+    connect(manager, &DeviceManager::deviceReenumerated, this, watch);
+    connect(manager, &DeviceManager::deviceRemoved,
+            this, [analyzer](std::shared_ptr<UsbDevice> device) {
+        analyzer->unwatchExfiltration(device);
+    });
+    
+    connect(analyzer, &ProtocolAnalyzer::exfiltrationSuspected,
+            this, [this](const UsbDevice* device, const ExfiltrationAlert& alert) {
+        std::ostringstream description;
+        description << "Bulk write of " << alert.windowBytes / (1024 * 1024) << " MiB in "
+                    << EXFIL_WINDOW << " s at entropy " << std::fixed << std::setprecision(2)
+                    << alert.entropy << " bits/byte";
+        reportMaliciousActivity(device, description.str());
+    });
+    
+    // Policies follow the config, also for devices already present
+    auto apply = [this, manager, analyzer, watch]() {
+        analyzer->setExfiltrationPolicy(nullptr, getDefaultExfiltrationPolicy());
+        for (const auto& device : manager->deviceSnapshot()->devices) {
+            watch(device);
+        }
+    };
+    connect(this, &SecurityManager::configurationChanged, this, apply);
+    apply();
+}
+
+bool SecurityManager::recordDeviceArrival(const UsbDevice* device) {
+    if (!device) return false;
+    
+    std::string portPath = device->portPath();
+    auto decision = d->floodGuard.recordArrival(portPath, device->descriptorHash(),
+                                                HotplugFloodGuard::Clock::now());
+    
+    // History takes the same budget as the event log: a flood would only
+    // push real arrivals out, and the skipped ones are counted in the next
+    // event logged
+    if (decision.log) {
+        auto arrival = d->arrivalRecord(device);
+        d->logArrival(arrival);
+        std::lock_guard<std::mutex> lock(d->stateMutex);
+        d->state.arrivals.push_back(std::move(arrival));
+        while (d->state.arrivals.size() > size_t(MAX_ARRIVAL_HISTORY)) {
+            d->state.arrivals.pop_front();
+        }
+    }
+    return handleFloodDecision(portPath, device, decision);
+}
+
+void SecurityManager::recordPortFlaps(const std::string& portPath, uint32_t flaps) {
+    if (flaps == 0) return;
+    
+    auto decision = d->floodGuard.recordArrival(portPath, 0, HotplugFloodGuard::Clock::now(), flaps);
+    handleFloodDecision(portPath, nullptr, decision);
+}
+
+bool SecurityManager::isPortBlocked(const std::string& portPath) const {
+    return d->floodGuard.isBlocked(portPath, HotplugFloodGuard::Clock::now());
+}
+
+void SecurityManager::unblockPort(const std::string& portPath) {
+    d->floodGuard.unblock(portPath);
+    logSecurityEvent(SecurityEvent::AuthorizationGranted, portPath, "Port unblocked");
+}
+
+std::vector<std::string> SecurityManager::getBlockedPorts() const {
+    return d->floodGuard.blockedPorts(HotplugFloodGuard::Clock::now());
+}
+
+void SecurityManager::setFloodThresholds(const FloodThresholds& thresholds) {
+    d->floodGuard.setThresholds(thresholds);
+}
+
+std::vector<DeviceArrivalRecord> SecurityManager::getArrivalHistory() const {
+    std::lock_guard<std::mutex> lock(d->stateMutex);
+    return {d->state.arrivals.begin(), d->state.arrivals.end()};
+}
+
+bool SecurityManager::setArrivalLog(const std::string& filename) {
+    std::lock_guard<std::mutex> logLock(d->arrivalLogMutex);
+    if (filename == d->arrivalLogPath && d->arrivalLog.is_open()) return true;
+    
+    if (d->arrivalLog.is_open()) {
+        d->flushArrivalLog();
+    }
+    d->pendingArrivals.clear();
+    d->arrivalLog.close();
+    d->arrivalLogPath.clear();
+    if (filename.empty()) return true;
+    
+    // Arrivals already in the file come back for dry runs; a file that
+    // does not exist yet is started
+    std::vector<DeviceArrivalRecord> history;
+    if (std::ifstream(filename)) {
+        auto earlier = readArrivalHistory(filename);
+        if (!earlier) {
+            LOG_WARNING("Cannot read arrival log " + filename);
+            return false;
+        }
+        history = std::move(*earlier);
+    }
+    
+    d->arrivalLog.open(filename, std::ios::app);
+    if (!d->arrivalLog) {
+        LOG_WARNING("Cannot open arrival log " + filename);
+        return false;
+    }
+    d->arrivalLogPath = filename;
+    
+    // Arrivals recorded before the log was set go into it too
+    std::lock_guard<std::mutex> lock(d->stateMutex);
+    for (const auto& arrival : d->state.arrivals) {
+        writeArrivalRecord(d->arrivalLog, arrival);
+    }
+    d->arrivalLog.flush();
+    
+    history.insert(history.end(), d->state.arrivals.begin(), d->state.arrivals.end());
+    size_t keep = std::min(history.size(), size_t(MAX_ARRIVAL_HISTORY));
+    d->state.arrivals.assign(history.end() - keep, history.end());
+    return true;
+}
+
+bool SecurityManager::saveArrivalHistory(const std::string& filename) const {
+    return writeArrivalHistory(filename, getArrivalHistory());
+}
+
+SimulationReport SecurityManager::simulateRules(const std::vector<SecurityRule>& candidate) const {
+    return simulateRules(candidate, getArrivalHistory());
+}
+
+SimulationReport SecurityManager::simulateRules(const std::vector<SecurityRule>& candidate,
+                                                const std::vector<DeviceArrivalRecord>& history) const {
+    PolicyIndex proposed(candidate);
+    return d->policySimulator().run(history, *d->currentIndex(), proposed);
+}
+
+SimulationReport SecurityManager::simulateImportedRules(const std::vector<UsbGuardRule>& candidate) const {
+    auto current = d->currentIndex();
+    PolicyIndex proposed(current->rules(), candidate);
+    return d->policySimulator().run(getArrivalHistory(), *current, proposed);
+}
+
 bool SecurityManager::loadSecurityConfig(const std::string& filename) {
     if (!d->loadJsonConfig(filename)) {
         return false;
@@ -449,17 +956,21 @@ void SecurityManager::logSecurityEvent(SecurityEvent event,
                                      const std::string& description) {
     if (!device) return;
     
-    SecurityEventInfo eventInfo;
-    eventInfo.event = event;
-    eventInfo.timestamp = std::chrono::system_clock::now();
-    
     auto id = device->identifier();
     std::stringstream ss;
     ss << std::hex << std::uppercase
        << std::setw(4) << std::setfill('0') << id.vendorId << ":"
        << std::setw(4) << std::setfill('0') << id.productId;
-    eventInfo.deviceId = ss.str();
-    
+    logSecurityEvent(event, ss.str(), description);
+}
+
+void SecurityManager::logSecurityEvent(SecurityEvent event,
+                                     const std::string& deviceId,
+                                     const std::string& description) {
+    SecurityEventInfo eventInfo;
+    eventInfo.event = event;
+    eventInfo.timestamp = std::chrono::system_clock::now();
+    eventInfo.deviceId = deviceId;
     eventInfo.description = description;
     eventInfo.securityLevel = getSecurityLevel();
     
@@ -474,10 +985,37 @@ void SecurityManager::logSecurityEvent(SecurityEvent event,
     emit securityEventOccurred(eventInfo);
 }
 
+// Logs within the guard's budget and raises a new block; events over the
+// budget are only counted, and the count goes out with the next one logged
+bool SecurityManager::handleFloodDecision(const std::string& portPath, const UsbDevice* device,
+                                          const FloodDecision& decision) {
+    std::string suppressed;
+    if (decision.suppressed) {
+        suppressed = " (" + std::to_string(decision.suppressed) + " earlier arrivals not logged)";
+    }
+    
+    if (decision.newlyBlocked) {
+        std::string reason = "Hotplug flood on port " + portPath + ": " +
+                             std::to_string(decision.arrivals) + " arrivals, " +
+                             std::to_string(decision.descriptorChanges) +
+                             " descriptor changes in the window";
+        logSecurityEvent(SecurityEvent::MaliciousActivityDetected, portPath, reason + suppressed);
+        emit portBlocked(portPath, reason);
+        if (device) {
+            emit deviceBlocked(device, reason);
+        }
+    } else if (decision.log) {
+        std::string what = decision.descriptorChanged ? "Device with new descriptors on port "
+                                                      : "Device arrived on port ";
+        logSecurityEvent(SecurityEvent::DeviceConnected, portPath, what + portPath + suppressed);
+    }
+    return !decision.blocked;
+}
+
 bool SecurityManager::validateDeviceProtocol(const UsbDevice* device) {
-    if (!device || !device->isOpen()) return false;
+    if (!device) return false;
     
-    // Get device configuration descriptor
+    // Get device configuration descriptor; arrivals are not opened
     libusb_config_descriptor* config;
     if (libusb_get_active_config_descriptor(device->nativeDevice(), &config) != 0) {
         return false;
@@ -568,10 +1106,10 @@ bool SecurityManager::validateDeviceProtocol(const UsbDevice* device) {
 void SecurityManager::checkDeviceCompliance(const UsbDevice* device) {
     if (!device) return;
     
-    auto rule = d->findMatchingRule(device);
+    auto decision = d->currentIndex()->evaluate(d->arrivalRecord(device));
     
     // Check interface compliance
-    if (!d->validateDeviceInterfaces(device, rule)) {
+    if (decision.verdict == PolicyVerdict::InterfaceNotAllowed) {
         logSecurityEvent(SecurityEvent::PolicyViolation, device,
                         "Non-compliant interface detected");
         emit deviceBlocked(device, "Device violates interface restrictions");
@@ -1,4 +1,6 @@
 #pragma once
+#include "SecurityRule.hpp"
+#include "PolicySimulator.hpp"
 #include <QObject>
 #include <memory>
 #include <string>
@@ -8,14 +10,11 @@
 namespace usb_monitor {
 
 class UsbDevice;
+class DeviceManager;
+class ProtocolAnalyzer;
 class DeviceAuthorizer;
-
-enum class SecurityLevel {
-    Low,
-    Medium,
-    High,
-    Custom
-};
+struct FloodThresholds;
+struct FloodDecision;
 
 enum class SecurityEvent {
     DeviceConnected,
@@ -28,16 +27,6 @@ enum class SecurityEvent {
     PolicyViolation
 };
 
-struct SecurityRule {
-    uint16_t vendorId;
-    uint16_t productId;
-    bool isWhitelisted;
-    bool requireAuthorization;
-    SecurityLevel securityLevel;
-    std::vector<std::string> allowedInterfaces;
-    std::chrono::system_clock::time_point expiryDate;
-};
-
 struct SecurityEventInfo {
     SecurityEvent event;
     std::chrono::system_clock::time_point timestamp;
@@ -64,6 +53,12 @@ public:
     std::vector<SecurityRule> getSecurityRules() const;
     void clearSecurityRules();
     
+    // USBGuard rules, matched after the native ones in file order. A file
+    // with any rule we cannot parse is rejected whole.
+    bool importUsbGuardRules(const std::string& filename);
+    std::vector<UsbGuardRule> getImportedRules() const;
+    void clearImportedRules();
+    
     // Security levels
     void setSecurityLevel(SecurityLevel level);
     SecurityLevel getSecurityLevel() const;
@@ -75,6 +70,54 @@ public:
         const std::chrono::system_clock::time_point& end) const;
     void clearSecurityEvents();
     
+    // Raised by the traffic analyzers, e.g. on suspected data exfiltration
+    void reportMaliciousActivity(const UsbDevice* device, const std::string& description);
+    
+    // Write limits for mass storage: the device's rule, else the default.
+    // Both are part of the security config.
+    ExfiltrationPolicy getExfiltrationPolicy(const UsbDevice* device) const;
+    ExfiltrationPolicy getDefaultExfiltrationPolicy() const;
+    void setDefaultExfiltrationPolicy(const ExfiltrationPolicy& policy);
+    
+    // Off by default: while attached with rules to enforce, turn off
+    // interface_authorized_default on every bus, so interfaces of new
+    // devices bind only once the rules allow them. System-wide, and put
+    // back when turned off, when the rules go, at exit and on fatal
+    // signals. Part of the security config.
+    void setDeauthorizeNewInterfaces(bool enabled);
+    bool getDeauthorizeNewInterfaces() const;
+    
+    // Follows the manager's devices: arrivals go through the flood guard
+    // before they are committed, and the analyzer, if given, watches the
+    // writes of every mass storage device under its policy and reports
+    // suspected exfiltration here. Both must outlive this.
+    void attach(DeviceManager* manager, ProtocolAnalyzer* analyzer = nullptr);
+    
+    // Hotplug flood guard, fed by attach(). Arrivals return false when the
+    // port is blocked; flaps are the arrivals the hotplug debouncer
+    // coalesced.
+    bool recordDeviceArrival(const UsbDevice* device);
+    void recordPortFlaps(const std::string& portPath, uint32_t flaps);
+    bool isPortBlocked(const std::string& portPath) const;
+    void unblockPort(const std::string& portPath);
+    std::vector<std::string> getBlockedPorts() const;
+    void setFloodThresholds(const FloodThresholds& thresholds);
+    
+    // Policy dry runs: candidate rules are evaluated against the recorded
+    // arrivals, or a loaded history, without touching the active rules.
+    // Arrivals over the flood guard's logging budget are not recorded.
+    // Memory keeps the latest MAX_ARRIVAL_HISTORY; the arrival log, set
+    // here or by the security config, appends them to disk every
+    // ARRIVAL_LOG_FLUSH_INTERVAL and loads what it already holds. An empty
+    // name stops logging.
+    bool setArrivalLog(const std::string& filename);
+    std::vector<DeviceArrivalRecord> getArrivalHistory() const;
+    bool saveArrivalHistory(const std::string& filename) const;
+    SimulationReport simulateRules(const std::vector<SecurityRule>& candidate) const;
+    SimulationReport simulateRules(const std::vector<SecurityRule>& candidate,
+                                   const std::vector<DeviceArrivalRecord>& history) const;
+    SimulationReport simulateImportedRules(const std::vector<UsbGuardRule>& candidate) const;
+    
     // Configuration
     bool loadSecurityConfig(const std::string& filename);
     bool saveSecurityConfig(const std::string& filename) const;
@@ -83,12 +126,22 @@ signals:
     void securityEventOccurred(const SecurityEventInfo& event);
     void securityLevelChanged(SecurityLevel level);
     void deviceBlocked(const UsbDevice* device, const std::string& reason);
+    void portBlocked(const std::string& portPath, const std::string& reason);
     void configurationChanged();
 
 private:
     void logSecurityEvent(SecurityEvent event, 
                          const UsbDevice* device,
                          const std::string& description);
+    void logSecurityEvent(SecurityEvent event,
+                         const std::string& deviceId,
+                         const std::string& description);
+    bool checkDevice(const UsbDevice* device, uint32_t& deniedInterfaces,
+                     bool& needsConfirmation);
+    bool admitDevice(const std::shared_ptr<UsbDevice>& device);
+    void deauthorizeInterfaces(UsbDevice* device, uint32_t interfaces);
+    bool handleFloodDecision(const std::string& portPath, const UsbDevice* device,
+                             const FloodDecision& decision);
     bool validateDeviceProtocol(const UsbDevice* device);
     void checkDeviceCompliance(const UsbDevice* device);
 
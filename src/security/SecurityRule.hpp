@@ -0,0 +1,31 @@
+#pragma once
+#include "../analysis/ExfiltrationDetector.hpp"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+enum class SecurityLevel {
+    Low,
+    Medium,
+    High,
+    Custom
+};
+
+struct SecurityRule {
+    uint16_t vendorId;
+    uint16_t productId;
+    bool isWhitelisted;
+    bool requireAuthorization;
+    SecurityLevel securityLevel;
+    std::vector<std::string> allowedInterfaces;     // "0x08" classes or "08:06:50" types, * allowed
+    std::chrono::system_clock::time_point expiryDate;
+    std::vector<std::string> blockedInterfaces;     // Denied even when allowed above
+    bool perInterface;          // Deauthorize denied interfaces rather than refuse the device
+    std::optional<ExfiltrationPolicy> exfiltration;   // Write limits on mass storage, if not the default
+};
+
+} // namespace usb_monitor
@@ -0,0 +1,388 @@
+#include "UsbGuardRules.hpp"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace usb_monitor {
+
+namespace {
+
+struct Token {
+    enum class Kind { Word, String, Open, Close };
+    Kind kind;
+    std::string text;
+};
+
+// Splits one rule into words, quoted strings and braces. A word runs to
+// the next space or brace, except that a condition's parameter list is
+// taken whole up to its closing parenthesis.
+bool tokenize(const std::string& line, std::vector<Token>& tokens, std::string& error) {
+    size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (c == '{' || c == '}') {
+            tokens.push_back({c == '{' ? Token::Kind::Open : Token::Kind::Close, std::string(1, c)});
+            i++;
+        } else if (c == '"') {
+            std::string text;
+            for (i++; i < line.size() && line[i] != '"'; i++) {
+                if (line[i] != '\\') {
+                    text += line[i];
+                    continue;
+                }
+                if (++i == line.size()) break;
+                switch (line[i]) {
+                    case 'n': text += '\n'; break;
+                    case 't': text += '\t'; break;
+                    case 'x':
+                        if (i + 2 < line.size() && std::isxdigit(static_cast<unsigned char>(line[i + 1])) &&
+                            std::isxdigit(static_cast<unsigned char>(line[i + 2]))) {
+                            text += char(std::stoi(line.substr(i + 1, 2), nullptr, 16));
+                            i += 2;
+                            break;
+                        }
+                        error = "bad \\x escape";
+                        return false;
+                    default: text += line[i]; break;
+                }
+            }
+            if (i >= line.size()) {
+                error = "unterminated string";
+                return false;
+            }
+            tokens.push_back({Token::Kind::String, text});
+            i++;
+        } else {
+            size_t start = i;
+            int depth = 0;
+            for (; i < line.size(); i++) {
+                char w = line[i];
+                if (w == '(') depth++;
+                if (w == ')' && depth > 0) depth--;
+                if (depth == 0 && (std::isspace(static_cast<unsigned char>(w)) || w == '{' || w == '}')) break;
+            }
+            if (depth > 0) {
+                error = "unbalanced parenthesis";
+                return false;
+            }
+            tokens.push_back({Token::Kind::Word, line.substr(start, i - start)});
+        }
+    }
+    return true;
+}
+
+std::optional<SetOperator> parseOperator(const std::string& word) {
+    if (word == "all-of") return SetOperator::AllOf;
+    if (word == "one-of") return SetOperator::OneOf;
+    if (word == "none-of") return SetOperator::NoneOf;
+    if (word == "equals") return SetOperator::Equals;
+    if (word == "equals-ordered") return SetOperator::EqualsOrdered;
+    if (word == "match-all") return SetOperator::MatchAll;
+    return std::nullopt;
+}
+
+// Exactly `digits` hex digits
+std::optional<uint32_t> parseHex(const std::string& text, size_t digits) {
+    if (text.size() != digits) return std::nullopt;
+    uint32_t value = 0;
+    for (char c : text) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return std::nullopt;
+        value = value * 16 + uint32_t(std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                                                                                   : std::tolower(c) - 'a' + 10);
+    }
+    return value;
+}
+
+std::optional<UsbGuardId> parseId(const Token& token) {
+    auto colon = token.text.find(':');
+    if (token.kind != Token::Kind::Word || colon == std::string::npos) return std::nullopt;
+
+    std::string vendor = token.text.substr(0, colon);
+    std::string product = token.text.substr(colon + 1);
+    UsbGuardId id;
+    if (vendor == "*") {
+        if (product != "*") return std::nullopt;
+        id.anyVendor = id.anyProduct = true;
+        return id;
+    }
+    auto vid = parseHex(vendor, 4);
+    if (!vid) return std::nullopt;
+    id.vendorId = uint16_t(*vid);
+    if (product == "*") {
+        id.anyProduct = true;
+        return id;
+    }
+    auto pid = parseHex(product, 4);
+    if (!pid) return std::nullopt;
+    id.productId = uint16_t(*pid);
+    return id;
+}
+
+std::optional<UsbGuardInterface> parseInterface(const Token& token) {
+    if (token.kind != Token::Kind::Word) return std::nullopt;
+    return parseInterfaceType(token.text);
+}
+
+std::optional<std::string> parseString(const Token& token) {
+    if (token.kind != Token::Kind::String && token.kind != Token::Kind::Word) return std::nullopt;
+    return token.text;
+}
+
+// HH:MM or HH:MM:SS, in seconds into the day
+std::optional<uint32_t> parseTimeOfDay(const std::string& text) {
+    if (text.size() != 5 && text.size() != 8) return std::nullopt;
+
+    const uint32_t limits[] = {24, 60, 60};
+    uint32_t seconds = 0;
+    for (size_t field = 0; field * 3 < text.size(); field++) {
+        size_t at = field * 3;
+        if (at > 0 && text[at - 1] != ':') return std::nullopt;
+        if (!std::isdigit(static_cast<unsigned char>(text[at])) ||
+            !std::isdigit(static_cast<unsigned char>(text[at + 1]))) {
+            return std::nullopt;
+        }
+        uint32_t value = uint32_t(text[at] - '0') * 10 + uint32_t(text[at + 1] - '0');
+        if (value >= limits[field]) return std::nullopt;
+        seconds = seconds * 60 + value;
+    }
+    return text.size() == 5 ? seconds * 60 : seconds;
+}
+
+std::optional<UsbGuardCondition> parseCondition(const Token& token, std::string& error) {
+    if (token.kind != Token::Kind::Word) {
+        error = "expected a condition";
+        return std::nullopt;
+    }
+
+    UsbGuardCondition condition;
+    std::string text = token.text;
+    if (!text.empty() && text[0] == '!') {
+        condition.negated = true;
+        text.erase(0, 1);
+    }
+
+    std::string name = text.substr(0, text.find('('));
+    std::string parameter;
+    if (name.size() < text.size()) {
+        if (text.back() != ')') {
+            error = "bad condition '" + text + "'";
+            return std::nullopt;
+        }
+        parameter = text.substr(name.size() + 1, text.size() - name.size() - 2);
+    }
+
+    if ((name == "true" || name == "false") && parameter.empty()) {
+        condition.kind = name == "true" ? UsbGuardCondition::Kind::True : UsbGuardCondition::Kind::False;
+        return condition;
+    }
+    if (name == "localtime") {
+        auto dash = parameter.find('-');
+        auto from = parseTimeOfDay(parameter.substr(0, dash));
+        auto until = dash == std::string::npos ? from : parseTimeOfDay(parameter.substr(dash + 1));
+        if (!from || !until) {
+            error = "bad time range '" + parameter + "'";
+            return std::nullopt;
+        }
+        condition.kind = UsbGuardCondition::Kind::LocalTime;
+        condition.from = *from;
+        condition.until = *until;
+        return condition;
+    }
+    error = "unsupported condition '" + name + "'";
+    return std::nullopt;
+}
+
+class RuleParser {
+public:
+    explicit RuleParser(const std::vector<Token>& tokens) : tokens(tokens) {}
+
+    std::optional<UsbGuardRule> parse(std::string& error) {
+        UsbGuardRule rule;
+        const std::string& target = tokens[0].text;
+        if (tokens[0].kind != Token::Kind::Word) {
+            error = "expected allow, block or reject";
+            return std::nullopt;
+        } else if (target == "allow") {
+            rule.target = RuleTarget::Allow;
+        } else if (target == "block") {
+            rule.target = RuleTarget::Block;
+        } else if (target == "reject") {
+            rule.target = RuleTarget::Reject;
+        } else {
+            error = "unknown target '" + target + "'";
+            return std::nullopt;
+        }
+        next = 1;
+
+        // The device id may follow the target without its keyword
+        if (next < tokens.size()) {
+            if (auto id = parseId(tokens[next])) {
+                rule.id = UsbGuardAttribute<UsbGuardId>{SetOperator::Equals, {*id}};
+                next++;
+            }
+        }
+
+        while (next < tokens.size()) {
+            const Token& keyword = tokens[next++];
+            const std::string& name = keyword.text;
+            bool ok = true;
+            if (keyword.kind != Token::Kind::Word) {
+                error = "expected an attribute name";
+                return std::nullopt;
+            } else if (name == "id") {
+                ok = attribute(rule.id, name, parseId, error);
+            } else if (name == "serial") {
+                ok = attribute(rule.serial, name, parseString, error);
+            } else if (name == "name") {
+                ok = attribute(rule.name, name, parseString, error);
+            } else if (name == "via-port") {
+                ok = attribute(rule.viaPort, name, parseString, error);
+            } else if (name == "with-connect-type") {
+                ok = attribute(rule.connectType, name, parseString, error);
+            } else if (name == "with-interface") {
+                ok = attribute(rule.interfaces, name, parseInterface, error);
+            } else if (name == "if") {
+                std::string conditionError;
+                ok = attribute(rule.conditions, name, [&](const Token& token) {
+                    return parseCondition(token, conditionError);
+                }, error, SetOperator::AllOf);
+                if (!ok && !conditionError.empty()) error = conditionError;
+            } else if (name == "label") {
+                if (next == tokens.size() || tokens[next].kind != Token::Kind::String) {
+                    error = "label needs a string";
+                    return std::nullopt;
+                }
+                rule.label = tokens[next++].text;
+            } else if (name == "hash" || name == "parent-hash") {
+                error = "unsupported attribute '" + name + "', generate the policy with --no-hashes";
+                return std::nullopt;
+            } else {
+                error = "unknown attribute '" + name + "'";
+                return std::nullopt;
+            }
+            if (!ok) return std::nullopt;
+        }
+        return rule;
+    }
+
+private:
+    // [operator] value | [operator] { value... }
+    template <typename T, typename Parse>
+    bool attribute(std::optional<UsbGuardAttribute<T>>& target, const std::string& name, Parse parse,
+                   std::string& error, SetOperator defaultOp = SetOperator::Equals) {
+        if (target) {
+            error = "duplicate " + name;
+            return false;
+        }
+
+        UsbGuardAttribute<T> result;
+        result.op = defaultOp;
+        if (next < tokens.size() && tokens[next].kind == Token::Kind::Word) {
+            if (auto op = parseOperator(tokens[next].text)) {
+                result.op = *op;
+                next++;
+            }
+        }
+        if (next == tokens.size()) {
+            error = name + " needs a value";
+            return false;
+        }
+
+        bool braced = tokens[next].kind == Token::Kind::Open;
+        if (braced) next++;
+        while (next < tokens.size()) {
+            if (braced && tokens[next].kind == Token::Kind::Close) {
+                next++;
+                break;
+            }
+            auto value = parse(tokens[next]);
+            if (!value) {
+                error = "bad " + name + " value '" + tokens[next].text + "'";
+                return false;
+            }
+            result.values.push_back(*value);
+            next++;
+            if (!braced) break;
+            if (next == tokens.size()) {
+                error = "unterminated " + name + " set";
+                return false;
+            }
+        }
+        if (result.values.empty()) {
+            error = "empty " + name + " set";
+            return false;
+        }
+        target = std::move(result);
+        return true;
+    }
+
+    const std::vector<Token>& tokens;
+    size_t next{0};
+};
+
+} // namespace
+
+std::optional<UsbGuardInterface> parseInterfaceType(const std::string& text) {
+    UsbGuardInterface result;
+    result.mask = 0;
+    std::istringstream fields(text);
+    std::string field;
+    int count = 0;
+    bool wildcard = false;
+    while (std::getline(fields, field, ':')) {
+        if (++count > 3) return std::nullopt;
+        result.type <<= 8;
+        result.mask <<= 8;
+        if (field == "*") {
+            wildcard = true;
+            continue;
+        }
+        auto value = parseHex(field, 2);
+        if (!value || wildcard) return std::nullopt;   // Only trailing fields may be *
+        result.type |= *value;
+        result.mask |= 0xFF;
+    }
+    if (count != 3) return std::nullopt;
+    return result;
+}
+
+UsbGuardRuleSet parseUsbGuardRules(const std::string& text) {
+    UsbGuardRuleSet result;
+    std::istringstream lines(text);
+    std::string line;
+    size_t number = 0;
+    std::vector<Token> tokens;
+    while (std::getline(lines, line)) {
+        number++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        tokens.clear();
+        std::string error;
+        if (!tokenize(line, tokens, error)) {
+            result.errors.push_back({number, error});
+            continue;
+        }
+        auto rule = RuleParser(tokens).parse(error);
+        if (!rule) {
+            result.errors.push_back({number, error});
+            continue;
+        }
+        rule->line = number;
+        result.rules.push_back(std::move(*rule));
+    }
+    return result;
+}
+
+std::optional<UsbGuardRuleSet> readUsbGuardRules(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return std::nullopt;
+
+    std::stringstream text;
+    text << file.rdbuf();
+    return parseUsbGuardRules(text.str());
+}
+
+} // namespace usb_monitor
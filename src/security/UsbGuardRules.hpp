@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace usb_monitor {
+
+// The USBGuard rule language, as in usbguard-rules.conf(5)
+enum class RuleTarget : uint8_t {
+    Allow,
+    Block,
+    Reject
+};
+
+enum class SetOperator : uint8_t {
+    AllOf,
+    OneOf,
+    NoneOf,
+    Equals,
+    EqualsOrdered,
+    MatchAll
+};
+
+// "1234:5678", "1234:*" or "*:*"
+struct UsbGuardId {
+    uint16_t vendorId{0};
+    uint16_t productId{0};
+    bool anyVendor{false};
+    bool anyProduct{false};
+};
+
+// "08:06:50", with trailing fields allowed to be "*"
+struct UsbGuardInterface {
+    uint32_t type{0};           // (class << 16) | (subclass << 8) | protocol
+    uint32_t mask{0xFFFFFF};    // Bits of type that must match
+};
+
+struct UsbGuardCondition {
+    enum class Kind : uint8_t { True, False, LocalTime };
+
+    Kind kind{Kind::True};
+    bool negated{false};
+    uint32_t from{0};           // LocalTime, seconds into the day
+    uint32_t until{0};          // Inclusive; before from wraps past midnight
+};
+
+template <typename T>
+struct UsbGuardAttribute {
+    SetOperator op{SetOperator::Equals};
+    std::vector<T> values;
+};
+
+struct UsbGuardRule {
+    RuleTarget target{RuleTarget::Block};
+    std::optional<UsbGuardAttribute<UsbGuardId>> id;
+    std::optional<UsbGuardAttribute<std::string>> serial;
+    std::optional<UsbGuardAttribute<std::string>> name;
+    std::optional<UsbGuardAttribute<std::string>> viaPort;
+    std::optional<UsbGuardAttribute<std::string>> connectType;
+    std::optional<UsbGuardAttribute<UsbGuardInterface>> interfaces;
+    std::optional<UsbGuardAttribute<UsbGuardCondition>> conditions;
+    std::string label;
+    size_t line{0};
+};
+
+struct UsbGuardParseError {
+    size_t line;
+    std::string message;
+};
+
+struct UsbGuardRuleSet {
+    std::vector<UsbGuardRule> rules;        // In file order, which is match order
+    std::vector<UsbGuardParseError> errors;
+};
+
+// "08:06:50" style interface type, with trailing fields allowed to be "*"
+std::optional<UsbGuardInterface> parseInterfaceType(const std::string& text);
+
+// Rules that use hash, parent-hash, or conditions other than true, false
+// and localtime() are reported as errors rather than guessed at. USBGuard's
+// hashes are over its own view of the device, which we do not reproduce;
+// generate-policy --no-hashes leaves them out.
+UsbGuardRuleSet parseUsbGuardRules(const std::string& text);
+std::optional<UsbGuardRuleSet> readUsbGuardRules(const std::string& path);
+
+} // namespace usb_monitor
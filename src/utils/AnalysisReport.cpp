@@ -0,0 +1,208 @@
+// src/utils/AnalysisReport.cpp
+#include "AnalysisReport.hpp"
+#include "../analysis/ProtocolAnalyzer.hpp"
+#include "../core/UsbDevice.hpp"
+#include "../capture/CaptureStore.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace usb_monitor {
+
+namespace {
+
+void writeHidPolling(std::ostream& out, const std::vector<HidEndpointStats>& endpoints) {
+    for (const auto& ep : endpoints) {
+        out << "  HID endpoint 0x" << std::hex << std::setw(2) << std::setfill('0')
+            << int(ep.endpoint) << std::dec << std::setfill(' ') << ": "
+            << ep.reports << " reports\n";
+        if (ep.declaredPeriod) {
+            out << "    declared   " << std::setprecision(1) << std::fixed << ep.declaredRate
+                << " Hz (" << ep.declaredPeriod << " us)\n";
+        }
+        out << "    measured   " << ep.measuredRate << " Hz, interval p50 "
+            << ep.p50Interval << " us, p99 " << ep.p99Interval << " us\n"
+            << "    jitter     mean " << ep.jitterMean << " us, stddev " << ep.jitterStdDev
+            << " us, p99 " << ep.jitterP99 << " us\n"
+            << "    dropped    ~" << ep.droppedReports << " ("
+            << std::setprecision(2) << ep.dropRatio * 100.0 << "%)\n";
+    }
+}
+
+void writeVideoStreams(std::ostream& out, const std::vector<VideoStreamStats>& streams) {
+    for (const auto& stream : streams) {
+        out << "  Video endpoint 0x" << std::hex << std::setw(2) << std::setfill('0')
+            << int(stream.endpoint) << std::dec << std::setfill(' ') << ": "
+            << stream.frames << " frames\n"
+            << "    rate       " << std::setprecision(1) << std::fixed << stream.frameRate
+            << " fps (nominal " << stream.nominalFrameRate << " fps), "
+            << stream.throughput / (1024 * 1024) << " MB/s\n"
+            << "    frame size min " << stream.minFrameSize << ", p50 " << stream.p50FrameSize
+            << ", max " << stream.maxFrameSize << " bytes\n"
+            << "    lost       " << stream.droppedFrames << " dropped, "
+            << stream.truncatedFrames << " truncated\n";
+        if (stream.isoPackets) {
+            out << "    iso errors " << stream.isoPacketErrors << " of " << stream.isoPackets
+                << " packets (" << std::setprecision(3) << stream.isoErrorRate * 100.0 << "%)\n";
+        }
+        if (stream.invalidHeaders) {
+            out << "    invalid payload headers " << stream.invalidHeaders << "\n";
+        }
+    }
+}
+
+void writeAudioStreams(std::ostream& out, const std::vector<AudioStreamStats>& streams) {
+    for (const auto& stream : streams) {
+        out << "  Audio endpoint 0x" << std::hex << std::setw(2) << std::setfill('0')
+            << int(stream.endpoint) << std::dec << std::setfill(' ') << ": "
+            << stream.packets << " packets, " << stream.samples << " samples\n";
+        if (stream.nominalRate) {
+            out << "    rate       " << stream.nominalRate << " Hz nominal, "
+                << std::setprecision(1) << std::fixed << stream.measuredRate << " Hz measured ("
+                << std::showpos << stream.measuredDriftPpm << std::noshowpos << " ppm)\n";
+        }
+        if (stream.hasFeedback) {
+            out << "    feedback   " << stream.feedbackRate << " Hz ("
+                << std::showpos << stream.feedbackDriftPpm << " ppm, range "
+                << stream.feedbackMinPpm << " to " << stream.feedbackMaxPpm
+                << std::noshowpos << " ppm)\n";
+        }
+        out << "    samples/packet min " << stream.minSamplesPerPacket << ", max "
+            << stream.maxSamplesPerPacket << "\n"
+            << "    continuity " << stream.underruns << " underruns (" << stream.emptyPackets
+            << " empty), " << stream.overruns << " overruns, " << stream.packetErrors
+            << " packet errors, " << stream.discontinuities << " gaps\n";
+    }
+}
+
+void writeSerial(std::ostream& out, const CdcAcmStats& serial) {
+    static const char* const parity[] = {"N", "O", "E", "M", "S"};
+    static const char* const stopBits[] = {"1", "1.5", "2"};
+    
+    out << "  CDC-ACM serial, " << int(serial.ports) << " port(s)\n";
+    if (serial.lineCoding.known) {
+        out << "    line       " << serial.lineCoding.baudRate << " "
+            << int(serial.lineCoding.dataBits)
+            << (serial.lineCoding.parity < 5 ? parity[serial.lineCoding.parity] : "?")
+            << (serial.lineCoding.stopBits < 3 ? stopBits[serial.lineCoding.stopBits] : "?")
+            << ", " << serial.lineCodingChanges << " changes, DTR "
+            << (serial.dtr ? "on" : "off") << ", RTS " << (serial.rts ? "on" : "off") << "\n";
+    }
+    out << std::setprecision(1) << std::fixed
+        << "    in         " << serial.in.bytes << " bytes, " << serial.in.rate << " B/s ("
+        << serial.in.utilization * 100.0 << "% of line)\n"
+        << "    out        " << serial.out.bytes << " bytes, " << serial.out.rate << " B/s ("
+        << serial.out.utilization * 100.0 << "% of line)\n";
+    if (serial.requests) {
+        out << "    requests   " << serial.requests << ", " << serial.unanswered
+            << " unanswered, first byte p50 " << serial.p50Response << " us, p99 "
+            << serial.p99Response << " us, line p50 " << serial.p50LineResponse << " us\n";
+    }
+    if (serial.framingErrors || serial.parityErrors || serial.overruns || serial.breaks) {
+        out << "    errors     " << serial.framingErrors << " framing, " << serial.parityErrors
+            << " parity, " << serial.overruns << " overrun, " << serial.breaks << " breaks\n";
+    }
+}
+
+void writePeriods(std::ostream& out, const std::vector<EndpointPeriod>& periods) {
+    for (const auto& period : periods) {
+        out << "  Periodic endpoint 0x" << std::hex << std::setw(2) << std::setfill('0')
+            << int(period.endpoint) << std::dec << std::setfill(' ') << ": every "
+            << std::setprecision(1) << std::fixed << period.period << " us";
+        if (period.bursty) {
+            out << ", bursts of " << period.eventsPerBurst;
+        }
+        out << " (strength " << std::setprecision(2) << period.strength << ")";
+        
+        // Polls that return nothing spend bus time for no data
+        if (period.emptyFraction > 0.5) {
+            out << ", " << std::setprecision(0) << period.emptyFraction * 100.0 << "% empty";
+        }
+        out << "\n";
+    }
+}
+
+void writeExfiltration(std::ostream& out, const ExfiltrationStats& writes) {
+    out << "  Mass storage writes " << writes.bytesWritten / (1024 * 1024) << " MiB in "
+        << writes.writes << " transfers, " << std::setprecision(1) << std::fixed
+        << writes.writeRate / (1024 * 1024) << " MiB/s now\n";
+    if (writes.sampledWrites) {
+        out << "    entropy    " << std::setprecision(2) << writes.entropy << " bits/byte over "
+            << writes.sampledWrites << " sampled writes\n";
+    }
+    if (writes.bursts) {
+        out << "    bursts     " << writes.bursts << ", " << writes.alerts << " flagged\n";
+    }
+}
+
+// The last few captured payloads, first bytes in hex
+void writePayloads(std::ostream& out, const ProtocolAnalyzer& analyzer, const UsbDevice& device) {
+    constexpr size_t SHOWN = 8;
+    constexpr size_t HEX_BYTES = 16;
+    
+    auto transfers = analyzer.getRecentTransfers(&device, SHOWN * 4);
+    std::vector<std::pair<TransferInfo, std::vector<uint8_t>>> shown;
+    for (auto it = transfers.rbegin(); it != transfers.rend() && shown.size() < SHOWN; ++it) {
+        if (it->payload == CaptureStore::NO_PAYLOAD) continue;
+        if (auto bytes = analyzer.getPayload(it->payload)) shown.emplace_back(*it, std::move(*bytes));
+    }
+    if (shown.empty()) return;
+    
+    auto store = analyzer.payloadStore().stats();
+    out << "  Payloads (store " << store.storedBytes / 1024 << " KiB, "
+        << std::setprecision(1) << std::fixed << store.ratio << "x compressed)\n";
+    for (auto it = shown.rbegin(); it != shown.rend(); ++it) {
+        const auto& [info, bytes] = *it;
+        out << "    0x" << std::hex << std::setw(2) << std::setfill('0') << int(info.endpointAddress)
+            << (info.isInput ? " in " : " out") << std::dec << std::setfill(' ')
+            << std::setw(7) << info.dataSize << " ";
+        for (size_t i = 0; i < std::min(bytes.size(), HEX_BYTES); i++) {
+            out << " " << std::hex << std::setw(2) << std::setfill('0') << int(bytes[i])
+                << std::dec << std::setfill(' ');
+        }
+        out << (bytes.size() > HEX_BYTES ? " ...\n" : "\n");
+    }
+}
+
+} // namespace
+
+std::string formatDeviceAnalysis(const ProtocolAnalyzer& analyzer, const UsbDevice& device) {
+    std::ostringstream out;
+    
+    auto hid = analyzer.getHidPollingStats(&device);
+    if (!hid.empty()) {
+        writeHidPolling(out, hid);
+    }
+    
+    auto video = analyzer.getVideoStreamStats(&device);
+    if (!video.empty()) {
+        writeVideoStreams(out, video);
+    }
+    
+    auto audio = analyzer.getAudioStreamStats(&device);
+    if (!audio.empty()) {
+        writeAudioStreams(out, audio);
+    }
+    
+    if (analyzer.isSerialDevice(&device)) {
+        writeSerial(out, analyzer.getSerialStats(&device));
+    }
+    
+    auto writes = analyzer.getExfiltrationStats(&device);
+    if (writes.writes) {
+        writeExfiltration(out, writes);
+    }
+    
+    auto periods = analyzer.getEndpointPeriods(&device);
+    if (!periods.empty()) {
+        writePeriods(out, periods);
+    }
+    
+    writePayloads(out, analyzer, device);
+    
+    std::string body = out.str();
+    if (body.empty()) return body;
+    return device.description() + "\n" + body;
+}
+
+} // namespace usb_monitor
@@ -0,0 +1,14 @@
+// src/utils/AnalysisReport.hpp
+#pragma once
+#include <string>
+
+namespace usb_monitor {
+
+class ProtocolAnalyzer;
+class UsbDevice;
+
+// Plain-text capture analysis for one device, shared by the analysis dock
+// and headless mode. Empty when nothing has been captured for it.
+std::string formatDeviceAnalysis(const ProtocolAnalyzer& analyzer, const UsbDevice& device);
+
+} // namespace usb_monitor
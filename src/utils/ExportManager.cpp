@@ -50,6 +50,33 @@ public:
         json["readSpeed"] = stats.readSpeed;
         json["writeSpeed"] = stats.writeSpeed;
         json["speedClass"] = stats.speedClass;
+        
+        QJsonArray endpoints;
+        for (const auto& endpoint : stats.endpoints) {
+            QJsonObject entry;
+            entry["address"] = QString::number(endpoint.address, 16);
+            entry["interface"] = endpoint.interfaceNumber;
+            entry["transferType"] = endpoint.transferType;
+            entry["bytes"] = qint64(endpoint.bytes);
+            entry["packets"] = qint64(endpoint.packets);
+            entry["rate"] = endpoint.rate;
+            entry["packetRate"] = endpoint.packetRate;
+            entry["peakRate"] = endpoint.peakRate;
+            endpoints.append(entry);
+        }
+        json["endpoints"] = endpoints;
+        
+        QJsonArray interfaces;
+        for (const auto& interface : stats.interfaces) {
+            QJsonObject entry;
+            entry["interface"] = interface.interfaceNumber;
+            entry["class"] = interface.interfaceClass;
+            entry["bytes"] = qint64(interface.bytes);
+            entry["rate"] = interface.rate;
+            entry["peakRate"] = interface.peakRate;
+            interfaces.append(entry);
+        }
+        json["interfaces"] = interfaces;
     }
     
     void generateHTML(std::stringstream& html,
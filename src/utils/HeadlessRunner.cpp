@@ -0,0 +1,104 @@
+// src/utils/HeadlessRunner.cpp
+#include "HeadlessRunner.hpp"
+#include "AnalysisReport.hpp"
+#include "../core/DeviceManager.hpp"
+#include "../core/UsbDevice.hpp"
+#include "../core/Logger.hpp"
+#include "../analysis/ProtocolAnalyzer.hpp"
+#include "../security/SecurityManager.hpp"
+#include "../capture/UsbmonReader.hpp"
+#include <QTimer>
+#include <iostream>
+
+namespace usb_monitor {
+
+class HeadlessRunner::Private {
+public:
+    std::chrono::seconds duration;
+    std::unique_ptr<DeviceManager> deviceManager;
+    std::unique_ptr<SecurityManager> securityManager;
+    std::unique_ptr<ProtocolAnalyzer> protocolAnalyzer;
+    std::unique_ptr<UsbmonReader> usbmonReader;
+};
+
+HeadlessRunner::HeadlessRunner(std::chrono::seconds duration, QObject* parent)
+    : QObject(parent)
+    , d(std::make_unique<Private>()) {
+    d->duration = duration;
+    d->deviceManager = std::make_unique<DeviceManager>();
+    d->securityManager = std::make_unique<SecurityManager>();
+    d->protocolAnalyzer = std::make_unique<ProtocolAnalyzer>();
+    d->usbmonReader = std::make_unique<UsbmonReader>();
+}
+
+HeadlessRunner::~HeadlessRunner() {
+    d->usbmonReader->stop();
+}
+
+SecurityManager* HeadlessRunner::securityManager() const {
+    return d->securityManager.get();
+}
+
+bool HeadlessRunner::start() {
+    connect(d->usbmonReader.get(), &UsbmonReader::errorOccurred,
+            this, [](const std::string& error) {
+        std::cerr << error << std::endl;
+    });
+    
+    d->protocolAnalyzer->setCaptureSource(d->usbmonReader.get());
+    d->protocolAnalyzer->setBandwidthMonitor(d->deviceManager->bandwidthMonitor());
+    if (!d->usbmonReader->start()) {
+        std::cerr << "USB capture unavailable: load the usbmon module and run with "
+                     "read access to /dev/usbmon0" << std::endl;
+        return false;
+    }
+    
+    // Without a window, security events go to the log
+    connect(d->securityManager.get(), &SecurityManager::securityEventOccurred,
+            this, [](const SecurityEventInfo& event) {
+        if (event.event == SecurityEvent::DeviceConnected ||
+            event.event == SecurityEvent::DeviceDisconnected) {
+            LOG_INFO(event.deviceId + ": " + event.description);
+        } else {
+            LOG_WARNING(event.deviceId + ": " + event.description);
+        }
+    });
+    d->securityManager->attach(d->deviceManager.get(), d->protocolAnalyzer.get());
+    
+    for (const auto& device : d->deviceManager->deviceSnapshot()->devices) {
+        d->protocolAnalyzer->startMonitoring(device);
+    }
+    connect(d->deviceManager.get(), &DeviceManager::devicesAdded,
+            this, [this](const std::vector<std::shared_ptr<UsbDevice>>& devices) {
+        for (const auto& device : devices) {
+            d->protocolAnalyzer->startMonitoring(device);
+        }
+    });
+    
+    LOG_INFO("Capturing for " + std::to_string(d->duration.count()) + " s");
+    QTimer::singleShot(std::chrono::milliseconds(d->duration).count(), this, [this]() {
+        report();
+        emit finished(0);
+    });
+    return true;
+}
+
+void HeadlessRunner::report() {
+    d->usbmonReader->stop();
+    
+    std::cout << "Captured " << d->usbmonReader->eventsRead() << " USB events in "
+              << d->duration.count() << " s";
+    if (uint64_t dropped = d->usbmonReader->eventsDropped()) {
+        std::cout << ", " << dropped << " dropped by the kernel";
+    }
+    std::cout << "\n";
+    for (const auto& device : d->deviceManager->deviceSnapshot()->devices) {
+        std::string analysis = formatDeviceAnalysis(*d->protocolAnalyzer, *device);
+        if (!analysis.empty()) {
+            std::cout << "\n" << analysis;
+        }
+    }
+    std::cout << std::flush;
+}
+
+} // namespace usb_monitor
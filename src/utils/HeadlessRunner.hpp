@@ -0,0 +1,34 @@
+// src/utils/HeadlessRunner.hpp
+#pragma once
+#include <QObject>
+#include <chrono>
+#include <memory>
+
+namespace usb_monitor {
+
+class SecurityManager;
+
+// Captures with usbmon for a fixed time without a window, then prints the
+// per-device analysis to stdout and quits the application
+class HeadlessRunner : public QObject {
+    Q_OBJECT
+
+public:
+    explicit HeadlessRunner(std::chrono::seconds duration, QObject* parent = nullptr);
+    ~HeadlessRunner();
+
+    // Rules and policies are loaded into it before start()
+    SecurityManager* securityManager() const;
+    bool start();
+
+signals:
+    void finished(int exitCode);
+
+private:
+    void report();
+
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace usb_monitor
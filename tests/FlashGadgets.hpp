@@ -0,0 +1,205 @@
+// tests/FlashGadgets.hpp
+//
+// Flashing stand-ins shared by the protocol and engine tests: gadgets that
+// answer like DFU and vendor bulk devices, driven by a virtual clock.
+#pragma once
+#include <gtest/gtest.h>
+#include "../src/flashing/FlashProtocols.hpp"
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+namespace usb_monitor {
+namespace testing {
+
+// Single-threaded event loop on a virtual clock, standing in for the libusb
+// event thread. Every device advances independently, as on separate ports.
+class VirtualLoop {
+public:
+    void post(double delay, std::coroutine_handle<> handle) {
+        queue.push(Event{now + delay, sequence++, handle});
+    }
+    
+    void run() {
+        while (!queue.empty()) {
+            auto event = queue.top();
+            queue.pop();
+            now = event.time;
+            event.handle.resume();
+        }
+    }
+    
+    // Reserves the shared bus for a transfer and returns how long after
+    // now it completes
+    double occupyBus(double busTime) {
+        busFreeAt = std::max(busFreeAt, now) + busTime;
+        return busFreeAt - now;
+    }
+    
+    double now{0.0};  // ms
+    double busFreeAt{0.0};
+    
+private:
+    struct Event {
+        double time;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+        
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+    
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue;
+    uint64_t sequence{0};
+};
+
+struct Completion {
+    VirtualLoop* loop;
+    double cost;
+    TransferResult result;
+    
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { loop->post(cost, handle); }
+    TransferResult await_resume() { return std::move(result); }
+};
+
+struct Sleep {
+    VirtualLoop* loop;
+    double cost;
+    
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { loop->post(cost, handle); }
+    void await_resume() const noexcept {}
+};
+
+// Full-speed DFU 1.1 device. Control data shares the bus at roughly
+// 1 MB/s, plus a frame of turnaround; each block takes writeTime ms to program.
+class DfuGadget {
+public:
+    explicit DfuGadget(VirtualLoop& loop) : loop(loop) {}
+    
+    Completion control(uint8_t requestType, uint8_t request, uint16_t value, uint16_t,
+                       const uint8_t* data, uint16_t length, unsigned int) {
+        Completion completion{&loop, 1.0 + loop.occupyBus(0.01 + length / 1000.0), {}};
+        completion.result.status = LIBUSB_TRANSFER_COMPLETED;
+        
+        switch (static_cast<DfuRequest>(request)) {
+        case DfuRequest::Download:
+            if (length == 0) {
+                state = DfuState::ManifestSync;
+            } else if (failuresLeft > 0 && value == failBlock) {
+                failuresLeft--;
+                state = DfuState::Error;
+            } else {
+                if (value == 0) flashed.clear();
+                flashed.insert(flashed.end(), data, data + length);
+                state = DfuState::DownloadSync;
+            }
+            break;
+        case DfuRequest::GetStatus: {
+            EXPECT_EQ(requestType, DFU_REQUEST_IN);
+            uint32_t poll = 0;
+            if (state == DfuState::DownloadSync) {
+                state = DfuState::DownloadBusy;
+                poll = writeTime;
+            } else if (state == DfuState::DownloadBusy) {
+                state = DfuState::DownloadIdle;
+            } else if (state == DfuState::ManifestSync) {
+                state = DfuState::Manifest;
+                poll = 20;
+            } else if (state == DfuState::Manifest) {
+                state = DfuState::Idle;
+                manifested = true;
+            }
+            uint8_t status = state == DfuState::Error ? 0x03 : 0x00;  // errWRITE
+            completion.result.data = {status, static_cast<uint8_t>(poll),
+                                      static_cast<uint8_t>(poll >> 8), 0,
+                                      static_cast<uint8_t>(state), 0};
+            break;
+        }
+        case DfuRequest::ClearStatus:
+        case DfuRequest::Abort:
+            state = DfuState::Idle;
+            break;
+        default:
+            completion.result.status = LIBUSB_TRANSFER_STALL;
+        }
+        return completion;
+    }
+    
+    Completion writePipelined(uint8_t, const uint8_t*, size_t, size_t, size_t, unsigned int,
+                              std::function<void(size_t)>) {
+        return Completion{&loop, 0.0, {}};  // Not a bulk device
+    }
+    
+    Sleep delay(uint32_t milliseconds) { return Sleep{&loop, double(milliseconds)}; }
+    
+    VirtualLoop& loop;
+    DfuState state{DfuState::Idle};
+    std::vector<uint8_t> flashed;
+    bool manifested{false};
+    uint32_t writeTime{4};
+    uint16_t failBlock{0};
+    int failuresLeft{0};
+};
+
+// High-speed vendor bootloader. Each bulk block pays a fixed turnaround
+// that keeping several blocks in flight hides.
+class VendorGadget {
+public:
+    explicit VendorGadget(VirtualLoop& loop) : loop(loop) {}
+    
+    Completion control(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+                       const uint8_t*, uint16_t, unsigned int) {
+        Completion completion{&loop, 0.125, {}};
+        completion.result.status = LIBUSB_TRANSFER_COMPLETED;
+        if (requestType == VENDOR_REQUEST_OUT && request == 0x01) {
+            expected = value | (size_t(index) << 16);
+            flashed.clear();
+        } else if (requestType == VENDOR_REQUEST_IN && request == 0x02) {
+            completion.result.data = {static_cast<uint8_t>(flashed.size() == expected ? 0 : 1)};
+        }
+        return completion;
+    }
+    
+    Completion writePipelined(uint8_t, const uint8_t* data, size_t length, size_t blockSize,
+                              size_t depth, unsigned int, std::function<void(size_t)> onBytes) {
+        const double turnaround = 0.5;          // ms per block
+        const double bytesPerMs = 40000.0;      // ~40 MB/s
+        size_t blocks = (length + blockSize - 1) / blockSize;
+        
+        flashed.assign(data, data + length);
+        for (size_t written = blockSize; written < length; written += blockSize) {
+            onBytes(written);
+        }
+        onBytes(length);
+        
+        Completion completion{&loop, blocks * turnaround / depth + length / bytesPerMs, {}};
+        completion.result.status = LIBUSB_TRANSFER_COMPLETED;
+        return completion;
+    }
+    
+    Sleep delay(uint32_t milliseconds) { return Sleep{&loop, double(milliseconds)}; }
+    
+    VirtualLoop& loop;
+    size_t expected{0};
+    std::vector<uint8_t> flashed;
+};
+
+inline std::vector<uint8_t> makeImage(size_t size) {
+    std::vector<uint8_t> image(size);
+    for (size_t i = 0; i < size; ++i) {
+        image[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    return image;
+}
+
+template <typename Link>
+Task<void> flashOne(Link& link, const std::vector<uint8_t>& image, const FlashOptions& options,
+                    FlashOutcome& outcome, int& attempts, FlashProgress progress = {}) {
+    outcome = co_await flashImage(link, image, options, std::move(progress), attempts);
+}
+
+} // namespace testing
+} // namespace usb_monitor
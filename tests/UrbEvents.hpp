@@ -0,0 +1,29 @@
+// tests/UrbEvents.hpp
+//
+// usbmon events for the capture analyzer tests: a common capture epoch and
+// the fields every event needs. Tests add data, setup bytes or iso packets.
+#pragma once
+#include "../src/capture/UrbEvent.hpp"
+#include <libusb-1.0/libusb.h>
+#include <cstdint>
+
+namespace usb_monitor {
+namespace testing {
+
+constexpr int64_t T0 = 1700000000LL * 1000000;  // us since the epoch
+
+inline UrbEvent urbEvent(char type, uint8_t transferType, uint16_t busNumber, uint8_t deviceAddress,
+                         uint8_t endpoint, int64_t timestamp, uint32_t length = 0) {
+    UrbEvent event;
+    event.type = type;
+    event.transferType = transferType;
+    event.endpoint = endpoint;
+    event.busNumber = busNumber;
+    event.deviceAddress = deviceAddress;
+    event.timestamp = timestamp;
+    event.length = length;
+    return event;
+}
+
+} // namespace testing
+} // namespace usb_monitor
@@ -0,0 +1,145 @@
+// tests/test_AnomalyDetector.cpp
+#include <gtest/gtest.h>
+#include "../src/analysis/AnomalyDetector.hpp"
+#include <usb-monitor/Constants.hpp>
+#include <vector>
+
+using namespace usb_monitor;
+using namespace std::chrono;
+
+namespace {
+
+const system_clock::time_point T0{seconds(1700000000)};
+const seconds ERRORS{ANOMALY_ERROR_INTERVAL};
+const seconds HOTPLUG{ANOMALY_HOTPLUG_INTERVAL};
+
+DetectorConfig quickConfig(double minDeviation) {
+    DetectorConfig config;
+    config.minDeviation = minDeviation;
+    config.warmup = 5;
+    return config;
+}
+
+} // namespace
+
+class AnomalyDetectorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        detector.setConfig(AnomalyMetric::ErrorRate, quickConfig(0.05));
+        detector.setConfig(AnomalyMetric::HotplugFrequency, quickConfig(1.0));
+        QObject::connect(&detector, &AnomalyDetector::anomalyDetected,
+                         [this](const AnomalyEvent& event) { events.push_back(event); });
+    }
+
+    // One error per interval from T0, so the last interval is still open
+    void steadyErrors(int intervals) {
+        for (int i = 0; i < intervals; i++) {
+            detector.recordTransferError("dev", T0 + i * ERRORS);
+        }
+    }
+
+    AnomalyDetector detector;
+    std::vector<AnomalyEvent> events;
+};
+
+TEST_F(AnomalyDetectorTest, ClosesErrorIntervalWhenTheNextOneStarts) {
+    steadyErrors(20);
+    EXPECT_TRUE(events.empty());
+
+    // A burst in the open interval is only judged once it has ended
+    auto burst = T0 + 19 * ERRORS;
+    for (int i = 0; i < 30; i++) {
+        detector.recordTransferError("dev", burst + seconds(5));
+    }
+    EXPECT_TRUE(events.empty());
+
+    detector.recordTransferError("dev", burst + ERRORS);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].source, "dev");
+    EXPECT_EQ(events[0].metric, AnomalyMetric::ErrorRate);
+    EXPECT_EQ(events[0].kind, AnomalyKind::Spike);
+    EXPECT_DOUBLE_EQ(events[0].value, 31.0 / ANOMALY_ERROR_INTERVAL);
+    EXPECT_NEAR(events[0].expected, 1.0 / ANOMALY_ERROR_INTERVAL, 1e-9);
+    EXPECT_EQ(events[0].timestamp, burst + ERRORS);
+}
+
+TEST_F(AnomalyDetectorTest, JumpsForwardOverLongSilence) {
+    steadyErrors(20);
+
+    // Only the first 64 empty intervals are replayed; they are enough to
+    // see the errors stop
+    auto open = T0 + 19 * ERRORS;
+    auto back = open + 10000 * ERRORS + seconds(5);
+    detector.recordTransferError("dev", back);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].kind, AnomalyKind::LevelShiftDown);
+    EXPECT_LE(events[0].timestamp, open + 64 * ERRORS);
+
+    // The grid stays aligned, so the interval holding 'back' closes on time
+    for (int i = 0; i < 30; i++) {
+        detector.recordTransferError("dev", back + seconds(1));
+    }
+    detector.recordTransferError("dev", back + seconds(5));
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[1].kind, AnomalyKind::Spike);
+    EXPECT_EQ(events[1].timestamp, open + 10001 * ERRORS);
+}
+
+TEST_F(AnomalyDetectorTest, FlushLearnsQuietIntervals) {
+    for (int i = 0; i < 20; i++) {
+        detector.recordHotplug("1-2", T0 + i * HOTPLUG);
+        detector.recordHotplug("1-2", T0 + i * HOTPLUG + HOTPLUG / 2);
+    }
+
+    // Nothing has ended yet
+    detector.flush(T0 + 20 * HOTPLUG - seconds(1));
+    EXPECT_TRUE(events.empty());
+
+    // The port goes quiet; flushing alone notices, on the seventh empty minute
+    detector.flush(T0 + 40 * HOTPLUG);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].source, "1-2");
+    EXPECT_EQ(events[0].metric, AnomalyMetric::HotplugFrequency);
+    EXPECT_EQ(events[0].kind, AnomalyKind::LevelShiftDown);
+    EXPECT_DOUBLE_EQ(events[0].value, 0.0);
+    EXPECT_EQ(events[0].timestamp, T0 + 27 * HOTPLUG);
+
+    // Intervals flushed once are not fed again
+    detector.flush(T0 + 40 * HOTPLUG);
+    EXPECT_EQ(events.size(), 1u);
+}
+
+TEST_F(AnomalyDetectorTest, SetConfigResetsThatMetricsDetectors) {
+    steadyErrors(20);
+    detector.recordThroughput("dev", 1000.0, T0);
+    EXPECT_EQ(detector.trackedSources(), 2u);
+
+    auto config = quickConfig(0.05);
+    config.warmup = 50;
+    detector.setConfig(AnomalyMetric::ErrorRate, config);
+    EXPECT_EQ(detector.config(AnomalyMetric::ErrorRate).warmup, 50u);
+    EXPECT_EQ(detector.trackedSources(), 1u);
+
+    // A fresh detector is still warming up, so the same burst passes
+    auto burst = T0 + 20 * ERRORS;
+    for (int i = 0; i < 30; i++) {
+        detector.recordTransferError("dev", burst);
+    }
+    detector.recordTransferError("dev", burst + ERRORS);
+    EXPECT_TRUE(events.empty());
+
+    detector.setConfig(AnomalyMetric::HotplugFrequency, quickConfig(1.0));
+    EXPECT_EQ(detector.trackedSources(), 2u);
+}
+
+TEST_F(AnomalyDetectorTest, RemoveDeviceKeepsPortHistory) {
+    detector.recordThroughput("dev", 1000.0, T0);
+    detector.recordTransferError("dev", T0);
+    detector.recordHotplug("1-2", T0);
+    EXPECT_EQ(detector.trackedSources(), 3u);
+
+    detector.removeDevice("dev");
+    EXPECT_EQ(detector.trackedSources(), 1u);
+    detector.removeDevice("unknown");
+    EXPECT_EQ(detector.trackedSources(), 1u);
+}
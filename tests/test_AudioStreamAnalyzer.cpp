@@ -0,0 +1,150 @@
+// tests/test_AudioStreamAnalyzer.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/AudioStreamAnalyzer.hpp"
+#include <vector>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+// One captured iso completion and the buffers it points into
+struct Capture {
+    std::vector<uint8_t> data;
+    std::vector<IsoPacketDescriptor> packets;
+    UrbEvent event;
+};
+
+Capture isoCompletion(uint8_t endpoint, int64_t timestamp, const std::vector<uint32_t>& lengths,
+                      const std::vector<int32_t>& statuses = {}) {
+    Capture capture;
+    uint32_t offset = 0;
+    for (size_t i = 0; i < lengths.size(); i++) {
+        int32_t status = i < statuses.size() ? statuses[i] : 0;
+        capture.packets.push_back({status, offset, lengths[i], 0});
+        offset += lengths[i];
+    }
+    
+    auto& event = capture.event;
+    event = urbEvent('C', LIBUSB_TRANSFER_TYPE_ISOCHRONOUS, 1, 9, endpoint, timestamp, offset);
+    event.isoPackets = capture.packets.data();
+    event.isoPacketCount = uint32_t(capture.packets.size());
+    return capture;
+}
+
+UrbEvent setInterface(uint8_t interfaceNumber, uint8_t altSetting) {
+    auto event = urbEvent('S', LIBUSB_TRANSFER_TYPE_CONTROL, 1, 9, 0x00, T0);
+    event.hasSetup = true;
+    uint8_t setup[8] = {0x01, 0x0B, altSetting, 0, interfaceNumber, 0, 0, 0};
+    std::copy(setup, setup + 8, event.setup);
+    return event;
+}
+
+} // namespace
+
+TEST(AudioStreamAnalyzerTest, ServicePeriodAndStandardRates) {
+    EXPECT_EQ(AudioStreamAnalyzer::servicePeriod(1, 2), 1000u);     // Full speed frame
+    EXPECT_EQ(AudioStreamAnalyzer::servicePeriod(1, 3), 125u);      // High speed microframe
+    EXPECT_EQ(AudioStreamAnalyzer::servicePeriod(4, 3), 1000u);
+    EXPECT_EQ(AudioStreamAnalyzer::nearestStandardRate(44101.3), 44100u);
+    EXPECT_EQ(AudioStreamAnalyzer::nearestStandardRate(47950.0), 48000u);
+    EXPECT_EQ(AudioStreamAnalyzer::nearestStandardRate(40000.0), 0u);
+}
+
+TEST(AudioStreamAnalyzerTest, MeasuresDriftAndContinuityOfCaptureStream) {
+    AudioStreamAnalyzer analyzer;
+    analyzer.addEndpoint(1, 9, 0x82, 1000, AudioFormat{2, 1, 4, 48000});
+    
+    // A 48 kHz stereo microphone whose clock runs 100 ppm fast, eight
+    // packets per URB for a minute
+    int64_t now = T0;
+    double owed = 0.0;
+    for (int urb = 0; urb < 7500; urb++) {
+        std::vector<uint32_t> lengths;
+        std::vector<int32_t> statuses;
+        for (int i = 0; i < 8; i++) {
+            owed += 48.0048;
+            uint32_t samples = uint32_t(owed);
+            owed -= samples;
+            lengths.push_back(samples * 4);
+            statuses.push_back(0);
+        }
+        if (urb == 3000) lengths[5] = 0;            // Device had nothing to send
+        if (urb == 4000) statuses[2] = -71;         // Lost on the bus
+        
+        // One completion arrives 5 ms late, the next one is on time again
+        int64_t jitter = urb == 5000 ? 5000 : 0;
+        now += 8000;
+        auto capture = isoCompletion(0x82, now + jitter, lengths, statuses);
+        analyzer.process(capture.event);
+        
+        if (urb == 6000) now += 12000;              // Host skipped a few ms
+    }
+    
+    auto stats = analyzer.streamStats(1, 9);
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].altSetting, 1);
+    EXPECT_EQ(stats[0].nominalRate, 48000u);
+    EXPECT_EQ(stats[0].packets, 60000u);
+    EXPECT_EQ(stats[0].emptyPackets, 1u);
+    EXPECT_EQ(stats[0].underruns, 1u);
+    EXPECT_EQ(stats[0].overruns, 0u);
+    EXPECT_EQ(stats[0].packetErrors, 1u);
+    EXPECT_EQ(stats[0].discontinuities, 2u);
+    EXPECT_EQ(stats[0].minSamplesPerPacket, 0u);
+    EXPECT_EQ(stats[0].maxSamplesPerPacket, 49u);
+    EXPECT_NEAR(stats[0].samplesPerPacket, 48.0, 0.01);
+    
+    // 100 ppm fast, less the two lost packets and the skipped 12 ms
+    EXPECT_NEAR(stats[0].measuredDriftPpm, 100.0 - 33.3 - 200.0, 10.0);
+    EXPECT_FALSE(stats[0].hasFeedback);
+}
+
+TEST(AudioStreamAnalyzerTest, FollowsAlternateSettingAndFeedback) {
+    AudioStreamAnalyzer analyzer;
+    
+    // UAC2 high speed playback: 16 and 24 bit stereo alternates, rate
+    // unknown from the descriptors, explicit feedback on 0x81
+    analyzer.addEndpoint(1, 9, 0x01, 125, AudioFormat{1, 1, 4, 0});
+    analyzer.addEndpoint(1, 9, 0x01, 125, AudioFormat{1, 2, 6, 0});
+    analyzer.addFeedback(1, 9, 0x81, 0x01, true);
+    
+    analyzer.process(setInterface(1, 2));
+    
+    int64_t now = T0;
+    for (int urb = 0; urb < 1000; urb++) {
+        std::vector<uint32_t> lengths(8, 6 * 6);
+        if (urb == 900) lengths[3] = 9 * 6;
+        now += 1000;
+        auto capture = isoCompletion(0x01, now, lengths);
+        capture.event.endpoint = 0x01;
+        analyzer.process(capture.event);
+        
+        // The device asks for 6.0006 samples per microframe
+        if (urb % 16 == 0) {
+            uint32_t value = uint32_t(6.0006 * 65536);
+            Capture feedback = isoCompletion(0x81, now, {4});
+            feedback.data = {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)};
+            feedback.event.data = feedback.data.data();
+            feedback.event.capturedLength = 4;
+            analyzer.process(feedback.event);
+        }
+    }
+    
+    auto stats = analyzer.streamStats(1, 9)[0];
+    EXPECT_EQ(stats.altSetting, 2);
+    EXPECT_EQ(stats.bytesPerFrame, 6);
+    EXPECT_EQ(stats.nominalRate, 48000u);
+    EXPECT_EQ(stats.overruns, 1u);
+    EXPECT_EQ(stats.samples, 8000u * 6 + 3);
+    EXPECT_TRUE(stats.hasFeedback);
+    EXPECT_NEAR(stats.feedbackDriftPpm, 100.0, 1.0);
+    
+    // Alternate setting 0 stops the stream
+    analyzer.process(setInterface(1, 0));
+    EXPECT_EQ(analyzer.streamStats(1, 9)[0].altSetting, 0);
+    
+    analyzer.removeDevice(1, 9);
+    EXPECT_TRUE(analyzer.streamStats(1, 9).empty());
+}
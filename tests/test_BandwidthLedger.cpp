@@ -0,0 +1,217 @@
+// tests/test_BandwidthLedger.cpp
+#include <gtest/gtest.h>
+#include "../src/core/BandwidthLedger.hpp"
+#include "../src/core/TransferPool.hpp"
+#include <algorithm>
+#include <vector>
+
+using namespace usb_monitor;
+
+namespace {
+
+using Clock = BandwidthLedger::Clock;
+
+Clock::time_point at(int64_t milliseconds) {
+    return Clock::time_point(std::chrono::milliseconds(milliseconds));
+}
+
+// A storage interface with bulk IN/OUT and a HID interface with an
+// interrupt IN, as loadDescriptors() would cache them
+struct Descriptors {
+    Descriptors() {
+        storageEndpoints[0].bEndpointAddress = 0x81;
+        storageEndpoints[0].bmAttributes = LIBUSB_TRANSFER_TYPE_BULK;
+        storageEndpoints[0].wMaxPacketSize = 512;
+        storageEndpoints[1].bEndpointAddress = 0x02;
+        storageEndpoints[1].bmAttributes = LIBUSB_TRANSFER_TYPE_BULK;
+        storageEndpoints[1].wMaxPacketSize = 512;
+        hidEndpoint.bEndpointAddress = 0x83;
+        hidEndpoint.bmAttributes = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+        hidEndpoint.wMaxPacketSize = 8;
+        
+        settings[0].bInterfaceNumber = 0;
+        settings[0].bInterfaceClass = LIBUSB_CLASS_MASS_STORAGE;
+        settings[0].bNumEndpoints = 2;
+        settings[0].endpoint = storageEndpoints;
+        settings[1].bInterfaceNumber = 1;
+        settings[1].bInterfaceClass = LIBUSB_CLASS_HID;
+        settings[1].bNumEndpoints = 1;
+        settings[1].endpoint = &hidEndpoint;
+        
+        for (int i = 0; i < 2; i++) {
+            interfaces[i].altsetting = &settings[i];
+            interfaces[i].num_altsetting = 1;
+        }
+        config.bNumInterfaces = 2;
+        config.interface = interfaces;
+    }
+    
+    libusb_endpoint_descriptor storageEndpoints[2]{};
+    libusb_endpoint_descriptor hidEndpoint{};
+    libusb_interface_descriptor settings[2]{};
+    libusb_interface interfaces[2]{};
+    libusb_config_descriptor config{};
+};
+
+// Holds submitted transfers until the test completes them, standing in
+// for libusb and its event thread
+struct HeldTransfers {
+    TransferBackend backend() {
+        return TransferBackend{
+            [this](libusb_transfer* transfer) {
+                held.push_back(transfer);
+                return int(LIBUSB_SUCCESS);
+            },
+            [](libusb_transfer*) { return int(LIBUSB_SUCCESS); }};
+    }
+    
+    std::vector<libusb_transfer*> held;
+};
+
+void submit(TransferPool& pool, uint8_t endpoint, uint8_t type, int length) {
+    auto slot = pool.acquire(size_t(length));
+    ASSERT_NE(slot, nullptr);
+    slot->transfer->type = type;
+    slot->transfer->endpoint = endpoint;
+    slot->transfer->buffer = slot->buffer.data();
+    slot->transfer->length = length;
+    slot->transfer->num_iso_packets = 0;
+    ASSERT_EQ(pool.submit(slot, nullptr), LIBUSB_SUCCESS);
+}
+
+void complete(libusb_transfer* transfer, libusb_transfer_status status, int actualLength) {
+    transfer->status = status;
+    transfer->actual_length = actualLength;
+    transfer->callback(transfer);
+}
+
+const EndpointBandwidth* findEndpoint(const BandwidthStats& stats, uint8_t address) {
+    auto it = std::find_if(stats.endpoints.begin(), stats.endpoints.end(),
+                           [address](const EndpointBandwidth& endpoint) { return endpoint.address == address; });
+    return it != stats.endpoints.end() ? &*it : nullptr;
+}
+
+} // namespace
+
+// Transfers completing in a device's pool land in its account, split by
+// direction, endpoint and the interface owning each endpoint
+TEST(BandwidthLedgerTest, CountsPoolCompletions) {
+    Descriptors descriptors;
+    BandwidthLedger ledger;
+    HeldTransfers bus;
+    int device = 0;
+    auto now = at(1000);
+    
+    TransferPool pool(8, 4096, 0, bus.backend());
+    pool.setObserver([&](uint8_t endpoint, uint64_t bytes) {
+        ledger.record(&device, &descriptors.config, endpoint, bytes, now);
+    });
+    
+    submit(pool, 0x81, LIBUSB_TRANSFER_TYPE_BULK, 4096);
+    submit(pool, 0x81, LIBUSB_TRANSFER_TYPE_BULK, 4096);
+    submit(pool, 0x02, LIBUSB_TRANSFER_TYPE_BULK, 2048);
+    submit(pool, 0x02, LIBUSB_TRANSFER_TYPE_BULK, 2048);
+    submit(pool, 0x83, LIBUSB_TRANSFER_TYPE_INTERRUPT, 8);
+    ASSERT_EQ(bus.held.size(), 5u);
+    
+    complete(bus.held[0], LIBUSB_TRANSFER_COMPLETED, 4096);
+    complete(bus.held[1], LIBUSB_TRANSFER_COMPLETED, 1000);
+    // A timeout still moved what it moved; a cancelled transfer moved nothing
+    complete(bus.held[2], LIBUSB_TRANSFER_TIMED_OUT, 700);
+    complete(bus.held[3], LIBUSB_TRANSFER_CANCELLED, 0);
+    complete(bus.held[4], LIBUSB_TRANSFER_COMPLETED, 8);
+    EXPECT_EQ(pool.inFlight(), 0u);
+    
+    auto stats = ledger.collect(&device, now);
+    EXPECT_EQ(stats.bytesRead, 4096u + 1000u + 8u);
+    EXPECT_EQ(stats.bytesWritten, 700u);
+    
+    auto bulkIn = findEndpoint(stats, 0x81);
+    ASSERT_NE(bulkIn, nullptr);
+    EXPECT_EQ(bulkIn->interfaceNumber, 0);
+    EXPECT_EQ(bulkIn->transferType, LIBUSB_TRANSFER_TYPE_BULK);
+    EXPECT_EQ(bulkIn->bytes, 5096u);
+    EXPECT_EQ(bulkIn->packets, 8u + 2u);
+    
+    auto bulkOut = findEndpoint(stats, 0x02);
+    ASSERT_NE(bulkOut, nullptr);
+    EXPECT_EQ(bulkOut->packets, 2u);
+    
+    auto interrupt = findEndpoint(stats, 0x83);
+    ASSERT_NE(interrupt, nullptr);
+    EXPECT_EQ(interrupt->interfaceNumber, 1);
+    EXPECT_EQ(interrupt->transferType, LIBUSB_TRANSFER_TYPE_INTERRUPT);
+    
+    ASSERT_EQ(stats.interfaces.size(), 2u);
+    EXPECT_EQ(stats.interfaces[0].interfaceClass, LIBUSB_CLASS_MASS_STORAGE);
+    EXPECT_EQ(stats.interfaces[0].bytes, 5796u);
+    EXPECT_EQ(stats.interfaces[1].interfaceClass, LIBUSB_CLASS_HID);
+    EXPECT_EQ(stats.interfaces[1].bytes, 8u);
+    EXPECT_GT(stats.readSpeed, 0.0);
+}
+
+TEST(BandwidthLedgerTest, ClearedObserverStopsCounting) {
+    BandwidthLedger ledger;
+    HeldTransfers bus;
+    int device = 0;
+    
+    TransferPool pool(2, 64, 0, bus.backend());
+    pool.setObserver([&](uint8_t endpoint, uint64_t bytes) {
+        ledger.record(&device, nullptr, endpoint, bytes, at(0));
+    });
+    submit(pool, 0x81, LIBUSB_TRANSFER_TYPE_BULK, 64);
+    submit(pool, 0x81, LIBUSB_TRANSFER_TYPE_BULK, 64);
+    
+    complete(bus.held[0], LIBUSB_TRANSFER_COMPLETED, 64);
+    pool.setObserver(nullptr);
+    complete(bus.held[1], LIBUSB_TRANSFER_COMPLETED, 64);
+    
+    auto stats = ledger.collect(&device, at(0));
+    EXPECT_EQ(stats.bytesRead, 64u);
+    // Without descriptors the endpoint lands on interface 0
+    ASSERT_EQ(stats.endpoints.size(), 1u);
+    EXPECT_EQ(stats.endpoints[0].interfaceNumber, 0);
+    EXPECT_EQ(stats.endpoints[0].packets, 1u);
+}
+
+// What drives the adaptive sampling interval: activity since last sample
+TEST(BandwidthLedgerTest, SampleReportsActivity) {
+    BandwidthLedger ledger;
+    int device = 0;
+    bool active = false;
+    
+    ledger.open(&device);
+    ledger.sample(&device, at(0), active);
+    EXPECT_FALSE(active);
+    
+    ledger.record(&device, nullptr, 0x81, 512, at(100));
+    ledger.sample(&device, at(200), active);
+    EXPECT_TRUE(active);
+    ledger.sample(&device, at(300), active);
+    EXPECT_FALSE(active);
+    
+    // A zero-length packet counts as traffic on its endpoint, not as bytes
+    ledger.record(&device, nullptr, 0x81, 0, at(400));
+    auto stats = ledger.sample(&device, at(500), active);
+    EXPECT_FALSE(active);
+    EXPECT_EQ(stats.endpoints[0].packets, 2u);
+}
+
+TEST(BandwidthLedgerTest, AccountsAreKeptPerDevice) {
+    BandwidthLedger ledger;
+    int first = 0;
+    int second = 0;
+    
+    ledger.record(&first, nullptr, 0x02, 100, at(0));
+    ledger.record(&second, nullptr, 0x02, 300, at(0));
+    EXPECT_EQ(ledger.collect(&first, at(0)).bytesWritten, 100u);
+    EXPECT_EQ(ledger.collect(&second, at(0)).bytesWritten, 300u);
+    
+    ledger.reset(&first);
+    EXPECT_TRUE(ledger.contains(&first));
+    EXPECT_EQ(ledger.collect(&first, at(0)).bytesWritten, 0u);
+    
+    ledger.erase(&second);
+    EXPECT_FALSE(ledger.contains(&second));
+    EXPECT_EQ(ledger.collect(&second, at(0)).bytesWritten, 0u);
+}
@@ -0,0 +1,99 @@
+// tests/test_BusBandwidthScheduler.cpp
+#include <gtest/gtest.h>
+#include "../src/core/BusBandwidthScheduler.hpp"
+
+using namespace usb_monitor;
+
+namespace {
+
+// High-bandwidth UVC altsetting: 3 x 1024 bytes every microframe
+PeriodicEndpoint hsWebcam(uint32_t interval = 1) {
+    PeriodicEndpoint endpoint;
+    endpoint.address = 0x81;
+    endpoint.isochronous = true;
+    endpoint.bytesPerInterval = 3 * 1024;
+    endpoint.packetsPerInterval = 3;
+    endpoint.interval = interval;
+    return endpoint;
+}
+
+// 48 kHz stereo 16-bit audio OUT, one packet per frame
+PeriodicEndpoint fsAudio() {
+    PeriodicEndpoint endpoint;
+    endpoint.address = 0x01;
+    endpoint.isochronous = true;
+    endpoint.bytesPerInterval = 192;
+    endpoint.interval = 1;
+    return endpoint;
+}
+
+} // namespace
+
+TEST(BusBandwidthSchedulerTest, SecondHighBandwidthWebcamDoesNotFit) {
+    BusBandwidthScheduler scheduler;
+    
+    EXPECT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam1", 1, {hsWebcam()}));
+    auto usage = scheduler.usage("bus 1");
+    EXPECT_GT(usage.peakPercent(), 50.0);
+    EXPECT_LT(usage.peakPercent(), 80.0);
+    
+    EXPECT_FALSE(scheduler.canFit("bus 1", BusSpeed::High, "cam2", 1, {hsWebcam()}));
+    EXPECT_FALSE(scheduler.reserve("bus 1", BusSpeed::High, "cam2", 1, {hsWebcam()}));
+    EXPECT_EQ(scheduler.usage("bus 1").endpointCount, 1u);
+    
+    // A different bus has its own budget
+    EXPECT_TRUE(scheduler.canFit("bus 2", BusSpeed::High, "cam2", 1, {hsWebcam()}));
+}
+
+TEST(BusBandwidthSchedulerTest, LongerIntervalsInterleave) {
+    BusBandwidthScheduler scheduler;
+    
+    // Every other microframe: two such streams take alternate microframes
+    EXPECT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam1", 1, {hsWebcam(2)}));
+    EXPECT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam2", 1, {hsWebcam(2)}));
+    EXPECT_FALSE(scheduler.canFit("bus 1", BusSpeed::High, "cam3", 1, {hsWebcam(2)}));
+    
+    auto usage = scheduler.usage("bus 1");
+    EXPECT_NEAR(usage.averageLoad, usage.peakLoad, 1.0);
+}
+
+TEST(BusBandwidthSchedulerTest, AltSettingChangeReplacesReservation) {
+    BusBandwidthScheduler scheduler;
+    ASSERT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam1", 1, {hsWebcam()}));
+    
+    // Same interface switching to a smaller altsetting is judged without
+    // its current share, so it fits on a bus that is otherwise busy
+    PeriodicEndpoint smaller = hsWebcam();
+    smaller.bytesPerInterval = 1024;
+    smaller.packetsPerInterval = 1;
+    EXPECT_TRUE(scheduler.canFit("bus 1", BusSpeed::High, "cam1", 1, {smaller}));
+    double before = scheduler.usage("bus 1").peakLoad;
+    EXPECT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam1", 1, {smaller}));
+    EXPECT_LT(scheduler.usage("bus 1").peakLoad, before / 2);
+    
+    // Altsetting 0 has no endpoints and frees the bus
+    EXPECT_TRUE(scheduler.reserve("bus 1", BusSpeed::High, "cam1", 1, {}));
+    EXPECT_EQ(scheduler.usage("bus 1").endpointCount, 0u);
+}
+
+TEST(BusBandwidthSchedulerTest, FullSpeedAudioOnTransactionTranslator) {
+    BusBandwidthScheduler scheduler;
+    const std::string tt = "bus 1 tt 1-2";
+    
+    int fitted = 0;
+    while (scheduler.reserve(tt, BusSpeed::Full, "audio" + std::to_string(fitted), 0, {fsAudio()})) {
+        fitted++;
+        ASSERT_LT(fitted, 100);
+    }
+    // About 157 us each against a 900 us periodic frame budget
+    EXPECT_EQ(fitted, 5);
+    
+    scheduler.release("audio0");
+    EXPECT_TRUE(scheduler.canFit(tt, BusSpeed::Full, "late", 0, {fsAudio()}));
+    EXPECT_EQ(scheduler.allUsage().size(), 1u);
+    
+    for (int i = 1; i < fitted; ++i) {
+        scheduler.release("audio" + std::to_string(i));
+    }
+    EXPECT_TRUE(scheduler.allUsage().empty());
+}
@@ -0,0 +1,117 @@
+// tests/test_CaptureStore.cpp
+#include <gtest/gtest.h>
+#include "../src/capture/CaptureStore.hpp"
+#include <random>
+
+using namespace usb_monitor;
+
+namespace {
+
+// A BOT command wrapper with a running tag and LBA, the kind of payload
+// that dominates mass storage captures
+std::vector<uint8_t> commandWrapper(uint32_t tag, uint32_t lba) {
+    std::vector<uint8_t> cbw(31, 0);
+    cbw[0] = 'U'; cbw[1] = 'S'; cbw[2] = 'B'; cbw[3] = 'C';
+    for (int i = 0; i < 4; i++) cbw[4 + i] = uint8_t(tag >> (8 * i));
+    cbw[9] = 0x02;              // 512 bytes
+    cbw[12] = 0x80;
+    cbw[14] = 10;
+    cbw[15] = 0x28;             // READ(10)
+    for (int i = 0; i < 4; i++) cbw[17 + i] = uint8_t(lba >> (8 * (3 - i)));
+    cbw[23] = 1;
+    return cbw;
+}
+
+} // namespace
+
+TEST(CaptureStoreTest, CompressesBlocksAndReadsBack) {
+    CaptureStore store;
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<uint32_t> lba(0, 1 << 20);
+    
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> kept;
+    for (uint32_t tag = 1; tag <= 20000; tag++) {
+        auto cbw = commandWrapper(tag, lba(rng));
+        uint64_t handle = store.append(0x08, cbw.data(), cbw.size());
+        if (tag % 997 == 0) kept.emplace_back(handle, cbw);
+    }
+    
+    // Snippets are cut at CAPTURE_SNAPLEN
+    std::vector<uint8_t> large(4096, 0x5A);
+    uint64_t largeHandle = store.append(0x08, large.data(), large.size());
+    store.flush();
+    
+    auto stats = store.stats();
+    EXPECT_EQ(stats.records, 20001u);
+    EXPECT_EQ(stats.pendingBlocks, 0u);
+    EXPECT_EQ(stats.evictedBlocks, 0u);
+    EXPECT_GT(stats.ratio, 4.0);
+    EXPECT_LT(stats.storedBytes, stats.rawBytes / 4);
+    
+    for (const auto& [handle, bytes] : kept) {
+        auto read = store.read(handle);
+        ASSERT_TRUE(read.has_value());
+        EXPECT_EQ(*read, bytes);
+    }
+    EXPECT_EQ(store.read(largeHandle)->size(), size_t(CAPTURE_SNAPLEN));
+    EXPECT_FALSE(store.read(CaptureStore::NO_PAYLOAD).has_value());
+    
+    // Block by block, every record comes back in order
+    size_t total = 0;
+    for (uint64_t block = store.firstBlock(); block < store.endBlock(); block++) {
+        auto records = store.readBlock(block);
+        if (block == CaptureStore::blockOf(kept.front().first)) {
+            EXPECT_EQ(records[kept.front().first & 0xFFFF], kept.front().second);
+        }
+        total += records.size();
+    }
+    EXPECT_EQ(total, 20001u);
+}
+
+TEST(CaptureStoreTest, EvictsOldestBlocksForBudget) {
+    CaptureStore store(256 * 1024);
+    std::mt19937 rng(4);
+    
+    // Random payloads barely compress, so only a few blocks fit
+    uint64_t first = 0;
+    for (int i = 0; i < 20000; i++) {
+        std::vector<uint8_t> payload(64);
+        for (auto& byte : payload) byte = uint8_t(rng());
+        uint64_t handle = store.append(0x03, payload.data(), payload.size());
+        if (i == 0) first = handle;
+    }
+    store.flush();
+    
+    auto stats = store.stats();
+    EXPECT_LE(stats.storedBytes, 256u * 1024);
+    EXPECT_GT(stats.evictedBlocks, 0u);
+    EXPECT_LT(stats.ratio, 1.2);            // Only the record tags compress
+    EXPECT_FALSE(store.read(first).has_value());
+    EXPECT_GT(store.firstBlock(), 0u);
+    EXPECT_TRUE(store.readBlock(0).empty());
+}
+
+TEST(CaptureStoreTest, TrainsDictionaryPerDeviceClass) {
+    CaptureStore store;
+    store.setDictionaryTraining(true);
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<uint32_t> lba(0, 1 << 20);
+    
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> kept;
+    for (uint32_t tag = 1; tag <= 40000; tag++) {
+        auto cbw = commandWrapper(tag, lba(rng));
+        uint64_t handle = store.append(0x08, cbw.data(), cbw.size());
+        if (tag % 1999 == 0) kept.emplace_back(handle, cbw);
+        if (tag == 20000) store.flush();    // Lets training finish midway
+    }
+    store.flush();
+    
+    auto stats = store.stats();
+    EXPECT_EQ(stats.dictionaries, 1u);
+    EXPECT_GT(stats.ratio, 4.0);
+    for (const auto& [handle, bytes] : kept) {
+        auto read = store.read(handle);
+        ASSERT_TRUE(read.has_value());
+        EXPECT_EQ(*read, bytes);
+    }
+}
@@ -0,0 +1,135 @@
+// tests/test_CdcAcmTracker.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/CdcAcmTracker.hpp"
+#include <string>
+#include <vector>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+// Events point into buffers owned by the fixture
+class CdcAcmTrackerTest : public ::testing::Test {
+protected:
+    CdcAcmTracker tracker;
+    std::vector<std::vector<uint8_t>> buffers;
+    uint64_t nextId{1};
+    
+    void SetUp() override {
+        tracker.addPort(1, 6, 0x83, 0x81, 0x02);
+    }
+    
+    UrbEvent event(char type, uint8_t transferType, uint8_t endpoint, int64_t timestamp,
+                   std::vector<uint8_t> data = {}) {
+        auto e = urbEvent(type, transferType, 1, 6, endpoint, timestamp, uint32_t(data.size()));
+        e.id = nextId++;
+        if (!data.empty()) {
+            buffers.push_back(std::move(data));
+            e.data = buffers.back().data();
+            e.capturedLength = e.length;
+        }
+        return e;
+    }
+    
+    UrbEvent classRequest(int64_t timestamp, uint8_t requestType, uint8_t request,
+                          uint16_t value, std::vector<uint8_t> data = {}) {
+        auto e = event('S', LIBUSB_TRANSFER_TYPE_CONTROL, 0x00, timestamp, std::move(data));
+        uint8_t setup[8] = {requestType, request, uint8_t(value), uint8_t(value >> 8), 0, 0,
+                            uint8_t(e.length), 0};
+        std::copy(setup, setup + 8, e.setup);
+        e.hasSetup = true;
+        return e;
+    }
+    
+    void send(int64_t timestamp, const std::string& text) {
+        std::vector<uint8_t> bytes(text.begin(), text.end());
+        tracker.process(event('S', LIBUSB_TRANSFER_TYPE_BULK, 0x02, timestamp, bytes));
+        auto done = event('C', LIBUSB_TRANSFER_TYPE_BULK, 0x02, timestamp + 50);
+        done.length = uint32_t(text.size());
+        tracker.process(done);
+    }
+    
+    void receive(int64_t timestamp, const std::string& text) {
+        tracker.process(event('C', LIBUSB_TRANSFER_TYPE_BULK, 0x81, timestamp, std::vector<uint8_t>(text.begin(), text.end())));
+    }
+};
+
+} // namespace
+
+TEST_F(CdcAcmTrackerTest, DecodesClassRequestsAndNotifications) {
+    EXPECT_TRUE(tracker.isTracked(1, 6));
+    EXPECT_FALSE(tracker.isTracked(1, 7));
+    
+    // 115200 8N1, then 9600 7E2, DTR and RTS up, a 250 ms break
+    tracker.process(classRequest(T0, 0x21, 0x20, 0, {0x00, 0xC2, 0x01, 0x00, 0, 0, 8}));
+    tracker.process(classRequest(T0 + 10, 0x21, 0x20, 0, {0x80, 0x25, 0x00, 0x00, 2, 2, 7}));
+    tracker.process(classRequest(T0 + 20, 0x21, 0x22, 0x0003));
+    tracker.process(classRequest(T0 + 30, 0x21, 0x23, 250));
+    tracker.process(classRequest(T0 + 40, 0x21, 0x23, 0));
+    
+    // SERIAL_STATE with a framing and an overrun error
+    tracker.process(event('C', LIBUSB_TRANSFER_TYPE_INTERRUPT, 0x83, T0 + 50,
+                          {0xA1, 0x20, 0, 0, 0, 0, 2, 0, 0x50, 0x00}));
+    
+    auto stats = tracker.stats(1, 6);
+    EXPECT_EQ(stats.ports, 1);
+    EXPECT_TRUE(stats.lineCoding.known);
+    EXPECT_EQ(stats.lineCoding.baudRate, 9600u);
+    EXPECT_EQ(stats.lineCoding.dataBits, 7);
+    EXPECT_EQ(stats.lineCoding.parity, 2);
+    EXPECT_EQ(stats.lineCodingChanges, 1u);
+    EXPECT_DOUBLE_EQ(stats.lineCoding.characterRate(), 9600.0 / 11);
+    EXPECT_TRUE(stats.dtr);
+    EXPECT_TRUE(stats.rts);
+    EXPECT_EQ(stats.breaks, 1u);
+    EXPECT_EQ(stats.framingErrors, 1u);
+    EXPECT_EQ(stats.parityErrors, 0u);
+    EXPECT_EQ(stats.overruns, 1u);
+    
+    // GET_LINE_CODING is read from its completion
+    auto get = classRequest(T0 + 60, 0xA1, 0x21, 0);
+    tracker.process(get);
+    auto reply = event('C', LIBUSB_TRANSFER_TYPE_CONTROL, 0x80, T0 + 70, {0x00, 0xC2, 0x01, 0x00, 0, 0, 8});
+    reply.id = get.id;
+    tracker.process(reply);
+    EXPECT_EQ(tracker.stats(1, 6).lineCoding.baudRate, 115200u);
+}
+
+TEST_F(CdcAcmTrackerTest, MeasuresRoundTripsAndThroughput) {
+    tracker.process(classRequest(T0, 0x21, 0x20, 0, {0x00, 0xC2, 0x01, 0x00, 0, 0, 8}));
+    
+    // An AT-style dialogue: the device starts answering after 2 ms and
+    // finishes the line 1 ms later; every tenth command gets no answer
+    int64_t now = T0;
+    for (int i = 0; i < 200; i++) {
+        now += 20000;
+        send(now, "AT+CSQ\r\n");
+        if (i % 10 == 9) continue;
+        receive(now + 2000, "+CSQ: 2");
+        receive(now + 3000, "1,99\r\n");
+    }
+    now += 20000;
+    send(now, "AT\r\n");
+    
+    // Unsolicited output is counted but is not a response
+    receive(now + 1000, "OK\r\n");
+    receive(now + 2000, "RING\r\n");
+    
+    auto stats = tracker.stats(1, 6);
+    EXPECT_EQ(stats.requests, 201u);
+    EXPECT_EQ(stats.unanswered, 20u);
+    EXPECT_NEAR(stats.meanResponse, 2000, 200);
+    EXPECT_LE(stats.p50Response, 2100u);
+    EXPECT_GE(stats.p50LineResponse, 3000u);
+    EXPECT_LE(stats.p50LineResponse, 3500u);
+    EXPECT_EQ(stats.out.bytes, 200u * 8 + 4);
+    EXPECT_EQ(stats.in.bytes, 180u * 13 + 10);
+    EXPECT_GT(stats.out.rate, 0.0);
+    EXPECT_GT(stats.in.utilization, 0.0);
+    EXPECT_LT(stats.in.utilization, 0.1);
+    
+    tracker.removeDevice(1, 6);
+    EXPECT_FALSE(tracker.isTracked(1, 6));
+}
@@ -38,6 +38,17 @@ TEST_F(DeviceManagerTest, GetConnectedDevicesTest) {
     EXPECT_GE(devices.size(), 0);
 }
 
+TEST_F(DeviceManagerTest, SnapshotTest) {
+    auto first = manager->deviceSnapshot();
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->generation, manager->generation());
+    
+    // Nothing changed: readers get the very same snapshot back
+    auto second = manager->deviceSnapshot();
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(manager->getConnectedDevices().size(), first->devices.size());
+}
+
 TEST_F(DeviceManagerTest, SignalTest) {
     bool deviceAddedEmitted = false;
     bool deviceRemovedEmitted = false;
@@ -0,0 +1,214 @@
+// tests/test_DeviceSession.cpp
+#include <gtest/gtest.h>
+#include "../src/core/DeviceSession.hpp"
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace usb_monitor;
+
+namespace {
+
+// Stands in for the libusb event thread: suspended coroutines queue up
+// here and are resumed one at a time by whoever drains it
+class FakeEventLoop {
+public:
+    struct Awaitable {
+        FakeEventLoop* loop;
+        int value;
+        
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { loop->ready.push_back(handle); }
+        int await_resume() const noexcept { return value; }
+    };
+    
+    Awaitable transfer(int value) { return Awaitable{this, value}; }
+    
+    size_t drain() {
+        size_t resumed = 0;
+        while (!ready.empty()) {
+            auto handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+            resumed++;
+        }
+        return resumed;
+    }
+    
+    std::deque<std::coroutine_handle<>> ready;
+};
+
+Task<int> readRegister(FakeEventLoop& loop, int value) {
+    int result = co_await loop.transfer(value);
+    co_return result * 2;
+}
+
+Task<void> provision(FakeEventLoop& loop, int& total) {
+    for (int i = 0; i < 4; ++i) {
+        total += co_await readRegister(loop, i);
+    }
+}
+
+Task<void> failingSession(FakeEventLoop& loop) {
+    co_await loop.transfer(0);
+    throw std::runtime_error("device stalled");
+}
+
+// Transfers go through a real TransferPool; the bus keeps them until the
+// test completes them through their libusb callback
+class PooledTarget : public TransferTarget {
+public:
+    explicit PooledTarget(size_t slots)
+        : pool(slots, 64, 0, TransferBackend{
+              [this](libusb_transfer* transfer) {
+                  submitted.push_back(transfer);
+                  return int(LIBUSB_SUCCESS);
+              },
+              [](libusb_transfer*) { return int(LIBUSB_SUCCESS); }}) {}
+    
+    bool submitControl(uint8_t, uint8_t, uint16_t, uint16_t, const uint8_t*, uint16_t,
+                       TransferCallback, unsigned int) override {
+        return false;
+    }
+    
+    bool submitBulk(uint8_t endpoint, const uint8_t* data, size_t length,
+                    TransferCallback callback, unsigned int timeout) override {
+        auto slot = pool.acquire(length);
+        if (!slot) return false;
+        
+        if (data) std::memcpy(slot->buffer.data(), data, length);
+        slot->transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+        slot->transfer->endpoint = endpoint;
+        slot->transfer->buffer = slot->buffer.data();
+        slot->transfer->length = static_cast<int>(length);
+        slot->transfer->timeout = timeout;
+        slot->transfer->num_iso_packets = 0;
+        return pool.submit(slot, std::move(callback)) == LIBUSB_SUCCESS;
+    }
+    
+    bool submitInterrupt(uint8_t endpoint, const uint8_t* data, size_t length,
+                         TransferCallback callback, unsigned int timeout) override {
+        return submitBulk(endpoint, data, length, std::move(callback), timeout);
+    }
+    
+    // What the event thread does once the device answers an IN transfer
+    void answer(const std::string& reply) {
+        auto transfer = submitted.front();
+        submitted.pop_front();
+        std::memcpy(transfer->buffer, reply.data(), reply.size());
+        transfer->status = LIBUSB_TRANSFER_COMPLETED;
+        transfer->actual_length = static_cast<int>(reply.size());
+        transfer->callback(transfer);
+    }
+    
+    std::deque<libusb_transfer*> submitted;
+    TransferPool pool;
+};
+
+Task<void> readTwice(PooledTarget& target, std::vector<std::string>& replies, size_t& inFlightOnResume) {
+    for (int i = 0; i < 2; ++i) {
+        auto result = co_await TransferAwaitable(&target, TransferAwaitable::Kind::Bulk, 0x81,
+                                                 nullptr, 16, 1000);
+        inFlightOnResume = target.pool.inFlight();
+        replies.emplace_back(result.data.begin(), result.data.end());
+    }
+}
+
+} // namespace
+
+TEST(DeviceSessionTest, NestedTasksComposeResults) {
+    FakeEventLoop loop;
+    SessionScheduler scheduler;
+    int total = 0;
+    
+    scheduler.spawn(provision(loop, total));
+    EXPECT_EQ(scheduler.activeSessions(), 1u);
+    
+    loop.drain();
+    EXPECT_EQ(total, (0 + 1 + 2 + 3) * 2);
+    EXPECT_EQ(scheduler.activeSessions(), 0u);
+    EXPECT_EQ(scheduler.completedSessions(), 1u);
+}
+
+TEST(DeviceSessionTest, ExceptionsReachCompletionHandler) {
+    FakeEventLoop loop;
+    SessionScheduler scheduler;
+    bool sawError = false;
+    
+    scheduler.spawn(failingSession(loop), [&sawError](std::exception_ptr error) {
+        sawError = error != nullptr;
+    });
+    loop.drain();
+    
+    EXPECT_TRUE(sawError);
+    EXPECT_EQ(scheduler.failedSessions(), 1u);
+    EXPECT_TRUE(scheduler.waitAll(std::chrono::milliseconds(0)));
+}
+
+TEST(DeviceSessionTest, SessionOutlivesScheduler) {
+    FakeEventLoop loop;
+    int total = 0;
+    bool completed = false;
+    
+    {
+        SessionScheduler scheduler;
+        scheduler.spawn(provision(loop, total), [&completed](std::exception_ptr error) {
+            completed = error == nullptr;
+        });
+    }
+    
+    // Still suspended when its scheduler gave up waiting; it must finish
+    // without touching the destroyed scheduler
+    loop.drain();
+    EXPECT_TRUE(completed);
+    EXPECT_EQ(total, 12);
+}
+
+TEST(DeviceSessionTest, ThousandsOfSessionsOnOneThread) {
+    const int sessionCount = 5000;
+    FakeEventLoop loop;
+    SessionScheduler scheduler;
+    std::vector<int> totals(sessionCount, 0);
+    
+    for (int i = 0; i < sessionCount; ++i) {
+        scheduler.spawn(provision(loop, totals[i]));
+    }
+    EXPECT_EQ(scheduler.activeSessions(), static_cast<size_t>(sessionCount));
+    
+    // All sessions advance on a single driver thread
+    std::thread driver([&loop] { loop.drain(); });
+    driver.join();
+    
+    EXPECT_TRUE(scheduler.waitAll(std::chrono::seconds(5)));
+    EXPECT_EQ(scheduler.completedSessions(), static_cast<size_t>(sessionCount));
+    for (int total : totals) {
+        EXPECT_EQ(total, 12);
+    }
+}
+
+TEST(DeviceSessionTest, ResumesAfterPooledSlotIsReleased) {
+    // One slot: the second read can only be submitted if the session
+    // resumes after the first completion has handed its slot back
+    PooledTarget target(1);
+    SessionScheduler scheduler;
+    std::vector<std::string> replies;
+    size_t inFlightOnResume = 99;
+    
+    scheduler.spawn(readTwice(target, replies, inFlightOnResume));
+    ASSERT_EQ(target.submitted.size(), 1u);
+    EXPECT_EQ(scheduler.activeSessions(), 1u);
+    
+    target.answer("first");
+    EXPECT_EQ(inFlightOnResume, 0u);
+    ASSERT_EQ(target.submitted.size(), 1u);
+    EXPECT_EQ(target.pool.inFlight(), 1u);
+    
+    target.answer("second");
+    EXPECT_EQ(scheduler.completedSessions(), 1u);
+    EXPECT_EQ(target.pool.inFlight(), 0u);
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_EQ(replies[0], "first");
+    EXPECT_EQ(replies[1], "second");
+}
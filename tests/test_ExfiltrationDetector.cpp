@@ -0,0 +1,110 @@
+// tests/test_ExfiltrationDetector.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/ExfiltrationDetector.hpp"
+#include <random>
+#include <string>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+class ExfiltrationDetectorTest : public ::testing::Test {
+protected:
+    static constexpr uint16_t BUS = 2;
+    static constexpr uint8_t ADDRESS = 7;
+    static constexpr uint8_t BULK_OUT = 0x02;
+    
+    void SetUp() override {
+        detector.addEndpoint(BUS, ADDRESS, BULK_OUT);
+        std::mt19937 rng(11);
+        random.resize(EXFIL_SAMPLE_BYTES);
+        for (auto& byte : random) byte = uint8_t(rng());
+        std::string prose = "The quick brown fox jumps over the lazy dog. ";
+        while (text.size() < size_t(EXFIL_SAMPLE_BYTES)) text.insert(text.end(), prose.begin(), prose.end());
+    }
+    
+    // A bulk write submission with the first bytes of its data captured
+    std::optional<ExfiltrationAlert> write(int64_t timestamp, uint32_t length,
+                                           const std::vector<uint8_t>& data) {
+        auto event = urbEvent('S', LIBUSB_TRANSFER_TYPE_BULK, BUS, ADDRESS, BULK_OUT, timestamp, length);
+        event.data = data.data();
+        event.capturedLength = uint32_t(data.size());
+        return detector.process(event);
+    }
+    
+    // Writes of a chunk size at the given rate for a number of seconds
+    int copy(int64_t start, double bytesPerSecond, int seconds, const std::vector<uint8_t>& data,
+             uint32_t chunk = 1 << 20) {
+        int alerts = 0;
+        int64_t step = int64_t(chunk / bytesPerSecond * 1e6);
+        for (int64_t t = start; t < start + seconds * 1000000LL; t += step) {
+            if (write(t, chunk, data)) alerts++;
+        }
+        return alerts;
+    }
+    
+    ExfiltrationDetector detector;
+    std::vector<uint8_t> random;
+    std::vector<uint8_t> text;
+};
+
+TEST_F(ExfiltrationDetectorTest, MeasuresByteEntropy) {
+    EXPECT_GT(ExfiltrationDetector::entropy(random.data(), random.size()), 7.95);
+    EXPECT_LT(ExfiltrationDetector::entropy(text.data(), text.size()), 4.5);
+    
+    std::vector<uint8_t> zeros(1000, 0);
+    EXPECT_DOUBLE_EQ(ExfiltrationDetector::entropy(zeros.data(), zeros.size()), 0.0);
+    
+    // The bias correction keeps short random samples above the threshold
+    EXPECT_GT(ExfiltrationDetector::entropy(random.data(), 512), EXFIL_ENTROPY_THRESHOLD);
+}
+
+TEST_F(ExfiltrationDetectorTest, AlertsOnceOnHighEntropyBurst) {
+    // Ordinary document saves: small, then a large low-entropy copy
+    EXPECT_EQ(copy(0, 1e6, 5, random), 0);
+    EXPECT_EQ(copy(10000000, 50e6, 5, text), 0);
+    auto stats = detector.stats(BUS, ADDRESS);
+    EXPECT_EQ(stats.bursts, 1u);
+    EXPECT_EQ(stats.alerts, 0u);
+    
+    // After a quiet spell, an archive copied out at full speed
+    EXPECT_EQ(copy(40000000, 50e6, 8, random), 1);
+    stats = detector.stats(BUS, ADDRESS);
+    EXPECT_EQ(stats.bursts, 2u);
+    EXPECT_EQ(stats.alerts, 1u);
+    EXPECT_GT(stats.entropy, EXFIL_ENTROPY_THRESHOLD);
+    EXPECT_GT(stats.writeRate, 40e6);
+    
+    // Command wrappers are not data
+    std::vector<uint8_t> cbw(31, 0);
+    std::copy_n("USBC", 4, cbw.begin());
+    uint64_t writes = stats.writes;
+    write(48500000, 31, cbw);
+    EXPECT_EQ(detector.stats(BUS, ADDRESS).writes, writes);
+}
+
+TEST_F(ExfiltrationDetectorTest, PolicyAllowsEncryptedTargets) {
+    ExfiltrationPolicy policy;
+    policy.highEntropyAllowed = true;
+    detector.setPolicy(BUS, ADDRESS, policy);
+    EXPECT_EQ(copy(0, 50e6, 8, random), 0);
+    EXPECT_EQ(detector.stats(BUS, ADDRESS).bursts, 1u);
+    
+    // A lower limit catches smaller copies
+    policy.highEntropyAllowed = false;
+    policy.burstBytes = 8 << 20;
+    detector.setPolicy(BUS, ADDRESS, policy);
+    EXPECT_EQ(copy(60000000, 2e6, 8, random), 1);
+}
+
+TEST_F(ExfiltrationDetectorTest, SamplingStaysWithinBudget) {
+    // USB 3 speed in 64 KiB writes, far more data than the budget
+    EXPECT_EQ(copy(0, 400e6, 10, random, 1 << 16), 1);
+    
+    auto stats = detector.stats(BUS, ADDRESS);
+    EXPECT_GT(stats.writes, 60000u);
+    EXPECT_GT(stats.sampledWrites, 1000u);
+    EXPECT_LT(stats.sampledWrites, stats.writes / 2);
+    EXPECT_LE(stats.sampledBytes, uint64_t(EXFIL_SAMPLE_BUDGET) * 11);
+    EXPECT_EQ(stats.sampledBytes, stats.sampledWrites * uint64_t(EXFIL_SAMPLE_BYTES));
+}
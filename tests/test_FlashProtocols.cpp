@@ -0,0 +1,233 @@
+// tests/test_FlashProtocols.cpp
+#include <gtest/gtest.h>
+#include "FlashGadgets.hpp"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <queue>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+// Bulk OUT through a real TransferPool. Submitted blocks wait on the bus
+// until the test lets the device accept them, in full or in part.
+class BulkSink : public TransferTarget {
+public:
+    BulkSink()
+        : pool(TRANSFER_POOL_SIZE, 64, 0, TransferBackend{
+              [this](libusb_transfer* transfer) {
+                  queued.push_back(transfer);
+                  return int(LIBUSB_SUCCESS);
+              },
+              [](libusb_transfer*) { return int(LIBUSB_SUCCESS); }}) {}
+    
+    bool submitControl(uint8_t, uint8_t, uint16_t, uint16_t, const uint8_t*, uint16_t,
+                       TransferCallback, unsigned int) override {
+        return false;
+    }
+    
+    bool submitBulk(uint8_t endpoint, const uint8_t* data, size_t length,
+                    TransferCallback callback, unsigned int timeout) override {
+        auto slot = pool.acquire(length);
+        if (!slot) return false;
+        
+        std::memcpy(slot->buffer.data(), data, length);
+        slot->transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+        slot->transfer->endpoint = endpoint;
+        slot->transfer->buffer = slot->buffer.data();
+        slot->transfer->length = static_cast<int>(length);
+        slot->transfer->timeout = timeout;
+        slot->transfer->num_iso_packets = 0;
+        return pool.submit(slot, std::move(callback)) == LIBUSB_SUCCESS;
+    }
+    
+    bool submitInterrupt(uint8_t, const uint8_t*, size_t, TransferCallback, unsigned int) override {
+        return false;
+    }
+    
+    // Completes the oldest block, accepting only the given number of bytes
+    void accept(int bytes) {
+        auto transfer = queued.front();
+        queued.pop_front();
+        received.insert(received.end(), transfer->buffer, transfer->buffer + bytes);
+        transfer->status = LIBUSB_TRANSFER_COMPLETED;
+        transfer->actual_length = bytes;
+        transfer->callback(transfer);
+    }
+    
+    void acceptAll() {
+        while (!queued.empty()) {
+            accept(queued.front()->length);
+        }
+    }
+    
+    std::deque<libusb_transfer*> queued;
+    std::vector<uint8_t> received;
+    TransferPool pool;
+};
+
+Task<void> writeAll(BulkSink& sink, const std::atomic<bool>& cancelled,
+                    const std::vector<uint8_t>& image, TransferResult& result, size_t& written) {
+    result = co_await PipelinedWrite(&sink, &cancelled, 0x01, image.data(), image.size(), 512, 4,
+                                     1000, [&written](size_t bytes) { written = bytes; });
+}
+
+} // namespace
+
+TEST(FlashProtocolsTest, DfuDownloadWritesImage) {
+    VirtualLoop loop;
+    SessionScheduler scheduler;
+    DfuGadget gadget(loop);
+    auto image = makeImage(10 * 1024 + 100);
+    FlashOptions options;
+    FlashOutcome outcome;
+    int attempts = 0;
+    std::vector<size_t> progress;
+    
+    scheduler.spawn(flashOne(gadget, image, options, outcome, attempts,
+        [&progress](size_t written, size_t) { progress.push_back(written); }));
+    loop.run();
+    
+    EXPECT_TRUE(outcome.ok) << outcome.error;
+    EXPECT_EQ(attempts, 1);
+    EXPECT_EQ(gadget.flashed, image);
+    EXPECT_TRUE(gadget.manifested);
+    ASSERT_EQ(progress.size(), 11u);
+    EXPECT_EQ(progress.back(), image.size());
+}
+
+TEST(FlashProtocolsTest, DfuRetriesAfterWriteError) {
+    VirtualLoop loop;
+    SessionScheduler scheduler;
+    DfuGadget gadget(loop);
+    gadget.failBlock = 3;
+    gadget.failuresLeft = 2;
+    auto image = makeImage(8 * 1024);
+    FlashOptions options;
+    FlashOutcome outcome;
+    int attempts = 0;
+    
+    scheduler.spawn(flashOne(gadget, image, options, outcome, attempts));
+    loop.run();
+    
+    EXPECT_TRUE(outcome.ok) << outcome.error;
+    EXPECT_EQ(attempts, 3);
+    EXPECT_EQ(gadget.flashed, image);
+}
+
+TEST(FlashProtocolsTest, DfuGivesUpAfterMaxRetries) {
+    VirtualLoop loop;
+    SessionScheduler scheduler;
+    DfuGadget gadget(loop);
+    gadget.failBlock = 1;
+    gadget.failuresLeft = 100;
+    auto image = makeImage(4 * 1024);
+    FlashOptions options;
+    options.maxRetries = 2;
+    FlashOutcome outcome;
+    int attempts = 0;
+    
+    scheduler.spawn(flashOne(gadget, image, options, outcome, attempts));
+    loop.run();
+    
+    EXPECT_FALSE(outcome.ok);
+    EXPECT_EQ(attempts, 3);
+}
+
+TEST(FlashProtocolsTest, VendorBulkPipelineHidesTurnaround) {
+    auto image = makeImage(512 * 1024);
+    double elapsed[2];
+    
+    for (int i = 0; i < 2; ++i) {
+        VirtualLoop loop;
+        SessionScheduler scheduler;
+        VendorGadget gadget(loop);
+        FlashOptions options;
+        options.protocol = FlashProtocol::VendorBulk;
+        options.blockSize = 4096;
+        options.pipelineDepth = i == 0 ? 1 : 8;
+        FlashOutcome outcome;
+        int attempts = 0;
+        
+        scheduler.spawn(flashOne(gadget, image, options, outcome, attempts));
+        loop.run();
+        
+        EXPECT_TRUE(outcome.ok) << outcome.error;
+        EXPECT_EQ(gadget.flashed, image);
+        elapsed[i] = loop.now;
+    }
+    EXPECT_LT(elapsed[1], elapsed[0] / 2);
+}
+
+TEST(FlashProtocolsTest, ManyDfuDevicesOnOneThread) {
+    const int kDevices = 500;
+    VirtualLoop loop;
+    SessionScheduler scheduler;
+    auto image = makeImage(64 * 1024);
+    FlashOptions options;
+    std::vector<std::unique_ptr<DfuGadget>> gadgets;
+    std::vector<FlashOutcome> outcomes(kDevices);
+    std::vector<int> attempts(kDevices);
+    
+    for (int i = 0; i < kDevices; ++i) {
+        gadgets.push_back(std::make_unique<DfuGadget>(loop));
+        if (i % 50 == 0) {
+            gadgets.back()->failBlock = 10;
+            gadgets.back()->failuresLeft = 1;
+        }
+        scheduler.spawn(flashOne(*gadgets.back(), image, options, outcomes[i], attempts[i]));
+    }
+    loop.run();
+    
+    EXPECT_EQ(scheduler.completedSessions(), static_cast<size_t>(kDevices));
+    for (int i = 0; i < kDevices; ++i) {
+        EXPECT_TRUE(outcomes[i].ok);
+        EXPECT_EQ(gadgets[i]->flashed, image);
+    }
+}
+
+TEST(FlashProtocolsTest, PipelinedWriteCompletesImage) {
+    BulkSink sink;
+    SessionScheduler scheduler;
+    std::atomic<bool> cancelled{false};
+    auto image = makeImage(10 * 512 + 100);
+    TransferResult result;
+    size_t written = 0;
+    
+    scheduler.spawn(writeAll(sink, cancelled, image, result, written));
+    EXPECT_EQ(sink.queued.size(), 4u);
+    sink.acceptAll();
+    
+    EXPECT_EQ(scheduler.completedSessions(), 1u);
+    EXPECT_TRUE(result.ok());
+    EXPECT_EQ(written, image.size());
+    EXPECT_EQ(sink.received, image);
+}
+
+TEST(FlashProtocolsTest, PipelinedWriteFailsOnShortBlock) {
+    BulkSink sink;
+    SessionScheduler scheduler;
+    std::atomic<bool> cancelled{false};
+    auto image = makeImage(10 * 512);
+    TransferResult result;
+    size_t written = 0;
+    
+    scheduler.spawn(writeAll(sink, cancelled, image, result, written));
+    sink.accept(512);
+    sink.accept(512);
+    sink.accept(100);  // Completed, but short
+    sink.acceptAll();
+    
+    EXPECT_EQ(scheduler.completedSessions(), 1u);
+    EXPECT_FALSE(result.ok());
+    EXPECT_EQ(result.status, LIBUSB_TRANSFER_ERROR);
+    
+    // Blocks already in flight finish, but nothing new goes out and the
+    // short block never counts as written
+    EXPECT_LT(sink.received.size(), image.size());
+    EXPECT_EQ(written % 512, 0u);
+    EXPECT_LT(written, sink.received.size());
+}
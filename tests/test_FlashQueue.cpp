@@ -0,0 +1,191 @@
+// tests/test_FlashQueue.cpp
+#include <gtest/gtest.h>
+#include "FlashGadgets.hpp"
+#include "../src/flashing/FlashQueue.hpp"
+#include <map>
+#include <memory>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+using Clock = FlashQueue::Clock;
+
+// Runs DFU gadgets through a FlashQueue the way FlashEngine runs devices:
+// a session for every device the queue starts, and another round of starts
+// whenever one finishes. Times come from the virtual loop.
+class FlashRig {
+public:
+    explicit FlashRig(size_t sessionsPerBus, size_t imageSize = 16 * 1024)
+        : queue(sessionsPerBus), image(makeImage(imageSize)) {}
+    
+    Clock::time_point at() const {
+        return base + std::chrono::microseconds(static_cast<int64_t>(loop.now * 1000));
+    }
+    
+    DfuGadget& add(uint8_t bus) {
+        auto device = std::make_unique<Device>(loop, bus);
+        EXPECT_TRUE(queue.enqueue(device.get(), bus, at()));
+        devices.push_back(std::move(device));
+        return devices.back()->gadget;
+    }
+    
+    void pump() {
+        while (auto key = queue.startNext(at())) {
+            auto* device = static_cast<Device*>(const_cast<void*>(*key));
+            size_t active = queue.stats(at()).buses[device->bus].activeSessions;
+            peakActive[device->bus] = std::max(peakActive[device->bus], active);
+            
+            auto progress = [this, device](size_t written, size_t) {
+                if (written < device->lastWritten) {
+                    device->lastWritten = 0;
+                }
+                queue.addBytes(device, written - device->lastWritten);
+                device->lastWritten = written;
+            };
+            scheduler.spawn(flashOne(device->gadget, image, options, device->outcome,
+                                     device->attempts, progress),
+                [this, device](std::exception_ptr) {
+                    queue.finish(device, device->outcome.ok, device->attempts, at());
+                    pump();
+                });
+        }
+    }
+    
+    struct Device {
+        Device(VirtualLoop& loop, uint8_t bus) : gadget(loop), bus(bus) {}
+        
+        DfuGadget gadget;
+        uint8_t bus;
+        FlashOutcome outcome;
+        int attempts{0};
+        size_t lastWritten{0};
+    };
+    
+    VirtualLoop loop;
+    SessionScheduler scheduler;
+    FlashQueue queue;
+    std::vector<uint8_t> image;
+    FlashOptions options;
+    std::vector<std::unique_ptr<Device>> devices;
+    std::map<uint8_t, size_t> peakActive;
+    Clock::time_point base{Clock::now()};
+};
+
+} // namespace
+
+TEST(FlashQueueTest, StartsOnLeastLoadedBus) {
+    FlashQueue queue(2);
+    auto now = Clock::now();
+    int devices[5];
+    
+    // Three on bus 1, two on bus 2
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(queue.enqueue(&devices[i], i < 3 ? 1 : 2, now));
+    }
+    EXPECT_FALSE(queue.enqueue(&devices[0], 1, now));
+    
+    // Ties go to the lower bus, otherwise the emptier one wins
+    EXPECT_EQ(queue.startNext(now), &devices[0]);
+    EXPECT_EQ(queue.startNext(now), &devices[3]);
+    EXPECT_EQ(queue.startNext(now), &devices[1]);
+    EXPECT_EQ(queue.startNext(now), &devices[4]);
+    
+    // Both buses are full, so the last device on bus 1 waits for a slot
+    EXPECT_EQ(queue.startNext(now), std::nullopt);
+    auto stats = queue.stats(now);
+    EXPECT_EQ(stats.active, 4u);
+    EXPECT_EQ(stats.queued, 1u);
+    EXPECT_EQ(stats.buses[1].activeSessions, 2u);
+    EXPECT_EQ(stats.buses[2].activeSessions, 2u);
+    
+    EXPECT_FALSE(queue.finish(&devices[3], true, 1, now));
+    EXPECT_EQ(queue.startNext(now), std::nullopt);
+    EXPECT_FALSE(queue.finish(&devices[0], true, 1, now));
+    EXPECT_EQ(queue.startNext(now), &devices[2]);
+}
+
+TEST(FlashQueueTest, FlashesEveryGadgetWithinBusLimits) {
+    FlashRig rig(3);
+    for (int i = 0; i < 12; ++i) {
+        auto& gadget = rig.add(i < 8 ? 1 : 2);
+        if (i % 5 == 0) {
+            gadget.failBlock = 4;
+            gadget.failuresLeft = 1;
+        }
+    }
+    
+    rig.pump();
+    rig.loop.run();
+    
+    for (const auto& device : rig.devices) {
+        EXPECT_TRUE(device->outcome.ok) << device->outcome.error;
+        EXPECT_EQ(device->gadget.flashed, rig.image);
+    }
+    EXPECT_EQ(rig.peakActive[1], 3u);
+    EXPECT_EQ(rig.peakActive[2], 3u);
+    
+    auto stats = rig.queue.stats(rig.at());
+    EXPECT_FALSE(rig.queue.isRunning());
+    EXPECT_EQ(stats.completed, 12u);
+    EXPECT_EQ(stats.failed, 0u);
+    EXPECT_EQ(stats.retries, 3u);
+    EXPECT_GE(stats.buses[1].bytesWritten, 8 * rig.image.size());
+    EXPECT_GE(stats.buses[2].bytesWritten, 4 * rig.image.size());
+    
+    // The run ended with the last finish, on the virtual clock
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(rig.at() - rig.base);
+    EXPECT_EQ(stats.elapsed, elapsed);
+    ASSERT_GT(elapsed.count(), 0);
+    EXPECT_DOUBLE_EQ(stats.devicesPerHour, 12 * 3600000.0 / elapsed.count());
+}
+
+TEST(FlashQueueTest, GivenUpDevicesCountAsFailed) {
+    FlashRig rig(2);
+    rig.options.maxRetries = 1;
+    rig.add(1);
+    auto& broken = rig.add(1);
+    broken.failBlock = 2;
+    broken.failuresLeft = 100;
+    
+    rig.pump();
+    rig.loop.run();
+    
+    auto stats = rig.queue.stats(rig.at());
+    EXPECT_EQ(stats.completed, 1u);
+    EXPECT_EQ(stats.failed, 1u);
+    EXPECT_EQ(stats.retries, 1u);
+}
+
+TEST(FlashQueueTest, CancelDropsQueuedDevices) {
+    FlashRig rig(1);
+    for (int i = 0; i < 3; ++i) {
+        rig.add(1);
+    }
+    
+    rig.pump();
+    auto dropped = rig.queue.cancel(rig.at());
+    ASSERT_EQ(dropped.size(), 2u);
+    EXPECT_EQ(dropped[0], rig.devices[1].get());
+    EXPECT_EQ(dropped[1], rig.devices[2].get());
+    EXPECT_TRUE(rig.queue.isCancelled());
+    
+    // The running device finishes, nothing else starts
+    rig.loop.run();
+    EXPECT_TRUE(rig.devices[0]->outcome.ok);
+    EXPECT_EQ(rig.devices[1]->attempts, 0);
+    EXPECT_FALSE(rig.queue.isRunning());
+    
+    auto stats = rig.queue.stats(rig.at());
+    EXPECT_EQ(stats.completed, 1u);
+    EXPECT_EQ(stats.queued, 0u);
+    EXPECT_EQ(rig.peakActive[1], 1u);
+    
+    // A new run starts clean
+    int device = 0;
+    EXPECT_TRUE(rig.queue.enqueue(&device, 3, rig.at()));
+    EXPECT_FALSE(rig.queue.isCancelled());
+    EXPECT_EQ(rig.queue.stats(rig.at()).completed, 0u);
+    EXPECT_EQ(rig.queue.startNext(rig.at()), &device);
+}
@@ -0,0 +1,78 @@
+// tests/test_HidPollingAnalyzer.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/HidPollingAnalyzer.hpp"
+#include <random>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+UrbEvent report(int64_t timestamp, uint8_t endpoint = 0x81) {
+    return urbEvent('C', LIBUSB_TRANSFER_TYPE_INTERRUPT, 3, 4, endpoint, timestamp, 8);
+}
+
+} // namespace
+
+TEST(HidPollingAnalyzerTest, PollingPeriodFromDescriptor) {
+    EXPECT_EQ(HidPollingAnalyzer::pollingPeriod(10, 2), 10000u);  // Full speed, 10 ms
+    EXPECT_EQ(HidPollingAnalyzer::pollingPeriod(0, 1), 1000u);    // Low speed, clamped
+    EXPECT_EQ(HidPollingAnalyzer::pollingPeriod(4, 3), 1000u);    // High speed, 8 microframes
+    EXPECT_EQ(HidPollingAnalyzer::pollingPeriod(1, 4), 125u);     // SuperSpeed, every microframe
+}
+
+TEST(HidPollingAnalyzerTest, MeasuresRateJitterAndDrops) {
+    HidPollingAnalyzer analyzer;
+    analyzer.addEndpoint(3, 4, 0x81, 1000);     // 1000 Hz gaming mouse
+    
+    std::mt19937 rng(11);
+    std::normal_distribution<double> jitter(0.0, 40.0);
+    
+    // Two bursts of motion separated by an idle second; every tenth poll
+    // in a burst has no report
+    int64_t now = T0;
+    for (int burst = 0; burst < 2; burst++) {
+        for (int poll = 0; poll < 5000; poll++) {
+            now += 1000;
+            if (poll % 10 == 9) continue;
+            analyzer.process(report(now + static_cast<int64_t>(jitter(rng))));
+        }
+        now += 1000000;
+    }
+    
+    auto stats = analyzer.endpointStats(3, 4);
+    ASSERT_EQ(stats.size(), 1u);
+    const auto& ep = stats[0];
+    EXPECT_EQ(ep.reports, 9000u);
+    EXPECT_DOUBLE_EQ(ep.declaredRate, 1000.0);
+    EXPECT_NEAR(ep.measuredRate, 900.0, 10.0);
+    EXPECT_NEAR(ep.dropRatio, 0.10, 0.01);
+    EXPECT_NEAR(double(ep.droppedReports), 1000.0, 20.0);
+    EXPECT_NEAR(ep.jitterMean, 0.0, 5.0);
+    EXPECT_NEAR(ep.jitterStdDev, 40.0 * std::sqrt(2.0), 8.0);
+    EXPECT_LT(ep.jitterP99, 250u);
+    EXPECT_NEAR(double(ep.p50Interval), 1000.0, 250.0);
+}
+
+TEST(HidPollingAnalyzerTest, EstimatesPeriodWhenUndeclared) {
+    HidPollingAnalyzer analyzer;
+    analyzer.addEndpoint(3, 4, 0x82, 0);
+    
+    int64_t now = T0;
+    for (int i = 0; i < 500; i++) {
+        now += 8000;                            // 125 Hz keyboard
+        analyzer.process(report(now, 0x82));
+        analyzer.process(report(now, 0x83));    // Not registered
+    }
+    
+    auto stats = analyzer.endpointStats(3, 4);
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].declaredPeriod, 0u);
+    EXPECT_NEAR(double(stats[0].effectivePeriod), 8000.0, 2000.0);
+    EXPECT_NEAR(stats[0].measuredRate, 125.0, 1.0);
+    EXPECT_EQ(stats[0].droppedReports, 0u);
+    
+    analyzer.removeDevice(3, 4);
+    EXPECT_TRUE(analyzer.allStats().empty());
+}
@@ -0,0 +1,71 @@
+// tests/test_HotplugDebouncer.cpp
+#include <gtest/gtest.h>
+#include "../src/core/HotplugDebouncer.hpp"
+
+namespace usb_monitor {
+namespace testing {
+
+class HotplugDebouncerTest : public ::testing::Test {
+protected:
+    using Clock = HotplugDebouncer::Clock;
+
+    // The debouncer never dereferences devices, so any distinct address will do
+    libusb_device* fakeDevice(int n) {
+        return reinterpret_cast<libusb_device*>(&storage[n]);
+    }
+
+    HotplugDebouncer debouncer{std::chrono::milliseconds(100)};
+    std::vector<libusb_device*> displaced;
+    Clock::time_point start = Clock::now();
+    char storage[16]{};
+};
+
+TEST_F(HotplugDebouncerTest, SettlesAfterQuietWindow) {
+    EXPECT_TRUE(debouncer.recordEvent("1-2", fakeDevice(0), true, start, displaced));
+    
+    EXPECT_TRUE(debouncer.takeSettled(start + std::chrono::milliseconds(50)).empty());
+    
+    auto settled = debouncer.takeSettled(start + std::chrono::milliseconds(100));
+    ASSERT_EQ(settled.size(), 1u);
+    EXPECT_EQ(settled[0].arrived, fakeDevice(0));
+    EXPECT_EQ(settled[0].departed, nullptr);
+    EXPECT_FALSE(debouncer.hasPending());
+}
+
+TEST_F(HotplugDebouncerTest, QuickReenumerationCoalesces) {
+    debouncer.recordEvent("1-2", fakeDevice(0), false, start, displaced);
+    debouncer.recordEvent("1-2", fakeDevice(1), true, start + std::chrono::milliseconds(10), displaced);
+    
+    auto settled = debouncer.takeSettled(start + std::chrono::milliseconds(200));
+    ASSERT_EQ(settled.size(), 1u);
+    EXPECT_EQ(settled[0].departed, fakeDevice(0));
+    EXPECT_EQ(settled[0].arrived, fakeDevice(1));
+    EXPECT_EQ(settled[0].flaps, 1u);
+    EXPECT_TRUE(displaced.empty());
+}
+
+TEST_F(HotplugDebouncerTest, StormSettlesOnceWithFlapCount) {
+    // 10k alternating events at 10 kHz on one port
+    const int events = 10000;
+    for (int i = 0; i < events; i++) {
+        bool arrived = (i % 2) == 0;
+        debouncer.recordEvent("3-1.4", fakeDevice(i % 16), arrived,
+                              start + std::chrono::microseconds(i * 100), displaced);
+    }
+    
+    auto last = start + std::chrono::microseconds(events * 100);
+    EXPECT_TRUE(debouncer.takeSettled(last).empty());
+    
+    auto settled = debouncer.takeSettled(last + std::chrono::milliseconds(100));
+    ASSERT_EQ(settled.size(), 1u);
+    EXPECT_EQ(settled[0].arrived, nullptr); // Ended with a leave
+    EXPECT_EQ(settled[0].flaps, static_cast<uint32_t>(events - 1));
+    
+    auto health = debouncer.portHealth();
+    ASSERT_EQ(health.size(), 1u);
+    EXPECT_EQ(health[0].eventCount, static_cast<uint64_t>(events));
+    EXPECT_EQ(health[0].flapCount, static_cast<uint64_t>(events - 1));
+}
+
+} // namespace testing
+} // namespace usb_monitor
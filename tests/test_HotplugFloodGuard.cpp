@@ -0,0 +1,109 @@
+// tests/test_HotplugFloodGuard.cpp
+#include <gtest/gtest.h>
+#include "../src/security/HotplugFloodGuard.hpp"
+#include <string>
+
+namespace usb_monitor {
+namespace testing {
+
+class HotplugFloodGuardTest : public ::testing::Test {
+protected:
+    using Clock = HotplugFloodGuard::Clock;
+
+    Clock::time_point at(double seconds) {
+        return start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    HotplugFloodGuard guard;
+    Clock::time_point start = Clock::now();
+};
+
+TEST_F(HotplugFloodGuardTest, OrdinaryReplugsPass) {
+    // A device plugged in and out every few seconds, and a dock's worth of
+    // other ports each seeing a device or two
+    for (int i = 0; i < 30; i++) {
+        auto decision = guard.recordArrival("1-2", 0xAAAA, at(i * 3.0));
+        EXPECT_FALSE(decision.blocked);
+        EXPECT_TRUE(decision.log);
+    }
+    for (int port = 0; port < 200; port++) {
+        for (int i = 0; i < 3; i++) {
+            auto path = "3-" + std::to_string(port);
+            EXPECT_FALSE(guard.recordArrival(path, 0x1000 + i, at(100 + port * 0.04 + i)).blocked);
+        }
+    }
+    EXPECT_TRUE(guard.blockedPorts(at(200)).empty());
+}
+
+TEST_F(HotplugFloodGuardTest, BlocksArrivalFloodAndDescriptorChurn) {
+    FloodDecision decision;
+    int arrivals = 0;
+    while (!decision.blocked) {
+        decision = guard.recordArrival("1-4", 0xBEEF, at(arrivals++ * 0.2));
+    }
+    EXPECT_TRUE(decision.newlyBlocked);
+    EXPECT_TRUE(decision.log);
+    EXPECT_EQ(arrivals, HOTPLUG_FLOOD_ARRIVALS + 1);
+    EXPECT_TRUE(guard.isBlocked("1-4", at(10)));
+    EXPECT_FALSE(guard.isBlocked("1-5", at(10)));
+
+    // Still blocked while it keeps coming, and no longer logged
+    decision = guard.recordArrival("1-4", 0xBEEF, at(11));
+    EXPECT_TRUE(decision.blocked);
+    EXPECT_FALSE(decision.newlyBlocked);
+    EXPECT_FALSE(decision.log);
+
+    // The block expires, then the port can be used again
+    EXPECT_FALSE(guard.isBlocked("1-4", at(5 + HOTPLUG_FLOOD_BLOCK)));
+    decision = guard.recordArrival("1-4", 0xBEEF, at(10 + HOTPLUG_FLOOD_BLOCK));
+    EXPECT_FALSE(decision.blocked);
+    EXPECT_EQ(decision.suppressed, 1u);
+
+    // A device posing as something new on every arrival trips much sooner
+    for (int i = 0; i <= HOTPLUG_FLOOD_DESCRIPTOR_CHANGES; i++) {
+        decision = guard.recordArrival("2-1", 0x5000 + i, at(1000 + i));
+        EXPECT_EQ(decision.descriptorChanged, i > 0);
+        EXPECT_FALSE(decision.blocked);
+    }
+    decision = guard.recordArrival("2-1", 0x6000, at(1006));
+    EXPECT_TRUE(decision.newlyBlocked);
+    EXPECT_EQ(decision.descriptorChanges, uint32_t(HOTPLUG_FLOOD_DESCRIPTOR_CHANGES + 1));
+
+    guard.unblock("2-1");
+    EXPECT_FALSE(guard.isBlocked("2-1", at(1007)));
+
+    // Coalesced flaps count in bulk
+    EXPECT_TRUE(guard.recordArrival("2-2", 0, at(2000), 50).newlyBlocked);
+}
+
+// 10k arrivals a second for ten seconds: a flooding port among quiet ones
+TEST_F(HotplugFloodGuardTest, StressFloodStaysBounded) {
+    constexpr int RATE = 10000;
+    constexpr int SECONDS = 10;
+    uint64_t logged = 0;
+    uint64_t blocks = 0;
+    uint64_t quietBlocked = 0;
+
+    for (int i = 0; i < RATE * SECONDS; i++) {
+        auto now = at(double(i) / RATE);
+        FloodDecision decision;
+        if (i % 1000 == 0) {
+            decision = guard.recordArrival("4-" + std::to_string(i / 1000 % 50), 0x77, now);
+            if (decision.blocked) quietBlocked++;
+        } else {
+            // The attacker changes its descriptors on every arrival
+            decision = guard.recordArrival("1-1.3", 0x100000 + i, now);
+        }
+        if (decision.log) logged++;
+        if (decision.newlyBlocked) blocks++;
+    }
+
+    EXPECT_EQ(blocks, 1u);
+    EXPECT_EQ(quietBlocked, 0u);
+    EXPECT_EQ(guard.blockedPorts(at(SECONDS)), std::vector<std::string>{"1-1.3"});
+    EXPECT_LE(logged, uint64_t(HOTPLUG_FLOOD_LOG_RATE) * (SECONDS + 1) + 1);
+    EXPECT_GE(guard.arrivalEstimate("1-1.3", at(SECONDS)), uint32_t(RATE * HOTPLUG_FLOOD_WINDOW * 0.9));
+}
+
+} // namespace testing
+} // namespace usb_monitor
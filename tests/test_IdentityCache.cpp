@@ -0,0 +1,84 @@
+// tests/test_IdentityCache.cpp
+#include <gtest/gtest.h>
+#include "../src/core/IdentityCache.hpp"
+
+namespace usb_monitor {
+namespace testing {
+
+class IdentityCacheTest : public ::testing::Test {
+protected:
+    using Clock = IdentityCache::Clock;
+
+    // The cache never dereferences devices, so any distinct address will do
+    std::shared_ptr<UsbDevice> fakeDevice(int n) {
+        return std::shared_ptr<UsbDevice>(std::shared_ptr<void>(),
+                                          reinterpret_cast<UsbDevice*>(&storage[n]));
+    }
+
+    IdentityCache cache{std::chrono::seconds(600), 4};
+    Clock::time_point start = Clock::now();
+    char storage[16]{};
+};
+
+TEST_F(IdentityCacheTest, ReplugGetsTheSameDeviceBack) {
+    EXPECT_TRUE(cache.retain("1-2|A1|00ff", fakeDevice(0), start).empty());
+    EXPECT_EQ(cache.size(), 1u);
+    
+    // Another unit of the same model, or the same one with new firmware
+    EXPECT_EQ(cache.take("1-2|B7|00ff"), nullptr);
+    EXPECT_EQ(cache.take("1-2|A1|0100"), nullptr);
+    
+    EXPECT_EQ(cache.take("1-2|A1|00ff"), fakeDevice(0));
+    EXPECT_EQ(cache.size(), 0u);
+    
+    // Handed back once; the next re-plug needs the device to leave again
+    EXPECT_EQ(cache.take("1-2|A1|00ff"), nullptr);
+}
+
+TEST_F(IdentityCacheTest, IdentitiesExpireAfterRetention) {
+    cache.retain("1-1|A|01", fakeDevice(0), start);
+    cache.retain("1-2|B|02", fakeDevice(1), start + std::chrono::seconds(300));
+    
+    EXPECT_TRUE(cache.prune(start + std::chrono::seconds(600)).empty());
+    
+    auto expired = cache.prune(start + std::chrono::seconds(601));
+    ASSERT_EQ(expired.size(), 1u);
+    EXPECT_EQ(expired[0], fakeDevice(0));
+    EXPECT_EQ(cache.take("1-1|A|01"), nullptr);
+    EXPECT_EQ(cache.take("1-2|B|02"), fakeDevice(1));
+}
+
+TEST_F(IdentityCacheTest, EvictsOldestPastCapacity) {
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(cache.retain("port" + std::to_string(i), fakeDevice(i),
+                                 start + std::chrono::seconds(i)).empty());
+    }
+    
+    auto evicted = cache.retain("port4", fakeDevice(4), start + std::chrono::seconds(4));
+    ASSERT_EQ(evicted.size(), 1u);
+    EXPECT_EQ(evicted[0], fakeDevice(0));
+    EXPECT_EQ(cache.size(), 4u);
+    EXPECT_EQ(cache.take("port1"), fakeDevice(1));
+}
+
+TEST_F(IdentityCacheTest, NewerDepartureReplacesStaleEntry) {
+    cache.retain("1-2|A1|00ff", fakeDevice(0), start);
+    
+    // Same identity left again as a different object; the old one's
+    // history must be released by the caller
+    auto replaced = cache.retain("1-2|A1|00ff", fakeDevice(1), start + std::chrono::seconds(1));
+    ASSERT_EQ(replaced.size(), 1u);
+    EXPECT_EQ(replaced[0], fakeDevice(0));
+    EXPECT_EQ(cache.take("1-2|A1|00ff"), fakeDevice(1));
+}
+
+TEST_F(IdentityCacheTest, TakeAllEmptiesTheCache) {
+    cache.retain("a", fakeDevice(0), start);
+    cache.retain("b", fakeDevice(1), start);
+    
+    EXPECT_EQ(cache.takeAll().size(), 2u);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+} // namespace testing
+} // namespace usb_monitor
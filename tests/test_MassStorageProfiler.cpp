@@ -0,0 +1,239 @@
+// tests/test_MassStorageProfiler.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/MassStorageProfiler.hpp"
+#include <vector>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+// Emits the usbmon events an f_mass_storage gadget produces for one
+// command: CBW submission, optional data-in, CSW completion
+class BotHost {
+public:
+    explicit BotHost(MassStorageProfiler& profiler) : profiler(profiler) {}
+    
+    int64_t now{T0};
+    
+    void command(const std::vector<uint8_t>& cdb, uint32_t dataLength, int64_t latency,
+                 uint8_t status = 0, const std::vector<uint8_t>& dataIn = {}) {
+        uint32_t tag = ++lastTag;
+        std::vector<uint8_t> cbw(31, 0);
+        put32(cbw.data(), 0x43425355);
+        put32(cbw.data() + 4, tag);
+        put32(cbw.data() + 8, dataLength);
+        cbw[14] = static_cast<uint8_t>(cdb.size());
+        std::copy(cdb.begin(), cdb.end(), cbw.begin() + 15);
+        profiler.process(event('S', 0x02, cbw));
+        
+        if (!dataIn.empty()) {
+            now += latency / 2;
+            profiler.process(event('C', 0x81, dataIn));
+            latency -= latency / 2;
+        }
+        
+        now += latency;
+        std::vector<uint8_t> csw(13, 0);
+        put32(csw.data(), 0x53425355);
+        put32(csw.data() + 4, tag);
+        csw[12] = status;
+        profiler.process(event('C', 0x81, csw));
+        now += 50;
+    }
+    
+    void rw(uint8_t opcode, uint32_t lba, uint16_t blocks, int64_t latency) {
+        command({opcode, 0, uint8_t(lba >> 24), uint8_t(lba >> 16), uint8_t(lba >> 8), uint8_t(lba),
+                 0, uint8_t(blocks >> 8), uint8_t(blocks), 0}, blocks * 512u, latency);
+    }
+
+    void rw16(uint8_t opcode, uint64_t lba, uint32_t blocks, int64_t latency) {
+        std::vector<uint8_t> cdb(16, 0);
+        cdb[0] = opcode;
+        for (int i = 0; i < 8; i++) cdb[2 + i] = uint8_t(lba >> (56 - 8 * i));
+        for (int i = 0; i < 4; i++) cdb[10 + i] = uint8_t(blocks >> (24 - 8 * i));
+        command(cdb, blocks * 512u, latency);
+    }
+    
+private:
+    static void put32(uint8_t* p, uint32_t v) {
+        for (int i = 0; i < 4; i++) p[i] = uint8_t(v >> (8 * i));
+    }
+    
+    UrbEvent event(char type, uint8_t endpoint, const std::vector<uint8_t>& payload) {
+        auto event = urbEvent(type, LIBUSB_TRANSFER_TYPE_BULK, 1, 7, endpoint, now,
+                              static_cast<uint32_t>(payload.size()));
+        event.id = 0xffff888000001000ull;
+        event.data = payload.data();
+        event.capturedLength = event.length;
+        return event;
+    }
+    
+    MassStorageProfiler& profiler;
+    uint32_t lastTag{0};
+};
+
+const ScsiCommandStats* find(const MassStorageProfile& profile, uint8_t opcode) {
+    for (const auto& command : profile.commands) {
+        if (command.opcode == opcode) return &command;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+TEST(MassStorageProfilerTest, ProfilesCommandsAndCapacity) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    host.command({0x00, 0, 0, 0, 0, 0}, 0, 150);
+    // 1 GiB medium: last LBA 0x1FFFFF, 512-byte blocks
+    host.command({0x25, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 8, 400,
+                 0, {0x00, 0x1F, 0xFF, 0xFF, 0x00, 0x00, 0x02, 0x00});
+    for (uint32_t i = 0; i < 100; i++) {
+        host.rw(0x28, i * 128, 128, 2000);          // 64 KiB reads at the start
+        host.rw(0x2A, 0x100000 + i * 128, 128, 4000);  // writes in the middle
+    }
+    host.command({0x35, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, 20000, 1);
+    
+    ASSERT_TRUE(profiler.isMassStorage(1, 7));
+    auto profile = profiler.profile(1, 7);
+    EXPECT_EQ(profile.capacityBlocks, 0x200000u);
+    EXPECT_EQ(profile.blockSize, 512u);
+    
+    auto* reads = find(profile, 0x28);
+    ASSERT_NE(reads, nullptr);
+    EXPECT_EQ(reads->name, "READ(10)");
+    EXPECT_EQ(reads->count, 100u);
+    EXPECT_EQ(reads->bytes, 100u * 65536);
+    EXPECT_DOUBLE_EQ(reads->meanLatency, 2000.0);
+    EXPECT_NEAR(reads->throughput, 65536 / 0.002, 1.0);
+    
+    auto* writes = find(profile, 0x2A);
+    ASSERT_NE(writes, nullptr);
+    EXPECT_NEAR(writes->throughput, 65536 / 0.004, 1.0);
+    EXPECT_EQ(profile.write.bytes, 100u * 65536);
+    
+    auto* sync = find(profile, 0x35);
+    ASSERT_NE(sync, nullptr);
+    EXPECT_EQ(sync->failed, 1u);
+    
+    EXPECT_EQ(profile.queueDepth, 0u);
+    EXPECT_EQ(profile.peakQueueDepth, 1u);
+    EXPECT_GT(profile.averageQueueDepth, 0.9);
+    
+    // The heatmap spans the medium: reads hit the first bucket, writes the middle
+    ASSERT_EQ(profile.readHeat.size(), size_t(MSC_HEATMAP_BUCKETS));
+    EXPECT_GE(profile.blocksPerBucket * MSC_HEATMAP_BUCKETS, profile.capacityBlocks);
+    ASSERT_EQ(profile.blocksPerBucket, 8192u);
+    EXPECT_EQ(profile.readHeat[0], 8192u);
+    EXPECT_EQ(profile.readHeat[1], 12800u - 8192);
+    EXPECT_EQ(profile.writeHeat[128], 8192u);
+    EXPECT_EQ(profile.writeHeat[129], 12800u - 8192);
+    uint64_t heat = 0;
+    for (auto blocks : profile.writeHeat) heat += blocks;
+    EXPECT_EQ(heat, 12800u);
+}
+
+TEST(MassStorageProfilerTest, HeatmapGrowsWithoutCapacity) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    host.rw(0x28, 0, 8, 100);
+    host.rw(0x28, 1000000, 8, 100);
+    
+    auto profile = profiler.profile(1, 7);
+    EXPECT_EQ(profile.capacityBlocks, 0u);
+    EXPECT_GE(profile.blocksPerBucket * MSC_HEATMAP_BUCKETS, 1000008u);
+    EXPECT_EQ(profile.readHeat[0], 8u);
+    EXPECT_EQ(profile.readHeat[1000000 / profile.blocksPerBucket], 8u);
+}
+
+TEST(MassStorageProfilerTest, DetectsWriteThrottling) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    // 30 MB/s while the cache absorbs writes, then 8 MB/s
+    uint32_t lba = 0;
+    for (int i = 0; i < 50; i++, lba += 256) {
+        host.rw(0x2A, lba, 256, 4370);
+    }
+    EXPECT_FALSE(profiler.profile(1, 7).write.throttled);
+    
+    for (int i = 0; i < 20; i++, lba += 256) {
+        host.rw(0x2A, lba, 256, 16384);
+    }
+    auto write = profiler.profile(1, 7).write;
+    EXPECT_TRUE(write.throttled);
+    EXPECT_NEAR(write.bestCommandRate, 30e6, 1e6);
+    EXPECT_LT(write.commandRate, 9e6);
+}
+
+TEST(MassStorageProfilerTest, IgnoresOtherBulkTraffic) {
+    MassStorageProfiler profiler;
+    
+    std::vector<uint8_t> payload(31, 0xAB);
+    auto event = urbEvent('S', LIBUSB_TRANSFER_TYPE_BULK, 1, 9, 0x02, T0, 31);
+    event.data = payload.data();
+    event.capturedLength = 31;
+    profiler.process(event);
+    
+    EXPECT_FALSE(profiler.isMassStorage(1, 9));
+    EXPECT_TRUE(profiler.allProfiles().empty());
+}
+
+// Ranges near 2^64 used to wrap the bucket arithmetic and spin forever
+TEST(MassStorageProfilerTest, HeatmapHandlesLbasNearTheTop) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    host.rw16(0x88, UINT64_MAX - 15, 8, 100);
+    auto profile = profiler.profile(1, 7);
+    EXPECT_EQ(profile.blocksPerBucket, uint64_t(1) << 56);
+    EXPECT_EQ(profile.readHeat[MSC_HEATMAP_BUCKETS - 1], 8u);
+    
+    // lba + blocks wraps: counted as a command, left off the heatmap
+    host.rw16(0x8A, UINT64_MAX - 3, 8, 100);
+    profile = profiler.profile(1, 7);
+    ASSERT_NE(find(profile, 0x8A), nullptr);
+    EXPECT_EQ(find(profile, 0x8A)->count, 1u);
+    uint64_t heat = 0;
+    for (auto blocks : profile.writeHeat) heat += blocks;
+    EXPECT_EQ(heat, 0u);
+}
+
+TEST(MassStorageProfilerTest, HeatmapStopsAtCapacity) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    // READ CAPACITY(16): last LBA 0x1FFFFF, 512-byte blocks
+    host.command({0x9E, 0x10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 32, 0, 0}, 32, 400, 0,
+                 {0, 0, 0, 0, 0x00, 0x1F, 0xFF, 0xFF, 0x00, 0x00, 0x02, 0x00});
+    auto profile = profiler.profile(1, 7);
+    ASSERT_EQ(profile.capacityBlocks, 0x200000u);
+    ASSERT_EQ(profile.blocksPerBucket, 8192u);
+    
+    host.rw16(0x88, uint64_t(1) << 63, 8, 100);
+    host.rw16(0x88, 0x1FFFFC, 8, 100);
+    profile = profiler.profile(1, 7);
+    EXPECT_EQ(profile.blocksPerBucket, 8192u);
+    EXPECT_EQ(profile.readHeat[MSC_HEATMAP_BUCKETS - 1], 4u);
+}
+
+// Opcode 0x9E is SERVICE ACTION IN(16); only service action 0x10 reads
+// the capacity
+TEST(MassStorageProfilerTest, OtherServiceActionsLeaveCapacity) {
+    MassStorageProfiler profiler;
+    BotHost host(profiler);
+    
+    // GET LBA STATUS: an LBA status descriptor, not a capacity
+    host.command({0x9E, 0x12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 24, 0, 0}, 24, 400, 0,
+                 {0, 0, 0, 0x14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10, 0, 0, 0, 0, 0x08, 0, 0, 0, 0});
+    auto profile = profiler.profile(1, 7);
+    EXPECT_EQ(profile.capacityBlocks, 0u);
+    EXPECT_EQ(profile.blockSize, 512u);
+    EXPECT_EQ(profile.blocksPerBucket, 1u);
+    ASSERT_NE(find(profile, 0x9E), nullptr);
+    EXPECT_EQ(find(profile, 0x9E)->name, "SERVICE ACTION IN(16)");
+}
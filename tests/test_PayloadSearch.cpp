@@ -0,0 +1,181 @@
+// tests/test_PayloadSearch.cpp
+#include <gtest/gtest.h>
+#include "../src/capture/PayloadSearch.hpp"
+#include "../src/capture/CaptureStore.hpp"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <tuple>
+
+using namespace usb_monitor;
+
+namespace {
+
+struct Stored {
+    CaptureTag tag;
+    std::vector<uint8_t> bytes;
+};
+
+// First offset of each pattern, the slow way
+std::vector<PayloadMatch> bruteForce(const std::map<uint64_t, Stored>& records, const PayloadQuery& query) {
+    std::vector<PayloadMatch> matches;
+    for (const auto& [handle, record] : records) {
+        const auto& tag = record.tag;
+        if (tag.timestamp < query.from || tag.timestamp > query.until) continue;
+        if (query.device && tag.device != *query.device) continue;
+        if (query.endpoint && tag.endpoint != *query.endpoint) continue;
+
+        for (size_t p = 0; p < query.patterns.size(); p++) {
+            const auto& pattern = query.patterns[p];
+            auto it = std::search(record.bytes.begin(), record.bytes.end(), pattern.begin(), pattern.end());
+            if (it == record.bytes.end()) continue;
+            matches.push_back(PayloadMatch{handle, tag.timestamp, tag.device, tag.endpoint,
+                                           uint16_t(p), uint16_t(it - record.bytes.begin())});
+        }
+    }
+    return matches;
+}
+
+using Key = std::tuple<uint64_t, uint16_t, uint16_t>;
+
+std::vector<Key> keys(const std::vector<PayloadMatch>& matches) {
+    std::vector<Key> result;
+    for (const auto& match : matches) result.emplace_back(match.handle, match.pattern, match.offset);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+} // namespace
+
+TEST(PayloadSearchTest, MatchesBruteForceAtEveryOffset) {
+    CaptureStore store;
+    std::mt19937 rng(7);
+
+    // A four-letter alphabet makes partial matches common, and lengths
+    // around 16 put matches across the SIMD chunk edges
+    std::map<uint64_t, Stored> records;
+    for (int i = 0; i < 30000; i++) {
+        std::vector<uint8_t> bytes(rng() % 80);
+        for (auto& byte : bytes) byte = "ACGT"[rng() % 4];
+        CaptureTag tag{1000000 + i * 125, uint16_t((1 << 8) | (2 + i % 3)), uint8_t(0x81 + i % 2)};
+        uint64_t handle = store.append(uint8_t(i % 2 ? 0x03 : 0x08), bytes.data(), bytes.size(), tag);
+        records[handle] = Stored{tag, std::move(bytes)};
+    }
+
+    PayloadSearch search(store, 4);
+    PayloadQuery query;
+    query.patterns = {{'G'}, {'A', 'T'}, {'G', 'A', 'T', 'T', 'A', 'C', 'A'},
+                      std::vector<uint8_t>(20, 'C'), {'T', 'T', 'T', 'T', 'T', 'G', 'A', 'A', 'C', 'G'}};
+    query.maxMatches = SIZE_MAX;
+
+    auto result = search.find(query);
+    EXPECT_FALSE(result.truncated);
+    EXPECT_EQ(result.recordsScanned, 30000u);
+    EXPECT_EQ(keys(result.matches), keys(bruteForce(records, query)));
+    EXPECT_TRUE(std::is_sorted(result.matches.begin(), result.matches.end(),
+                               [](const auto& a, const auto& b) { return a.timestamp < b.timestamp; }));
+
+    query.device = uint16_t((1 << 8) | 3);
+    query.endpoint = 0x82;
+    query.from = 1000000 + 10000 * 125;
+    query.until = 1000000 + 12000 * 125;
+    result = search.find(query);
+    EXPECT_FALSE(result.matches.empty());
+    EXPECT_EQ(keys(result.matches), keys(bruteForce(records, query)));
+}
+
+TEST(PayloadSearchTest, SkipsBlocksByTimeAndEndpoint) {
+    CaptureStore store;
+    const std::vector<uint8_t> magic{'U', 'S', 'B', 'S'};
+
+    // Two devices in separate classes, so each block holds one of them
+    for (int i = 0; i < 40000; i++) {
+        std::vector<uint8_t> bytes(13, uint8_t(i));
+        if (i % 100 == 0) std::copy(magic.begin(), magic.end(), bytes.begin() + 9);
+        bool storage = i % 2 == 0;
+        CaptureTag tag{int64_t(i) * 1000, uint16_t(storage ? 0x0105 : 0x0106), uint8_t(storage ? 0x81 : 0x83)};
+        store.append(storage ? 0x08 : 0x03, bytes.data(), bytes.size(), tag);
+    }
+    store.flush();
+
+    PayloadSearch search(store);
+    PayloadQuery query;
+    query.patterns = {magic};
+    auto all = search.find(query);
+    EXPECT_EQ(all.matches.size(), 400u);
+    EXPECT_EQ(all.blocksSkipped, 0u);
+    ASSERT_FALSE(all.matches.empty());
+    EXPECT_EQ(all.matches.front().offset, 9);
+    EXPECT_EQ(store.read(all.matches.front().handle)->at(9), 'U');
+
+    query.device = 0x0106;
+    auto device = search.find(query);
+    EXPECT_TRUE(device.matches.empty());        // Magic only lands on even records
+    EXPECT_GT(device.blocksSkipped, 0u);
+
+    query.device = 0x0105;
+    query.from = 30000000;
+    auto late = search.find(query);
+    EXPECT_EQ(late.matches.size(), 100u);
+    EXPECT_GT(late.blocksSkipped, all.blocksSkipped);
+    EXPECT_LT(late.blocksScanned, all.blocksScanned);
+}
+
+TEST(PayloadSearchTest, StopsAtMaxMatches) {
+    CaptureStore store;
+    for (int i = 0; i < 50000; i++) {
+        std::vector<uint8_t> bytes{0x55, 0x53, 0x42, 0x43, uint8_t(i)};
+        store.append(0x08, bytes.data(), bytes.size(), CaptureTag{i, 0x0102, 0x02});
+    }
+
+    PayloadSearch search(store, 2);
+    PayloadQuery query;
+    query.patterns = {{0x55, 0x53, 0x42, 0x43}, {}};
+    query.maxMatches = 100;
+    auto result = search.find(query);
+    EXPECT_TRUE(result.truncated);
+    EXPECT_EQ(result.matches.size(), 100u);
+    EXPECT_LT(result.recordsScanned, 50000u);
+
+    query.patterns = {{}};
+    EXPECT_TRUE(search.find(query).matches.empty());
+}
+
+TEST(PayloadSearchTest, TruncatedResultIsTheEarliestMatches) {
+    CaptureStore store;
+    std::mt19937 rng(11);
+
+    // Two classes fill blocks side by side, and timestamps jitter within
+    // each block, so neither block order nor record order is capture time
+    std::map<uint64_t, Stored> records;
+    for (int i = 0; i < 40000; i++) {
+        std::vector<uint8_t> bytes(8 + rng() % 24);
+        for (auto& byte : bytes) byte = "ACGT"[rng() % 4];
+        CaptureTag tag{1000000 + i * 100 + int64_t(rng() % 5000), 0x0102, 0x81};
+        uint64_t handle = store.append(uint8_t(i % 3 ? 0x03 : 0x08), bytes.data(), bytes.size(), tag);
+        records[handle] = Stored{tag, std::move(bytes)};
+    }
+
+    PayloadQuery query;
+    query.patterns = {{'G', 'A', 'T'}, {'C', 'C', 'C'}};
+    query.maxMatches = 250;
+
+    auto expected = bruteForce(records, query);
+    ASSERT_GT(expected.size(), query.maxMatches);
+    std::sort(expected.begin(), expected.end(), [](const PayloadMatch& a, const PayloadMatch& b) {
+        return std::tie(a.timestamp, a.handle, a.pattern) < std::tie(b.timestamp, b.handle, b.pattern);
+    });
+    expected.resize(query.maxMatches);
+
+    PayloadSearch search(store, 4);
+    for (int run = 0; run < 5; run++) {
+        auto result = search.find(query);
+        EXPECT_TRUE(result.truncated);
+        ASSERT_EQ(result.matches.size(), query.maxMatches);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(result.matches[i].handle, expected[i].handle);
+            EXPECT_EQ(result.matches[i].pattern, expected[i].pattern);
+        }
+        EXPECT_LT(result.recordsScanned, 40000u);
+    }
+}
@@ -0,0 +1,117 @@
+// tests/test_PeriodicityDetector.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/PeriodicityDetector.hpp"
+#include <random>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+UrbEvent completion(int64_t timestamp, uint8_t endpoint, uint32_t length = 8) {
+    return urbEvent('C', LIBUSB_TRANSFER_TYPE_INTERRUPT, 2, 7, endpoint, timestamp, length);
+}
+
+// A detector watching the given endpoints of device 2/7
+PeriodicityDetector watching(std::initializer_list<uint8_t> endpoints) {
+    PeriodicityDetector detector;
+    for (uint8_t endpoint : endpoints) {
+        detector.addEndpoint(2, 7, endpoint);
+    }
+    return detector;
+}
+
+} // namespace
+
+TEST(PeriodicityDetectorTest, FindsPollingPeriods) {
+    auto detector = watching({0x81, 0x82});
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> jitter(-40, 40);
+    
+    // A 1 kHz mouse on 0x81, and a high-speed endpoint answering every
+    // microframe on 0x82, mostly with nothing to say
+    for (int64_t t = 0; t < 3000000; t += 125) {
+        if (t % 1000 == 0) detector.process(completion(T0 + t + jitter(rng), 0x81));
+        detector.process(completion(T0 + t, 0x82, t % 8000 == 0 ? 64 : 0));
+    }
+    
+    auto periods = detector.periods(2, 7);
+    ASSERT_EQ(periods.size(), 2u);
+    
+    EXPECT_EQ(periods[0].endpoint, 0x81);
+    EXPECT_NEAR(periods[0].period, 1000.0, 10.0);
+    EXPECT_GT(periods[0].strength, 0.5);
+    EXPECT_FALSE(periods[0].bursty);
+    EXPECT_NEAR(periods[0].eventRate, 1000.0, 30.0);
+    
+    EXPECT_EQ(periods[1].endpoint, 0x82);
+    EXPECT_NEAR(periods[1].period, 125.0, 2.0);
+    EXPECT_NEAR(periods[1].emptyFraction, 63.0 / 64, 0.01);
+}
+
+TEST(PeriodicityDetectorTest, FindsBurstPeriod) {
+    auto detector = watching({0x83});
+    
+    // Five transfers 100 us apart every 20 ms
+    for (int64_t burst = 0; burst < 150; burst++) {
+        for (int i = 0; i < 5; i++) {
+            detector.process(completion(T0 + burst * 20000 + i * 100, 0x83, 512));
+        }
+    }
+    
+    auto periods = detector.periods(2, 7);
+    ASSERT_EQ(periods.size(), 1u);
+    EXPECT_NEAR(periods[0].period, 20000.0, 250.0);
+    EXPECT_TRUE(periods[0].bursty);
+    EXPECT_NEAR(periods[0].eventsPerBurst, 5.0, 0.5);
+}
+
+TEST(PeriodicityDetectorTest, IgnoresRandomAndStoppedTraffic) {
+    auto detector = watching({0x81, 0x84, 0x85});
+    std::mt19937 rng(9);
+    std::exponential_distribution<double> gap(1.0 / 3000);
+    
+    // Poisson arrivals have no period
+    double t = 0;
+    while (t < 3000000) {
+        t += gap(rng);
+        detector.process(completion(T0 + int64_t(t), 0x81));
+    }
+    EXPECT_TRUE(detector.periods(2, 7).empty());
+    
+    // A periodic endpoint that falls silent is dropped once its last
+    // window is old
+    for (int64_t s = 0; s < 2000000; s += 4000) {
+        detector.process(completion(T0 + 3000000 + s, 0x84));
+    }
+    EXPECT_EQ(detector.periods(2, 7).size(), 1u);
+    for (int64_t s = 0; s < 3000000; s += 50000) {
+        detector.process(completion(T0 + 5000000 + s, 0x85, 0));
+    }
+    for (const auto& period : detector.periods(2, 7)) {
+        EXPECT_NE(period.endpoint, 0x84);
+    }
+    
+    detector.removeDevice(2, 7);
+    EXPECT_TRUE(detector.periods(2, 7).empty());
+}
+
+TEST(PeriodicityDetectorTest, IgnoresUnregisteredEndpoints) {
+    auto detector = watching({0x81});
+    
+    // The same 1 kHz polling on a registered and an unregistered endpoint,
+    // and on another device entirely
+    for (int64_t t = 0; t < 3000000; t += 1000) {
+        detector.process(completion(T0 + t, 0x81));
+        detector.process(completion(T0 + t, 0x82));
+        auto other = completion(T0 + t, 0x81);
+        other.deviceAddress = 8;
+        detector.process(other);
+    }
+    
+    auto periods = detector.periods(2, 7);
+    ASSERT_EQ(periods.size(), 1u);
+    EXPECT_EQ(periods[0].endpoint, 0x81);
+    EXPECT_TRUE(detector.periods(2, 8).empty());
+}
@@ -0,0 +1,297 @@
+// tests/test_PolicySimulator.cpp
+#include <gtest/gtest.h>
+#include "../src/security/PolicySimulator.hpp"
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace usb_monitor {
+namespace testing {
+
+class PolicySimulatorTest : public ::testing::Test {
+protected:
+    using Clock = std::chrono::system_clock;
+
+    static SecurityRule rule(uint16_t vendorId, uint16_t productId, bool whitelisted = true,
+                             std::vector<std::string> interfaces = {}) {
+        SecurityRule result{};
+        result.vendorId = vendorId;
+        result.productId = productId;
+        result.isWhitelisted = whitelisted;
+        result.allowedInterfaces = std::move(interfaces);
+        return result;
+    }
+
+    static DeviceArrivalRecord arrival(uint16_t vendorId, uint16_t productId,
+                                       std::initializer_list<int> classes, Clock::time_point when = {}) {
+        DeviceArrivalRecord result;
+        result.timestamp = when;
+        result.vendorId = vendorId;
+        result.productId = productId;
+        for (int c : classes) result.interfaceClasses.set(c);
+        return result;
+    }
+
+    // Random history over a small device population, so rules hit often
+    static std::vector<DeviceArrivalRecord> history(size_t count, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<DeviceArrivalRecord> result;
+        result.reserve(count);
+        auto start = Clock::now() - std::chrono::hours(24 * 30);
+        for (size_t i = 0; i < count; i++) {
+            auto device = rng() % 64;
+            auto record = arrival(uint16_t(0x1000 + device % 16), uint16_t(device), {},
+                                  start + std::chrono::seconds(i * 2));
+            record.interfaceClasses.set(device % 4 == 0 ? 0x08 : 0x03);
+            if (device % 7 == 0) record.interfaceClasses.set(0xFF);
+            result.push_back(std::move(record));
+        }
+        return result;
+    }
+
+    static std::vector<SecurityRule> rules(uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<SecurityRule> result;
+        for (int device = 0; device < 64; device++) {
+            if (rng() % 3 == 0) continue;
+            std::vector<std::string> interfaces;
+            if (rng() % 2) interfaces = {"0x03", "0x08"};
+            auto r = rule(uint16_t(0x1000 + device % 16), uint16_t(device), rng() % 5 != 0, interfaces);
+            r.requireAuthorization = rng() % 4 == 0;
+            if (rng() % 6 == 0) r.expiryDate = Clock::now() - std::chrono::hours(24 * 15);
+            result.push_back(r);
+        }
+        return result;
+    }
+};
+
+TEST_F(PolicySimulatorTest, IndexMatchesManagerSemantics) {
+    auto expired = rule(0x3333, 0x0001);
+    expired.expiryDate = Clock::now() - std::chrono::hours(1);
+    auto gated = rule(0x4444, 0x0001);
+    gated.requireAuthorization = true;
+    PolicyIndex index({rule(0x1111, 0x0001, true, {"0x08"}),
+                       rule(0x1111, 0x0001, false),     // Shadowed, first rule wins
+                       rule(0x2222, 0x0001, false),
+                       expired, gated,
+                       rule(0x5555, 0x0001)});
+
+    EXPECT_EQ(index.evaluate(arrival(0x1111, 0x0001, {0x08})).verdict, PolicyVerdict::Allow);
+    EXPECT_EQ(index.evaluate(arrival(0x1111, 0x0001, {0x08})).rule, 0);
+    EXPECT_EQ(index.evaluate(arrival(0x1111, 0x0001, {0x08, 0x03})).verdict, PolicyVerdict::InterfaceNotAllowed);
+    EXPECT_EQ(index.evaluate(arrival(0x2222, 0x0001, {})).verdict, PolicyVerdict::NotWhitelisted);
+    EXPECT_EQ(index.evaluate(arrival(0x9999, 0x0001, {})).rule, -1);
+
+    // Expiry is judged at the time of the arrival, not now
+    EXPECT_EQ(index.evaluate(arrival(0x3333, 0x0001, {}, Clock::now())).verdict, PolicyVerdict::Expired);
+    EXPECT_EQ(index.evaluate(arrival(0x3333, 0x0001, {}, Clock::now() - std::chrono::hours(2))).verdict,
+              PolicyVerdict::Allow);
+    EXPECT_EQ(index.evaluate(arrival(0x4444, 0x0001, {})).verdict, PolicyVerdict::AllowAfterAuthorization);
+
+    // No interface list allows every class
+    auto everything = arrival(0x5555, 0x0001, {});
+    everything.interfaceClasses.set();
+    EXPECT_EQ(index.evaluate(everything).verdict, PolicyVerdict::Allow);
+}
+
+TEST_F(PolicySimulatorTest, InterfaceMasksNarrowByType) {
+    auto mask = InterfaceMask::parse({"0x0e", "08:06:*", "03:01:02", "junk"});
+    EXPECT_TRUE(mask.matches(0x0e0100));
+    EXPECT_TRUE(mask.matches(0x080650));
+    EXPECT_TRUE(mask.matches(0x080662));
+    EXPECT_FALSE(mask.matches(0x080550));
+    EXPECT_TRUE(mask.matches(0x030102));
+    EXPECT_FALSE(mask.matches(0x030101));
+    EXPECT_FALSE(mask.matches(0xff0000));
+
+    // The interface number in the top byte is not part of the type
+    EXPECT_TRUE(mask.matches(0x05080650));
+    EXPECT_TRUE(mask.wholeClasses().test(0x0e));
+    EXPECT_FALSE(mask.wholeClasses().test(0x08));
+    EXPECT_TRUE(mask.partialClasses().test(0x08));
+    EXPECT_TRUE(InterfaceMask().empty());
+}
+
+// A composite device: mass storage on interface 0, a keyboard on 1
+TEST_F(PolicySimulatorTest, DeniesSingleInterfaces) {
+    auto composite = arrival(0x0781, 0x5567, {});
+    composite.interfaceTypes = {0x00080650, 0x01030101};
+    composite.interfaceClasses.set(0x08).set(0x03);
+
+    auto storageOnly = rule(0x0781, 0x5567, true, {"08:*:*"});
+    EXPECT_EQ(PolicyIndex({storageOnly}).evaluate(composite).verdict, PolicyVerdict::InterfaceNotAllowed);
+
+    storageOnly.perInterface = true;
+    auto decision = PolicyIndex({storageOnly}).evaluate(composite);
+    EXPECT_EQ(decision.verdict, PolicyVerdict::Allow);
+    EXPECT_EQ(decision.deniedInterfaces, 0x2u);
+
+    auto noKeyboards = rule(0x0781, 0x5567);
+    noKeyboards.blockedInterfaces = {"03:01:*"};
+    noKeyboards.perInterface = true;
+    EXPECT_EQ(PolicyIndex({noKeyboards}).evaluate(composite).deniedInterfaces, 0x2u);
+
+    // An alternate setting of a denied type denies its interface
+    auto alternate = composite;
+    alternate.interfaceTypes = {0x00080650, 0x01ff0000, 0x01030101};
+    EXPECT_EQ(PolicyIndex({storageOnly}).evaluate(alternate).deniedInterfaces, 0x2u);
+
+    // Nothing left to allow refuses the device
+    auto keyboard = arrival(0x0781, 0x5567, {});
+    keyboard.interfaceTypes = {0x00030101};
+    EXPECT_EQ(PolicyIndex({storageOnly}).evaluate(keyboard).verdict, PolicyVerdict::InterfaceNotAllowed);
+
+    // Records with classes only cannot be split up
+    auto classesOnly = arrival(0x0781, 0x5567, {0x08, 0x03});
+    EXPECT_EQ(PolicyIndex({noKeyboards}).evaluate(classesOnly).verdict, PolicyVerdict::InterfaceNotAllowed);
+}
+
+// Per-interface checks ride along in the same descriptor pass
+TEST_F(PolicySimulatorTest, InterfaceDecisionsAmongManyRules) {
+    std::vector<SecurityRule> rules;
+    for (int device = 0; device < 1000; device++) {
+        auto r = rule(uint16_t(0x3000 + device / 100), uint16_t(device % 100), true,
+                      {"08:06:50", "08:06:62", "0x0e", "01:01:*"});
+        r.blockedInterfaces = {"03:*:*", "ff:42:01"};
+        r.perInterface = true;
+        rules.push_back(r);
+    }
+    PolicyIndex index(rules);
+
+    auto composite = arrival(0x3004, 0x0017, {});
+    for (uint32_t number = 0; number < 8; number++) {
+        uint32_t types[] = {0x080650, 0x030101, 0x0e0100, 0xff4201};
+        composite.interfaceTypes.push_back((number << 24) | types[number % 4]);
+        composite.interfaceTypes.push_back((number << 24) | 0x010100);
+    }
+
+    auto decision = index.evaluate(composite);
+    EXPECT_EQ(decision.verdict, PolicyVerdict::Allow);
+    EXPECT_EQ(decision.rule, 423);
+    EXPECT_EQ(decision.deniedInterfaces, 0b10101010u);
+}
+
+TEST_F(PolicySimulatorTest, ReportsChangedDecisions) {
+    auto records = history(200000, 7);
+    PolicyIndex current(rules(1));
+    PolicyIndex candidate(rules(2));
+
+    PolicySimulator simulator(4);
+    auto report = simulator.run(records, current, candidate, 100);
+
+    // Brute force, one record at a time
+    uint64_t changed = 0, newlyAllowed = 0, newlyBlocked = 0;
+    std::vector<size_t> firstChanges;
+    for (size_t i = 0; i < records.size(); i++) {
+        auto before = current.evaluate(records[i]);
+        auto after = candidate.evaluate(records[i]);
+        if (before.verdict == after.verdict && before.rule == after.rule) continue;
+        changed++;
+        if (!isAllowed(before.verdict) && isAllowed(after.verdict)) newlyAllowed++;
+        if (isAllowed(before.verdict) && !isAllowed(after.verdict)) newlyBlocked++;
+        if (firstChanges.size() < 100) firstChanges.push_back(i);
+    }
+
+    ASSERT_GT(changed, 0u);
+    EXPECT_EQ(report.records, records.size());
+    EXPECT_EQ(report.changed, changed);
+    EXPECT_EQ(report.newlyAllowed, newlyAllowed);
+    EXPECT_EQ(report.newlyBlocked, newlyBlocked);
+    ASSERT_EQ(report.changes.size(), firstChanges.size());
+    for (size_t i = 0; i < firstChanges.size(); i++) {
+        EXPECT_EQ(report.changes[i].record, firstChanges[i]);
+    }
+
+    uint64_t before = 0, after = 0, summarized = 0;
+    for (size_t v = 0; v < POLICY_VERDICTS; v++) {
+        before += report.before[v];
+        after += report.after[v];
+    }
+    for (const auto& device : report.devices) {
+        summarized += device.newlyAllowed + device.newlyBlocked + device.otherChanges;
+    }
+    EXPECT_EQ(before, records.size());
+    EXPECT_EQ(after, records.size());
+    EXPECT_EQ(summarized, changed);
+
+    // The same rules change nothing
+    auto same = simulator.run(records, current, current);
+    EXPECT_EQ(same.changed, 0u);
+    EXPECT_TRUE(same.devices.empty());
+}
+
+TEST_F(PolicySimulatorTest, HistoryRoundTrips) {
+    std::vector<DeviceArrivalRecord> records = history(1000, 3);
+    records[0].portPath = "1-2.3";
+    records[0].serialNumber = "has\ttab";
+    records[1].interfaceClasses.reset();
+    records[2].interfaceTypes = {0x00080650, 0x01030101};
+    records[2].connectType = "not used";
+
+    std::string path = ::testing::TempDir() + "arrivals.tsv";
+    ASSERT_TRUE(writeArrivalHistory(path, records));
+    auto loaded = readArrivalHistory(path);
+    std::remove(path.c_str());
+
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ(loaded->size(), records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ((*loaded)[i].vendorId, records[i].vendorId);
+        EXPECT_EQ((*loaded)[i].productId, records[i].productId);
+        EXPECT_EQ((*loaded)[i].interfaceClasses, records[i].interfaceClasses);
+        EXPECT_EQ((*loaded)[i].interfaceTypes, records[i].interfaceTypes);
+        EXPECT_EQ(std::chrono::duration_cast<std::chrono::milliseconds>((*loaded)[i].timestamp.time_since_epoch()),
+                  std::chrono::duration_cast<std::chrono::milliseconds>(records[i].timestamp.time_since_epoch()));
+    }
+    EXPECT_EQ((*loaded)[0].portPath, "1-2.3");
+    EXPECT_EQ((*loaded)[0].serialNumber, "has tab");
+    EXPECT_EQ((*loaded)[2].connectType, "not used");
+    EXPECT_FALSE(readArrivalHistory(path));
+}
+
+TEST_F(PolicySimulatorTest, AppendedHistoryReadsAsOne) {
+    std::vector<DeviceArrivalRecord> records = history(300, 5);
+    std::vector<DeviceArrivalRecord> first(records.begin(), records.begin() + 100);
+    std::string path = ::testing::TempDir() + "appended.tsv";
+    std::remove(path.c_str());
+
+    // The arrival log starts from nothing and grows one record at a time
+    ASSERT_TRUE(appendArrivalHistory(path, first));
+    for (size_t i = 100; i < records.size(); i++) {
+        ASSERT_TRUE(appendArrivalHistory(path, {records[i]}));
+    }
+    auto loaded = readArrivalHistory(path);
+    std::remove(path.c_str());
+
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ(loaded->size(), records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ((*loaded)[i].vendorId, records[i].vendorId);
+        EXPECT_EQ((*loaded)[i].productId, records[i].productId);
+        EXPECT_EQ((*loaded)[i].interfaceClasses, records[i].interfaceClasses);
+    }
+}
+
+// A history split over many chunks adds up to the single-threaded run
+TEST_F(PolicySimulatorTest, ChunkedRunMatchesSingleWorker) {
+    auto records = history(100000, 11);
+    PolicyIndex current(rules(1));
+    PolicyIndex candidate(rules(2));
+
+    auto report = PolicySimulator(8).run(records, current, candidate);
+    auto serial = PolicySimulator(1).run(records, current, candidate);
+    EXPECT_EQ(report.records, records.size());
+    EXPECT_GT(report.changed, 0u);
+    EXPECT_EQ(report.changed, serial.changed);
+    EXPECT_EQ(report.newlyAllowed, serial.newlyAllowed);
+    EXPECT_EQ(report.newlyBlocked, serial.newlyBlocked);
+    EXPECT_EQ(report.before, serial.before);
+    EXPECT_EQ(report.after, serial.after);
+    ASSERT_EQ(report.changes.size(), serial.changes.size());
+    for (size_t i = 0; i < report.changes.size(); i++) {
+        EXPECT_EQ(report.changes[i].record, serial.changes[i].record);
+    }
+}
+
+} // namespace testing
+} // namespace usb_monitor
@@ -0,0 +1,65 @@
+// tests/test_RateWindow.cpp
+#include <gtest/gtest.h>
+#include "../src/core/RateWindow.hpp"
+
+using namespace usb_monitor;
+using namespace std::chrono;
+
+namespace {
+
+using Window = RateWindow<100, 50>;
+
+Window::Clock::time_point at(int64_t milliseconds) {
+    return Window::Clock::time_point(std::chrono::milliseconds(milliseconds));
+}
+
+} // namespace
+
+TEST(RateWindowTest, RateOverFullWindow) {
+    Window window;
+    // 1000 bytes every 10 ms for 10 s: 100 kB/s
+    for (int64_t t = 0; t < 10000; t += 10) {
+        window.add(1000, 2, at(t));
+    }
+    window.advance(at(10000));
+    
+    EXPECT_NEAR(window.rate(), 100000.0, 2500.0);
+    EXPECT_NEAR(window.packetRate(), 200.0, 5.0);
+    EXPECT_EQ(window.totalBytes(), 1000u * 1000u);
+    EXPECT_EQ(window.totalPackets(), 2000u);
+}
+
+TEST(RateWindowTest, RateWhileWindowFills) {
+    Window window;
+    for (int64_t t = 0; t < 1000; t += 10) {
+        window.add(500, 1, at(t));
+    }
+    // One second of data must not be averaged over the full five
+    EXPECT_NEAR(window.rate(), 50000.0, 2500.0);
+}
+
+TEST(RateWindowTest, OldBucketsExpire) {
+    Window window;
+    window.add(10000, 10, at(0));
+    window.advance(at(4900));
+    EXPECT_GT(window.rate(), 0.0);
+    
+    window.advance(at(5100));
+    EXPECT_EQ(window.rate(), 0.0);
+    window.advance(at(60000));
+    EXPECT_EQ(window.rate(), 0.0);
+    EXPECT_EQ(window.totalBytes(), 10000u);
+}
+
+TEST(RateWindowTest, PeakTracksBusiestBucket) {
+    Window window;
+    window.add(100, 1, at(0));
+    window.add(5000, 1, at(120));
+    window.add(5000, 1, at(130));
+    window.add(100, 1, at(400));
+    
+    // 10000 bytes in one 50 ms bucket
+    EXPECT_DOUBLE_EQ(window.peakRate(), 200000.0);
+    window.advance(at(20000));
+    EXPECT_DOUBLE_EQ(window.peakRate(), 200000.0);
+}
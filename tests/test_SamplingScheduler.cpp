@@ -0,0 +1,142 @@
+// tests/test_SamplingScheduler.cpp
+#include <gtest/gtest.h>
+#include "../src/core/SamplingScheduler.hpp"
+#include <vector>
+
+using namespace usb_monitor;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Clock = SamplingScheduler::Clock;
+
+// Runs ticks on a virtual clock for the given duration
+void run(SamplingScheduler& scheduler, Clock::time_point& now, std::chrono::milliseconds duration) {
+    auto end = now + duration;
+    while (now < end) {
+        now += std::chrono::milliseconds(SAMPLING_TICK);
+        scheduler.tick(now);
+    }
+}
+
+} // namespace
+
+TEST(SamplingSchedulerTest, IdleSourcesBackOffAndActiveOnesSpeedUp) {
+    SamplingScheduler scheduler;
+    auto now = Clock::now();
+    bool busy = false;
+    int busySamples = 0;
+    int idleSamples = 0;
+    int device = 0;
+    
+    auto idle = scheduler.add(&device, 1000ms, [&idleSamples]() { idleSamples++; return false; });
+    auto active = scheduler.add(&busy, 1000ms, [&]() { busySamples++; return busy; });
+    busy = true;
+    
+    run(scheduler, now, 30s);
+    EXPECT_EQ(scheduler.interval(idle), std::chrono::milliseconds(SAMPLING_MAX_INTERVAL));
+    EXPECT_EQ(scheduler.interval(active), std::chrono::milliseconds(SAMPLING_MIN_INTERVAL));
+    EXPECT_GT(busySamples, 20 * idleSamples);
+    
+    // Activity stops: the source backs off again
+    busy = false;
+    run(scheduler, now, 30s);
+    EXPECT_EQ(scheduler.interval(active), std::chrono::milliseconds(SAMPLING_MAX_INTERVAL));
+}
+
+TEST(SamplingSchedulerTest, VisibleSourcesAreCapped) {
+    SamplingScheduler scheduler;
+    auto now = Clock::now();
+    int device = 0;
+    int samples = 0;
+    
+    auto id = scheduler.add(&device, 1000ms, [&samples]() { samples++; return false; });
+    run(scheduler, now, 30s);
+    EXPECT_EQ(scheduler.interval(id), std::chrono::milliseconds(SAMPLING_MAX_INTERVAL));
+    
+    scheduler.setVisible(&device, true);
+    EXPECT_EQ(scheduler.interval(id), std::chrono::milliseconds(SAMPLING_VISIBLE_INTERVAL));
+    samples = 0;
+    run(scheduler, now, 10s);
+    EXPECT_GE(samples, 10000 / SAMPLING_VISIBLE_INTERVAL - 1);
+    
+    scheduler.setVisible(&device, false);
+    EXPECT_EQ(scheduler.interval(id), std::chrono::milliseconds(SAMPLING_MAX_INTERVAL));
+}
+
+TEST(SamplingSchedulerTest, CpuBudgetDefersWork) {
+    SamplingPolicy policy;
+    policy.cpuBudget = 0.01;  // 0.5 ms of every 50 ms tick
+    
+    // Each sample costs 1 ms on the scheduler's cost clock
+    auto spent = Clock::time_point();
+    SamplingScheduler scheduler(policy, [&spent]() { return spent; });
+    std::vector<int> targets(20);
+    
+    for (auto& target : targets) {
+        scheduler.add(&target, 50ms, [&spent]() {
+            spent += 1ms;
+            return true;
+        });
+    }
+    
+    auto now = Clock::now();
+    EXPECT_EQ(scheduler.tick(now), 1u);
+    now += 50ms;
+    
+    // Only one expensive sample fits in a tick, the rest wait
+    EXPECT_EQ(scheduler.tick(now), 1u);
+    auto metrics = scheduler.metrics(now);
+    EXPECT_EQ(metrics.totalSamples, 2u);
+    EXPECT_EQ(metrics.deferredSamples, 2u * (targets.size() - 1));
+}
+
+TEST(SamplingSchedulerTest, RemovedSourcesStopSampling) {
+    SamplingScheduler scheduler;
+    auto now = Clock::now();
+    int device = 0;
+    int samples = 0;
+    
+    scheduler.add(&device, 50ms, [&samples]() { samples++; return true; });
+    scheduler.add(&device, 50ms, [&samples]() { samples++; return true; });
+    run(scheduler, now, 1s);
+    EXPECT_GT(samples, 0);
+    
+    scheduler.removeTarget(&device);
+    samples = 0;
+    run(scheduler, now, 1s);
+    EXPECT_EQ(samples, 0);
+    EXPECT_EQ(scheduler.metrics(now).sources, 0u);
+}
+
+TEST(SamplingSchedulerTest, FleetMetrics) {
+    const int kDevices = 1000;
+    
+    for (bool busyFleet : {false, true}) {
+        SamplingScheduler scheduler;
+        auto now = Clock::now();
+        std::vector<int> devices(kDevices);
+        
+        // Two samplers per device (power and bandwidth); a busy fleet has a
+        // tenth of its devices moving data
+        for (int i = 0; i < kDevices; ++i) {
+            bool active = busyFleet && i % 10 == 0;
+            scheduler.add(&devices[i], 100ms, [active]() { return active; });
+            scheduler.add(&devices[i], 1000ms, []() { return false; });
+        }
+        for (int i = 0; i < 20; ++i) {
+            scheduler.setVisible(&devices[i], true);
+        }
+        
+        run(scheduler, now, 60s);
+        auto metrics = scheduler.metrics(now);
+        
+        // Fixed timers would take 1000 x (10 + 1) = 11000 samples/sec; the
+        // idle fleet is carried by the visible rows, the busy one by its
+        // active devices at 20 samples/sec each
+        EXPECT_LT(metrics.samplesPerSecond, busyFleet ? 11000.0 / 4 : 11000.0 / 50);
+        EXPECT_EQ(metrics.sources, size_t(2 * kDevices));
+        EXPECT_EQ(metrics.visibleSources, 40u);
+        EXPECT_EQ(metrics.activeSources, busyFleet ? size_t(kDevices / 10) : 0u);
+    }
+}
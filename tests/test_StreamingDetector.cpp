@@ -0,0 +1,124 @@
+// tests/test_StreamingDetector.cpp
+#include <gtest/gtest.h>
+#include "../src/analysis/StreamingDetector.hpp"
+#include <random>
+
+using namespace usb_monitor;
+using namespace std::chrono;
+
+namespace {
+
+system_clock::time_point at(int64_t secondsFromEpoch) {
+    return system_clock::time_point(seconds(secondsFromEpoch));
+}
+
+DetectorConfig testConfig() {
+    DetectorConfig config;
+    config.minDeviation = 1.0;
+    config.warmup = 30;
+    return config;
+}
+
+} // namespace
+
+TEST(StreamingDetectorTest, QuietOnStationaryNoise) {
+    StreamingDetector detector(testConfig());
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(1000.0, 20.0);
+    
+    int alarms = 0;
+    for (int i = 0; i < 5000; i++) {
+        if (detector.update(noise(rng), at(i)).kind != AnomalyKind::None) alarms++;
+    }
+    
+    // Roughly one false alarm per thousand samples at most
+    EXPECT_LE(alarms, 5);
+    EXPECT_NEAR(detector.mean(), 1000.0, 10.0);
+    EXPECT_NEAR(detector.deviation(), 20.0, 5.0);
+}
+
+TEST(StreamingDetectorTest, ReportsSpikeWithoutShiftingBaseline) {
+    StreamingDetector detector(testConfig());
+    std::mt19937 rng(2);
+    std::normal_distribution<double> noise(1000.0, 20.0);
+    
+    for (int i = 0; i < 200; i++) {
+        detector.update(noise(rng), at(i));
+    }
+    
+    auto result = detector.update(5000.0, at(200));
+    EXPECT_EQ(result.kind, AnomalyKind::Spike);
+    EXPECT_GT(result.score, 4.0);
+    EXPECT_NEAR(result.expected, 1000.0, 10.0);
+    
+    // One outlier is clamped, so the baseline barely moves
+    EXPECT_NEAR(detector.mean(), 1000.0, 15.0);
+}
+
+TEST(StreamingDetectorTest, DetectsLevelShiftAndRelearns) {
+    StreamingDetector detector(testConfig());
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 20.0);
+    
+    for (int i = 0; i < 200; i++) {
+        detector.update(1000.0 + noise(rng), at(i));
+    }
+    
+    // A sustained drop of 2 sigma: too small for a spike, found by CUSUM
+    int detectedAt = -1;
+    for (int i = 200; i < 260; i++) {
+        auto result = detector.update(960.0 + noise(rng), at(i));
+        if (result.kind == AnomalyKind::LevelShiftDown) {
+            detectedAt = i;
+            break;
+        }
+        EXPECT_NE(result.kind, AnomalyKind::LevelShiftUp);
+    }
+    ASSERT_GE(detectedAt, 200);
+    EXPECT_LT(detectedAt, 220);
+    
+    // After relearning, the new level is normal again
+    int alarms = 0;
+    for (int i = detectedAt + 1; i < detectedAt + 500; i++) {
+        if (detector.update(960.0 + noise(rng), at(i)).kind != AnomalyKind::None) alarms++;
+    }
+    EXPECT_LE(alarms, 2);
+    EXPECT_NEAR(detector.mean(), 960.0, 10.0);
+}
+
+TEST(StreamingDetectorTest, SeasonalBaselineAcceptsDailyPattern) {
+    auto config = testConfig();
+    config.seasonBins = 24;
+    config.seasonLength = hours(24);
+    config.alpha = 0.1;
+    StreamingDetector seasonal(config);
+    config.seasonBins = 0;
+    StreamingDetector flat(config);
+    
+    std::mt19937 rng(4);
+    std::normal_distribution<double> noise(0.0, 5.0);
+    
+    // Busy during working hours, idle at night; one sample every 10 minutes
+    auto level = [](int64_t t) {
+        int hour = static_cast<int>((t / 3600) % 24);
+        return (hour >= 9 && hour < 17) ? 1000.0 : 100.0;
+    };
+    
+    int seasonalAlarms = 0;
+    int flatAlarms = 0;
+    for (int64_t t = 0; t < 14 * 86400; t += 600) {
+        double value = level(t) + noise(rng);
+        bool late = t >= 7 * 86400;
+        if (seasonal.update(value, at(t)).kind != AnomalyKind::None && late) seasonalAlarms++;
+        if (flat.update(value, at(t)).kind != AnomalyKind::None && late) flatAlarms++;
+    }
+    
+    // The seasonal detector has learned the day; the flat one keeps alarming
+    EXPECT_LE(seasonalAlarms, 10);
+    EXPECT_GT(flatAlarms, 3 * seasonalAlarms);
+    
+    // Daytime traffic in the middle of the night is still anomalous
+    auto result = seasonal.update(1000.0, at(14 * 86400 + 3 * 3600));
+    EXPECT_NE(result.kind, AnomalyKind::None);
+    EXPECT_NEAR(result.expected, 100.0, 10.0);
+}
@@ -0,0 +1,177 @@
+// tests/test_TransferPool.cpp
+#include <gtest/gtest.h>
+#include "../src/core/TransferPool.hpp"
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace usb_monitor {
+namespace testing {
+
+// Stands in for libusb: keeps submitted transfers until the test completes
+// them through their callback, as the event thread would
+class FakeBus {
+public:
+    TransferBackend backend() {
+        return TransferBackend{
+            [this](libusb_transfer* transfer) {
+                if (failSubmits) return int(LIBUSB_ERROR_NO_DEVICE);
+                std::lock_guard<std::mutex> lock(mutex);
+                submitted.push_back(transfer);
+                return int(LIBUSB_SUCCESS);
+            },
+            [this](libusb_transfer* transfer) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cancelled.push_back(transfer);
+                return int(LIBUSB_SUCCESS);
+            }};
+    }
+    
+    static void complete(libusb_transfer* transfer, libusb_transfer_status status, int actualLength) {
+        transfer->status = status;
+        transfer->actual_length = actualLength;
+        transfer->callback(transfer);
+    }
+    
+    std::mutex mutex;
+    std::vector<libusb_transfer*> submitted;
+    std::vector<libusb_transfer*> cancelled;
+    bool failSubmits{false};
+};
+
+class TransferPoolTest : public ::testing::Test {
+protected:
+    // What UsbDevice's fill step would set up for a bulk transfer
+    static void fillBulk(PooledTransfer* slot, const char* text) {
+        size_t length = std::strlen(text);
+        std::memcpy(slot->buffer.data(), text, length);
+        slot->transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+        slot->transfer->endpoint = 0x81;
+        slot->transfer->buffer = slot->buffer.data();
+        slot->transfer->length = static_cast<int>(length);
+        slot->transfer->num_iso_packets = 0;
+    }
+    
+    FakeBus bus;
+};
+
+TEST_F(TransferPoolTest, CompletionSeesBufferAndFreesSlot) {
+    TransferPool pool(2, 64, 0, bus.backend());
+    auto slot = pool.acquire(16);
+    ASSERT_NE(slot, nullptr);
+    fillBulk(slot, "sensor");
+    
+    std::string received;
+    int status = -1;
+    ASSERT_EQ(pool.submit(slot, [&](const TransferCompletion& completion) {
+        status = completion.status;
+        received.assign(reinterpret_cast<const char*>(completion.data), completion.actualLength);
+    }), LIBUSB_SUCCESS);
+    EXPECT_EQ(pool.inFlight(), 1u);
+    
+    ASSERT_EQ(bus.submitted.size(), 1u);
+    FakeBus::complete(bus.submitted[0], LIBUSB_TRANSFER_COMPLETED, 3);
+    EXPECT_EQ(status, LIBUSB_TRANSFER_COMPLETED);
+    EXPECT_EQ(received, "sen");
+    EXPECT_EQ(pool.inFlight(), 0u);
+    EXPECT_TRUE(pool.waitIdle(std::chrono::milliseconds(0)));
+    
+    // Both slots are free again
+    EXPECT_NE(pool.acquire(16), nullptr);
+    EXPECT_NE(pool.acquire(16), nullptr);
+    EXPECT_EQ(pool.acquire(16), nullptr);
+}
+
+TEST_F(TransferPoolTest, GrowsBuffersAndReusesSlots) {
+    TransferPool pool(1, 64, 0, bus.backend());
+    EXPECT_EQ(pool.capacity(), 1u);
+    
+    auto slot = pool.acquire(4096);
+    ASSERT_NE(slot, nullptr);
+    EXPECT_GE(slot->buffer.size(), 4096u);
+    EXPECT_EQ(pool.acquire(1), nullptr);
+    
+    pool.release(slot);
+    auto again = pool.acquire(1);
+    EXPECT_EQ(again, slot);
+    EXPECT_GE(again->buffer.size(), 4096u);
+}
+
+TEST_F(TransferPoolTest, FailedSubmitReleasesSlot) {
+    TransferPool pool(1, 64, 0, bus.backend());
+    bus.failSubmits = true;
+    
+    auto slot = pool.acquire(8);
+    fillBulk(slot, "x");
+    bool called = false;
+    EXPECT_EQ(pool.submit(slot, [&called](const TransferCompletion&) { called = true; }),
+              LIBUSB_ERROR_NO_DEVICE);
+    EXPECT_FALSE(called);
+    EXPECT_EQ(pool.inFlight(), 0u);
+    EXPECT_EQ(pool.acquire(8), slot);
+}
+
+TEST_F(TransferPoolTest, DestructionWaitsForCancelledTransfers) {
+    std::vector<TransferCompletion> completions;
+    auto pool = std::make_unique<TransferPool>(4, 64, 0, bus.backend());
+    for (int i = 0; i < 3; i++) {
+        auto slot = pool->acquire(8);
+        fillBulk(slot, "data");
+        pool->submit(slot, [&completions](const TransferCompletion& completion) {
+            completions.push_back(completion);
+        });
+    }
+    
+    // The event thread reports each cancellation once the pool asked for it
+    int remaining = 3;
+    std::thread eventThread([this, &remaining] {
+        for (;;) {
+            libusb_transfer* transfer = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(bus.mutex);
+                if (!bus.cancelled.empty()) {
+                    transfer = bus.cancelled.back();
+                    bus.cancelled.pop_back();
+                }
+            }
+            if (transfer) {
+                FakeBus::complete(transfer, LIBUSB_TRANSFER_CANCELLED, 0);
+                if (--remaining == 0) return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    pool.reset();
+    eventThread.join();
+    
+    ASSERT_EQ(completions.size(), 3u);
+    for (const auto& completion : completions) {
+        EXPECT_EQ(completion.status, LIBUSB_TRANSFER_CANCELLED);
+    }
+}
+
+TEST_F(TransferPoolTest, LateCompletionOutlivesPool) {
+    auto pool = std::make_unique<TransferPool>(2, 64, 0, bus.backend());
+    auto slot = pool->acquire(8);
+    fillBulk(slot, "late");
+    
+    std::string received;
+    pool->submit(slot, [&received](const TransferCompletion& completion) {
+        received.assign(reinterpret_cast<const char*>(completion.data), completion.actualLength);
+    });
+    
+    // The device never answers the cancel, so the destructor gives up
+    // waiting with the transfer still in flight
+    pool.reset();
+    ASSERT_EQ(bus.submitted.size(), 1u);
+    ASSERT_EQ(bus.cancelled.size(), 1u);
+    
+    // libusb calls back eventually; the slot and its buffer are still there
+    FakeBus::complete(bus.submitted[0], LIBUSB_TRANSFER_COMPLETED, 4);
+    EXPECT_EQ(received, "late");
+}
+
+} // namespace testing
+} // namespace usb_monitor
@@ -0,0 +1,137 @@
+// tests/test_UrbMatcher.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/UrbMatcher.hpp"
+#include <random>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+UrbEvent urb(char type, uint64_t id, int64_t timestamp, uint8_t endpoint = 0x81,
+             uint32_t length = 512, int32_t status = 0) {
+    auto event = urbEvent(type, LIBUSB_TRANSFER_TYPE_BULK, 2, 5, endpoint, timestamp, length);
+    event.id = id;
+    event.status = status;
+    return event;
+}
+
+} // namespace
+
+TEST(UrbMatcherTest, HistogramBucketsAreLogLinear) {
+    for (uint64_t v : {0ull, 3ull, 4ull, 7ull, 8ull, 100ull, 1000ull, 123456ull}) {
+        size_t bucket = LatencyHistogram::bucketOf(v);
+        EXPECT_LE(LatencyHistogram::bucketLowerBound(bucket), v);
+        EXPECT_GT(LatencyHistogram::bucketLowerBound(bucket + 1), v);
+    }
+    
+    LatencyHistogram histogram;
+    for (uint64_t v = 1; v <= 1000; v++) {
+        histogram.add(v);
+    }
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 500.5);
+    EXPECT_NEAR(double(histogram.percentile(0.5)), 500.0, 125.0);
+    EXPECT_NEAR(double(histogram.percentile(0.99)), 990.0, 250.0);
+    EXPECT_EQ(histogram.percentile(1.0), 1000u);
+}
+
+TEST(UrbMatcherTest, MatchesSubmitAndCompleteOutOfOrder) {
+    UrbMatcher matcher(64);
+    
+    matcher.process(urb('S', 0xffff8880a0001000, T0));
+    matcher.process(urb('S', 0xffff8880a0002000, T0 + 10));
+    matcher.process(urb('S', 0xffff8880a0003000, T0 + 20, 0x02));
+    EXPECT_EQ(matcher.inFlight(), 3u);
+    
+    auto second = matcher.process(urb('C', 0xffff8880a0002000, T0 + 260, 0x81, 64));
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(second->latency, 250);
+    EXPECT_EQ(second->requested, 512u);
+    EXPECT_EQ(second->actual, 64u);
+    EXPECT_EQ(second->endpoint, 0x81);
+    
+    auto failed = matcher.process(urb('C', 0xffff8880a0003000, T0 + 1020, 0x02, 0, -32));
+    ASSERT_TRUE(failed.has_value());
+    EXPECT_EQ(failed->latency, 1000);
+    EXPECT_EQ(failed->status, -32);
+    
+    auto first = matcher.process(urb('C', 0xffff8880a0001000, T0 + 2000));
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first->latency, 2000);
+    
+    EXPECT_FALSE(matcher.process(urb('C', 0xdead, T0 + 3000)).has_value());
+    EXPECT_EQ(matcher.unmatched(), 1u);
+    EXPECT_EQ(matcher.inFlight(), 0u);
+    
+    auto stats = matcher.endpointStats(2, 5);
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[0].endpoint, 0x02);
+    EXPECT_EQ(stats[0].errors, 1u);
+    EXPECT_EQ(stats[1].endpoint, 0x81);
+    EXPECT_EQ(stats[1].completed, 2u);
+    EXPECT_EQ(stats[1].peakInFlight, 2u);
+    EXPECT_EQ(stats[1].minLatency, 250u);
+    EXPECT_EQ(stats[1].maxLatency, 2000u);
+}
+
+TEST(UrbMatcherTest, TracksInFlightDepthOverTime) {
+    UrbMatcher matcher(64);
+    
+    // Four URBs queued for 50 ms, then one for the next 50 ms
+    for (uint64_t id = 1; id <= 4; id++) {
+        matcher.process(urb('S', id * 64, T0));
+    }
+    for (uint64_t id = 1; id <= 3; id++) {
+        matcher.process(urb('C', id * 64, T0 + 50000));
+    }
+    matcher.process(urb('C', 4 * 64, T0 + 100000));
+    
+    auto stats = matcher.endpointStats(2, 5);
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].inFlight, 0u);
+    EXPECT_EQ(stats[0].peakInFlight, 4u);
+    EXPECT_NEAR(stats[0].averageInFlight, 2.5, 0.01);
+    ASSERT_EQ(stats[0].depthHistory.size(), size_t(URB_DEPTH_SLOTS));
+    // Peak depth of the last two 100 ms slots
+    EXPECT_EQ(stats[0].depthHistory[URB_DEPTH_SLOTS - 2], 4u);
+    EXPECT_EQ(stats[0].depthHistory.back(), 1u);
+}
+
+TEST(UrbMatcherTest, SurvivesChurnAndLostCompletions) {
+    UrbMatcher matcher(1024);
+    std::mt19937_64 rng(7);
+    
+    // Page-aligned ids completed in random order keep the probe runs busy
+    std::vector<uint64_t> pending;
+    uint64_t nextId = 1;
+    int64_t now = T0;
+    uint64_t matched = 0;
+    for (int i = 0; i < 200000; i++) {
+        now += 5;
+        if (pending.size() < 500 && (pending.empty() || rng() % 2)) {
+            uint64_t id = 0xffff888000000000ull + (nextId++ << 12);
+            matcher.process(urb('S', id, now));
+            pending.push_back(id);
+        } else {
+            size_t pick = rng() % pending.size();
+            std::swap(pending[pick], pending.back());
+            if (matcher.process(urb('C', pending.back(), now))) matched++;
+            pending.pop_back();
+        }
+    }
+    
+    EXPECT_EQ(matcher.unmatched(), 0u);
+    EXPECT_EQ(matcher.overflows(), 0u);
+    EXPECT_EQ(matcher.inFlight(), pending.size());
+    EXPECT_EQ(matched + pending.size(), nextId - 1);
+    
+    // Completions for the first ten were never captured
+    for (size_t i = 10; i < pending.size(); i++) {
+        ASSERT_TRUE(matcher.process(urb('C', pending[i], now + 10)).has_value());
+    }
+    EXPECT_EQ(matcher.expire(now + 1), std::min<size_t>(10, pending.size()));
+    EXPECT_EQ(matcher.inFlight(), 0u);
+    EXPECT_EQ(matcher.endpointStats(2, 5)[0].inFlight, 0u);
+}
@@ -0,0 +1,308 @@
+// tests/test_UsbGuardRules.cpp
+#include <gtest/gtest.h>
+#include "../src/security/PolicySimulator.hpp"
+#include <random>
+#include <string>
+
+namespace usb_monitor {
+namespace testing {
+
+class UsbGuardRulesTest : public ::testing::Test {
+protected:
+    static DeviceArrivalRecord device(uint16_t vendorId, uint16_t productId, std::vector<uint32_t> interfaces,
+                                      std::string serial = "", std::string port = "1-1") {
+        DeviceArrivalRecord result;
+        result.vendorId = vendorId;
+        result.productId = productId;
+        result.interfaceTypes = std::move(interfaces);
+        for (uint32_t type : result.interfaceTypes) result.interfaceClasses.set((type >> 16) & 0xFF);
+        result.serialNumber = std::move(serial);
+        result.portPath = std::move(port);
+        return result;
+    }
+
+    static PolicyIndex compile(const std::string& text) {
+        auto ruleSet = parseUsbGuardRules(text);
+        EXPECT_TRUE(ruleSet.errors.empty()) << ruleSet.errors.front().message;
+        return PolicyIndex({}, ruleSet.rules);
+    }
+};
+
+TEST_F(UsbGuardRulesTest, ParsesRuleSyntax) {
+    auto ruleSet = parseUsbGuardRules(
+        "# generated by usbguard generate-policy\n"
+        "\n"
+        "allow id 1d6b:0002 serial \"0000:00:14.0\" name \"xHCI Host Controller\" "
+        "with-interface 09:00:00 with-connect-type \"\"\n"
+        "allow 046d:* via-port one-of { \"1-1\" \"1-2\" } with-interface all-of { 03:*:* 03:01:02 } "
+        "label \"keyboards\"\n"
+        "reject with-interface one-of { 08:*:* 06:*:* } if !localtime(08:00-18:30)\n"
+        "block id *:* if { true !false }\n");
+    ASSERT_TRUE(ruleSet.errors.empty()) << ruleSet.errors.front().message;
+    ASSERT_EQ(ruleSet.rules.size(), 4u);
+
+    const auto& hub = ruleSet.rules[0];
+    EXPECT_EQ(hub.target, RuleTarget::Allow);
+    EXPECT_EQ(hub.line, 3u);
+    ASSERT_TRUE(hub.id);
+    EXPECT_EQ(hub.id->values[0].vendorId, 0x1d6b);
+    EXPECT_EQ(hub.id->values[0].productId, 0x0002);
+    EXPECT_EQ(hub.serial->values[0], "0000:00:14.0");
+    EXPECT_EQ(hub.name->values[0], "xHCI Host Controller");
+    EXPECT_EQ(hub.interfaces->op, SetOperator::Equals);
+    EXPECT_EQ(hub.interfaces->values[0].type, 0x090000u);
+    EXPECT_EQ(hub.connectType->values[0], "");
+
+    const auto& keyboards = ruleSet.rules[1];
+    EXPECT_TRUE(keyboards.id->values[0].anyProduct);
+    EXPECT_EQ(keyboards.viaPort->op, SetOperator::OneOf);
+    EXPECT_EQ(keyboards.viaPort->values.size(), 2u);
+    EXPECT_EQ(keyboards.interfaces->values[0].mask, 0xFF0000u);
+    EXPECT_EQ(keyboards.label, "keyboards");
+
+    const auto& storage = ruleSet.rules[2];
+    EXPECT_EQ(storage.target, RuleTarget::Reject);
+    ASSERT_TRUE(storage.conditions);
+    EXPECT_TRUE(storage.conditions->values[0].negated);
+    EXPECT_EQ(storage.conditions->values[0].from, 8u * 3600);
+    EXPECT_EQ(storage.conditions->values[0].until, 18u * 3600 + 30 * 60);
+
+    EXPECT_TRUE(ruleSet.rules[3].id->values[0].anyVendor);
+    EXPECT_EQ(ruleSet.rules[3].conditions->values.size(), 2u);
+}
+
+TEST_F(UsbGuardRulesTest, ReportsErrorsByLine) {
+    auto ruleSet = parseUsbGuardRules(
+        "allow id 1234:5678\n"
+        "permit id 1234:5678\n"
+        "allow id 12345:1\n"
+        "allow with-interface 08:*:50\n"
+        "allow serial \"open\n"
+        "allow if rule-applied\n"
+        "allow id 1234:5678 hash \"jEP/6WzviqdJ5VSeTUY8PatCNBKeaREvo2OqdplND/o=\"\n"
+        "allow id 1234:5678 id 1234:5679\n"
+        "allow with-interface { 08:06:50\n");
+    ASSERT_EQ(ruleSet.rules.size(), 1u);
+    ASSERT_EQ(ruleSet.errors.size(), 8u);
+    for (size_t i = 0; i < ruleSet.errors.size(); i++) {
+        EXPECT_EQ(ruleSet.errors[i].line, i + 2);
+    }
+    EXPECT_NE(ruleSet.errors[4].message.find("rule-applied"), std::string::npos);
+    EXPECT_NE(ruleSet.errors[5].message.find("--no-hashes"), std::string::npos);
+}
+
+// usbguard generate-policy on a laptop with a receiver plugged in, as
+// written by default and with --no-hashes
+TEST_F(UsbGuardRulesTest, ImportsGeneratedPolicies) {
+    const char* hashed =
+        "allow id 1d6b:0002 serial \"0000:00:14.0\" name \"xHCI Host Controller\" "
+        "hash \"jEP/6WzviqdJ5VSeTUY8PatCNBKeaREvo2OqdplND/o=\" "
+        "parent-hash \"G1ehGQdrl3dJ9HvW9w2HdC//pk87pKzFE1WY25bq8k4=\" "
+        "with-interface 09:00:00 with-connect-type \"\"\n"
+        "allow id 8087:0a2b serial \"\" name \"\" hash \"TtRMrWxJil9GOY/JzidUEOz/yUiwwC4gx7DVpgqNzKA=\" "
+        "parent-hash \"jEP/6WzviqdJ5VSeTUY8PatCNBKeaREvo2OqdplND/o=\" via-port \"1-14\" "
+        "with-interface { e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 } "
+        "with-connect-type \"not used\"\n"
+        "allow id 046d:c52b serial \"\" name \"USB Receiver\" hash \"Ji2OSNZ5cEBdrrGVDH/E4yGlnSAKJ1zyrLdA4+jMXjY=\" "
+        "parent-hash \"jEP/6WzviqdJ5VSeTUY8PatCNBKeaREvo2OqdplND/o=\" via-port \"1-2\" "
+        "with-interface { 03:01:01 03:01:02 03:00:00 } with-connect-type \"hotplug\"\n";
+    const char* unhashed =
+        "allow id 1d6b:0002 serial \"0000:00:14.0\" name \"xHCI Host Controller\" "
+        "with-interface 09:00:00 with-connect-type \"\"\n"
+        "allow id 8087:0a2b serial \"\" name \"\" via-port \"1-14\" "
+        "with-interface { e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 e0:01:01 } "
+        "with-connect-type \"not used\"\n"
+        "allow id 046d:c52b serial \"\" name \"USB Receiver\" via-port \"1-2\" "
+        "with-interface { 03:01:01 03:01:02 03:00:00 } with-connect-type \"hotplug\"\n";
+
+    // Hashes cannot be checked, so every rule is refused by line rather
+    // than allowed or blocked on a hash that never matches
+    auto refused = parseUsbGuardRules(hashed);
+    EXPECT_TRUE(refused.rules.empty());
+    ASSERT_EQ(refused.errors.size(), 3u);
+    for (size_t i = 0; i < refused.errors.size(); i++) {
+        EXPECT_EQ(refused.errors[i].line, i + 1);
+        EXPECT_NE(refused.errors[i].message.find("'hash'"), std::string::npos);
+    }
+
+    auto index = compile(unhashed);
+    auto arrival = [](uint16_t vendorId, uint16_t productId, std::vector<uint32_t> interfaces,
+                      std::string name, std::string port, std::string connectType) {
+        auto result = device(vendorId, productId, std::move(interfaces), "", std::move(port));
+        result.name = std::move(name);
+        result.connectType = std::move(connectType);
+        return result;
+    };
+
+    auto hub = arrival(0x1d6b, 0x0002, {0x090000}, "xHCI Host Controller", "usb1", "");
+    hub.serialNumber = "0000:00:14.0";
+    EXPECT_EQ(index.evaluate(hub).rule, 0);
+    EXPECT_EQ(index.evaluate(arrival(0x8087, 0x0a2b, std::vector<uint32_t>(7, 0xe00101), "", "1-14",
+                                     "not used")).rule, 1);
+
+    auto receiver = arrival(0x046d, 0xc52b, {0x030101, 0x030102, 0x030000}, "USB Receiver", "1-2", "hotplug");
+    EXPECT_EQ(index.evaluate(receiver).verdict, PolicyVerdict::Allow);
+    EXPECT_EQ(index.evaluate(receiver).rule, 2);
+
+    // The same receiver on another port, or a port of another type
+    receiver.portPath = "1-3";
+    EXPECT_EQ(index.evaluate(receiver).verdict, PolicyVerdict::NotWhitelisted);
+    receiver.portPath = "1-2";
+    receiver.connectType = "hardwired";
+    EXPECT_EQ(index.evaluate(receiver).verdict, PolicyVerdict::NotWhitelisted);
+}
+
+TEST_F(UsbGuardRulesTest, MatchesLikeUsbGuard) {
+    auto index = compile(
+        "allow id 1d6b:0002\n"
+        "block id 046d:c52b with-interface one-of { 08:*:* }\n"
+        "allow id 046d:* with-interface all-of { 03:01:* }\n"
+        "allow with-interface equals { 08:06:50 }\n"
+        "allow with-interface match-all { 02:*:* 0a:*:* }\n"
+        "allow serial one-of { \"A1\" \"B2\" } via-port \"2-1\"\n"
+        "block id none-of { 1d6b:* } if false\n"
+        "reject with-interface none-of { 09:*:* }\n");
+
+    auto verdict = [&index](const DeviceArrivalRecord& arrival) { return index.evaluate(arrival); };
+
+    EXPECT_EQ(verdict(device(0x1d6b, 0x0002, {0x090000})).rule, 0);
+
+    // File order decides, across the exact, vendor and wildcard buckets
+    auto receiver = device(0x046d, 0xc52b, {0x030101, 0x080650});
+    EXPECT_EQ(verdict(receiver).verdict, PolicyVerdict::Blocked);
+    EXPECT_EQ(verdict(receiver).rule, 1);
+    EXPECT_EQ(verdict(device(0x046d, 0xc52b, {0x030101, 0x030102})).rule, 2);
+    EXPECT_EQ(verdict(device(0x046d, 0x0001, {0x030102})).rule, 2);
+
+    // equals needs the same set, match-all only covers the device's
+    EXPECT_EQ(verdict(device(0x0781, 0x5567, {0x080650})).rule, 3);
+    EXPECT_EQ(verdict(device(0x0781, 0x5567, {0x080650, 0x080650})).verdict, PolicyVerdict::Blocked);
+    EXPECT_EQ(verdict(device(0x2341, 0x0043, {0x020201, 0x0a0000})).rule, 4);
+
+    EXPECT_EQ(verdict(device(0x1234, 0x0001, {0xff0000}, "B2", "2-1")).rule, 5);
+    EXPECT_EQ(verdict(device(0x1234, 0x0001, {0xff0000}, "B2", "2-2")).rule, 7);
+
+    // Nothing matched
+    EXPECT_EQ(verdict(device(0x1d6b, 0x0003, {0x090000})).verdict, PolicyVerdict::NotWhitelisted);
+    EXPECT_EQ(verdict(device(0x1d6b, 0x0003, {0x090000})).rule, -1);
+}
+
+TEST_F(UsbGuardRulesTest, NativeRulesComeFirst) {
+    SecurityRule native{};
+    native.vendorId = 0x0781;
+    native.productId = 0x5567;
+    native.isWhitelisted = true;
+    auto ruleSet = parseUsbGuardRules("block id 0781:5567\nallow id 0781:*\n");
+    PolicyIndex index({native}, ruleSet.rules);
+
+    EXPECT_EQ(index.evaluate(device(0x0781, 0x5567, {})).verdict, PolicyVerdict::Allow);
+    EXPECT_EQ(index.evaluate(device(0x0781, 0x5567, {})).rule, 0);
+    EXPECT_EQ(index.evaluate(device(0x0781, 0x5568, {})).rule, 2);
+}
+
+// The same policy written natively and as USBGuard rules decides alike
+TEST_F(UsbGuardRulesTest, ImportedMatchesNativeDecisions) {
+    std::mt19937 rng(5);
+    std::vector<SecurityRule> native;
+    std::string text;
+    char line[96];
+    for (int i = 0; i < 300; i++) {
+        SecurityRule rule{};
+        rule.vendorId = uint16_t(0x1000 + i / 10);
+        rule.productId = uint16_t(i % 10);
+        rule.isWhitelisted = rng() % 4 != 0;
+        if (rng() % 2) rule.allowedInterfaces = {"0x03", "0x08"};
+        native.push_back(rule);
+
+        std::snprintf(line, sizeof(line), "%s id %04x:%04x%s\n", rule.isWhitelisted ? "allow" : "block",
+                      rule.vendorId, rule.productId,
+                      rule.allowedInterfaces.empty() ? "" : " with-interface match-all { 03:*:* 08:*:* }");
+        text += line;
+    }
+    auto ruleSet = parseUsbGuardRules(text);
+    ASSERT_TRUE(ruleSet.errors.empty());
+
+    std::vector<DeviceArrivalRecord> history;
+    uint32_t types[] = {0x030101, 0x080650, 0xff0000, 0x0e0100};
+    for (int i = 0; i < 100000; i++) {
+        auto arrival = device(uint16_t(0x1000 + rng() % 32), uint16_t(rng() % 10), {});
+        for (int n = 1 + rng() % 2; n > 0; n--) {
+            uint32_t type = types[rng() % (rng() % 3 ? 2 : 4)];
+            arrival.interfaceTypes.push_back(type);
+            arrival.interfaceClasses.set(type >> 16);
+        }
+        history.push_back(std::move(arrival));
+    }
+
+    PolicyIndex nativeIndex(native);
+    PolicyIndex importedIndex({}, ruleSet.rules);
+    for (const auto& arrival : history) {
+        ASSERT_EQ(isAllowed(nativeIndex.evaluate(arrival).verdict), isAllowed(importedIndex.evaluate(arrival).verdict));
+    }
+
+    PolicySimulator simulator;
+    auto report = simulator.run(history, nativeIndex, importedIndex);
+    EXPECT_EQ(report.newlyAllowed, 0u);
+    EXPECT_EQ(report.newlyBlocked, 0u);
+}
+
+// A rule bucketed both by device and by vendor is tried once, in its place
+TEST_F(UsbGuardRulesTest, RuleInSeveralBucketsKeepsItsOrder) {
+    auto index = compile(
+        "block id one-of { 1234:5678 1234:* } via-port \"9-9\"\n"
+        "allow id one-of { 1234:5678 1234:* } with-interface 08:*:*\n"
+        "allow id 1234:5678\n");
+
+    EXPECT_EQ(index.evaluate(device(0x1234, 0x5678, {0x030101}, "", "9-9")).rule, 0);
+    EXPECT_EQ(index.evaluate(device(0x1234, 0x5678, {0x080650})).rule, 1);
+    EXPECT_EQ(index.evaluate(device(0x1234, 0x5678, {0x030101})).rule, 2);
+    EXPECT_EQ(index.evaluate(device(0x1234, 0x0001, {0x080650})).rule, 1);
+    EXPECT_EQ(index.evaluate(device(0x1234, 0x0001, {0x030101})).verdict, PolicyVerdict::NotWhitelisted);
+}
+
+// A fleet-sized rule file, mostly per-device allow rules with a tail of
+// vendor and class rules, decides every arrival as file order says
+TEST_F(UsbGuardRulesTest, EvaluatesLargeRuleFiles) {
+    std::string text;
+    char line[96];
+    for (int i = 0; i < 5000; i++) {
+        std::snprintf(line, sizeof(line), "allow id %04x:%04x with-interface one-of { 03:*:* 08:*:* }\n",
+                      0x2000 + i / 50, i % 50);
+        text += line;
+    }
+    for (int i = 0; i < 200; i++) {
+        std::snprintf(line, sizeof(line), "block id %04x:* via-port \"3-%d\"\n", 0x2000 + i, i % 4);
+        text += line;
+    }
+    text += "reject with-interface one-of { 08:*:* }\nallow with-interface all-of { 09:*:* }\n";
+    auto index = compile(text);
+
+    std::mt19937 rng(9);
+    size_t allowed = 0;
+    for (int i = 0; i < 20000; i++) {
+        int vendor = int(rng() % 150);
+        int product = int(rng() % 60);
+        uint32_t type = rng() % 2 ? 0x030101u : 0x080650u;
+        int port = int(rng() % 8);
+        auto decision = index.evaluate(device(uint16_t(0x2000 + vendor), uint16_t(product), {type}, "",
+                                              "3-" + std::to_string(port)));
+
+        if (vendor < 100 && product < 50) {
+            ASSERT_EQ(decision.verdict, PolicyVerdict::Allow);
+            ASSERT_EQ(decision.rule, vendor * 50 + product);
+            allowed++;
+        } else if (port == vendor % 4) {
+            ASSERT_EQ(decision.verdict, PolicyVerdict::Blocked);
+            ASSERT_EQ(decision.rule, 5000 + vendor);
+        } else if (type == 0x080650u) {
+            ASSERT_EQ(decision.verdict, PolicyVerdict::Blocked);
+            ASSERT_EQ(decision.rule, 5200);
+        } else {
+            ASSERT_EQ(decision.verdict, PolicyVerdict::NotWhitelisted);
+        }
+    }
+    EXPECT_GT(allowed, 0u);
+}
+
+} // namespace testing
+} // namespace usb_monitor
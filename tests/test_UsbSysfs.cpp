@@ -0,0 +1,111 @@
+// tests/test_UsbSysfs.cpp
+#include <gtest/gtest.h>
+#include "../src/core/UsbSysfs.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace usb_monitor {
+namespace testing {
+
+namespace fs = std::filesystem;
+
+// Two buses and a device with two interfaces, laid out like
+// /sys/bus/usb/devices
+class UsbSysfsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        previous = usbSysfsRoot();
+        root = fs::path(::testing::TempDir()) / "usb_sysfs";
+        fs::remove_all(root);
+        
+        write("usb1/interface_authorized_default", "1\n");
+        write("usb2/interface_authorized_default", "1\n");
+        write("1-2/authorized", "1\n");
+        write("1-2/idVendor", "0781\n");
+        write("1-2/1-2:1.0/authorized", "1\n");
+        write("1-2/1-2:1.1/authorized", "1\n");
+        setUsbSysfsRoot(root.string());
+    }
+    
+    void TearDown() override {
+        setUsbSysfsRoot(previous);
+        fs::remove_all(root);
+    }
+    
+    void write(const std::string& file, const std::string& contents) {
+        fs::path path = root / file;
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << contents;
+    }
+    
+    std::string read(const std::string& file) {
+        std::ifstream in(root / file);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+    
+    std::string previous;
+    fs::path root;
+};
+
+TEST_F(UsbSysfsTest, ReadsAttributesUnderRoot) {
+    EXPECT_EQ(readUsbAttribute("1-2", "idVendor"), "0781");
+    EXPECT_EQ(readUsbAttribute("1-2", "idProduct"), "");
+    EXPECT_EQ(readUsbAttribute("1-3", "idVendor"), "");
+}
+
+TEST_F(UsbSysfsTest, AuthorizesDevicesAndInterfaces) {
+    EXPECT_TRUE(setUsbDeviceAuthorized("1-2", false));
+    EXPECT_EQ(read("1-2/authorized"), "0");
+    
+    EXPECT_TRUE(setUsbInterfaceAuthorized("1-2", 1, 1, false));
+    EXPECT_EQ(read("1-2/1-2:1.1/authorized"), "0");
+    EXPECT_EQ(read("1-2/1-2:1.0/authorized"), "1");
+    
+    EXPECT_TRUE(setUsbInterfaceAuthorized("1-2", 1, 1, true));
+    EXPECT_EQ(read("1-2/1-2:1.1/authorized"), "1");
+    
+    // Nothing is created for a device or interface that is not there
+    EXPECT_FALSE(setUsbDeviceAuthorized("1-3", false));
+    EXPECT_FALSE(setUsbInterfaceAuthorized("1-2", 1, 2, false));
+    EXPECT_FALSE(fs::exists(root / "1-3"));
+    EXPECT_FALSE(fs::exists(root / "1-2/1-2:1.2"));
+}
+
+TEST_F(UsbSysfsTest, RestoresHeldInterfaceDefault) {
+    write("usb2/interface_authorized_default", "0\n");
+    
+    EXPECT_EQ(holdUsbInterfaceAuthorizedDefault(), 2u);
+    EXPECT_TRUE(usbInterfaceAuthorizedDefaultHeld());
+    EXPECT_EQ(read("usb1/interface_authorized_default"), "0");
+    // Devices are not buses
+    EXPECT_FALSE(fs::exists(root / "1-2/interface_authorized_default"));
+    
+    // Holding again adds nothing, and a bus the system had off stays off
+    EXPECT_EQ(holdUsbInterfaceAuthorizedDefault(), 2u);
+    restoreUsbInterfaceAuthorizedDefault();
+    EXPECT_FALSE(usbInterfaceAuthorizedDefaultHeld());
+    EXPECT_EQ(read("usb1/interface_authorized_default"), "1");
+    EXPECT_EQ(read("usb2/interface_authorized_default"), "0");
+}
+
+TEST_F(UsbSysfsTest, RestoresHeldInterfaceDefaultOnFatalSignal) {
+    EXPECT_EXIT({
+        holdUsbInterfaceAuthorizedDefault();
+        std::raise(SIGTERM);
+    }, ::testing::KilledBySignal(SIGTERM), "");
+    EXPECT_EQ(read("usb1/interface_authorized_default"), "1");
+    EXPECT_EQ(read("usb2/interface_authorized_default"), "1");
+    
+    EXPECT_EXIT({
+        holdUsbInterfaceAuthorizedDefault();
+        std::exit(0);
+    }, ::testing::ExitedWithCode(0), "");
+    EXPECT_EQ(read("usb1/interface_authorized_default"), "1");
+}
+
+} // namespace testing
+} // namespace usb_monitor
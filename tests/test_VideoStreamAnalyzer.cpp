@@ -0,0 +1,200 @@
+// tests/test_VideoStreamAnalyzer.cpp
+#include <gtest/gtest.h>
+#include "UrbEvents.hpp"
+#include "../src/analysis/VideoStreamAnalyzer.hpp"
+#include <vector>
+
+using namespace usb_monitor;
+using namespace usb_monitor::testing;
+
+namespace {
+
+struct Payload {
+    uint8_t info;           // bmHeaderInfo
+    uint32_t bytes;         // Image data after the header
+    int32_t status{0};
+    uint32_t pts{0};
+};
+
+// One captured completion and the buffers it points into
+struct Capture {
+    std::vector<uint8_t> data;
+    std::vector<IsoPacketDescriptor> packets;
+    UrbEvent event;
+};
+
+void appendPayload(std::vector<uint8_t>& data, const Payload& payload) {
+    bool withPts = payload.info & 0x04;
+    uint8_t header = withPts ? 6 : 2;
+    data.push_back(header);
+    data.push_back(0x80 | payload.info);
+    if (withPts) {
+        for (int i = 0; i < 4; i++) data.push_back(uint8_t(payload.pts >> (8 * i)));
+    }
+    data.insert(data.end(), payload.bytes, 0xAB);
+}
+
+Capture isoTransfer(int64_t timestamp, const std::vector<Payload>& payloads) {
+    Capture capture;
+    for (const auto& payload : payloads) {
+        uint32_t offset = uint32_t(capture.data.size());
+        appendPayload(capture.data, payload);
+        uint32_t length = uint32_t(capture.data.size()) - offset;
+        capture.packets.push_back({payload.status, offset, payload.status ? 0 : length, 0});
+    }
+    
+    auto& event = capture.event;
+    event = urbEvent('C', LIBUSB_TRANSFER_TYPE_ISOCHRONOUS, 2, 5, 0x81, timestamp,
+                     uint32_t(capture.data.size()));
+    event.data = capture.data.data();
+    event.capturedLength = event.length;
+    event.isoPackets = capture.packets.data();
+    event.isoPacketCount = uint32_t(capture.packets.size());
+    return capture;
+}
+
+// A frame of four 3000 byte payloads, the last one with EOF
+Capture isoFrame(int64_t timestamp, int fid, int32_t failedStatus = 0) {
+    uint8_t info = uint8_t(fid);
+    return isoTransfer(timestamp, {
+        {info, 3000}, {info, 3000, failedStatus}, {info, 3000}, {uint8_t(info | 0x02), 3000}
+    });
+}
+
+} // namespace
+
+TEST(VideoStreamAnalyzerTest, CountsFramesAndDroppedFrames) {
+    VideoStreamAnalyzer analyzer;
+    analyzer.addEndpoint(2, 5, 0x81);
+    
+    // 30 fps for ten seconds; every 25th frame never arrives, but the FID
+    // still toggles as the camera moves on
+    int64_t now = T0;
+    int fid = 0;
+    int sent = 0;
+    for (int frame = 0; frame < 300; frame++) {
+        now += 33333;
+        fid ^= 1;
+        if (frame % 25 == 24) continue;
+        auto capture = isoFrame(now, fid);
+        analyzer.process(capture.event);
+        sent++;
+    }
+    
+    auto stats = analyzer.streamStats(2, 5);
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].frames, uint64_t(sent));
+    EXPECT_EQ(stats[0].droppedFrames, 11u);     // The last loss has no frame after it
+    EXPECT_EQ(stats[0].truncatedFrames, 0u);
+    EXPECT_EQ(stats[0].minFrameSize, 12000u);
+    EXPECT_NEAR(stats[0].nominalFrameRate, 30.0, 3.0);
+    EXPECT_NEAR(stats[0].frameRate, 28.8, 2.0);
+    EXPECT_NEAR(stats[0].throughput, 28.8 * 12000, 40000);
+    EXPECT_EQ(stats[0].isoPackets, uint64_t(sent) * 4);
+    EXPECT_EQ(stats[0].isoPacketErrors, 0u);
+}
+
+TEST(VideoStreamAnalyzerTest, FlagsTruncatedFramesAndIsoErrors) {
+    VideoStreamAnalyzer analyzer;
+    analyzer.addEndpoint(2, 5, 0x81);
+    
+    int64_t now = T0;
+    int fid = 0;
+    for (int frame = 0; frame < 100; frame++) {
+        now += 33333;
+        fid ^= 1;
+        
+        // Every tenth frame loses a packet on the bus (-EPROTO)
+        auto capture = isoFrame(now, fid, frame % 10 == 3 ? -71 : 0);
+        analyzer.process(capture.event);
+    }
+    
+    // The device reports an error of its own, and a FID toggle without
+    // EOF still closes the frame
+    now += 33333;
+    fid ^= 1;
+    auto errored = isoTransfer(now, {{uint8_t(fid), 3000}, {uint8_t(fid | 0x40), 3000}});
+    analyzer.process(errored.event);
+    now += 33333;
+    auto next = isoFrame(now, fid ^ 1);
+    analyzer.process(next.event);
+    
+    auto stats = analyzer.streamStats(2, 5)[0];
+    EXPECT_EQ(stats.frames, 102u);
+    EXPECT_EQ(stats.truncatedFrames, 11u);
+    EXPECT_EQ(stats.erroredPayloads, 1u);
+    EXPECT_EQ(stats.isoPacketErrors, 10u);
+    EXPECT_NEAR(stats.isoErrorRate, 10.0 / 406, 1e-9);
+    EXPECT_EQ(stats.minFrameSize, 6000u);
+    EXPECT_EQ(stats.droppedFrames, 0u);
+}
+
+TEST(VideoStreamAnalyzerTest, UsesPtsForCadenceWhenClockIsKnown) {
+    VideoStreamAnalyzer analyzer;
+    analyzer.addEndpoint(2, 5, 0x81, 48000000);     // 48 MHz device clock
+    
+    // The host sees frames in irregular bursts, the camera's PTS is steady
+    // at 60 fps; frames 50 and 51 are lost
+    int64_t now = T0;
+    uint32_t pts = 0xFFF00000;      // Wraps during the run
+    int fid = 0;
+    for (int frame = 0; frame < 120; frame++) {
+        pts += 800000;
+        fid ^= 1;
+        now += frame % 3 == 0 ? 40000 : 5000;
+        if (frame == 50 || frame == 51) continue;
+        
+        uint8_t info = uint8_t(fid | 0x04);
+        auto capture = isoTransfer(now, {{info, 4000, 0, pts}, {uint8_t(info | 0x02), 4000, 0, pts}});
+        analyzer.process(capture.event);
+    }
+    
+    auto stats = analyzer.streamStats(2, 5)[0];
+    EXPECT_TRUE(stats.hasPts);
+    EXPECT_FALSE(stats.hasScr);
+    EXPECT_EQ(stats.frames, 118u);
+    EXPECT_EQ(stats.droppedFrames, 2u);
+    EXPECT_NEAR(stats.nominalFrameRate, 60.0, 4.0);
+}
+
+TEST(VideoStreamAnalyzerTest, BulkPayloadsAndBadHeaders) {
+    VideoStreamAnalyzer analyzer;
+    analyzer.addEndpoint(2, 5, 0x82);
+    
+    auto bulk = [&](int64_t timestamp, std::vector<uint8_t> data) {
+        auto event = urbEvent('C', LIBUSB_TRANSFER_TYPE_BULK, 2, 5, 0x82, timestamp,
+                              uint32_t(data.size()));
+        event.data = data.data();
+        event.capturedLength = event.length;
+        analyzer.process(event);
+    };
+    
+    int64_t now = T0;
+    for (int frame = 0; frame < 10; frame++) {
+        uint8_t fid = frame & 1;
+        for (int part = 0; part < 3; part++) {
+            std::vector<uint8_t> data;
+            appendPayload(data, {uint8_t(fid | (part == 2 ? 0x02 : 0)), 16000});
+            bulk(now += 1000, data);
+        }
+        now += 30000;
+    }
+    
+    // A header length larger than the payload is not a UVC header
+    bulk(now, {40, 0x80, 1, 2, 3});
+    
+    // Other endpoints and directions are ignored
+    analyzer.process(urbEvent('C', LIBUSB_TRANSFER_TYPE_BULK, 2, 5, 0x02, now));
+    
+    auto stats = analyzer.streamStats(2, 5);
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].transferType, LIBUSB_TRANSFER_TYPE_BULK);
+    EXPECT_EQ(stats[0].frames, 10u);
+    EXPECT_EQ(stats[0].p50FrameSize, 48000u);
+    EXPECT_EQ(stats[0].payloads, 31u);
+    EXPECT_EQ(stats[0].invalidHeaders, 1u);
+    EXPECT_EQ(stats[0].isoPackets, 0u);
+    
+    analyzer.removeDevice(2, 5);
+    EXPECT_TRUE(analyzer.streamStats(2, 5).empty());
+}
@@ -0,0 +1,73 @@
+// tests/test_WorkerPool.cpp
+#include <gtest/gtest.h>
+#include "../src/core/WorkerPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace usb_monitor {
+namespace testing {
+
+class WorkerPoolTest : public ::testing::Test {
+protected:
+    static constexpr int kArrivals = 100;
+};
+
+TEST_F(WorkerPoolTest, RunsAllJobs) {
+    WorkerPool pool(4);
+    std::atomic<int> completed{0};
+    
+    for (int i = 0; i < kArrivals; i++) {
+        pool.submit([&completed]() { completed++; });
+    }
+    pool.waitIdle();
+    
+    EXPECT_EQ(completed.load(), kArrivals);
+    EXPECT_EQ(pool.pendingJobs(), 0u);
+}
+
+TEST_F(WorkerPoolTest, SingleWorkerKeepsSubmissionOrder) {
+    WorkerPool pool(1);
+    std::vector<int> order;
+    
+    for (int i = 0; i < kArrivals; i++) {
+        pool.submit([&order, i]() { order.push_back(i); });
+    }
+    pool.waitIdle();
+    
+    ASSERT_EQ(order.size(), size_t(kArrivals));
+    for (int i = 0; i < kArrivals; i++) {
+        EXPECT_EQ(order[i], i);
+    }
+}
+
+TEST_F(WorkerPoolTest, BlockedArrivalsRunTogether) {
+    // Each job blocks until a whole batch of arrivals is in flight, which
+    // only happens if the pool runs one per worker at the same time
+    constexpr int kWorkers = 8;
+    WorkerPool pool(kWorkers);
+    std::mutex mutex;
+    std::condition_variable allStarted;
+    int started = 0;
+    std::atomic<int> batched{0};
+    
+    for (int i = 0; i < kWorkers; i++) {
+        pool.submit([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            started++;
+            allStarted.notify_all();
+            if (allStarted.wait_for(lock, std::chrono::seconds(30), [&] { return started == kWorkers; })) {
+                batched++;
+            }
+        });
+    }
+    pool.waitIdle();
+    
+    EXPECT_EQ(pool.threadCount(), size_t(kWorkers));
+    EXPECT_EQ(batched.load(), kWorkers);
+}
+
+} // namespace testing
+} // namespace usb_monitor